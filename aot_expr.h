@@ -0,0 +1,60 @@
+/* Generated by mexprgen from: a = 1.5; b = -2; c = 0.5; ax^2 + bx + c + sin(x)cos(x)/(1 + x^2) */
+
+#pragma once
+
+#include <complex>
+#include <cmath>
+#include <stddef.h>
+
+typedef double mexpr_fn_num;
+
+static const char * const mexpr_fn_expression = "a = 1.5; b = -2; c = 0.5; ax^2 + bx + c + sin(x)cos(x)/(1 + x^2)";
+static const size_t mexpr_fn_nvars = 4;
+static const char * const mexpr_fn_vars[] = { "a", "b", "c", "x", nullptr };
+
+static inline mexpr_fn_num mexpr_fn_fact( const mexpr_fn_num & a )
+{
+	return std::tgamma( a + 1.0 );
+}
+
+static inline mexpr_fn_num mexpr_fn( const mexpr_fn_num * x )
+{
+	mexpr_fn_num v_a = x[ 0 ];
+	mexpr_fn_num v_b = x[ 1 ];
+	mexpr_fn_num v_c = x[ 2 ];
+	mexpr_fn_num v_x = x[ 3 ];
+
+	v_a = 0x1.8p+0;
+	const mexpr_fn_num r0 = v_a;
+	const mexpr_fn_num r1 = -0x1p+1;
+	v_b = r1;
+	const mexpr_fn_num r2 = v_b;
+	v_c = 0x1p-1;
+	const mexpr_fn_num r3 = v_c;
+	const mexpr_fn_num r4 = std::pow( v_x, 0x1p+1 );
+	const mexpr_fn_num r5 = v_a * r4;
+	const mexpr_fn_num r6 = v_b * v_x;
+	const mexpr_fn_num r7 = r5 + r6;
+	const mexpr_fn_num r8 = r7 + v_c;
+	const mexpr_fn_num r9 = std::sin( v_x );
+	const mexpr_fn_num r10 = std::cos( v_x );
+	const mexpr_fn_num r11 = r9 * r10;
+	const mexpr_fn_num r12 = std::pow( v_x, 0x1p+1 );
+	const mexpr_fn_num r13 = 0x1p+0 + r12;
+	const mexpr_fn_num r14 = ( r13 );
+	const mexpr_fn_num r15 = r11 / r14;
+	const mexpr_fn_num r16 = r8 + r15;
+	const mexpr_fn_num r17 = r16;
+	const mexpr_fn_num r18 = r17;
+	const mexpr_fn_num r19 = r18;
+	return r19;
+}
+
+static void mexpr_fn_batch( const mexpr_fn_num * const * cols, mexpr_fn_num * out, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const mexpr_fn_num x[] = { cols[ 0 ][ i ], cols[ 1 ][ i ], cols[ 2 ][ i ], cols[ 3 ][ i ], };
+		out[ i ] = mexpr_fn( x );
+	}
+}
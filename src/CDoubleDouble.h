@@ -0,0 +1,254 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Double-double numbers: unevaluated sum of two doubles with about 106 bits of mantissa,
+   and complex numbers of them. Arithmetic is in CDoubleDoubleImpl.h, shared with the kernels */
+
+#pragma once
+
+#include "w32def.h"
+#include <float.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <cmath>
+#include <limits>
+
+typedef struct _tagDOUBLE_DOUBLE
+{
+	double						hi;
+	double						lo;			// |lo| <= ulp( hi ) / 2
+} DOUBLE_DOUBLE, *PDOUBLE_DOUBLE;
+
+#define KERNEL_NS ddscalar
+#if defined( __FMA__ ) || defined( __ARM_FEATURE_FMA )
+#define KERNEL_FMA 1
+#else
+#define KERNEL_FMA 0
+#endif
+#include "CDoubleDoubleImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_FMA
+
+class CDoubleDouble : public DOUBLE_DOUBLE
+{
+public:
+	CDoubleDouble()
+	{
+		hi = lo = 0.0;
+	}
+
+	CDoubleDouble( double d )
+	{
+		hi = d;
+		lo = 0.0;
+	}
+
+	CDoubleDouble( double h, double l )
+	{
+		hi = h;
+		lo = l;
+	}
+
+	CDoubleDouble( const DOUBLE_DOUBLE & dd )
+	{
+		hi = dd.hi;
+		lo = dd.lo;
+	}
+
+	// exact, long double has 64 bits of mantissa
+	explicit CDoubleDouble( long double d )
+	{
+		hi = double( d );
+		lo = ( std::fabs( hi ) <= DBL_MAX ? double( d - hi ) : 0.0 );
+	}
+
+	explicit CDoubleDouble( int n )
+	{
+		hi = n;
+		lo = 0.0;
+	}
+
+	explicit operator long double() const
+	{
+		return static_cast<long double>( hi ) + lo;
+	}
+
+	CDoubleDouble operator-() const { return ddscalar::DDNeg( *this ); }
+	CDoubleDouble operator+( const CDoubleDouble & b ) const { return ddscalar::DDAdd( *this, b ); }
+	CDoubleDouble operator-( const CDoubleDouble & b ) const { return ddscalar::DDSub( *this, b ); }
+	CDoubleDouble operator*( const CDoubleDouble & b ) const { return ddscalar::DDMul( *this, b ); }
+	CDoubleDouble operator/( const CDoubleDouble & b ) const { return ddscalar::DDDiv( *this, b ); }
+	CDoubleDouble & operator+=( const CDoubleDouble & b ) { return ( *this = *this + b ); }
+	CDoubleDouble & operator-=( const CDoubleDouble & b ) { return ( *this = *this - b ); }
+	CDoubleDouble & operator*=( const CDoubleDouble & b ) { return ( *this = *this * b ); }
+	CDoubleDouble & operator/=( const CDoubleDouble & b ) { return ( *this = *this / b ); }
+
+	bool operator==( const CDoubleDouble & b ) const { return ( hi == b.hi && lo == b.lo ); }
+	bool operator!=( const CDoubleDouble & b ) const { return !( *this == b ); }
+	bool operator<( const CDoubleDouble & b ) const { return ( hi < b.hi || ( hi == b.hi && lo < b.lo ) ); }
+	bool operator>( const CDoubleDouble & b ) const { return ( b < *this ); }
+	bool operator<=( const CDoubleDouble & b ) const { return !( b < *this ); }
+	bool operator>=( const CDoubleDouble & b ) const { return !( *this < b ); }
+
+	static CDoubleDouble	Pi() { return CDoubleDouble( 0x1.921fb54442d18p+1, 0x1.1a62633145c07p-53 ); }
+	static CDoubleDouble	E() { return CDoubleDouble( 0x1.5bf0a8b145769p+1, 0x1.4d57ee2b1013ap-53 ); }
+
+	static CDoubleDouble	Abs( const CDoubleDouble & a ) { return ( a.hi < 0 ? -a : a ); }
+	static CDoubleDouble	Sqr( const CDoubleDouble & a ) { return ddscalar::DDSqr( a ); }
+	static CDoubleDouble	Sqrt( const CDoubleDouble & a ) { return ddscalar::DDSqrt( a ); }
+	static CDoubleDouble	Exp( const CDoubleDouble & a ) { return ddscalar::DDExp( a ); }
+	static CDoubleDouble	Log( const CDoubleDouble & a ) { return ddscalar::DDLog( a ); }
+	static CDoubleDouble	Atan2( const CDoubleDouble & y, const CDoubleDouble & x ) { return ddscalar::DDAtan2( y, x ); }
+
+	static VOID				SinCos( const CDoubleDouble & a, CDoubleDouble & s, CDoubleDouble & c )
+	{
+		ddscalar::DDSinCos( a, s, c );
+	}
+
+	// sinh and cosh by one exponent, sinh loses the relative accuracy for |a| near zero
+	static VOID				SinhCosh( const CDoubleDouble & a, CDoubleDouble & sh, CDoubleDouble & ch )
+	{
+		const CDoubleDouble e = Exp( a ), ie = CDoubleDouble( 1.0 ) / e;
+		sh = ddscalar::DDScale( e - ie, 0.5 );
+		ch = ddscalar::DDScale( e + ie, 0.5 );
+	}
+};
+
+class CComplexDD
+{
+public:
+	CDoubleDouble				re;
+	CDoubleDouble				im;
+
+	CComplexDD() {}
+	CComplexDD( double r ) : re( r ) {}
+	CComplexDD( const CDoubleDouble & r ) : re( r ) {}
+	CComplexDD( const CDoubleDouble & r, const CDoubleDouble & i ) : re( r ), im( i ) {}
+
+	CComplexDD operator-() const { return CComplexDD( -re, -im ); }
+	CComplexDD operator+( const CComplexDD & b ) const { return CComplexDD( re + b.re, im + b.im ); }
+	CComplexDD operator-( const CComplexDD & b ) const { return CComplexDD( re - b.re, im - b.im ); }
+
+	CComplexDD operator*( const CComplexDD & b ) const
+	{
+		CComplexDD z;
+		ddscalar::DDCMul( re, im, b.re, b.im, z.re, z.im );
+		return z;
+	}
+
+	CComplexDD operator/( const CComplexDD & b ) const
+	{
+		CComplexDD z;
+		ddscalar::DDCDiv( re, im, b.re, b.im, z.re, z.im );
+		return z;
+	}
+
+	CComplexDD & operator+=( const CComplexDD & b ) { return ( *this = *this + b ); }
+	CComplexDD & operator-=( const CComplexDD & b ) { return ( *this = *this - b ); }
+	CComplexDD & operator*=( const CComplexDD & b ) { return ( *this = *this * b ); }
+	CComplexDD & operator/=( const CComplexDD & b ) { return ( *this = *this / b ); }
+
+	bool operator==( const CComplexDD & b ) const { return ( re == b.re && im == b.im ); }
+	bool operator!=( const CComplexDD & b ) const { return !( *this == b ); }
+
+	static CDoubleDouble	Abs( const CComplexDD & a )
+	{
+		return CDoubleDouble::Sqrt( CDoubleDouble::Sqr( a.re ) + CDoubleDouble::Sqr( a.im ) );
+	}
+
+	static CComplexDD		Exp( const CComplexDD & a )
+	{
+		CComplexDD z;
+		ddscalar::DDCExp( a.re, a.im, z.re, z.im );
+		return z;
+	}
+
+	static CComplexDD		Log( const CComplexDD & a )
+	{
+		const CDoubleDouble r2 = CDoubleDouble::Sqr( a.re ) + CDoubleDouble::Sqr( a.im );
+		return CComplexDD( ddscalar::DDScale( CDoubleDouble::Log( r2 ), 0.5 ), CDoubleDouble::Atan2( a.im, a.re ) );
+	}
+
+	// principal root
+	static CComplexDD		Sqrt( const CComplexDD & a )
+	{
+		if ( a.re.hi == 0 && a.im.hi == 0 )
+		{
+			return CComplexDD( 0.0, a.im );
+		}
+
+		const CDoubleDouble r = Abs( a );
+		if ( a.re.hi >= 0 )
+		{
+			const CDoubleDouble t = CDoubleDouble::Sqrt( ddscalar::DDScale( r + a.re, 0.5 ) );
+			return CComplexDD( t, a.im / ddscalar::DDScale( t, 2.0 ) );
+		}
+
+		const CDoubleDouble t = CDoubleDouble::Sqrt( ddscalar::DDScale( r - a.re, 0.5 ) );
+		return CComplexDD( CDoubleDouble::Abs( a.im ) / ddscalar::DDScale( t, 2.0 ), a.im.hi < 0 ? -t : t );
+	}
+
+	// zero base gives zero as std::pow
+	static CComplexDD		Pow( const CComplexDD & a, const CComplexDD & b )
+	{
+		if ( a.re.hi == 0 && a.im.hi == 0 )
+		{
+			return CComplexDD();
+		}
+
+		return Exp( b * Log( a ) );
+	}
+
+	static CComplexDD		Sin( const CComplexDD & a )
+	{
+		CDoubleDouble s, c, sh, ch;
+		CDoubleDouble::SinCos( a.re, s, c );
+		CDoubleDouble::SinhCosh( a.im, sh, ch );
+		return CComplexDD( s * ch, c * sh );
+	}
+
+	static CComplexDD		Cos( const CComplexDD & a )
+	{
+		CDoubleDouble s, c, sh, ch;
+		CDoubleDouble::SinCos( a.re, s, c );
+		CDoubleDouble::SinhCosh( a.im, sh, ch );
+		return CComplexDD( c * ch, -( s * sh ) );
+	}
+
+	static CComplexDD		Tan( const CComplexDD & a )
+	{
+		return Sin( a ) / Cos( a );
+	}
+
+	// asin( z ) = -i log( iz + sqrt( 1 - z^2 ) )
+	static CComplexDD		Asin( const CComplexDD & a )
+	{
+		const CComplexDD w = Log( CComplexDD( -a.im, a.re ) + Sqrt( CComplexDD( 1.0 ) - a * a ) );
+		return CComplexDD( w.im, -w.re );
+	}
+
+	static CComplexDD		Acos( const CComplexDD & a )
+	{
+		return CComplexDD( ddscalar::DDScale( CDoubleDouble::Pi(), 0.5 ) ) - Asin( a );
+	}
+
+	// atan( z ) = i/2 ( log( 1 - iz ) - log( 1 + iz ) )
+	static CComplexDD		Atan( const CComplexDD & a )
+	{
+		const CComplexDD w = Log( CComplexDD( CDoubleDouble( 1.0 ) + a.im, -a.re ) ) - Log( CComplexDD( CDoubleDouble( 1.0 ) - a.im, a.re ) );
+		return CComplexDD( ddscalar::DDScale( w.im, -0.5 ), ddscalar::DDScale( w.re, 0.5 ) );
+	}
+};
@@ -0,0 +1,547 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Bodies of the double-double arithmetic. CDoubleDouble.h includes this file for the scalar
+   type and CExprKernelsImpl.h once per instruction set, with KERNEL_NS defined to the name of
+   the instance and KERNEL_FMA to 1 if the instance has fused multiply-add, so there is no include guard.
+   Functions besides DDAtan2 have no branches: special values are selected at the end, so the
+   kernel loops are vectorized. Arithmetic, exp and the reduction of sin and cos follow the QD
+   library by Hida, Li and Bailey, log and atan take the nodes of tables */
+
+// the functions are inlined into the kernel loops, otherwise the loops are not vectorized
+#ifndef DD_INLINE
+#define DD_INLINE					inline __attribute__(( always_inline ))
+#endif
+
+namespace KERNEL_NS
+{
+
+// adding and subtracting it rounds to integer, the integer is in the low bits of the sum
+static const double			kDDRound = 0x1.8p52;
+static const double			kDDTrigMax = 0x1p50;		// quadrant of the reduction fits into the low bits
+
+static const double			kDDPio2[ 3 ] = { 0x1.921fb54442d18p+0, 0x1.1a62633145c07p-54, -0x1.f1976b7ed8fbcp-110 };
+static const double			kDDLn2[ 3 ] = { 0x1.62e42fefa39efp-1, 0x1.abc9e3b39803fp-56, 0x1.7b57a079a1934p-111 };
+
+// ( -1 )^j / ( 2j + 1 )! and ( -1 )^j / ( 2j )!, the last terms are below 2^-106 for |x| <= pi/4
+static const double			kDDSin[ 14 ][ 2 ] =
+{
+	{ 1.0, 0.0 }, { -0x1.5555555555555p-3, -0x1.5555555555555p-57 }, { 0x1.1111111111111p-7, 0x1.1111111111111p-63 },
+	{ -0x1.a01a01a01a01ap-13, -0x1.a01a01a01a01ap-73 }, { 0x1.71de3a556c734p-19, -0x1.c154f8ddc6c00p-73 },
+	{ -0x1.ae64567f544e4p-26, 0x1.c062e06d1f209p-80 }, { 0x1.6124613a86d09p-33, 0x1.f28e0cc748ebep-87 },
+	{ -0x1.ae7f3e733b81fp-41, -0x1.1d8656b0ee8cbp-97 }, { 0x1.952c77030ad4ap-49, 0x1.ac981465ddc6cp-103 },
+	{ -0x1.2f49b46814157p-57, -0x1.2650f61dbdcb4p-112 }, { 0x1.71b8ef6dcf572p-66, -0x1.d043ae40c4647p-120 },
+	{ -0x1.761b41316381ap-75, 0x1.3423c7d91404fp-130 }, { 0x1.3f3ccdd165fa9p-84, -0x1.58ddadf344487p-139 },
+	{ -0x1.d1ab1c2dccea3p-94, -0x1.054d0c78aea14p-149 }
+};
+
+static const double			kDDCos[ 15 ][ 2 ] =
+{
+	{ 1.0, 0.0 }, { -0.5, 0.0 }, { 0x1.5555555555555p-5, 0x1.5555555555555p-59 },
+	{ -0x1.6c16c16c16c17p-10, 0x1.f49f49f49f49fp-65 }, { 0x1.a01a01a01a01ap-16, 0x1.a01a01a01a01ap-76 },
+	{ -0x1.27e4fb7789f5cp-22, -0x1.cbbc05b4fa99ap-76 }, { 0x1.1eed8eff8d898p-29, -0x1.2aec959e14c06p-83 },
+	{ -0x1.93974a8c07c9dp-37, -0x1.05d6f8a2efd1fp-92 }, { 0x1.ae7f3e733b81fp-45, 0x1.1d8656b0ee8cbp-101 },
+	{ -0x1.6827863b97d97p-53, -0x1.eec01221a8b0bp-107 }, { 0x1.e542ba4020225p-62, 0x1.ea72b4afe3c2fp-120 },
+	{ -0x1.0ce396db7f853p-70, 0x1.aebcdbd20331cp-124 }, { 0x1.f2cf01972f578p-80, -0x1.9ada5fcc1ab14p-135 },
+	{ -0x1.88e85fc6a4e5ap-89, 0x1.71c37ebd16540p-143 }, { 0x1.0a18a2635085dp-98, 0x1.b9e2e28e1aa54p-153 }
+};
+
+// 1 / n! for n = 2..9, terms of expm1 for |x| <= ln2 / 1024
+static const double			kDDExp[ 8 ][ 2 ] =
+{
+	{ 0.5, 0.0 }, { 0x1.5555555555555p-3, 0x1.5555555555555p-57 }, { 0x1.5555555555555p-5, 0x1.5555555555555p-59 },
+	{ 0x1.1111111111111p-7, 0x1.1111111111111p-63 }, { 0x1.6c16c16c16c17p-10, -0x1.f49f49f49f49fp-65 },
+	{ 0x1.a01a01a01a01ap-13, 0x1.a01a01a01a01ap-73 }, { 0x1.a01a01a01a01ap-16, 0x1.a01a01a01a01ap-76 },
+	{ 0x1.71de3a556c734p-19, -0x1.c154f8ddc6c00p-73 }
+};
+
+// log( 1 + j / 128 ) for j = -38..53, the nodes of DDLog
+static const double			kDDLog[ 92 ][ 2 ] =
+{
+	{ -0x1.68ac83e9c6a14p-2, -0x1.a64eadd740178p-58 }, { -0x1.5d5bddf595f3p-2, 0x1.6541148cbb8a2p-56 },
+	{ -0x1.522ae0738a3d8p-2, 0x1.8f7e9b38a6979p-57 }, { -0x1.4718dc271c41bp-2, -0x1.8fb4c14c56eefp-60 },
+	{ -0x1.3c25277333184p-2, 0x1.2ad27e50a8ec6p-56 }, { -0x1.314f1e1d35ce4p-2, 0x1.3d69909e5c3dcp-56 },
+	{ -0x1.269621134db92p-2, -0x1.e0efadd9db02bp-56 }, { -0x1.1bf99635a6b95p-2, 0x1.12aeb84249223p-57 },
+	{ -0x1.1178e8227e47cp-2, 0x1.0e63a5f01c691p-57 }, { -0x1.07138604d5862p-2, -0x1.cdb16ed4e9138p-56 },
+	{ -0x1.f991c6cb3b379p-3, -0x1.f665066f980a2p-57 }, { -0x1.e530effe71012p-3, -0x1.2276041f43042p-59 },
+	{ -0x1.d1037f2655e7bp-3, -0x1.60629242471a2p-57 }, { -0x1.bd087383bd8adp-3, -0x1.dd355f6a516d7p-60 },
+	{ -0x1.a93ed3c8ad9e3p-3, -0x1.bcafa9de97203p-57 }, { -0x1.95a5adcf7017fp-3, -0x1.142c507fb7a3dp-58 },
+	{ -0x1.823c16551a3c2p-3, 0x1.1232ce70be781p-57 }, { -0x1.6f0128b756abcp-3, 0x1.8de59c21e166cp-57 },
+	{ -0x1.5bf406b543db2p-3, 0x1.1f5b44c0df7e7p-61 }, { -0x1.4913d8333b561p-3, 0x1.0d5604930f135p-58 },
+	{ -0x1.365fcb0159016p-3, -0x1.7d411a5b944adp-58 }, { -0x1.23d712a49c202p-3, 0x1.6e38161051d69p-57 },
+	{ -0x1.1178e8227e47cp-3, 0x1.0e63a5f01c691p-58 }, { -0x1.fe89139dbd566p-4, 0x1.ac9f4215f9393p-58 },
+	{ -0x1.da727638446a2p-4, -0x1.401fa71733019p-58 }, { -0x1.b6ac88dad5b1cp-4, 0x1.0057eed1ca59fp-59 },
+	{ -0x1.9335e5d594989p-4, 0x1.478a85704ccb7p-58 }, { -0x1.700d30aeac0e1p-4, 0x1.72566212cdd05p-61 },
+	{ -0x1.4d3115d207eacp-4, -0x1.769f42c7842ccp-58 }, { -0x1.2aa04a44717a5p-4, 0x1.d15d38d2fa3f7p-58 },
+	{ -0x1.08598b59e3a07p-4, 0x1.dd7009902bf32p-58 }, { -0x1.ccb73cdddb2ccp-5, 0x1.e48fb0500efd4p-59 },
+	{ -0x1.894aa149fb343p-5, -0x1.a8be97660a23dp-60 }, { -0x1.466aed42de3eap-5, 0x1.cdd6f7f4a137ep-59 },
+	{ -0x1.0415d89e74444p-5, -0x1.c05cf1d753622p-59 }, { -0x1.8492528c8cabfp-6, 0x1.d192d0619fa67p-60 },
+	{ -0x1.0205658935847p-6, -0x1.27c8e8416e71fp-60 }, { -0x1.010157588de71p-7, -0x1.46662d417cedp-62 },
+	{ 0.0, 0.0 }, { 0x1.fe02a6b106789p-8, -0x1.e44b7e3711ebep-67 },
+	{ 0x1.fc0a8b0fc03e4p-7, -0x1.83092c59642a1p-62 }, { 0x1.7b91b07d5b11bp-6, -0x1.5b602ace3a51p-60 },
+	{ 0x1.f829b0e7833p-6, 0x1.33e3f04f1ef23p-60 }, { 0x1.39e87b9febd6p-5, -0x1.5bfa937f551bbp-59 },
+	{ 0x1.77458f632dcfcp-5, 0x1.18d3ca87b9296p-59 }, { 0x1.b42dd711971bfp-5, -0x1.eb9759c130499p-60 },
+	{ 0x1.f0a30c01162a6p-5, 0x1.85f325c5bbacdp-59 }, { 0x1.16536eea37ae1p-4, -0x1.79da3e8c22cdap-60 },
+	{ 0x1.341d7961bd1d1p-4, -0x1.b599f227becbbp-58 }, { 0x1.51b073f06183fp-4, 0x1.a49e39a1a8be4p-58 },
+	{ 0x1.6f0d28ae56b4cp-4, -0x1.906d99184b992p-58 }, { 0x1.8c345d6319b21p-4, -0x1.4a697ab3424aap-61 },
+	{ 0x1.a926d3a4ad563p-4, 0x1.942f48aa70ea9p-58 }, { 0x1.c5e548f5bc743p-4, 0x1.5d617ef8161b1p-60 },
+	{ 0x1.e27076e2af2e6p-4, -0x1.61578001e0162p-60 }, { 0x1.fec9131dbeabbp-4, -0x1.5746b9981b36cp-58 },
+	{ 0x1.0d77e7cd08e59p-3, 0x1.9a5dc5e9030acp-57 }, { 0x1.1b72ad52f67ap-3, 0x1.483023472cd74p-58 },
+	{ 0x1.29552f81ff523p-3, 0x1.301771c407dbfp-57 }, { 0x1.371fc201e8f74p-3, 0x1.de6cb62af18ap-58 },
+	{ 0x1.44d2b6ccb7d1ep-3, 0x1.9f4f6543e1f88p-57 }, { 0x1.526e5e3a1b438p-3, -0x1.746ff8a470d3ap-57 },
+	{ 0x1.5ff3070a793d4p-3, -0x1.bc60efafc6f6ep-58 }, { 0x1.6d60fe719d21dp-3, -0x1.caae268ecd179p-57 },
+	{ 0x1.7ab890210d909p-3, 0x1.be36b2d6a0608p-59 }, { 0x1.87fa06520c911p-3, -0x1.bf7fdbfa08d9ap-57 },
+	{ 0x1.9525a9cf456b4p-3, 0x1.d904c1d4e2e26p-57 }, { 0x1.a23bc1fe2b563p-3, 0x1.93711b07a998cp-59 },
+	{ 0x1.af3c94e80bff3p-3, -0x1.398cff3641985p-58 }, { 0x1.bc286742d8cd6p-3, 0x1.4fce744870f55p-58 },
+	{ 0x1.c8ff7c79a9a22p-3, -0x1.4f689f8434012p-57 }, { 0x1.d5c216b4fbb91p-3, 0x1.6e443597e4d4p-57 },
+	{ 0x1.e27076e2af2e6p-3, -0x1.61578001e0162p-59 }, { 0x1.ef0adcbdc5936p-3, 0x1.48637950dc20dp-57 },
+	{ 0x1.fb9186d5e3e2bp-3, -0x1.caaae64f21acbp-57 }, { 0x1.0402594b4d041p-2, -0x1.28ec217a5022dp-57 },
+	{ 0x1.0a324e27390e3p-2, 0x1.7dcfde8061c03p-56 }, { 0x1.1058bf9ae4ad5p-2, 0x1.89fa0ab4cb31dp-58 },
+	{ 0x1.1675cababa60ep-2, 0x1.ce63eab883717p-61 }, { 0x1.1c898c16999fbp-2, -0x1.0e5c62aff1c44p-60 },
+	{ 0x1.22941fbcf7966p-2, -0x1.76f5eb09628afp-56 }, { 0x1.2895a13de86a3p-2, 0x1.7ad24c13f040ep-56 },
+	{ 0x1.2e8e2bae11d31p-2, -0x1.8f4cdb95ebdf9p-56 }, { 0x1.347dd9a987d55p-2, -0x1.4dd4c580919f8p-57 },
+	{ 0x1.3a64c556945eap-2, -0x1.c68651945f97cp-57 }, { 0x1.404308686a7e4p-2, -0x1.0bcfb6082ce6dp-56 },
+	{ 0x1.4618bc21c5ec2p-2, 0x1.f42decdeccf1dp-56 }, { 0x1.4be5f957778a1p-2, -0x1.259b35b04813dp-57 },
+	{ 0x1.51aad872df82dp-2, 0x1.3927ac19f55e3p-59 }, { 0x1.5767717455a6cp-2, 0x1.526adb283660cp-56 },
+	{ 0x1.5d1bdbf5809cap-2, 0x1.4236383dc7fe1p-56 }, { 0x1.62c82f2b9c795p-2, 0x1.7b7af915300e5p-57 }
+};
+
+// atan( j / 64 ) for j = 0..64, the nodes of DDAtan
+static const double			kDDAtan[ 65 ][ 2 ] =
+{
+	{ 0.0, 0.0 }, { 0x1.fff555bbb729bp-7, -0x1.220c39d4dff5p-61 },
+	{ 0x1.ffd55bba97625p-6, -0x1.5ec431444912cp-60 }, { 0x1.7fb818430da2ap-5, -0x1.86ef8f794f105p-63 },
+	{ 0x1.ff55bb72cfdeap-5, -0x1.c934d86d23f1dp-60 }, { 0x1.3f59f0e7c559dp-4, 0x1.ac4ce285df847p-58 },
+	{ 0x1.7ee182602f10fp-4, -0x1.cfb654c0c3d98p-58 }, { 0x1.be39ebe6f07c3p-4, 0x1.f7b8f29a05987p-58 },
+	{ 0x1.fd5ba9aac2f6ep-4, -0x1.cd37686760c17p-59 }, { 0x1.1e1fafb043727p-3, -0x1.b485914dacf8cp-59 },
+	{ 0x1.3d6eee8c6626cp-3, 0x1.61a3b0ce9281bp-57 }, { 0x1.5c9811e3ec26ap-3, -0x1.054ab2c010f3dp-58 },
+	{ 0x1.7b97b4bce5b02p-3, 0x1.347b0b4f881cap-58 }, { 0x1.9a6a8e96c8626p-3, 0x1.cf601e7b4348ep-59 },
+	{ 0x1.b90d7529260a2p-3, 0x1.17b10d2e0e5aap-61 }, { 0x1.d77d5df205736p-3, 0x1.c648d1534597ep-57 },
+	{ 0x1.f5b75f92c80ddp-3, 0x1.8ab6e3cf7afbdp-57 }, { 0x1.09dc597d86362p-2, 0x1.62e47390cb865p-56 },
+	{ 0x1.18bf5a30bf178p-2, 0x1.30ca4748b1bf8p-57 }, { 0x1.278372057ef46p-2, -0x1.077cdd36dfc81p-56 },
+	{ 0x1.362773707ebccp-2, -0x1.963a544b672d8p-57 }, { 0x1.44aa436c2af0ap-2, -0x1.5d5e43c55b3bap-56 },
+	{ 0x1.530ad9951cd4ap-2, -0x1.2566480884082p-57 }, { 0x1.614840309cfe2p-2, -0x1.a725715711fp-56 },
+	{ 0x1.6f61941e4def1p-2, -0x1.c63aae6f6e918p-56 }, { 0x1.7d5604b63b3f7p-2, 0x1.69c885c2b249ap-56 },
+	{ 0x1.8b24d394a1b25p-2, 0x1.b6d0ba3748fa8p-56 }, { 0x1.98cd5454d6b18p-2, 0x1.9e6c988fd0a77p-56 },
+	{ 0x1.a64eec3cc23fdp-2, -0x1.24dec1b50b7ffp-56 }, { 0x1.b3a911da65c6cp-2, 0x1.ae187b1ca504p-56 },
+	{ 0x1.c0db4c94ec9fp-2, -0x1.cc1ce70934c34p-56 }, { 0x1.cde53432c1351p-2, -0x1.a2cfa4418f1adp-56 },
+	{ 0x1.dac670561bb4fp-2, 0x1.a2b7f222f65e2p-56 }, { 0x1.e77eb7f175a34p-2, 0x1.0e53dc1bf3435p-56 },
+	{ 0x1.f40dd0b541418p-2, -0x1.a3992dc382a23p-57 }, { 0x1.0039c73c1a40cp-1, -0x1.b32c949c9d593p-55 },
+	{ 0x1.0657e94db30dp-1, -0x1.d5b495f6349e6p-56 }, { 0x1.0c6145b5b43dap-1, 0x1.974fa13b5404fp-58 },
+	{ 0x1.1255d9bfbd2a9p-1, -0x1.2bdaee1c0ee35p-58 }, { 0x1.1835a88be7c13p-1, 0x1.c621cec00c301p-55 },
+	{ 0x1.1e00babdefeb4p-1, -0x1.928df287a668fp-58 }, { 0x1.23b71e2cc9e6ap-1, 0x1.c421c9f38224ep-57 },
+	{ 0x1.2958e59308e31p-1, -0x1.09e73b0c6c087p-56 }, { 0x1.2ee628406cbcap-1, 0x1.c5d5e9ff0cf8dp-55 },
+	{ 0x1.345f01cce37bbp-1, 0x1.1021137c71102p-55 }, { 0x1.39c391cd4171ap-1, -0x1.2304331d8bf46p-55 },
+	{ 0x1.3f13fb89e96f4p-1, 0x1.ecf8b492644fp-56 }, { 0x1.445065b795b56p-1, -0x1.f76d0163f79c8p-56 },
+	{ 0x1.4978fa3269ee1p-1, 0x1.2419a87f2a458p-56 }, { 0x1.4e8de5bb6ec04p-1, 0x1.4a33dbeb3796cp-55 },
+	{ 0x1.538f57b89061fp-1, -0x1.1bb74abda520cp-55 }, { 0x1.587d81f732fbbp-1, -0x1.5e5c9d8c5a95p-56 },
+	{ 0x1.5d58987169b18p-1, 0x1.0028e4bc5e7cap-57 }, { 0x1.6220d115d7b8ep-1, -0x1.2b785350ee8c1p-57 },
+	{ 0x1.66d663923e087p-1, -0x1.6ea6febe8bbbap-56 }, { 0x1.6b798920b3d99p-1, -0x1.a80386188c50ep-55 },
+	{ 0x1.700a7c5784634p-1, -0x1.8c34d25aadef6p-56 }, { 0x1.748978fba8e0fp-1, 0x1.7b2a6165884a2p-59 },
+	{ 0x1.78f6bbd5d315ep-1, 0x1.406a08980374p-55 }, { 0x1.7d528289fa093p-1, 0x1.560821e2f3aa9p-55 },
+	{ 0x1.819d0b7158a4dp-1, -0x1.bf76229d3b917p-56 }, { 0x1.85d69576cc2c5p-1, 0x1.6b66e7fc8b8c4p-57 },
+	{ 0x1.89ff5ff57f1f8p-1, -0x1.55b9a5e177a1bp-55 }, { 0x1.8e17aa99cc05ep-1, -0x1.ec182ab042f61p-56 },
+	{ 0x1.921fb54442d18p-1, 0x1.1a62633145c07p-55 }
+};
+
+// 1/3, 1/5 and 1/7, the first terms of atanh( s ) / s in s^2, and of atan( t ) / t in -t^2
+static const double			kDDAtanh[ 3 ][ 2 ] = { { 0x1.5555555555555p-2, 0x1.5555555555555p-56 }, { 0x1.999999999999ap-3, -0x1.999999999999ap-57 },
+	{ 0x1.2492492492492p-3, 0x1.2492492492492p-57 } };
+
+static DD_INLINE uint64_t		DDBits( double d )
+{
+	uint64_t u;
+	memcpy( &u, &d, sizeof( u ) );
+	return u;
+}
+
+static DD_INLINE double		DDFromBits( uint64_t u )
+{
+	double d;
+	memcpy( &d, &u, sizeof( d ) );
+	return d;
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DD( double hi, double lo = 0.0 )
+{
+	DOUBLE_DOUBLE r;
+	r.hi = hi;
+	r.lo = lo;
+	return r;
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDSelect( bool f, const DOUBLE_DOUBLE & a, const DOUBLE_DOUBLE & b )
+{
+	return DD( f ? a.hi : b.hi, f ? a.lo : b.lo );
+}
+
+// infinities and NaN have no low part: ref is the result of the high parts
+static DD_INLINE DOUBLE_DOUBLE	DDFinite( double ref, const DOUBLE_DOUBLE & r )
+{
+	return DDSelect( std::fabs( ref ) <= DBL_MAX, r, DD( ref ) );
+}
+
+// nearest integer for |x| < 2^51
+static DD_INLINE double		DDRound( double x )
+{
+	return ( x + kDDRound ) - kDDRound;
+}
+
+// 2^k for integer k in [ -1022, 1023 ]
+static DD_INLINE double		DDPow2( double k )
+{
+	return DDFromBits( DDBits( k + 1023.0 + kDDRound ) << 52 );
+}
+
+// s + e = a + b exactly when |a| >= |b|
+static DD_INLINE double		DDQuickTwoSum( double a, double b, double & e )
+{
+	const double s = a + b;
+	e = b - ( s - a );
+	return s;
+}
+
+// s + e = a + b exactly
+static DD_INLINE double		DDTwoSum( double a, double b, double & e )
+{
+	const double s = a + b, bb = s - a;
+	e = ( a - ( s - bb ) ) + ( b - bb );
+	return s;
+}
+
+// p + e = a * b exactly
+static DD_INLINE double		DDTwoProd( double a, double b, double & e )
+{
+	const double p = a * b;
+#if KERNEL_FMA
+	e = __builtin_fma( a, b, -p );
+#else
+	const double ca = 134217729.0 * a, ah = ca - ( ca - a ), al = a - ah;
+	const double cb = 134217729.0 * b, bh = cb - ( cb - b ), bl = b - bh;
+	e = ( ( ah * bh - p ) + ah * bl + al * bh ) + al * bl;
+#endif
+	return p;
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDProd( double a, double b )
+{
+	DOUBLE_DOUBLE r;
+	r.hi = DDTwoProd( a, b, r.lo );
+	return r;
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDNeg( const DOUBLE_DOUBLE & a )
+{
+	return DD( -a.hi, -a.lo );
+}
+
+// multiplication by a power of two is exact
+static DD_INLINE DOUBLE_DOUBLE	DDScale( const DOUBLE_DOUBLE & a, double p )
+{
+	return DD( a.hi * p, a.lo * p );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDAddD( const DOUBLE_DOUBLE & a, double b )
+{
+	double s2;
+	double s1 = DDTwoSum( a.hi, b, s2 );
+	s2 += a.lo;
+	s1 = DDQuickTwoSum( s1, s2, s2 );
+	return DDFinite( a.hi + b, DD( s1, s2 ) );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDAdd( const DOUBLE_DOUBLE & a, const DOUBLE_DOUBLE & b )
+{
+	double s2, t2;
+	double s1 = DDTwoSum( a.hi, b.hi, s2 );
+	const double t1 = DDTwoSum( a.lo, b.lo, t2 );
+	s2 += t1;
+	s1 = DDQuickTwoSum( s1, s2, s2 );
+	s2 += t2;
+	s1 = DDQuickTwoSum( s1, s2, s2 );
+	return DDFinite( a.hi + b.hi, DD( s1, s2 ) );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDSub( const DOUBLE_DOUBLE & a, const DOUBLE_DOUBLE & b )
+{
+	return DDAdd( a, DDNeg( b ) );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDMulD( const DOUBLE_DOUBLE & a, double b )
+{
+	double p2;
+	double p1 = DDTwoProd( a.hi, b, p2 );
+	p2 += a.lo * b;
+	p1 = DDQuickTwoSum( p1, p2, p2 );
+	return DDFinite( a.hi * b, DD( p1, p2 ) );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDMul( const DOUBLE_DOUBLE & a, const DOUBLE_DOUBLE & b )
+{
+	double p2;
+	double p1 = DDTwoProd( a.hi, b.hi, p2 );
+	p2 += a.hi * b.lo + a.lo * b.hi;
+	p1 = DDQuickTwoSum( p1, p2, p2 );
+	return DDFinite( a.hi * b.hi, DD( p1, p2 ) );
+}
+
+static DD_INLINE DOUBLE_DOUBLE	DDSqr( const DOUBLE_DOUBLE & a )
+{
+	double p2;
+	double p1 = DDTwoProd( a.hi, a.hi, p2 );
+	p2 += 2.0 * a.hi * a.lo + a.lo * a.lo;
+	p1 = DDQuickTwoSum( p1, p2, p2 );
+	return DDFinite( a.hi * a.hi, DD( p1, p2 ) );
+}
+
+// three quotients of the long division by one reciprocal: the remainders are exact, so the
+// next quotient corrects the rounding of the reciprocal. Divisors below 2^-900 are scaled
+// with the dividend, otherwise the reciprocal would overflow
+static DD_INLINE DOUBLE_DOUBLE	DDDiv( const DOUBLE_DOUBLE & a, const DOUBLE_DOUBLE & b )
+{
+	const double p = ( std::fabs( b.hi ) < 0x1p-900 ? 0x1p200 : 1.0 );
+	const DOUBLE_DOUBLE as = DDScale( a, p ), bs = DDScale( b, p );
+	const double rb = 1.0 / bs.hi;
+
+	double q1 = as.hi * rb;
+	DOUBLE_DOUBLE r = DDSub( as, DDMulD( bs, q1 ) );
+	double q2 = r.hi * rb;
+	r = DDSub( r, DDMulD( bs, q2 ) );
+	const double q3 = r.hi * rb;
+
+	const double ref = q1;
+	q1 = DDQuickTwoSum( q1, q2, q2 );
+	return DDFinite( ref, DDAddD( DD( q1, q2 ), q3 ) );
+}
+
+// Karp's method: one Newton step for 1 / sqrt( a ) from the double root
+static DD_INLINE DOUBLE_DOUBLE	DDSqrt( const DOUBLE_DOUBLE & a )
+{
+	const double x = 1.0 / std::sqrt( a.hi ), ax = a.hi * x;
+	double e;
+	const double s = DDTwoSum( ax, DDSub( a, DDProd( ax, ax ) ).hi * ( x * 0.5 ), e );
+	return DDSelect( ( a.hi > 0 ) & ( a.hi <= DBL_MAX ), DD( s, e ), DD( std::sqrt( a.hi ) ) );
+}
+
+// exp( x ) = ( 1 + expm1( r ) )^512 * 2^m, x = m ln2 + 512 r. expm1( r ) is the Taylor series,
+// then it is squared by expm1( 2r ) = expm1( r ) * ( expm1( r ) + 2 )
+static DD_INLINE DOUBLE_DOUBLE	DDExp( const DOUBLE_DOUBLE & a )
+{
+	const double kMax = 709.782712893384, kMin = -745.2;
+	const double x = ( a.hi < -750.0 ? -750.0 : ( a.hi > 750.0 ? 750.0 : a.hi ) );
+	const DOUBLE_DOUBLE ac = DDSelect( x == a.hi, a, DD( x ) );
+	const double m = DDRound( x * 0x1.71547652b82fep0 );
+
+	DOUBLE_DOUBLE r = DDSub( DDSub( ac, DDProd( m, kDDLn2[ 0 ] ) ), DDProd( m, kDDLn2[ 1 ] ) );
+	r = DDScale( DDAddD( r, -m * kDDLn2[ 2 ] ), 1.0 / 512 );
+
+	DOUBLE_DOUBLE s = DD( kDDExp[ 7 ][ 0 ], kDDExp[ 7 ][ 1 ] );
+#pragma GCC unroll 8
+	for ( int n = 6; n >= 0; --n )
+	{
+		s = DDAdd( DDMul( s, r ), DD( kDDExp[ n ][ 0 ], kDDExp[ n ][ 1 ] ) );
+	}
+	s = DDMul( DDAddD( DDMul( s, r ), 1.0 ), r );
+
+#pragma GCC unroll 9
+	for ( int n = 0; n < 9; ++n )
+	{
+		s = DDAdd( DDScale( s, 2.0 ), DDSqr( s ) );
+	}
+
+	const double k1 = DDRound( m * 0.5 ), k2 = m - k1;
+	s = DDScale( DDScale( DDAddD( s, 1.0 ), DDPow2( k1 ) ), DDPow2( k2 ) );
+
+	s = DDFinite( s.hi, s );
+	s = DDSelect( a.hi > kMax, DD( HUGE_VAL ), s );
+	s = DDSelect( a.hi < kMin, DD( 0.0 ), s );
+	return DDSelect( a.hi != a.hi, DD( a.hi ), s );
+}
+
+// log( x ) = k ln2 + log( c ) + 2 atanh( s ): x = 2^k m with m in [ sqrt( 1/2 ), sqrt( 2 ) ), c = 1 + j / 128
+// is the nearest node to m and s = ( m - c ) / ( m + c ), so |s| < 2^-8.5. Terms of atanh( s ) / s from
+// s^6 on are below 2^-53 and are summed in double
+static DD_INLINE DOUBLE_DOUBLE	DDLog( const DOUBLE_DOUBLE & a )
+{
+	// subnormals are scaled to normal numbers
+	const bool fTiny = ( a.hi < 0x1p-1000 );
+	const double x = a.hi * ( fTiny ? 0x1p100 : 1.0 );
+	const uint64_t u = DDBits( x );
+	const double dExp = DDFromBits( ( u >> 52 ) | DDBits( kDDRound ) ) - kDDRound;
+	double fm = DDFromBits( ( u & 0x000fffffffffffffULL ) | 0x3ff0000000000000ULL );
+
+	const bool fHigh = ( fm > 0x1.6a09e667f3bcdp0 );
+	fm *= ( fHigh ? 0.5 : 1.0 );
+	const double k = dExp - 1023.0 + ( fHigh ? 1.0 : 0.0 ) - ( fTiny ? 100.0 : 0.0 );
+
+	const double k1 = DDRound( k * -0.5 ), k2 = -k - k1;
+	const DOUBLE_DOUBLE m = DDScale( DDScale( a, DDPow2( k1 ) ), DDPow2( k2 ) );
+
+	// m.hi - c is exact
+	const double j = DDRound( ( fm - 1.0 ) * 128.0 ), c = 1.0 + j * ( 1.0 / 128 );
+	const uint64_t n = DDBits( j + kDDRound ) - DDBits( kDDRound ) + 38;
+	const DOUBLE_DOUBLE s = DDDiv( DDAddD( m, -c ), DDAddD( m, c ) ), z = DDSqr( s );
+
+	const double q = z.hi * ( 1.0 / 7 + z.hi * ( 1.0 / 9 + z.hi * ( 1.0 / 11 + z.hi * ( 1.0 / 13 + z.hi * ( 1.0 / 15 ) ) ) ) );
+	DOUBLE_DOUBLE p = DDAddD( DD( kDDAtanh[ 1 ][ 0 ], kDDAtanh[ 1 ][ 1 ] ), q );
+	p = DDAdd( DDMul( p, z ), DD( kDDAtanh[ 0 ][ 0 ], kDDAtanh[ 0 ][ 1 ] ) );
+	p = DDAddD( DDMul( p, z ), 1.0 );
+
+	DOUBLE_DOUBLE y = DDAdd( DD( kDDLog[ n ][ 0 ], kDDLog[ n ][ 1 ] ), DDScale( DDMul( s, p ), 2.0 ) );
+	y = DDAdd( y, DDProd( k, kDDLn2[ 0 ] ) );
+	y = DDAddD( y, k * kDDLn2[ 1 ] + k * kDDLn2[ 2 ] );
+
+	const double dSpecial = ( a.hi == 0 ? -HUGE_VAL : ( a.hi > 0 ? a.hi : std::numeric_limits<double>::quiet_NaN() ) );
+	return DDSelect( ( a.hi > 0 ) & ( a.hi <= DBL_MAX ), y, DD( dSpecial ) );
+}
+
+// Taylor series of cos( r ) or of sin( r ) / r in t = r^2 for |r| <= pi/4. Terms from t^9 on
+// are below 2^-60 and are summed in double. The series may be chosen for each element
+static DD_INLINE DOUBLE_DOUBLE	DDTrigSeries( const DOUBLE_DOUBLE & t, bool fCos )
+{
+	double q = ( fCos ? kDDCos[ 14 ][ 0 ] : 0.0 );
+#pragma GCC unroll 5
+	for ( int n = 13; n >= 9; --n )
+	{
+		q = q * t.hi + ( fCos ? kDDCos[ n ][ 0 ] : kDDSin[ n ][ 0 ] );
+	}
+
+	DOUBLE_DOUBLE p = DD( q );
+#pragma GCC unroll 9
+	for ( int n = 8; n >= 0; --n )
+	{
+		p = DDAdd( DDMul( p, t ), fCos ? DD( kDDCos[ n ][ 0 ], kDDCos[ n ][ 1 ] ) : DD( kDDSin[ n ][ 0 ], kDDSin[ n ][ 1 ] ) );
+	}
+
+	return p;
+}
+
+// a - k pi/2 for the nearest integer k, q is k in the low bits
+static DD_INLINE DOUBLE_DOUBLE	DDReduce( const DOUBLE_DOUBLE & a, uint64_t & q )
+{
+	const double k = DDRound( a.hi * 0x1.45f306dc9c883p-1 );
+	q = DDBits( k + kDDRound );
+
+	const DOUBLE_DOUBLE r = DDSub( DDSub( a, DDProd( k, kDDPio2[ 0 ] ) ), DDProd( k, kDDPio2[ 1 ] ) );
+	return DDAddD( r, -k * kDDPio2[ 2 ] );
+}
+
+// reduction by pi/2 and Taylor series for |r| <= pi/4. |x| above kDDTrigMax gives NaN
+static DD_INLINE void			DDSinCos( const DOUBLE_DOUBLE & a, DOUBLE_DOUBLE & s, DOUBLE_DOUBLE & c )
+{
+	uint64_t q;
+	const DOUBLE_DOUBLE r = DDReduce( a, q ), t = DDSqr( r );
+	const DOUBLE_DOUBLE ps = DDMul( DDTrigSeries( t, false ), r ), pc = DDTrigSeries( t, true );
+
+	// quadrant q: sin is sin, cos, -sin, -cos; cos is cos, -sin, -cos, sin
+	const bool fSwap = ( q & 1 );
+	s = DDScale( DDSelect( fSwap, pc, ps ), ( q & 2 ) ? -1.0 : 1.0 );
+	c = DDScale( DDSelect( fSwap, ps, pc ), ( ( q + 1 ) & 2 ) ? -1.0 : 1.0 );
+
+	const bool fValid = ( std::fabs( a.hi ) <= kDDTrigMax );
+	s = DDSelect( fValid, s, DD( std::numeric_limits<double>::quiet_NaN() ) );
+	c = DDSelect( fValid, c, DD( std::numeric_limits<double>::quiet_NaN() ) );
+}
+
+// sin( a ) or cos( a ) by one series: cos( r + q pi/2 ) is sin( r + ( q + 1 ) pi/2 ), and the
+// quadrant chooses the series of sin or of cos
+static DD_INLINE DOUBLE_DOUBLE	DDSinOrCos( const DOUBLE_DOUBLE & a, bool fCos )
+{
+	uint64_t q;
+	const DOUBLE_DOUBLE r = DDReduce( a, q ), t = DDSqr( r );
+	q += ( fCos ? 1 : 0 );
+
+	const bool fSwap = ( q & 1 );
+	DOUBLE_DOUBLE p = DDTrigSeries( t, fSwap );
+	p = DDScale( DDSelect( fSwap, p, DDMul( p, r ) ), ( q & 2 ) ? -1.0 : 1.0 );
+	return DDSelect( std::fabs( a.hi ) <= kDDTrigMax, p, DD( std::numeric_limits<double>::quiet_NaN() ) );
+}
+
+// atan( x ) = atan( c ) + atan( t ) for x in [ 0, 1 ]: c = j / 64 is the nearest node to x and
+// t = ( x - c ) / ( 1 + x c ), so |t| < 2^-7. Greater x are taken by pi/2 - atan( 1 / x ) and
+// negative ones by the symmetry. Terms of atan( t ) / t from t^8 on are summed in double
+static DD_INLINE DOUBLE_DOUBLE	DDAtan( const DOUBLE_DOUBLE & a )
+{
+	const double dSign = ( a.hi < 0 ? -1.0 : 1.0 );
+	const DOUBLE_DOUBLE x = DDScale( a, dSign );
+	const bool fInv = ( x.hi > 1.0 );
+	const DOUBLE_DOUBLE r = DDSelect( fInv, DDDiv( DD( 1.0 ), x ), x );
+
+	// NaN takes the first node
+	const double j = DDRound( ( r.hi <= 1.0 ? r.hi : 0.0 ) * 64.0 ), c = j * ( 1.0 / 64 );
+	const uint64_t n = DDBits( j + kDDRound ) - DDBits( kDDRound );
+	const DOUBLE_DOUBLE t = DDDiv( DDAddD( r, -c ), DDAddD( DDMulD( r, c ), 1.0 ) ), z = DDSqr( t );
+
+	const double q = z.hi * ( 1.0 / 9 - z.hi * ( 1.0 / 11 - z.hi * ( 1.0 / 13 - z.hi * ( 1.0 / 15 ) ) ) );
+	DOUBLE_DOUBLE p = DDAddD( DD( -kDDAtanh[ 2 ][ 0 ], -kDDAtanh[ 2 ][ 1 ] ), q );
+	p = DDAdd( DDMul( p, z ), DD( kDDAtanh[ 1 ][ 0 ], kDDAtanh[ 1 ][ 1 ] ) );
+	p = DDSub( DDMul( p, z ), DD( kDDAtanh[ 0 ][ 0 ], kDDAtanh[ 0 ][ 1 ] ) );
+	p = DDAddD( DDMul( p, z ), 1.0 );
+
+	DOUBLE_DOUBLE y = DDAdd( DD( kDDAtan[ n ][ 0 ], kDDAtan[ n ][ 1 ] ), DDMul( t, p ) );
+	y = DDSelect( fInv, DDSub( DD( kDDPio2[ 0 ], kDDPio2[ 1 ] ), y ), y );
+	y = DDSelect( x.hi <= DBL_MAX, y, DD( kDDPio2[ 0 ], kDDPio2[ 1 ] ) );
+	return DDSelect( a.hi == a.hi, DDScale( y, dSign ), a );
+}
+
+// Newton step for the angle of the double atan2 on the unit circle
+static inline DOUBLE_DOUBLE	DDAtan2( const DOUBLE_DOUBLE & y, const DOUBLE_DOUBLE & x )
+{
+	const DOUBLE_DOUBLE r = DDSqrt( DDAdd( DDSqr( x ), DDSqr( y ) ) );
+	if ( !( r.hi > 0 ) || !( r.hi <= DBL_MAX ) )
+	{
+		return DD( std::atan2( y.hi, x.hi ) );
+	}
+
+	const DOUBLE_DOUBLE xx = DDDiv( x, r ), yy = DDDiv( y, r );
+	DOUBLE_DOUBLE z = DD( std::atan2( y.hi, x.hi ) ), s, c;
+	DDSinCos( z, s, c );
+
+	if ( std::fabs( xx.hi ) > std::fabs( yy.hi ) )
+	{
+		return DDAdd( z, DDDiv( DDSub( yy, s ), c ) );
+	}
+
+	return DDSub( z, DDDiv( DDSub( xx, c ), s ) );
+}
+
+// complex operations on the real and imaginary parts
+static DD_INLINE void			DDCMul( const DOUBLE_DOUBLE & ar, const DOUBLE_DOUBLE & ai, const DOUBLE_DOUBLE & br, const DOUBLE_DOUBLE & bi,
+	DOUBLE_DOUBLE & zr, DOUBLE_DOUBLE & zi )
+{
+	const DOUBLE_DOUBLE re = DDSub( DDMul( ar, br ), DDMul( ai, bi ) );
+	zi = DDAdd( DDMul( ar, bi ), DDMul( ai, br ) );
+	zr = re;
+}
+
+static DD_INLINE void			DDCDiv( const DOUBLE_DOUBLE & ar, const DOUBLE_DOUBLE & ai, const DOUBLE_DOUBLE & br, const DOUBLE_DOUBLE & bi,
+	DOUBLE_DOUBLE & zr, DOUBLE_DOUBLE & zi )
+{
+	const DOUBLE_DOUBLE den = DDAdd( DDSqr( br ), DDSqr( bi ) );
+	const DOUBLE_DOUBLE re = DDDiv( DDAdd( DDMul( ar, br ), DDMul( ai, bi ) ), den );
+	zi = DDDiv( DDSub( DDMul( ai, br ), DDMul( ar, bi ) ), den );
+	zr = re;
+}
+
+static DD_INLINE void			DDCExp( const DOUBLE_DOUBLE & ar, const DOUBLE_DOUBLE & ai, DOUBLE_DOUBLE & zr, DOUBLE_DOUBLE & zi )
+{
+	DOUBLE_DOUBLE s, c;
+	const DOUBLE_DOUBLE e = DDExp( ar );
+	DDSinCos( ai, s, c );
+	zr = DDMul( e, c );
+	zi = DDMul( e, s );
+}
+
+}
@@ -0,0 +1,178 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Builder of programs without text. The values are the arguments of CExprProgram, the nodes
+   take the operators and functions registered in the parser by name, so the program is the
+   same as Compile and CExprProgram::Build would produce for the equivalent text:
+
+	CExprBuilder<TOK> b( parser );
+	EXPR_ARG x = b.Variable( TEXT( "x" ) );
+	b.Build( b.Op( TEXT( "+" ), b.Op( TEXT( "*" ), b.Const( 3 ), x ), b.Func( TEXT( "sin" ), { x } ) ), prog );
+*/
+
+#pragma once
+
+#include "CExprProgram.h"
+
+template <class NUM>
+class CExprBuilder
+{
+	const CExprParser<NUM> &			m_parser;
+	CExprProgram<NUM>					m_prog;
+	std::vector<BOOL>					m_vused;		// results of the nodes taken by other nodes
+	size_t								m_nConsts;
+
+	VOID			Check( const EXPR_ARG & arg ) const
+	{
+		switch ( arg.eat )
+		{
+			case eatSlot: if ( arg.u < m_prog.Slots().size() ) return; break;
+			case eatNode: if ( arg.u < m_prog.Nodes().size() ) return; break;
+			default: if ( arg.u < m_nConsts ) return; break;
+		}
+
+		throw CExprParserTreeNotInitialized();
+	}
+
+	// copy of the subtree of the node, taken by the caller. Programs of the parser are trees,
+	// so each result is used once and the passes may rewrite the nodes in place
+	EXPR_ARG		Clone( const EXPR_ARG & arg )
+	{
+		if ( arg.eat != eatNode )
+		{
+			return arg;
+		}
+
+		EXPR_NODE node = m_prog.Nodes()[ arg.u ];
+		for ( auto & v : node.varg )
+		{
+			v = Clone( v );
+		}
+
+		m_prog.Nodes().push_back( node );
+		m_vused.push_back( TRUE );
+		return EXPR_ARG( eatNode, m_prog.Nodes().size() - 1 );
+	}
+
+	EXPR_ARG		Use( const EXPR_ARG & arg )
+	{
+		Check( arg );
+		if ( arg.eat != eatNode )
+		{
+			return arg;
+		}
+
+		if ( m_vused[ arg.u ] )
+		{
+			return Clone( arg );
+		}
+
+		m_vused[ arg.u ] = TRUE;
+		return arg;
+	}
+
+	EXPR_ARG		Emitted( const EXPR_ARG & arg )
+	{
+		m_vused.push_back( FALSE );
+		return arg;
+	}
+
+public:
+	// parser is the source of the tokens, it must outlive the builder
+	CExprBuilder( const CExprParser<NUM> & parser )
+		: m_parser( parser ), m_nConsts( 0 )
+	{
+	}
+
+	EXPR_ARG		Const( const NUM & value )
+	{
+		m_nConsts++;
+		return EXPR_ARG( eatConst, m_prog.AddConst( value ) );
+	}
+
+	// slot of the variable, the same for the same name
+	EXPR_ARG		Variable( LPCTSTR pszName )
+	{
+		return EXPR_ARG( eatSlot, m_prog.AddSlot( pszName ) );
+	}
+
+	EXPR_ARG		Unary( LPCTSTR pszName, const EXPR_ARG & a, BOOL fPrefix = TRUE )
+	{
+		const CExprTokenUn<NUM> * ptok = m_parser.GetUnaryOp( pszName, fPrefix );
+		if ( !ptok )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		const EXPR_ARG va = Use( a );
+		return Emitted( m_prog.Emit( *ptok, va ) );
+	}
+
+	// binary operator, the empty name is the implicit operator
+	EXPR_ARG		Op( LPCTSTR pszName, const EXPR_ARG & a, const EXPR_ARG & b )
+	{
+		const CExprTokenOp<NUM> * ptok = m_parser.GetOp( pszName );
+		if ( !ptok )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		const EXPR_ARG va = Use( a );
+		const EXPR_ARG vb = Use( b );
+		return Emitted( m_prog.Emit( *ptok, va, vb ) );
+	}
+
+	// function, the empty name is the brackets
+	EXPR_ARG		Func( LPCTSTR pszName, const std::vector<EXPR_ARG> & varg )
+	{
+		const CExprTokenFunc<NUM> * ptok = m_parser.GetFunc( pszName );
+		if ( !ptok )
+		{
+			throw CExprParserNoSuchFunction( pszName );
+		}
+
+		// functions with size_t( -1 ) arguments take any number of them
+		if ( ptok->Args() != size_t( -1 ) && ptok->Args() != varg.size() )
+		{
+			throw CExprParserWrongArguments( ptok->Args(), varg.size() );
+		}
+
+		std::vector<EXPR_ARG> vuse;
+		for ( const auto & v : varg )
+		{
+			vuse.push_back( Use( v ) );
+		}
+
+		CExprTokenFunc<NUM> fn( varg.size() );
+		fn.TokFunc() = ptok->Func();
+		fn.TokName() = ptok->Name();
+		fn.SetAttributes( ptok->Attributes(), ptok->Cost() );
+		fn.SetLazy( ptok->Lazy() );
+		return Emitted( m_prog.Emit( fn, vuse ) );
+	}
+
+	// finishes the program with the result and starts the next one. The result is the
+	// same program as CExprProgram::Build makes, so it may be optimized and compiled
+	VOID			Build( const EXPR_ARG & result, CExprProgram<NUM> & prog )
+	{
+		Check( result );
+		m_prog.Result() = result;
+		prog = std::move( m_prog );
+
+		m_prog = CExprProgram<NUM>();
+		m_vused.clear();
+		m_nConsts = 0;
+	}
+};
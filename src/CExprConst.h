@@ -0,0 +1,1006 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compile-time front end of CMyParser. EXPR_CONST parses a string literal by the grammar of
+   CExprParser::ParseLoop and lowers it as CExprProgram::Build does, but in constexpr functions,
+   so the formula becomes a tree of inlined templates evaluated in real long double.
+   Variables are the fields of a struct:
+
+	struct QUAD { double a, b, c, x; };
+	constexpr auto quad = EXPR_CONST( QUAD, "a*x^2 + b*x + c", a, b, c, x );
+	long double y = quad( QUAD{ 1, -2, 0.5, x } );
+
+   The fields are listed in the order of declaration. Syntax errors stop the compilation at the
+   throw of the exception which the runtime parser would throw. Values which leave the real
+   axis are NaN, complex literals and assignments are not supported */
+
+#pragma once
+
+#include "CMyParser.h"
+#include "CExprProgram.h"
+#include <array>
+
+#define CONST_MAX_TOKENS		128		// tokens of the RPN, nodes and constants of the program
+#define CONST_MAX_UNARY			8		// unary operators of one operand
+#define CONST_MAX_DEPTH			32		// nesting of the functions
+#define CONST_MAX_FIELDS		16
+
+typedef enum _tagCONST_OP
+{
+	ecoNone,
+	// unary
+	ecoPlus,
+	ecoNeg,
+	ecoRev,
+	ecoFact,
+	// binary
+	ecoAdd,
+	ecoSub,
+	ecoMul,
+	ecoDiv,
+	ecoPow,
+	ecoSecond,
+	ecoAssign,
+	// functions
+	ecoBracket,
+	ecoSin,
+	ecoSinc,
+	ecoCos,
+	ecoTan,
+	ecoCot,
+	ecoArcsin,
+	ecoArccos,
+	ecoArctan,
+	ecoArccot,
+	ecoPi,
+	ecoE,
+	ecoExp,
+	ecoSqrt,
+	ecoCbrt
+} CONST_OP, *PCONST_OP;
+
+// operator or function of CMyParser
+typedef struct _tagCONST_TOKEN
+{
+	const char *			pszName;
+	CONST_OP				eco;
+	int						prio;		// number of arguments for the functions
+	EXPR_TOKEN_ASSOC		eta;
+} CONST_TOKEN, *PCONST_TOKEN;
+
+typedef struct _tagCONST_UNARY
+{
+	CONST_OP				veco[ CONST_MAX_UNARY ] = {};
+	int						vprio[ CONST_MAX_UNARY ] = {};
+	size_t					n = 0;
+
+	constexpr VOID			Push( const CONST_TOKEN & tok )
+	{
+		if ( n == CONST_MAX_UNARY )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		veco[ n ] = tok.eco;
+		vprio[ n++ ] = tok.prio;
+	}
+} CONST_UNARY;
+
+// PARSER_TREE of the compile-time parser
+typedef struct _tagCONST_TREE
+{
+	EXPR_TOKEN_TYPE			ett = ettNone;
+	CONST_TOKEN				tok = {};
+	size_t					nArgs = 0;
+	long double				dValue = 0;
+	size_t					uField = 0;
+	CONST_UNARY				uPreOp;
+	CONST_UNARY				uPostOp;
+} CONST_TREE;
+
+typedef struct _tagCONST_NODE
+{
+	CONST_OP				eco = ecoNone;
+	size_t					nArgs = 0;
+	EXPR_ARG				varg[ 2 ];
+} CONST_NODE;
+
+typedef struct _tagCONST_PROGRAM
+{
+	CONST_NODE				vnode[ CONST_MAX_TOKENS ];
+	long double				vconst[ CONST_MAX_TOKENS ] = {};
+	size_t					nNodes = 0;
+	size_t					nConsts = 0;
+	EXPR_ARG				result;
+} CONST_PROGRAM;
+
+template <class CHAR>
+class CExprConstParser
+{
+	const CHAR *			m_psz;
+	size_t					m_length;
+	const char *			m_pszFields;
+	size_t					m_vfield[ CONST_MAX_FIELDS ] = {};		// offsets of the names in m_pszFields
+	size_t					m_vfieldLen[ CONST_MAX_FIELDS ] = {};
+	size_t					m_nFields = 0;
+	size_t					m_vvar[ CONST_MAX_FIELDS ] = {};		// variables in the order of appearance, as mvarList
+	size_t					m_nVars = 0;
+
+	CONST_TREE				m_vtree[ CONST_MAX_TOKENS ] = {};
+	size_t					m_nTree = 0;
+	CONST_TREE				m_vstack[ CONST_MAX_TOKENS ] = {};
+	size_t					m_nStack = 0;
+
+	static constexpr CONST_TOKEN	vop[] =
+	{
+		{ "", ecoMul, 5, etaLeftOriented },
+		{ "*", ecoMul, 5, etaLeftOriented },
+		{ "+", ecoAdd, 10, etaLeftOriented },
+		{ "-", ecoSub, 10, etaLeftOriented },
+		{ "/", ecoDiv, 5, etaLeftOriented },
+		{ "^", ecoPow, 4, etaRightOriented },
+		{ ";", ecoSecond, 40, etaRightOriented },
+		{ "=", ecoAssign, 20, etaRightOriented },
+	};
+
+	static constexpr CONST_TOKEN	vprefix[] =
+	{
+		{ "+", ecoPlus, 10 },
+		{ "-", ecoNeg, 10 },
+		{ "~", ecoRev, 1 },
+	};
+
+	static constexpr CONST_TOKEN	vpostfix[] =
+	{
+		{ "!", ecoFact, 1 },
+	};
+
+	static constexpr CONST_TOKEN	vfunc[] =
+	{
+		{ "", ecoBracket, 1 },
+		{ "sin", ecoSin, 1 },
+		{ "sinc", ecoSinc, 1 },
+		{ "cos", ecoCos, 1 },
+		{ "tg", ecoTan, 1 },
+		{ "ctg", ecoCot, 1 },
+		{ "arcsin", ecoArcsin, 1 },
+		{ "arccos", ecoArccos, 1 },
+		{ "arctg", ecoArctan, 1 },
+		{ "arcctg", ecoArccot, 1 },
+		{ "pi", ecoPi, 0 },
+		{ "e", ecoE, 0 },
+		{ "exp", ecoExp, 1 },
+		{ "sqrt", ecoSqrt, 1 },
+		{ "cbrt", ecoCbrt, 1 },
+	};
+
+	constexpr CHAR			At( size_t u ) const
+	{
+		return ( u < m_length ? m_psz[ u ] : CHAR( 0 ) );
+	}
+
+	static constexpr size_t	Length( const char * psz )
+	{
+		size_t n = 0;
+		while ( psz[ n ] ) ++n;
+		return n;
+	}
+
+	static constexpr BOOL	IsAlpha( int chr )
+	{
+		return ( chr >= 'A' && chr <= 'Z' || chr >= 'a' && chr <= 'z' || chr == '_' );
+	}
+
+	static constexpr BOOL	IsDigit( int chr )
+	{
+		return ( chr >= '0' && chr <= '9' );
+	}
+
+	constexpr VOID			SkipSpaces( size_t & uAtChar ) const
+	{
+		while ( At( uAtChar ) == CHAR( ' ' ) ) uAtChar++;
+	}
+
+	constexpr BOOL			IsNextChar( size_t & uAtChar, char chr ) const
+	{
+		SkipSpaces( uAtChar );
+		if ( At( uAtChar ) == CHAR( chr ) )
+		{
+			uAtChar++;
+			return TRUE;
+		}
+
+		return FALSE;
+	}
+
+	// the longest token which name starts the text at uAtChar, as CExprParser::FindToken
+	template <size_t N>
+	constexpr const CONST_TOKEN * FindToken( size_t & uAtChar, const CONST_TOKEN ( & vtok )[ N ] ) const
+	{
+		const CONST_TOKEN * ptok = nullptr;
+		size_t length = 0;
+		for ( const auto & tok : vtok )
+		{
+			const size_t n = Length( tok.pszName );
+			size_t u = 0;
+			while ( u < n && At( uAtChar + u ) == CHAR( tok.pszName[ u ] ) ) ++u;
+			if ( u == n && ( !ptok || n > length ) )
+			{
+				ptok = &tok;
+				length = n;
+			}
+		}
+
+		if ( ptok )
+		{
+			uAtChar += length;
+		}
+
+		return ptok;
+	}
+
+	// CMyParser::ParseDouble, FALSE for invalid numeric
+	constexpr BOOL			ParseDouble( size_t & uAtChar, long double & d ) const
+	{
+		int mode = 0;
+		long double d1 = 0, d2 = 0, l = 10;
+		int ex = 0, exSign = 1;
+		size_t u = uAtChar;
+
+		for ( ; u < m_length; ++u )
+		{
+			const CHAR s = m_psz[ u ];
+			if ( IsDigit( s ) )
+			{
+				switch ( mode )
+				{
+					case 0: d1 = 10 * d1 + static_cast<long double>( s - CHAR( '0' ) ); break;
+					case 1: d2 = d2 + static_cast<long double>( s - CHAR( '0' ) ) / l; l *= 10; break;
+					default: ex = 10 * ex + ( s - CHAR( '0' ) ); mode = 3; break;
+				}
+			}
+			else if ( s == CHAR( '.' ) && mode == 0 )
+			{
+				mode = 1;
+			}
+			else if ( ( s == CHAR( 'e' ) || s == CHAR( 'E' ) ) && mode <= 1 )
+			{
+				mode = 2;
+				if ( At( u + 1 ) == CHAR( '-' ) )
+				{
+					exSign = -1;
+					u++;
+				}
+				else if ( At( u + 1 ) == CHAR( '+' ) )
+				{
+					u++;
+				}
+			}
+			else
+			{
+				break;
+			}
+		}
+
+		if ( u == uAtChar || mode == 2 )
+		{
+			return FALSE;
+		}
+
+		// std::pow( 10, n ) of the runtime parser is double
+		double p = 1;
+		for ( int n = 0; n < ex; ++n ) p *= 10;
+
+		uAtChar = u;
+		d = ( d1 + d2 ) * ( exSign < 0 ? 1 / p : p );
+		return TRUE;
+	}
+
+	constexpr BOOL			FieldIs( size_t uField, size_t uAtChar, size_t length ) const
+	{
+		if ( m_vfieldLen[ uField ] != length )
+		{
+			return FALSE;
+		}
+
+		for ( size_t u = 0; u < length; ++u )
+		{
+			if ( CHAR( m_pszFields[ m_vfield[ uField ] + u ] ) != At( uAtChar + u ) )
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	// CExprParser::TestVariable: the longest variable seen before, otherwise CMyParser::IsVariable
+	constexpr VOID			TestVariable( size_t & uAtChar, CONST_TREE & pt )
+	{
+		size_t length = 0;
+		for ( size_t v = 0; v < m_nVars; ++v )
+		{
+			const size_t n = m_vfieldLen[ m_vvar[ v ] ];
+			if ( n > length && FieldIs( m_vvar[ v ], uAtChar, n ) )
+			{
+				pt.uField = m_vvar[ v ];
+				length = n;
+			}
+		}
+
+		if ( !length )
+		{
+			while ( IsAlpha( At( uAtChar + length ) ) || ( length && IsDigit( At( uAtChar + length ) ) ) ) ++length;
+
+			pt.uField = m_nFields;
+			for ( size_t f = 0; f < m_nFields; ++f )
+			{
+				if ( FieldIs( f, uAtChar, length ) )
+				{
+					pt.uField = f;
+				}
+			}
+
+			// not an identifier or not a field of the struct
+			if ( !length || pt.uField == m_nFields )
+			{
+				throw CExprParserNoSuchVariable( uAtChar );
+			}
+
+			m_vvar[ m_nVars++ ] = pt.uField;
+		}
+
+		uAtChar += length;
+		pt.ett = ettVariable;
+	}
+
+	constexpr VOID			Push( CONST_TREE * vpt, size_t & n, const CONST_TREE & pt ) const
+	{
+		if ( n == CONST_MAX_TOKENS )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		vpt[ n++ ] = pt;
+	}
+
+	// CExprParser::SortToken
+	constexpr VOID			SortToken( CONST_TREE & op )
+	{
+		switch ( op.ett )
+		{
+			case ettNumber:
+			case ettVariable:
+				{
+					Push( m_vtree, m_nTree, op );
+					break;
+				}
+			case ettFunc:
+				{
+					Push( m_vstack, m_nStack, op );
+					break;
+				}
+			case ettBraceRight:
+			case ettComma:
+				{
+					while ( m_nStack && m_vstack[ m_nStack - 1 ].ett != ettFunc )
+					{
+						Push( m_vtree, m_nTree, m_vstack[ --m_nStack ] );
+					}
+
+					if ( !m_nStack )
+					{
+						throw CExprParserNoSuchToken();
+					}
+
+					if ( op.ett == ettBraceRight )
+					{
+						Push( m_vtree, m_nTree, m_vstack[ --m_nStack ] );
+					}
+					break;
+				}
+			case ettOpToken:
+				{
+					while ( m_nStack && m_vstack[ m_nStack - 1 ].ett == ettOpToken )
+					{
+						const CONST_TOKEN & back = m_vstack[ m_nStack - 1 ].tok;
+						if ( op.tok.eta == etaRightOriented ? op.tok.prio > back.prio : op.tok.prio >= back.prio )
+						{
+							Push( m_vtree, m_nTree, m_vstack[ --m_nStack ] );
+						}
+						else
+						{
+							break;
+						}
+					}
+
+					Push( m_vstack, m_nStack, op );
+					break;
+				}
+			default:
+				{
+					break;
+				}
+		}
+
+		op = CONST_TREE();
+	}
+
+	// CExprParser::ParseLoop
+	constexpr VOID			ParseLoop()
+	{
+		CONST_TREE pt;
+		size_t vfuncArgs[ CONST_MAX_DEPTH ] = {};
+		BOOL vfargpresent[ CONST_MAX_DEPTH ] = {};
+		size_t nDepth = 0;
+		EXPR_TOKEN_TYPE etExpected = ettUnaryPre;
+		size_t uAtChar = 0;
+
+		auto ArgumentPresent = [ & ]()
+			{
+				if ( nDepth && !vfuncArgs[ nDepth - 1 ] )
+				{
+					vfuncArgs[ nDepth - 1 ]++;
+				}
+
+				if ( nDepth )
+				{
+					vfargpresent[ nDepth - 1 ] = TRUE;
+				}
+			};
+
+		while ( uAtChar < m_length )
+		{
+			SkipSpaces( uAtChar );
+
+			switch ( etExpected )
+			{
+				case ettUnaryPre:
+					{
+						const CONST_TOKEN * ptok = FindToken( uAtChar, vprefix );
+						if ( ptok )
+						{
+							pt.uPreOp.Push( *ptok );
+						}
+						else
+						{
+							etExpected = ettNumber;
+						}
+						break;
+					}
+				case ettUnaryPost:
+					{
+						const CONST_TOKEN * ptok = FindToken( uAtChar, vpostfix );
+						if ( ptok )
+						{
+							pt.uPostOp.Push( *ptok );
+						}
+						else
+						{
+							etExpected = ettComma;
+							SortToken( pt );
+						}
+						break;
+					}
+				case ettUnaryPostFunc:
+					{
+						if ( !m_nTree || m_vtree[ m_nTree - 1 ].ett != ettFunc )
+						{
+							throw CExprParserNoSuchToken( uAtChar );
+						}
+
+						const CONST_TOKEN * ptok = FindToken( uAtChar, vpostfix );
+						if ( ptok )
+						{
+							m_vtree[ m_nTree - 1 ].uPostOp.Push( *ptok );
+						}
+						else
+						{
+							etExpected = ettComma;
+						}
+						break;
+					}
+				case ettNumber:
+					{
+						if ( At( uAtChar ) == CHAR( 'i' ) )
+						{
+							// imaginary unit of CMyParser::ParseNumeric
+							throw CExprParserInvalidNumeric( uAtChar );
+						}
+
+						if ( ParseDouble( uAtChar, pt.dValue ) )
+						{
+							pt.ett = ettNumber;
+							etExpected = ettUnaryPost;
+							ArgumentPresent();
+						}
+						else
+						{
+							etExpected = ettFunc;
+						}
+						break;
+					}
+				case ettFunc:
+					{
+						size_t uAtFunc = uAtChar;
+						const CONST_TOKEN * ptok = FindToken( uAtFunc, vfunc );
+						if ( IsNextChar( uAtFunc, '(' ) )
+						{
+							uAtChar = uAtFunc;
+							pt.ett = ettFunc;
+							pt.tok = *ptok;
+							SortToken( pt );
+							etExpected = ettUnaryPre;
+
+							ArgumentPresent();
+							if ( nDepth == CONST_MAX_DEPTH )
+							{
+								throw CExprParserNoSuchToken( uAtChar );
+							}
+
+							vfuncArgs[ nDepth ] = 0;
+							vfargpresent[ nDepth++ ] = FALSE;
+
+							SkipSpaces( uAtChar );
+							if ( At( uAtChar ) == CHAR( ')' ) )
+							{
+								etExpected = ettBraceRight;
+							}
+						}
+						else if ( ptok->pszName[ 0 ] )
+						{
+							// the runtime parser skips the name of the function without brackets
+							throw CExprParserNoSuchFunction( TEXT( "" ), uAtChar );
+						}
+						else
+						{
+							etExpected = ettVariable;
+						}
+						break;
+					}
+				case ettVariable:
+					{
+						TestVariable( uAtChar, pt );
+						etExpected = ettUnaryPost;
+						ArgumentPresent();
+						break;
+					}
+				case ettComma:
+					{
+						if ( IsNextChar( uAtChar, ',' ) )
+						{
+							pt.ett = ettComma;
+							SortToken( pt );
+							etExpected = ettUnaryPre;
+
+							if ( !nDepth )
+							{
+								throw CExprParserNoSuchToken( uAtChar );
+							}
+
+							vfuncArgs[ nDepth - 1 ]++;
+							vfargpresent[ nDepth - 1 ] = FALSE;
+						}
+						else
+						{
+							etExpected = ettBraceRight;
+						}
+						break;
+					}
+				case ettBraceRight:
+					{
+						if ( IsNextChar( uAtChar, ')' ) )
+						{
+							if ( !nDepth )
+							{
+								throw CExprParserBracketMismatch( uAtChar );
+							}
+
+							const size_t nlastArgs = vfuncArgs[ --nDepth ];
+							const BOOL fargpresent = vfargpresent[ nDepth ];
+							pt.ett = ettBraceRight;
+							SortToken( pt );
+							etExpected = ettUnaryPostFunc;
+
+							if ( nlastArgs > 0 && !fargpresent )
+							{
+								throw CExprParserUnexpectedEndOfExpression( uAtChar );
+							}
+							else if ( nlastArgs != size_t( m_vtree[ m_nTree - 1 ].tok.prio ) )
+							{
+								throw CExprParserWrongArguments( m_vtree[ m_nTree - 1 ].tok.prio, nlastArgs, uAtChar );
+							}
+						}
+						else
+						{
+							etExpected = ettOpToken;
+						}
+						break;
+					}
+				case ettOpToken:
+					{
+						// the nameless operator is the multiplication, so some operator is always found
+						pt.tok = *FindToken( uAtChar, vop );
+						pt.ett = ettOpToken;
+						SortToken( pt );
+						etExpected = ettUnaryPre;
+						break;
+					}
+				default:
+					{
+						throw CExprParserException( TEXT( "Internal error while parsing" ) );
+					}
+			}
+		}
+
+		if ( nDepth )
+		{
+			throw CExprParserBracketMismatch();
+		}
+
+		switch ( pt.ett )
+		{
+			case ettNumber:
+			case ettFunc:
+			case ettVariable:
+				{
+					SortToken( pt );
+					break;
+				}
+			default:
+				{
+					break;
+				}
+		}
+
+		while ( m_nStack )
+		{
+			Push( m_vtree, m_nTree, m_vstack[ --m_nStack ] );
+		}
+	}
+
+	// CExprProgram::Operand, prefix operators [ uPreBegin, uPreEnd ) are applied
+	static constexpr EXPR_ARG	Operand( CONST_PROGRAM & prog, EXPR_ARG arg, const CONST_UNARY & uPreOp, size_t uPreBegin, size_t uPreEnd, const CONST_UNARY & uPostOp )
+	{
+		for ( size_t u = 0; u < uPostOp.n; ++u )
+		{
+			arg = Emit( prog, uPostOp.veco[ u ], 1, arg, EXPR_ARG() );
+		}
+
+		while ( uPreEnd != uPreBegin )
+		{
+			arg = Emit( prog, uPreOp.veco[ --uPreEnd ], 1, arg, EXPR_ARG() );
+		}
+
+		return arg;
+	}
+
+	static constexpr EXPR_ARG	Emit( CONST_PROGRAM & prog, CONST_OP eco, size_t nArgs, const EXPR_ARG & a, const EXPR_ARG & b )
+	{
+		if ( prog.nNodes == CONST_MAX_TOKENS )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		CONST_NODE & node = prog.vnode[ prog.nNodes ];
+		node.eco = eco;
+		node.nArgs = nArgs;
+		node.varg[ 0 ] = a;
+		node.varg[ 1 ] = b;
+		return EXPR_ARG( eatNode, prog.nNodes++ );
+	}
+
+	// CExprProgram::Build, slots are the fields of the struct
+	constexpr CONST_PROGRAM	Build() const
+	{
+		typedef struct _tagOPERAND
+		{
+			EXPR_ARG				arg;
+			CONST_UNARY				uPreOp;
+			CONST_UNARY				uPostOp;
+		} OPERAND;
+
+		CONST_PROGRAM prog;
+		OPERAND stack[ CONST_MAX_TOKENS ] = {};
+		size_t nStack = 0;
+
+		for ( size_t n = 0; n < m_nTree; ++n )
+		{
+			const CONST_TREE & pt = m_vtree[ n ];
+			OPERAND op;
+			op.uPreOp = pt.uPreOp;
+			op.uPostOp = pt.uPostOp;
+
+			switch ( pt.ett )
+			{
+				case ettNumber:
+					{
+						prog.vconst[ prog.nConsts ] = pt.dValue;
+						op.arg = EXPR_ARG( eatConst, prog.nConsts++ );
+						break;
+					}
+				case ettVariable:
+					{
+						op.arg = EXPR_ARG( eatSlot, pt.uField );
+						break;
+					}
+				case ettFunc:
+					{
+						const size_t nArgs = size_t( pt.tok.prio );
+						if ( nStack < nArgs )
+						{
+							throw CExprParserWrongArguments( nArgs, nStack );
+						}
+
+						EXPR_ARG varg[ 2 ];
+						for ( size_t a = 0; a < nArgs; ++a )
+						{
+							const OPERAND & arg = stack[ nStack - nArgs + a ];
+							varg[ a ] = Operand( prog, arg.arg, arg.uPreOp, 0, arg.uPreOp.n, arg.uPostOp );
+						}
+						nStack -= nArgs;
+
+						op.arg = Emit( prog, pt.tok.eco, nArgs, varg[ 0 ], varg[ 1 ] );
+						break;
+					}
+				case ettOpToken:
+					{
+						if ( nStack < 2 )
+						{
+							throw CExprParserUnexpectedEndOfExpression();
+						}
+
+						if ( pt.tok.eco == ecoAssign )
+						{
+							throw CExprParserCantAssignNumeric();
+						}
+
+						const OPERAND p2 = stack[ --nStack ];
+						const OPERAND p1 = stack[ --nStack ];
+
+						// all lower priorities prefix tokens will be applied to the result
+						size_t v = 0;
+						while ( v < p1.uPreOp.n && p1.uPreOp.vprio[ v ] > pt.tok.prio ) ++v;
+
+						const EXPR_ARG a = Operand( prog, p1.arg, p1.uPreOp, v, p1.uPreOp.n, p1.uPostOp );
+						const EXPR_ARG b = Operand( prog, p2.arg, p2.uPreOp, 0, p2.uPreOp.n, p2.uPostOp );
+
+						op.arg = Emit( prog, pt.tok.eco, 2, a, b );
+						op.uPreOp = CONST_UNARY();
+						for ( size_t u = 0; u < v; ++u )
+						{
+							op.uPreOp.veco[ u ] = p1.uPreOp.veco[ u ];
+							op.uPreOp.vprio[ u ] = p1.uPreOp.vprio[ u ];
+						}
+						op.uPreOp.n = v;
+						op.uPostOp = CONST_UNARY();
+						break;
+					}
+				default:
+					{
+						throw CExprParserException( TEXT( "Internal error while compiling" ) );
+					}
+			}
+
+			stack[ nStack++ ] = op;
+		}
+
+		if ( !nStack )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		const OPERAND & r = stack[ nStack - 1 ];
+		prog.result = Operand( prog, r.arg, r.uPreOp, 0, r.uPreOp.n, r.uPostOp );
+		return prog;
+	}
+
+public:
+	// pszFields - comma separated names of the fields
+	constexpr CExprConstParser( const CHAR * psz, const char * pszFields )
+		: m_psz( psz ), m_length( 0 ), m_pszFields( pszFields )
+	{
+		while ( psz[ m_length ] ) ++m_length;
+
+		for ( size_t u = 0; pszFields[ u ]; )
+		{
+			while ( pszFields[ u ] == ' ' || pszFields[ u ] == ',' ) ++u;
+			if ( !pszFields[ u ] )
+			{
+				break;
+			}
+
+			if ( m_nFields == CONST_MAX_FIELDS )
+			{
+				throw CExprParserNoSuchVariable();
+			}
+
+			m_vfield[ m_nFields ] = u;
+			while ( pszFields[ u ] && pszFields[ u ] != ' ' && pszFields[ u ] != ',' ) ++u;
+			m_vfieldLen[ m_nFields ] = u - m_vfield[ m_nFields ];
+			m_nFields++;
+		}
+	}
+
+	constexpr CONST_PROGRAM	Compile()
+	{
+		ParseLoop();
+		return Build();
+	}
+
+	constexpr size_t		Fields() const
+	{
+		return m_nFields;
+	}
+
+	// name of the field, for the runtime parser
+	CStringOp				Field( size_t uField ) const
+	{
+		std::vector<TCHAR> vsz( m_pszFields + m_vfield[ uField ], m_pszFields + m_vfield[ uField ] + m_vfieldLen[ uField ] );
+		vsz.push_back( 0 );
+		return CStringOp( vsz.data() );
+	}
+};
+
+// values of the fields in long double
+template <class... T>
+static inline constexpr std::array<long double, sizeof...( T )> ConstValues( const T & ... v )
+{
+	return { static_cast<long double>( v )... };
+}
+
+template <class VARS, class SOURCE>
+class CExprConst
+{
+	static constexpr CONST_PROGRAM	m_prog = CExprConstParser<TCHAR>( SOURCE::Expression(), SOURCE::Fields() ).Compile();
+
+	// the expression is parsed where EXPR_CONST is expanded, not where it is called first
+	static_assert( m_prog.nNodes <= CONST_MAX_TOKENS, "The expression is too long" );
+
+	template <EXPR_ARG_TYPE eat, size_t u, size_t N>
+	static long double		Value( const std::array<long double, N> & v )
+	{
+		if constexpr ( eat == eatNode )
+		{
+			return Node<u>( v );
+		}
+		else if constexpr ( eat == eatSlot )
+		{
+			return v[ u ];
+		}
+		else
+		{
+			return m_prog.vconst[ u ];
+		}
+	}
+
+	template <size_t uNode, size_t uArg, size_t N>
+	static long double		Arg( const std::array<long double, N> & v )
+	{
+		return Value<m_prog.vnode[ uNode ].varg[ uArg ].eat, m_prog.vnode[ uNode ].varg[ uArg ].u>( v );
+	}
+
+	// real semantic of the operators and functions of CMyParser
+	template <size_t uNode, size_t N>
+	static long double		Node( const std::array<long double, N> & v )
+	{
+		constexpr CONST_OP eco = m_prog.vnode[ uNode ].eco;
+
+		if constexpr ( eco == ecoPi )
+		{
+			return M_PIC;
+		}
+		else if constexpr ( eco == ecoE )
+		{
+			return std::exp( 1.0 );
+		}
+		else if constexpr ( eco >= ecoAdd && eco <= ecoSecond )
+		{
+			const long double a = Arg<uNode, 0>( v ), b = Arg<uNode, 1>( v );
+			switch ( eco )
+			{
+				case ecoAdd: return a + b;
+				case ecoSub: return a - b;
+				case ecoMul: return a * b;
+				case ecoDiv: return a / b;
+				case ecoSecond: return b;
+				default:
+					{
+						// power of negative base is complex for non-integer exponent, std::pow gives NaN
+						if ( a != 0 && b == std::trunc( b ) && std::fabs( b ) <= POW_INT_MAX )
+						{
+							return ( b ? PowInt( a, long( b ) ) : 1.0L );
+						}
+
+						return std::pow( a, b );
+					}
+			}
+		}
+		else
+		{
+			const long double a = Arg<uNode, 0>( v );
+			switch ( eco )
+			{
+				case ecoNeg: return -a;
+				case ecoFact: return std::tgamma( a + 1 );
+				case ecoSin: return std::sin( a );
+				case ecoSinc: return std::sin( a ) / a;
+				case ecoCos: return std::cos( a );
+				case ecoTan: return std::tan( a );
+				case ecoCot: return 1 / std::tan( a );
+				case ecoArcsin: return std::asin( a );
+				case ecoArccos: return std::acos( a );
+				case ecoArctan: return std::atan( a );
+				case ecoArccot: return std::atan( 1 / a );
+				case ecoExp: return std::exp( a );
+				case ecoSqrt: return std::sqrt( a );
+				// pow( z, 1.0 / 3.0 ) of CMyParser
+				case ecoCbrt: return ( a >= 0 ? std::pow( a, static_cast<long double>( 1.0 / 3.0 ) ) : NAN );
+				default: return a;		// '+', '~' and brackets
+			}
+		}
+	}
+
+public:
+	static constexpr LPCTSTR		Expression()
+	{
+		return SOURCE::Expression();
+	}
+
+	long double				operator()( const VARS & vars ) const
+	{
+		return Value<m_prog.result.eat, m_prog.result.u>( SOURCE::Values( vars ) );
+	}
+
+	// the same formula compiled by CMyParser
+	static VOID				Program( CExprProgram<TOK> & prog )
+	{
+		CMyParser parser;
+		parser.Compile( CStringOp( SOURCE::Expression() ).GetString() );
+		prog.Build( parser.Tree() );
+	}
+
+	// slots of the runtime program from the fields
+	static VOID				Slots( const VARS & vars, const CExprProgram<TOK> & prog, std::vector<TOK> & vslots )
+	{
+		const CExprConstParser<char> fields( "", SOURCE::Fields() );
+		const auto v = SOURCE::Values( vars );
+
+		vslots.assign( prog.Slots().size(), TOK() );
+		for ( size_t f = 0; f < fields.Fields(); ++f )
+		{
+			const size_t uSlot = prog.Slot( fields.Field( f ) );
+			if ( uSlot != size_t( -1 ) )
+			{
+				vslots[ uSlot ] = TOK( v[ f ] );
+				vslots[ uSlot ].var = TRUE;
+				vslots[ uSlot ].name = fields.Field( f );
+			}
+		}
+	}
+};
+
+// pszExpression is a literal of TCHAR, fields follow in the order of declaration
+#define EXPR_CONST( VARS, pszExpression, ... ) \
+	[]() \
+	{ \
+		struct _tagSOURCE \
+		{ \
+			static constexpr LPCTSTR Expression() { return TEXT( pszExpression ); } \
+			static constexpr const char * Fields() { return #__VA_ARGS__; } \
+			static auto Values( const VARS & vars ) { const auto & [ __VA_ARGS__ ] = vars; return ConstValues( __VA_ARGS__ ); } \
+		}; \
+		return CExprConst<VARS, _tagSOURCE>(); \
+	}()
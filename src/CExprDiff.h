@@ -0,0 +1,285 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Automatic differentiation of compiled programs. The rules give the partial derivatives of
+   the operators and functions at the point, and CExprDiff evaluates the program with them:
+   the derivative along a direction by one forward pass of dual numbers, or the whole gradient
+   by the forward pass which records the partials and one reverse pass over them:
+
+	CExprDerivatives<TOK> rules;
+	CMyParser::Derivatives( rules );
+	CExprDiff<TOK> diff( rules, prog );
+	TOK value = diff.Gradient( vslots.data(), vgrad.data() );
+*/
+
+#pragma once
+
+#include "CExprProgram.h"
+
+template <class NUM>
+class CExprDerivatives
+{
+public:
+	// ppartial[ n ] = d result / d parg[ n ], n < nArgs
+	typedef std::function<VOID( const NUM * parg, size_t nArgs, const NUM & result, NUM * ppartial )>	RULE;
+	typedef std::function<NUM( const NUM &, const NUM & )>	ARITH;
+
+private:
+	typedef struct _tagDERIV_RULE
+	{
+		EXPR_NODE_TYPE					ent;
+		CStringOp						sName;
+		BOOL							fPrefix;
+		RULE							rule;
+	} DERIV_RULE;
+
+	std::deque<DERIV_RULE>				m_vrule;	// references given by AddRule stay valid
+	ARITH								m_add;
+	ARITH								m_mul;
+
+public:
+	CExprDerivatives()
+	{
+		// brackets are the function without name, see CExprParser::CExprParser
+		AddRule( entFunc, TEXT( "" ) ) = []( const NUM * parg, size_t nArgs, const NUM & result, NUM * ppartial ) { ppartial[ 0 ] = NUM( 1 ); };
+	}
+
+	// rule of the token, the later one replaces the former. Tokens without rules can't be differentiated
+	RULE &				AddRule( EXPR_NODE_TYPE ent, LPCTSTR pszName, BOOL fPrefix = TRUE )
+	{
+		for ( auto & v : m_vrule )
+		{
+			if ( v.ent == ent && v.sName == CStringOp( pszName ) && ( ent != entUnary || v.fPrefix == fPrefix ) )
+			{
+				return v.rule;
+			}
+		}
+
+		DERIV_RULE rule;
+		rule.ent = ent;
+		rule.sName = pszName;
+		rule.fPrefix = fPrefix;
+		m_vrule.push_back( rule );
+		return m_vrule.back().rule;
+	}
+
+	// rule of the token of the node, nullptr if there is none
+	const RULE *		Find( const CExprProgram<NUM> & prog, const EXPR_NODE & node ) const
+	{
+		const CStringOp & sName = prog.TokenName( node );
+		for ( const auto & v : m_vrule )
+		{
+			if ( v.ent == node.ent && v.sName == sName && ( node.ent != entUnary || v.fPrefix == prog.Unary( node ).Prefix() ) && v.rule )
+			{
+				return &v.rule;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// arithmetic of the derivatives
+	ARITH &				AddFunc()
+	{
+		return m_add;
+	}
+
+	ARITH &				MulFunc()
+	{
+		return m_mul;
+	}
+
+	NUM					Add( const NUM & a, const NUM & b ) const
+	{
+		return m_add( a, b );
+	}
+
+	NUM					Mul( const NUM & a, const NUM & b ) const
+	{
+		return m_mul( a, b );
+	}
+};
+
+// derivatives of one program. The scratch memory is kept between the calls, so the object
+// belongs to one thread, and the program and the rules must outlive it
+template <class NUM>
+class CExprDiff
+{
+	const CExprDerivatives<NUM> &		m_rules;
+	const CExprProgram<NUM> &			m_prog;
+	std::vector<const typename CExprDerivatives<NUM>::RULE *>	m_vrule;	// of each node
+	std::vector<size_t>					m_vfirst;	// first partial of each node
+	std::vector<NUM>					m_vval;		// results of the nodes
+	std::vector<NUM>					m_vdot;		// their derivatives along the direction
+	std::vector<NUM>					m_vadj;		// derivatives of the result by them
+	std::vector<NUM>					m_vpartial;	// partials of the nodes by their arguments
+	std::vector<NUM>					m_vargs;	// arguments of the node
+
+	const NUM &			Value( const EXPR_ARG & arg, const NUM * pSlots ) const
+	{
+		switch ( arg.eat )
+		{
+			case eatConst: return m_prog.Const( arg.u );
+			case eatSlot: return pSlots[ arg.u ];
+			default: return m_vval[ arg.u ];
+		}
+	}
+
+	// evaluates the nodes and their partials, and their derivatives along pDir if it is given
+	VOID				Forward( const NUM * pSlots, const NUM * pDir )
+	{
+		const auto & vnode = m_prog.Nodes();
+		size_t u = 0;
+
+		try
+		{
+			for ( ; u < vnode.size(); ++u )
+			{
+				const EXPR_NODE & node = vnode[ u ];
+				const size_t cargs = node.varg.size();
+				m_vargs.resize( cargs );
+				for ( size_t n = 0; n < cargs; ++n )
+				{
+					m_vargs[ n ] = Value( node.varg[ n ], pSlots );
+				}
+
+				switch ( node.ent )
+				{
+					case entUnary: m_vval[ u ] = m_prog.Unary( node ).Func()( m_vargs[ 0 ] ); break;
+					case entBinary:
+						{
+							// operators take references, the copies keep the arguments of the partials
+							NUM a = m_vargs[ 0 ], b = m_vargs[ 1 ];
+							m_vval[ u ] = m_prog.Binary( node ).Func()( a, b );
+							break;
+						}
+					default: m_vval[ u ] = m_prog.Func( node ).Func()( m_vargs ); break;
+				}
+
+				NUM * ppartial = m_vpartial.data() + m_vfirst[ u ];
+				( *m_vrule[ u ] )( m_vargs.data(), cargs, m_vval[ u ], ppartial );
+
+				if ( !pDir )
+				{
+					continue;
+				}
+
+				NUM dot = NUM( 0 );
+				for ( size_t n = 0; n < cargs; ++n )
+				{
+					const EXPR_ARG & arg = node.varg[ n ];
+					if ( arg.eat != eatConst )
+					{
+						dot = m_rules.Add( dot, m_rules.Mul( ppartial[ n ], arg.eat == eatSlot ? pDir[ arg.u ] : m_vdot[ arg.u ] ) );
+					}
+				}
+
+				m_vdot[ u ] = dot;
+			}
+		}
+		catch ( CExprParserLimitExceeded & e )
+		{
+			UNREFERENCED_PARAMETER( e );
+			throw;
+		}
+		catch ( CExprParserException & e )
+		{
+			throw CExprParserException( e.Message(), e.AtChar() == size_t( -1 ) ? vnode[ u ].uAtChar : e.AtChar() );
+		}
+	}
+
+public:
+	// throws if the program has lazy nodes, or a token without the rule, e.g. assignment
+	CExprDiff( const CExprDerivatives<NUM> & rules, const CExprProgram<NUM> & prog )
+		: m_rules( rules ), m_prog( prog )
+	{
+		if ( prog.Lazy() )
+		{
+			throw CExprParserException( TEXT( "Lazy functions can't be differentiated" ) );
+		}
+
+		const auto & vnode = prog.Nodes();
+		size_t nPartials = 0;
+		for ( const auto & node : vnode )
+		{
+			const typename CExprDerivatives<NUM>::RULE * prule = rules.Find( prog, node );
+			if ( !prule )
+			{
+				throw CExprParserException( TEXT( "There is no derivative of the operator" ), node.uAtChar );
+			}
+
+			m_vrule.push_back( prule );
+			m_vfirst.push_back( nPartials );
+			nPartials += node.varg.size();
+		}
+
+		m_vval.resize( vnode.size() );
+		m_vdot.resize( vnode.size() );
+		m_vadj.resize( vnode.size() );
+		m_vpartial.resize( nPartials );
+	}
+
+	// derivative along pDir, pDir[ i ] is the change of Slots()[ i ]. value is the result
+	NUM					Tangent( const NUM * pSlots, const NUM * pDir, NUM & value )
+	{
+		Forward( pSlots, pDir );
+
+		const EXPR_ARG & result = m_prog.Result();
+		value = Value( result, pSlots );
+		switch ( result.eat )
+		{
+			case eatConst: return NUM( 0 );
+			case eatSlot: return pDir[ result.u ];
+			default: return m_vdot[ result.u ];
+		}
+	}
+
+	// pGrad[ i ] is the derivative by Slots()[ i ]. Returns the result
+	NUM					Gradient( const NUM * pSlots, NUM * pGrad )
+	{
+		Forward( pSlots, nullptr );
+
+		const auto & vnode = m_prog.Nodes();
+		const EXPR_ARG & result = m_prog.Result();
+		std::fill( m_vadj.begin(), m_vadj.end(), NUM( 0 ) );
+		std::fill( pGrad, pGrad + m_prog.Slots().size(), NUM( 0 ) );
+
+		switch ( result.eat )
+		{
+			case eatConst: break;
+			case eatSlot: pGrad[ result.u ] = NUM( 1 ); break;
+			default: m_vadj[ result.u ] = NUM( 1 ); break;
+		}
+
+		for ( size_t u = vnode.size(); u-- > 0; )
+		{
+			const EXPR_NODE & node = vnode[ u ];
+			const NUM * ppartial = m_vpartial.data() + m_vfirst[ u ];
+			for ( size_t n = 0; n < node.varg.size(); ++n )
+			{
+				const EXPR_ARG & arg = node.varg[ n ];
+				if ( arg.eat == eatConst )
+				{
+					continue;
+				}
+
+				NUM & adj = ( arg.eat == eatSlot ? pGrad[ arg.u ] : m_vadj[ arg.u ] );
+				adj = m_rules.Add( adj, m_rules.Mul( m_vadj[ u ], ppartial[ n ] ) );
+			}
+		}
+
+		return Value( result, pSlots );
+	}
+};
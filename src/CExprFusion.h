@@ -0,0 +1,171 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Superinstructions of the executor. Pairs of nodes which are frequent in the profiled
+   programs are executed as one instruction, pairs of binary operators by their fused functions */
+
+#pragma once
+
+#include "CExprProgram.h"
+
+template <class NUM>
+class CExprFusion
+{
+public:
+	typedef typename CExprProgram<NUM>::FUSED	FUSED;
+
+	// node of type entFirst and the next node which takes its result as argument uArg
+	typedef struct _tagPATTERN
+	{
+		EXPR_NODE_TYPE				entFirst;
+		CStringOp					sFirst;
+		EXPR_NODE_TYPE				entSecond;
+		CStringOp					sSecond;
+		size_t						uArg;
+		size_t						nCount;		// in the profiled programs
+		FUSED						fused;
+	} PATTERN;
+
+private:
+	std::vector<PATTERN>			m_vfused;
+	std::vector<PATTERN>			m_vprofile;
+	std::vector<PATTERN>			m_vset;
+
+	static BOOL		Match( const PATTERN & pattern, const CExprProgram<NUM> & prog, size_t uNode, size_t uArg )
+	{
+		const EXPR_NODE & first = prog.Nodes()[ uNode ], & second = prog.Nodes()[ uNode + 1 ];
+		return ( pattern.uArg == uArg && pattern.entFirst == first.ent && pattern.entSecond == second.ent &&
+			pattern.sFirst == prog.TokenName( first ) && pattern.sSecond == prog.TokenName( second ) );
+	}
+
+	static typename std::vector<PATTERN>::const_iterator	Find( const std::vector<PATTERN> & v, const CExprProgram<NUM> & prog, size_t uNode, size_t uArg )
+	{
+		return std::find_if( v.begin(), v.end(), [ & ]( const PATTERN & pattern ) { return Match( pattern, prog, uNode, uArg ); } );
+	}
+
+public:
+	// function which replaces binary operators pszFirst and pszSecond, see CExprProgram::Fuse
+	FUSED &			AddFused( LPCTSTR pszFirst, LPCTSTR pszSecond, size_t uArg )
+	{
+		PATTERN pattern;
+		pattern.entFirst = pattern.entSecond = entBinary;
+		pattern.sFirst = pszFirst;
+		pattern.sSecond = pszSecond;
+		pattern.uArg = uArg;
+		pattern.nCount = 0;
+		m_vfused.push_back( pattern );
+		return m_vfused.back().fused;
+	}
+
+	// counts pairs of nodes which may be fused. Each node is executed once per evaluation,
+	// so the counts are dispatches saved per evaluation of the profiled programs
+	VOID			Record( const CExprProgram<NUM> & prog )
+	{
+		for ( size_t u = 0; u + 1 < prog.Nodes().size(); ++u )
+		{
+			const size_t uArg = prog.Fusible( u );
+			if ( uArg == size_t( -1 ) )
+			{
+				continue;
+			}
+
+			auto v = Find( m_vprofile, prog, u, uArg );
+			if ( v != m_vprofile.end() )
+			{
+				m_vprofile[ v - m_vprofile.begin() ].nCount++;
+				continue;
+			}
+
+			const EXPR_NODE & first = prog.Nodes()[ u ], & second = prog.Nodes()[ u + 1 ];
+			PATTERN pattern;
+			pattern.entFirst = first.ent;
+			pattern.sFirst = prog.TokenName( first );
+			pattern.entSecond = second.ent;
+			pattern.sSecond = prog.TokenName( second );
+			pattern.uArg = uArg;
+			pattern.nCount = 1;
+
+			auto f = Find( m_vfused, prog, u, uArg );
+			if ( f != m_vfused.end() )
+			{
+				pattern.fused = f->fused;
+			}
+
+			m_vprofile.push_back( pattern );
+		}
+	}
+
+	// chooses up to nMax most frequent pairs of the profile, returns their count
+	size_t			Select( size_t nMax )
+	{
+		m_vset = m_vprofile;
+		std::stable_sort( m_vset.begin(), m_vset.end(), []( const PATTERN & a, const PATTERN & b ) { return a.nCount > b.nCount; } );
+		if ( m_vset.size() > nMax )
+		{
+			m_vset.resize( nMax );
+		}
+
+		return m_vset.size();
+	}
+
+	// drops the selected pairs which don't make the profiled programs faster, from the least
+	// frequent one. time( fusion ) returns the time of the programs fused by fusion. Returns
+	// count of the pairs left
+	size_t			Prune( const std::function<double( const CExprFusion & fusion )> & time )
+	{
+		for ( size_t u = m_vset.size(); u-- > 0; )
+		{
+			CExprFusion without = *this;
+			without.m_vset.erase( without.m_vset.begin() + u );
+			if ( time( without ) <= time( *this ) )
+			{
+				m_vset = without.m_vset;
+			}
+		}
+
+		return m_vset.size();
+	}
+
+	const std::vector<PATTERN> &	Selected() const
+	{
+		return m_vset;
+	}
+
+	// fuses the selected pairs from the first node, returns count of superinstructions.
+	// Program must not be changed afterwards, see CExprProgram::Nodes
+	size_t			Apply( CExprProgram<NUM> & prog ) const
+	{
+		const CExprProgram<NUM> & cprog = prog;
+		size_t nFused = 0;
+
+		for ( size_t u = 0; u + 1 < cprog.Nodes().size(); ++u )
+		{
+			const size_t uArg = cprog.Fusible( u );
+			if ( uArg == size_t( -1 ) )
+			{
+				continue;
+			}
+
+			auto v = Find( m_vset, cprog, u, uArg );
+			if ( v != m_vset.end() && prog.Fuse( u, v->fused ) )
+			{
+				nFused++;
+				u++;
+			}
+		}
+
+		return nFused;
+	}
+};
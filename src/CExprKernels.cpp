@@ -0,0 +1,268 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Vector math kernels. Exact tier calls libm, other tiers are built from CExprKernelsImpl.h
+   for each instruction set and are selected by the processor features */
+
+#include "CExprKernels.h"
+#include "CDoubleDouble.h"
+#include <float.h>
+#include <stdint.h>
+#include <cmath>
+#include <complex>
+
+static const struct
+{
+	EXPR_KERNEL		ek;
+	LPCTSTR			pszName;
+} g_vKernelName[] =
+{
+	{ ekSin, TEXT( "sin" ) },
+	{ ekSinc, TEXT( "sinc" ) },
+	{ ekCos, TEXT( "cos" ) },
+	{ ekTan, TEXT( "tg" ) },
+	{ ekCot, TEXT( "ctg" ) },
+	{ ekArcsin, TEXT( "arcsin" ) },
+	{ ekArccos, TEXT( "arccos" ) },
+	{ ekArctan, TEXT( "arctg" ) },
+	{ ekArccot, TEXT( "arcctg" ) },
+	{ ekExp, TEXT( "exp" ) },
+	{ ekSqrt, TEXT( "sqrt" ) },
+	{ ekCbrt, TEXT( "cbrt" ) },
+};
+
+namespace exact
+{
+
+template <class FN>
+static inline void			Apply( const double * x, double * y, size_t n, FN fn )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = fn( x[ i ] );
+	}
+}
+
+template <class FN>
+static inline void			Apply( const double * xre, const double * xim, double * yre, double * yim, size_t n, FN fn )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const std::complex<double> v = fn( std::complex<double>( xre[ i ], xim[ i ] ) );
+		yre[ i ] = v.real();
+		yim[ i ] = v.imag();
+	}
+}
+
+typedef std::complex<double> CPX;
+
+static void		KSin( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::sin( v ); } ); }
+static void		KSinc( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::sin( v ) / v; } ); }
+static void		KCos( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::cos( v ); } ); }
+static void		KTan( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::tan( v ); } ); }
+static void		KCot( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return 1.0 / std::tan( v ); } ); }
+static void		KArcsin( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::asin( v ); } ); }
+static void		KArccos( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::acos( v ); } ); }
+static void		KArctan( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::atan( v ); } ); }
+static void		KArccot( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::atan( 1.0 / v ); } ); }
+static void		KExp( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::exp( v ); } ); }
+static void		KSqrt( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::sqrt( v ); } ); }
+static void		KCbrt( const double * x, double * y, size_t n ) { Apply( x, y, n, []( double v ) { return std::cbrt( v ); } ); }
+
+static void		KCSin( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::sin( v ); } ); }
+static void		KCSinc( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::sin( v ) / v; } ); }
+static void		KCCos( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::cos( v ); } ); }
+static void		KCTan( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::tan( v ); } ); }
+static void		KCCot( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return 1.0 / std::tan( v ); } ); }
+static void		KCArcsin( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::asin( v ); } ); }
+static void		KCArccos( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::acos( v ); } ); }
+static void		KCArctan( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::atan( v ); } ); }
+static void		KCArccot( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::atan( 1.0 / v ); } ); }
+static void		KCExp( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::exp( v ); } ); }
+static void		KCSqrt( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::sqrt( v ); } ); }
+static void		KCCbrt( const double * xr, const double * xi, double * yr, double * yi, size_t n ) { Apply( xr, xi, yr, yi, n, []( const CPX & v ) { return std::pow( v, 1.0 / 3.0 ); } ); }
+
+// real tiers of all instruction sets start from libm, complex ones have only eacExact here:
+// std::complex<double> is neither faster nor within EXPR_COMPLEX_ULP for all the functions
+static VOID		Fill( PEXPR_REAL_KERNEL vreal[ ekMax ][ eacMax ], PEXPR_COMPLEX_KERNEL vcomplex[ ekMax ][ eacMax ] )
+{
+	static const PEXPR_REAL_KERNEL vr[ ekMax ] = { KSin, KSinc, KCos, KTan, KCot, KArcsin, KArccos, KArctan, KArccot, KExp, KSqrt, KCbrt };
+	static const PEXPR_COMPLEX_KERNEL vc[ ekMax ] = { KCSin, KCSinc, KCCos, KCTan, KCCot, KCArcsin, KCArccos, KCArctan, KCArccot, KCExp, KCSqrt, KCCbrt };
+
+	for ( int ek = 0; ek < ekMax; ++ek )
+	{
+		for ( int eac = 0; eac < eacMax; ++eac )
+		{
+			vreal[ ek ][ eac ] = vr[ ek ];
+			vcomplex[ ek ][ eac ] = ( eac == eacExact ? vc[ ek ] : nullptr );
+		}
+	}
+}
+
+}
+
+#define KERNEL_NS generic
+#if defined( __FMA__ ) || defined( __ARM_FEATURE_FMA )
+#define KERNEL_FMA 1
+#else
+#define KERNEL_FMA 0
+#endif
+#include "CExprKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_FMA
+
+#if defined( __x86_64__ ) && defined( __GNUC__ )
+#define KERNELS_X86
+
+#pragma GCC push_options
+#pragma GCC target( "avx2,fma" )
+#define KERNEL_NS avx2
+#define KERNEL_FMA 1
+#include "CExprKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_FMA
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target( "avx512f,avx512dq,avx512vl,avx2,fma,prefer-vector-width=512" )
+#define KERNEL_NS avx512
+#define KERNEL_FMA 1
+#include "CExprKernelsImpl.h"
+#undef KERNEL_NS
+#undef KERNEL_FMA
+#pragma GCC pop_options
+#endif
+
+typedef struct _tagKERNEL_TABLE
+{
+	PEXPR_REAL_KERNEL		vreal[ eisaMax ][ ekMax ][ eacMax ];
+	PEXPR_COMPLEX_KERNEL	vcomplex[ eisaMax ][ ekMax ][ eacMax ];
+	PEXPR_DD_KERNEL			vdd[ eisaMax ][ eddMax ];
+
+	_tagKERNEL_TABLE()
+	{
+		for ( int eisa = 0; eisa < eisaMax; ++eisa )
+		{
+			exact::Fill( vreal[ eisa ], vcomplex[ eisa ] );
+			generic::FillDD( vdd[ eisa ] );
+		}
+
+		generic::Fill( vreal[ eisaGeneric ], vcomplex[ eisaGeneric ] );
+#ifdef KERNELS_X86
+		avx2::Fill( vreal[ eisaAVX2 ], vcomplex[ eisaAVX2 ] );
+		avx512::Fill( vreal[ eisaAVX512 ], vcomplex[ eisaAVX512 ] );
+		avx2::FillDD( vdd[ eisaAVX2 ] );
+		avx512::FillDD( vdd[ eisaAVX512 ] );
+#endif
+	}
+} KERNEL_TABLE;
+
+static const KERNEL_TABLE & Table()
+{
+	static const KERNEL_TABLE table;
+	return table;
+}
+
+BOOL CExprKernels::Supported( EXPR_ISA eisa )
+{
+	switch ( eisa )
+	{
+		case eisaGeneric: return TRUE;
+#ifdef KERNELS_X86
+		case eisaAVX2: return ( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) );
+		case eisaAVX512: return ( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512dq" ) &&
+							__builtin_cpu_supports( "avx512vl" ) && Supported( eisaAVX2 ) );
+#endif
+		default: return FALSE;
+	}
+}
+
+EXPR_ISA CExprKernels::Isa()
+{
+	static const EXPR_ISA eisaBest = Supported( eisaAVX512 ) ? eisaAVX512 : ( Supported( eisaAVX2 ) ? eisaAVX2 : eisaGeneric );
+	return eisaBest;
+}
+
+static EXPR_ISA Usable( EXPR_ISA eisa )
+{
+	return ( eisa < eisaMax && CExprKernels::Supported( eisa ) ? eisa : CExprKernels::Isa() );
+}
+
+PEXPR_REAL_KERNEL CExprKernels::Real( EXPR_KERNEL ek, EXPR_ACCURACY eac, EXPR_ISA eisa )
+{
+	if ( ek >= ekMax || eac >= eacMax )
+	{
+		return nullptr;
+	}
+
+	return Table().vreal[ Usable( eisa ) ][ ek ][ eac ];
+}
+
+PEXPR_COMPLEX_KERNEL CExprKernels::Complex( EXPR_KERNEL ek, EXPR_ACCURACY eac, EXPR_ISA eisa )
+{
+	if ( ek >= ekMax || eac >= eacMax )
+	{
+		return nullptr;
+	}
+
+	return Table().vcomplex[ Usable( eisa ) ][ ek ][ eac ];
+}
+
+PEXPR_DD_KERNEL CExprKernels::DoubleDouble( EXPR_DD_OP edd, EXPR_ISA eisa )
+{
+	if ( edd >= eddMax )
+	{
+		return nullptr;
+	}
+
+	return Table().vdd[ Usable( eisa ) ][ edd ];
+}
+
+LPCTSTR CExprKernels::Name( EXPR_KERNEL ek )
+{
+	return ( ek < ekMax ? g_vKernelName[ ek ].pszName : TEXT( "" ) );
+}
+
+LPCTSTR CExprKernels::Name( EXPR_ISA eisa )
+{
+	static LPCTSTR vszIsa[ eisaMax ] = { TEXT( "generic" ), TEXT( "avx2" ), TEXT( "avx512" ) };
+	return ( eisa < eisaMax ? vszIsa[ eisa ] : TEXT( "" ) );
+}
+
+LPCTSTR CExprKernels::Name( EXPR_ACCURACY eac )
+{
+	static LPCTSTR vszAccuracy[ eacMax ] = { TEXT( "exact" ), TEXT( "1-ulp" ), TEXT( "fast" ) };
+	return ( eac < eacMax ? vszAccuracy[ eac ] : TEXT( "" ) );
+}
+
+LPCTSTR CExprKernels::Name( EXPR_DD_OP edd )
+{
+	static LPCTSTR vszOp[ eddMax ] = { TEXT( "add" ), TEXT( "sub" ), TEXT( "mul" ), TEXT( "div" ), TEXT( "sqrt" ), TEXT( "exp" ), TEXT( "log" ),
+		TEXT( "sin" ), TEXT( "cos" ), TEXT( "atan" ), TEXT( "cadd" ), TEXT( "csub" ), TEXT( "cmul" ), TEXT( "cdiv" ), TEXT( "cexp" ) };
+	return ( edd < eddMax ? vszOp[ edd ] : TEXT( "" ) );
+}
+
+EXPR_KERNEL CExprKernels::Find( const CStringOp & sName )
+{
+	for ( const auto & v : g_vKernelName )
+	{
+		if ( sName == CStringOp( v.pszName ) )
+		{
+			return v.ek;
+		}
+	}
+
+	return ekMax;
+}
@@ -0,0 +1,125 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Vector math kernels for the functions of CMyParser. Kernels evaluate arrays of real or
+   split-complex doubles and are built for several instruction sets, selected at run time */
+
+#pragma once
+
+#include "w32def.h"
+#include "CStringOp.h"
+#include <stddef.h>
+
+typedef enum _tagEXPR_ACCURACY
+{
+	eacExact,			// libm for each element
+	eacUlp1,			// 1 ulp for real kernels, EXPR_COMPLEX_ULP for complex ones
+	eacFast,			// relative error below 1e-8
+	eacMax
+} EXPR_ACCURACY, *PEXPR_ACCURACY;
+
+// error bound of the complex eacUlp1 kernels in ulp of the modulus of the result. It is the
+// error of std::complex<double>: each part is computed by products of rounded real functions
+#define EXPR_COMPLEX_ULP	2.5
+
+typedef enum _tagEXPR_ISA
+{
+	eisaGeneric,		// baseline of the compiler, SSE2 on x86-64
+	eisaAVX2,			// AVX2 and FMA
+	eisaAVX512,			// AVX-512F/DQ/VL
+	eisaMax
+} EXPR_ISA, *PEXPR_ISA;
+
+typedef enum _tagEXPR_KERNEL
+{
+	ekSin,
+	ekSinc,
+	ekCos,
+	ekTan,
+	ekCot,
+	ekArcsin,
+	ekArccos,
+	ekArctan,
+	ekArccot,
+	ekExp,
+	ekSqrt,
+	ekCbrt,
+	ekMax
+} EXPR_KERNEL, *PEXPR_KERNEL;
+
+// double-double kernels, real parts of complex ones are in [ 0 ] and imaginary parts in [ 1 ]
+typedef enum _tagEXPR_DD_OP
+{
+	eddAdd,				// z = x + y
+	eddSub,
+	eddMul,
+	eddDiv,
+	eddSqrt,			// z = f( x )
+	eddExp,
+	eddLog,
+	eddSin,
+	eddCos,
+	eddAtan,
+	eddCAdd,			// complex z = x + y
+	eddCSub,
+	eddCMul,
+	eddCDiv,
+	eddCExp,			// complex z = f( x )
+	eddMax
+} EXPR_DD_OP, *PEXPR_DD_OP;
+
+// split double-double array: element i is hi[ i ] + lo[ i ]
+typedef struct _tagEXPR_DD_ARRAY
+{
+	double *				hi;
+	double *				lo;
+} EXPR_DD_ARRAY, *PEXPR_DD_ARRAY;
+
+// y[ i ] = f( x[ i ] ), arrays must not overlap
+typedef void ( *PEXPR_REAL_KERNEL )( const double * x, double * y, size_t n );
+// ( yre + i * yim )[ i ] = f( ( xre + i * xim )[ i ] )
+typedef void ( *PEXPR_COMPLEX_KERNEL )( const double * xre, const double * xim, double * yre, double * yim, size_t n );
+// z[ i ] = f( x[ i ], y[ i ] ), functions of one argument ignore y. Arrays must not overlap
+typedef void ( *PEXPR_DD_KERNEL )( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n );
+
+class CExprKernels
+{
+	CExprKernels();
+
+public:
+	// the best instruction set of the processor
+	static EXPR_ISA					Isa();
+	static BOOL						Supported( EXPR_ISA eisa );
+
+	// real kernels follow libm: cbrt of negative number is negative, arcsin( 2 ) is NaN.
+	// Unsupported instruction set is replaced by the best supported one
+	static PEXPR_REAL_KERNEL		Real( EXPR_KERNEL ek, EXPR_ACCURACY eac, EXPR_ISA eisa = Isa() );
+
+	// complex kernels follow the parser: cbrt is the principal root, arcctg is atan( 1 / z ).
+	// Arguments which parts are beyond 1e150, or which overflow cosh, are passed to libm
+	static PEXPR_COMPLEX_KERNEL		Complex( EXPR_KERNEL ek, EXPR_ACCURACY eac, EXPR_ISA eisa = Isa() );
+
+	// double-double kernels have no accuracy tiers: error is about 2^-104, sin and cos give NaN for |x| > 2^50
+	static PEXPR_DD_KERNEL			DoubleDouble( EXPR_DD_OP edd, EXPR_ISA eisa = Isa() );
+
+	// name of the function in CMyParser
+	static LPCTSTR					Name( EXPR_KERNEL ek );
+	static LPCTSTR					Name( EXPR_ISA eisa );
+	static LPCTSTR					Name( EXPR_ACCURACY eac );
+	static LPCTSTR					Name( EXPR_DD_OP edd );
+
+	// ekMax if the parser function has no kernel
+	static EXPR_KERNEL				Find( const CStringOp & sName );
+};
@@ -0,0 +1,1064 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Bodies of the vector kernels. CExprKernels.cpp includes this file once per instruction set
+   with KERNEL_NS defined to the name of the instance and KERNEL_FMA to 1 if the instance has
+   fused multiply-add, so there is no include guard.
+   Loops have no branches and are vectorized by the compiler: both sides of each condition
+   are computed and selected, arguments out of the reduced range are recomputed by libm after the loop.
+   Polynomials and reductions are the ones of fdlibm. Double-double kernels use the arithmetic
+   of CDoubleDoubleImpl.h built for the same instruction set */
+
+#include "CDoubleDoubleImpl.h"
+
+namespace KERNEL_NS
+{
+
+static inline uint64_t		Bits( double d )
+{
+	uint64_t u;
+	memcpy( &u, &d, sizeof( u ) );
+	return u;
+}
+
+static inline double		Double( uint64_t u )
+{
+	double d;
+	memcpy( &d, &u, sizeof( d ) );
+	return d;
+}
+
+// adding and subtracting it rounds to integer, the integer is in the low bits of the sum
+static const double			kRound = 0x1.8p52;
+static const double			kTrigMax = 1e5;			// |n| < 2^17 keeps n * pio2_1 exact
+static const double			kExpMax = 708.0;		// 2^k stays normal
+
+// recomputes by libm elements which are not in [ dMin, dMax ] by absolute value
+template <class FN>
+static inline void			Fixup( const double * x, double * y, size_t n, double dMin, double dMax, FN fn )
+{
+	// vectorized check first, the scalar loop is rare
+	int fOut = 0;
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double ax = std::fabs( x[ i ] );
+		fOut |= !( ( ax >= dMin ) & ( ax <= dMax ) );
+	}
+
+	if ( !fOut )
+	{
+		return;
+	}
+
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double ax = std::fabs( x[ i ] );
+		if ( !( ax >= dMin && ax <= dMax ) )
+		{
+			y[ i ] = fn( x[ i ] );
+		}
+	}
+}
+
+// s + e = a + b exactly
+static inline double		TwoSum( double a, double b, double & e )
+{
+	const double s = a + b;
+	const double bb = s - a;
+	e = ( a - ( s - bb ) ) + ( b - bb );
+	return s;
+}
+
+// p + e = a * b exactly. Without FMA the operands are split in halves (Dekker), which
+// is correct only while the compiler doesn't contract it to FMA itself
+static inline double		TwoProd( double a, double b, double & e )
+{
+	const double p = a * b;
+#if KERNEL_FMA
+	e = __builtin_fma( a, b, -p );
+#else
+	const double ca = a * 134217729.0, cb = b * 134217729.0;
+	const double ah = ca - ( ca - a ), bh = cb - ( cb - b );
+	const double al = a - ah, bl = b - bh;
+	e = ( ( ah * bh - p ) + ah * bl + al * bh ) + al * bl;
+#endif
+	return p;
+}
+
+// hi + lo = a * b + c * d from the exact products
+static inline double		Dot2( double a, double b, double c, double d, double & lo )
+{
+	double e1, e2, e3;
+	const double s = TwoSum( TwoProd( a, b, e1 ), TwoProd( c, d, e2 ), e3 );
+	const double t = ( e1 + e2 ) + e3, hi = s + t;
+	lo = ( s - hi ) + t;
+	return hi;
+}
+
+// ( n + nlo ) / ( d + dlo ), the rounding of n / d is corrected by its exact remainder
+static inline double		Quotient( double n, double nlo, double d, double dlo )
+{
+	double e;
+	const double r = n / d;
+	const double p = TwoProd( r, d, e );
+	return r + ( ( ( n - p ) - e ) + ( nlo - r * dlo ) ) / d;
+}
+
+// r + y = x - q * pi / 2, returns q in the low bits. pi / 2 is split into 33 bit parts
+// and a tail, products of q by the parts are exact. Fast tier drops the tail and y
+template <EXPR_ACCURACY eac>
+static inline uint64_t		ReducePio2( double x, double & r, double & y )
+{
+	const double t = x * 6.36619772367581382433e-01 + kRound;
+	const double q = t - kRound;
+	const double r0 = x - q * 1.57079632673412561417e+00;
+
+	if ( eac == eacFast )
+	{
+		r = ( r0 - q * 6.07710050630396597660e-11 ) - q * 2.02226624871116645580e-21;
+		y = 0;
+		return Bits( t );
+	}
+
+	double e1, e2;
+	const double r1 = TwoSum( r0, -q * 6.07710050630396597660e-11, e1 );
+	const double r2 = TwoSum( r1, -q * 2.02226624871116645580e-21, e2 );
+	const double tail = ( e1 + e2 ) - q * 8.47842766036889956997e-32;
+	r = r2 + tail;
+	y = ( r2 - r ) + tail;
+	return Bits( t );
+}
+
+// sin and cos of r + y, |r| <= pi / 4, z = r * r. The result is rounded from hi + lo
+template <EXPR_ACCURACY eac>
+static inline double		SinPoly( double r, double y, double z, double & lo )
+{
+	if ( eac == eacFast )
+	{
+		lo = 0;
+		return r + r * z * ( -1.66666666666666324348e-01 + z * ( 8.33333333332248946124e-03 +
+			z * ( -1.98412698298579493134e-04 + z * 2.75573137070700676789e-06 ) ) );
+	}
+
+	const double p = 8.33333333332248946124e-03 + z * ( -1.98412698298579493134e-04 + z * ( 2.75573137070700676789e-06 +
+		z * ( -2.50507602534068634195e-08 + z * 1.58969099521155010221e-10 ) ) );
+	const double v = z * r;
+	const double c = -( ( z * ( 0.5 * y - v * p ) - y ) - v * -1.66666666666666324348e-01 );
+	const double hi = r + c;
+	lo = ( r - hi ) + c;
+	return hi;
+}
+
+template <EXPR_ACCURACY eac>
+static inline double		CosPoly( double r, double y, double z, double & lo )
+{
+	if ( eac == eacFast )
+	{
+		lo = 0;
+		return 1.0 - 0.5 * z + z * z * ( 4.16666666666666019037e-02 + z * ( -1.38888888888741095749e-03 +
+			z * ( 2.48015872894767294178e-05 + z * -2.75573143513906633035e-07 ) ) );
+	}
+
+	const double p = z * ( 4.16666666666666019037e-02 + z * ( -1.38888888888741095749e-03 + z * ( 2.48015872894767294178e-05 +
+		z * ( -2.75573143513906633035e-07 + z * ( 2.08757232129817482790e-09 + z * -1.13596475577881948265e-11 ) ) ) ) );
+
+	// 1 - qx and 0.5 * z - qx are exact, qx is about |r| / 4 with the low word cleared
+	const double ar = std::fabs( r );
+	const double qx4 = Double( ( Bits( ar ) - 0x0020000000000000ull ) & 0xFFFFFFFF00000000ull );
+	const double qx = ar < 0.3 ? 0.0 : ( ar > 0.78125 ? 0.28125 : qx4 );
+	const double a = 1.0 - qx, c = -( ( 0.5 * z - qx ) - ( z * p - r * y ) );
+	const double hi = a + c;
+	lo = ( a - hi ) + c;
+	return hi;
+}
+
+// sine and cosine of |x| <= kTrigMax, slo and clo are the rests of them
+template <EXPR_ACCURACY eac>
+static inline void			SinCos( double x, double & s, double & c, double & slo, double & clo )
+{
+	double r, y, splo, cplo;
+	const uint64_t q = ReducePio2<eac>( x, r, y );
+	const double z = r * r;
+	const double sp = SinPoly<eac>( r, y, z, splo ), cp = CosPoly<eac>( r, y, z, cplo );
+	const uint64_t sgn = ( q & 2 ) << 62, cgn = ( ( q + 1 ) & 2 ) << 62;
+
+	s = Double( Bits( ( q & 1 ) ? cp : sp ) ^ sgn );
+	slo = Double( Bits( ( q & 1 ) ? cplo : splo ) ^ sgn );
+	c = Double( Bits( ( q & 1 ) ? sp : cp ) ^ cgn );
+	clo = Double( Bits( ( q & 1 ) ? splo : cplo ) ^ cgn );
+}
+
+template <EXPR_ACCURACY eac>
+static inline void			SinCos( double x, double & s, double & c, double & slo )
+{
+	double clo;
+	SinCos<eac>( x, s, c, slo, clo );
+}
+
+template <EXPR_ACCURACY eac>
+static inline void			SinCos( double x, double & s, double & c )
+{
+	double slo;
+	SinCos<eac>( x, s, c, slo );
+}
+
+// tan( r + y ) when iy is 1, -1 / tan( r + y ) when iy is -1. |r| <= pi / 4, fdlibm __kernel_tan
+static inline double		TanPoly( double r, double y, double iy )
+{
+	// above 0.6744 tan( pi / 4 - r ) is approximated
+	const bool fBig = std::fabs( r ) >= 0.67434;
+	const double sr = std::copysign( 1.0, r );
+	const double xb = ( 7.85398163397448278999e-01 - sr * r ) + ( 3.06161699786838301793e-17 - sr * y );
+	const double x = fBig ? xb : r;
+	const double yx = fBig ? 0.0 : y;
+
+	const double z = x * x, w = z * z;
+	const double pr = 1.33333333333201242699e-01 + w * ( 2.18694882948595424599e-02 + w * ( 3.59207910759131235356e-03 +
+		w * ( 5.88041240820264096874e-04 + w * ( 7.81794442939557092300e-05 + w * -1.85586374855275456654e-05 ) ) ) );
+	const double pv = z * ( 5.39682539762260521377e-02 + w * ( 8.86323982359930005737e-03 + w * ( 1.45620945432529025516e-03 +
+		w * ( 2.46463134818469906812e-04 + w * ( 7.14072491382608190305e-05 + w * 2.59073051863633712884e-05 ) ) ) ) );
+	const double s = z * x;
+	const double rr = ( yx + z * ( s * ( pr + pv ) + yx ) ) + 3.33333333333334091986e-01 * s;
+	const double t = x + rr;
+
+	const double big = sr * ( iy - 2.0 * ( x - ( t * t / ( t + iy ) - rr ) ) );
+
+	// -1 / ( x + rr ) with the high parts of t and of the quotient split off
+	const double th = Double( Bits( t ) & 0xFFFFFFFF00000000ull );
+	const double tl = rr - ( th - x );
+	const double a = -1.0 / t;
+	const double ah = Double( Bits( a ) & 0xFFFFFFFF00000000ull );
+	const double inv = ah + a * ( ( 1.0 + ah * th ) + ah * tl );
+
+	return fBig ? big : ( iy > 0 ? t : inv );
+}
+
+// tangent of |x| <= kTrigMax, or cotangent when fCot
+template <EXPR_ACCURACY eac, bool fCot>
+static inline double		Tan( double x )
+{
+	double r, y;
+	const uint64_t q = ReducePio2<eac>( x, r, y );
+
+	if ( eac == eacFast )
+	{
+		double lo;
+		const double z = r * r;
+		const double sp = SinPoly<eac>( r, y, z, lo ), cp = CosPoly<eac>( r, y, z, lo );
+		return ( q & 1 ) ? ( fCot ? -sp / cp : -cp / sp ) : ( fCot ? cp / sp : sp / cp );
+	}
+
+	// tan( r + pi / 2 ) = -1 / tan( r ), cot = -( -1 / tan )
+	const double iy = ( ( q & 1 ) != fCot ) ? -1.0 : 1.0;
+	const double t = TanPoly( r, y, iy );
+	return fCot ? -t : t;
+}
+
+// e^x for |x| <= kExpMax, elo is the rest of the result
+template <EXPR_ACCURACY eac>
+static inline double		Exp( double x, double & elo )
+{
+	const double t = x * 1.44269504088896338700e+00 + kRound;
+	const double k = t - kRound;
+	const double hi = x - k * 6.93147180369123816490e-01;
+	const double lo = k * 1.90821492927058770002e-10;
+	const double r = hi - lo;
+	double y, ylo;
+
+	if ( eac == eacFast )
+	{
+		y = 1.0 + r * ( 1.0 + r * ( 1.0 / 2 + r * ( 1.0 / 6 + r * ( 1.0 / 24 + r * ( 1.0 / 120 +
+			r * ( 1.0 / 720 + r * ( 1.0 / 5040 + r * ( 1.0 / 40320 ) ) ) ) ) ) ) );
+		ylo = 0;
+	}
+	else
+	{
+		const double z = r * r;
+		const double c = r - z * ( 1.66666666666666019037e-01 + z * ( -2.77777777770155933842e-03 + z * ( 6.61375632143793436117e-05 +
+			z * ( -1.65339022054652515390e-06 + z * 4.13813679705723846039e-08 ) ) ) );
+		const double u = ( lo - ( r * c ) / ( 2.0 - c ) ) - hi;
+		y = 1.0 - u;
+		ylo = ( 1.0 - y ) - u;
+	}
+
+	// the low bits of t are k in two's complement
+	const double scale = Double( ( Bits( t ) - Bits( kRound ) + 1023 ) << 52 );
+	elo = ylo * scale;
+	return y * scale;
+}
+
+template <EXPR_ACCURACY eac>
+static inline double		Exp( double x )
+{
+	double elo;
+	return Exp<eac>( x, elo );
+}
+
+// sinh and cosh of |x| <= kExpMax
+template <EXPR_ACCURACY eac>
+static inline void			SinhCosh( double x, double & sh, double & ch )
+{
+	// e^|x| and its reciprocal with their rests, each of cosh and sinh is rounded once
+	double elo, pe;
+	const double e = Exp<eac>( std::fabs( x ), elo );
+	const double ie = 1.0 / e;
+	const double p = TwoProd( ie, e, pe );
+	const double ielo = ( ( ( 1.0 - p ) - pe ) - elo * ie ) / e;
+	const double z = x * x;
+
+	// Taylor series up to x^19 / 19! and x^20 / 20! below 1
+	const double ps = x + x * z * ( 1.0 / 6 + z * ( 1.0 / 120 + z * ( 1.0 / 5040 + z * ( 1.0 / 362880 + z * ( 1.0 / 39916800 +
+		z * ( 1.0 / 6227020800 + z * ( 1.0 / 1307674368000 + z * ( 1.0 / 355687428096000 + z * ( 1.0 / 121645100408832000.0 ) ) ) ) ) ) ) ) );
+	const double pc = 1.0 + z * ( 1.0 / 2 + z * ( 1.0 / 24 + z * ( 1.0 / 720 + z * ( 1.0 / 40320 + z * ( 1.0 / 3628800 +
+		z * ( 1.0 / 479001600 + z * ( 1.0 / 87178291200 + z * ( 1.0 / 20922789888000 + z * ( 1.0 / 6402373705728000.0 +
+		z * ( 1.0 / 2432902008176640000.0 ) ) ) ) ) ) ) ) ) );
+
+	ch = std::fabs( x ) < 1.0 ? pc : 0.5 * ( e + ( ie + ( elo + ielo ) ) );
+	sh = std::fabs( x ) < 1.0 ? ps : std::copysign( 0.5 * ( e - ( ie - ( elo - ielo ) ) ), x );
+}
+
+// arctangent of any x, or of 1 / x when fRcp. t = |x| or 1 / |x| is reduced to |u| < 7 / 16
+// around atan( 0.5 ), atan( 1 ), atan( 1.5 ) or atan( inf ) as in fdlibm, the reciprocal is
+// folded into the reduction, so one division serves all the intervals
+template <EXPR_ACCURACY eac, bool fRcp>
+static inline double		Atan( double x )
+{
+	const double ax = std::fabs( x );
+	const bool f0 = fRcp ? ax <= 2.2857142857142856 : ax >= 0.4375;
+	const bool f1 = fRcp ? ax <= 1.4545454545454546 : ax >= 0.6875;
+	const bool f2 = fRcp ? ax <= 0.8421052631578947 : ax >= 1.1875;
+	const bool f3 = fRcp ? ax <= 0.41025641025641024 : ax >= 2.4375;
+
+	// one level selects keep the loop vectorizable. Operands of the subtractions are exact
+	double num = fRcp ? 1.0 : ax, den = fRcp ? ax : 1.0, hi = 0.0, lo = 0.0;
+	num = f0 ? ( fRcp ? 2.0 - ax : 2.0 * ax - 1.0 ) : num;		den = f0 ? ( fRcp ? 2.0 * ax + 1.0 : 2.0 + ax ) : den;
+	hi = f0 ? 4.63647609000806093515e-01 : hi;					lo = f0 ? 2.26987774529616870924e-17 : lo;
+	num = f1 ? ( fRcp ? 1.0 - ax : ax - 1.0 ) : num;			den = f1 ? ax + 1.0 : den;
+	hi = f1 ? 7.85398163397448278999e-01 : hi;					lo = f1 ? 3.06161699786838301793e-17 : lo;
+	num = f2 ? ( fRcp ? ( 1.0 - ax ) - 0.5 * ax : ax - 1.5 ) : num;	den = f2 ? ( fRcp ? ax + 1.5 : 1.0 + 1.5 * ax ) : den;
+	hi = f2 ? 9.82793723247329054082e-01 : hi;					lo = f2 ? 1.39033110312309984516e-17 : lo;
+	num = f3 ? ( fRcp ? -ax : -1.0 ) : num;						den = f3 ? ( fRcp ? 1.0 : ax ) : den;
+	hi = f3 ? 1.57079632679489655800e+00 : hi;					lo = f3 ? 6.12323399573676603587e-17 : lo;
+
+	const double u = num / den;
+
+	// rounding of 1 / |x| is added to lo: atan( u + du ) = atan( u ) + du * ( 1 - u^2 ) + ...
+	double e;
+	const double p = TwoProd( u, ax, e );
+	const double du = ( ( 1.0 - p ) - e ) * u;
+	const double z = u * u, w = z * z;
+	double s1, s2;
+
+	if ( eac == eacFast )
+	{
+		s1 = z * ( 3.33333333333329318027e-01 + w * ( 1.42857142725034663711e-01 + w * ( 9.09088713343650656196e-02 +
+			w * ( 6.66107313738753120669e-02 + w * 4.97687799461593236017e-02 ) ) ) );
+		s2 = w * ( -1.99999999998764832476e-01 + w * ( -1.11111104054623557880e-01 + w * ( -7.69187620504482999495e-02 + w * -5.83357013379057348645e-02 ) ) );
+	}
+	else
+	{
+		s1 = z * ( 3.33333333333329318027e-01 + w * ( 1.42857142725034663711e-01 + w * ( 9.09088713343650656196e-02 +
+			w * ( 6.66107313738753120669e-02 + w * ( 4.97687799461593236017e-02 + w * 1.62858201153657823623e-02 ) ) ) ) );
+		s2 = w * ( -1.99999999998764832476e-01 + w * ( -1.11111104054623557880e-01 + w * ( -7.69187620504482999495e-02 +
+			w * ( -5.83357013379057348645e-02 + w * -3.65315727442169155270e-02 ) ) ) );
+	}
+
+	lo = ( fRcp && !f0 && std::fabs( du ) < 1.0 ) ? du * ( 1.0 - z ) : lo;
+	return std::copysign( hi - ( ( u * ( s1 + s2 ) - lo ) - u ), x );
+}
+
+// argument of x + iy in [ -pi, pi ], x and y are not both zero. pi is added with its tail
+template <EXPR_ACCURACY eac>
+static inline double		Atan2( double y, double x )
+{
+	const double t = Atan<eac, false>( y / x );
+	return x < 0 ? std::copysign( 3.14159265358979311600e+00, y ) + ( t + std::copysign( 1.22464679914735317723e-16, y ) ) : t;
+}
+
+// natural logarithm of normal x > 0 as in fdlibm: x = 2^k ( 1 + f ), sqrt( 2 ) / 2 < 1 + f < sqrt( 2 )
+static inline double		Log( double x )
+{
+	const uint64_t ux = Bits( x ) + ( uint64_t( 0x3ff00000 - 0x3fe6a09e ) << 32 );
+	const double k = double( int64_t( ux >> 52 ) - 0x3ff );
+	const double f = Double( ( ux & 0x000fffffffffffffull ) + ( uint64_t( 0x3fe6a09e ) << 32 ) ) - 1.0;
+	const double hfsq = 0.5 * f * f, s = f / ( 2.0 + f ), z = s * s, w = z * z;
+	const double r = z * ( 6.666666666666735130e-01 + w * ( 2.857142874366239149e-01 + w * ( 1.818357216161805012e-01 + w * 1.479819860511658591e-01 ) ) ) +
+		w * ( 3.999999999940941908e-01 + w * ( 2.222219843214978396e-01 + w * 1.531383769920937332e-01 ) );
+	return s * ( hfsq + r ) + k * 1.90821492927058770002e-10 - hfsq + f + k * 6.93147180369123816490e-01;
+}
+
+// log( 1 + x ) of x > -1, the rounding of u = 1 + x is added as ( x - ( u - 1 ) ) / u as in fdlibm
+static inline double		Log1p( double x )
+{
+	const double u = 1.0 + x;
+	return Log( u ) + ( x - ( u - 1.0 ) ) / u;
+}
+
+// p( t ) / q( t ) of fdlibm asin and acos
+static inline double		AsinRatio( double t )
+{
+	const double p = t * ( 1.66666666666666657415e-01 + t * ( -3.25565818622400915405e-01 + t * ( 2.01212532134862925881e-01 +
+		t * ( -4.00555345006794114027e-02 + t * ( 7.91534994289814532176e-04 + t * 3.47933107596021167570e-05 ) ) ) ) );
+	const double q = 1.0 + t * ( -2.40339491173441421878e+00 + t * ( 2.02094576023350569471e+00 +
+		t * ( -6.88283971605453293030e-01 + t * 7.70381505559019352791e-02 ) ) );
+	return p / q;
+}
+
+// arcsine of |x| < 1, the ratio is computed once for the selected branch
+static inline double		Asin( double x )
+{
+	const double ax = std::fabs( x );
+	const bool fSmall = ax < 0.5;
+	const double t = ( 1.0 - ax ) * 0.5;
+	const double r = AsinRatio( fSmall ? x * x : t );
+	const double s = std::sqrt( t );
+
+	// |x| > 0.975
+	const double near1 = 1.57079632679489655800e+00 - ( 2.0 * ( s + s * r ) - 6.12323399573676603587e-17 );
+
+	const double df = Double( Bits( s ) & 0xFFFFFFFF00000000ull );
+	const double c = ( t - df * df ) / ( s + df );
+	const double p = 2.0 * s * r - ( 6.12323399573676603587e-17 - 2.0 * c );
+	const double q = 7.85398163397448278999e-01 - 2.0 * df;
+	const double mid = 7.85398163397448278999e-01 - ( p - q );
+
+	const double big = std::copysign( ax > 0.975 ? near1 : mid, x );
+	return fSmall ? x + x * r : big;
+}
+
+// arccosine of |x| < 1
+static inline double		Acos( double x )
+{
+	const double ax = std::fabs( x );
+	const bool fSmall = ax < 0.5;
+	const double t = ( 1.0 - ax ) * 0.5;
+	const double r = AsinRatio( fSmall ? x * x : t );
+	const double s = std::sqrt( t );
+
+	const double small = 1.57079632679489655800e+00 - ( x - ( 6.12323399573676603587e-17 - x * r ) );
+	const double neg = 3.14159265358979311600e+00 - 2.0 * ( s + ( r * s - 6.12323399573676603587e-17 ) );
+
+	const double df = Double( Bits( s ) & 0xFFFFFFFF00000000ull );
+	const double c = ( t - df * df ) / ( s + df );
+	const double pos = 2.0 * ( df + ( r * s + c ) );
+
+	return fSmall ? small : ( x < 0 ? neg : pos );
+}
+
+// arcsine and arccosine of x + iy, x >= 0, y >= 0 by Hull, Fairgrieve and Tang. With
+// alpha = ( |z + 1| + |z - 1| ) / 2 the real parts are asin and acos of beta = x / alpha, by
+// atan near beta = 1, and the imaginary part is log( alpha + sqrt( alpha^2 - 1 ) ), by log1p
+// near alpha = 1. Both branches are computed and selected to keep the loops vectorizable
+template <EXPR_ACCURACY eac>
+static inline void			AsinAcos( double x, double y, double & dAsin, double & dAcos, double & dIm )
+{
+	const double xp1 = x + 1.0, xm1 = x - 1.0, y2 = y * y;
+	const double r = std::sqrt( xp1 * xp1 + y2 ), s = std::sqrt( xm1 * xm1 + y2 );
+	const double alpha = 0.5 * ( r + s ), beta = x / alpha, apx = alpha + x;
+
+	// tan( asin( beta ) )^2 = x^2 / t
+	const double t = x <= 1.0 ? 0.5 * apx * ( y2 / ( r + xp1 ) + ( s - xm1 ) ) : 0.5 * ( apx / ( r + xp1 ) + apx / ( s + xm1 ) ) * y2;
+	dAsin = beta <= 0.6417 ? Asin( beta ) : Atan<eac, false>( x / std::sqrt( t ) );
+	dAcos = beta <= 0.6417 ? Acos( beta ) : Atan<eac, false>( std::sqrt( t ) / x );
+
+	const double am1 = x < 1.0 ? 0.5 * ( y2 / ( r + xp1 ) + y2 / ( s - xm1 ) ) : 0.5 * ( y2 / ( r + xp1 ) + ( s + xm1 ) );
+	dIm = alpha <= 1.5 ? Log1p( am1 + std::sqrt( am1 * ( alpha + 1.0 ) ) ) : Log( alpha + std::sqrt( alpha * alpha - 1.0 ) );
+}
+
+// atan( a + ib ) = atan2( 2a, 1 - a^2 - b^2 ) / 2 + i log( ( a^2 + ( 1 + b )^2 ) / ( a^2 + ( 1 - b )^2 ) ) / 4.
+// 1 - a^2 - b^2 is summed from the exact squares to avoid the cancellation. The imaginary
+// part is odd in b, the ratio for |b| is 1 + 4|b| / ( a^2 + ( 1 - |b| )^2 ) taken by log1p.
+// atan( 1 / z ) when fRcp: 1 - |1 / z|^2 has the sign of -( 1 - |z|^2 ) and the ratio is
+// inverted, so 1 / z is never rounded
+template <EXPR_ACCURACY eac, bool fRcp>
+static inline void			CAtan( double a, double b, double & re, double & im )
+{
+	double ea, eb, e1, e2;
+	const double pa = TwoProd( a, a, ea ), pb = TwoProd( b, b, eb );
+	const double s1 = TwoSum( 1.0, -pa, e1 ), s2 = TwoSum( s1, -pb, e2 );
+	const double d = s2 + ( ( e1 + e2 ) - ( ea + eb ) );
+	re = 0.5 * Atan2<eac>( 2.0 * a, fRcp ? -d : d );
+
+	double dlo;
+	const double ab = std::fabs( b ), den = Dot2( a, a, 1.0 - ab, 1.0 - ab, dlo );
+	const double l = std::copysign( 0.25 * Log1p( Quotient( 4.0 * ab, 0.0, den, dlo ) ), b );
+	im = fRcp ? -l : l;
+}
+
+// cube root of normal x
+static inline double		Cbrt( double x )
+{
+	const double ax = std::fabs( x );
+
+	// exponent divided by 3 gives 5 bits, rational approximation 20 bits, chopped to 21 bits
+	const uint32_t hx = uint32_t( Bits( ax ) >> 32 );
+	double t = Double( uint64_t( hx / 3 + 715094163 ) << 32 );
+	double r = t * t / ax;
+	double s = 5.42857142857142815906e-01 + r * t;
+	t *= 3.57142857142857150787e-01 + 1.60714285714285720630e+00 / ( s + 1.41428571428571436819e+00 + -7.05306122448979611050e-01 / s );
+	t = Double( ( Bits( t ) + 0x100000000ull ) & 0xFFFFFFFF00000000ull );
+
+	// one Newton step to 53 bits
+	s = t * t;
+	r = ax / s;
+	const double w = t + t;
+	r = ( r - t ) / ( w + r );
+	t = t + t * r;
+
+	return std::copysign( t, x );
+}
+
+/*
+	Real kernels
+*/
+
+template <EXPR_ACCURACY eac>
+static void					KSin( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double s, c;
+		SinCos<eac>( x[ i ], s, c );
+		y[ i ] = s;
+	}
+
+	Fixup( x, y, n, 0, kTrigMax, []( double v ) { return std::sin( v ); } );
+}
+
+template <EXPR_ACCURACY eac>
+static void					KSinc( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		// ( s + slo ) / x with the remainder of the division
+		double s, c, slo, e;
+		SinCos<eac>( x[ i ], s, c, slo );
+		const double q = s / x[ i ];
+		const double p = TwoProd( q, x[ i ], e );
+		y[ i ] = q + ( ( ( s - p ) - e ) + slo ) / x[ i ];
+	}
+
+	Fixup( x, y, n, 0, kTrigMax, []( double v ) { return std::sin( v ) / v; } );
+}
+
+template <EXPR_ACCURACY eac>
+static void					KCos( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double s, c;
+		SinCos<eac>( x[ i ], s, c );
+		y[ i ] = c;
+	}
+
+	Fixup( x, y, n, 0, kTrigMax, []( double v ) { return std::cos( v ); } );
+}
+
+template <EXPR_ACCURACY eac>
+static void					KTan( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Tan<eac, false>( x[ i ] );
+	}
+
+	Fixup( x, y, n, 0, kTrigMax, []( double v ) { return std::tan( v ); } );
+}
+
+template <EXPR_ACCURACY eac>
+static void					KCot( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Tan<eac, true>( x[ i ] );
+	}
+
+	Fixup( x, y, n, 0, kTrigMax, []( double v ) { return 1.0 / std::tan( v ); } );
+}
+
+static void					KArcsin( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Asin( x[ i ] );
+	}
+
+	Fixup( x, y, n, 0, 0x1.fffffffffffffp-1, []( double v ) { return std::asin( v ); } );
+}
+
+static void					KArccos( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Acos( x[ i ] );
+	}
+
+	Fixup( x, y, n, 0, 0x1.fffffffffffffp-1, []( double v ) { return std::acos( v ); } );
+}
+
+template <EXPR_ACCURACY eac>
+static void					KArctan( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Atan<eac, false>( x[ i ] );
+	}
+}
+
+// atan( 1 / x ) as the parser defines arcctg
+template <EXPR_ACCURACY eac>
+static void					KArccot( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Atan<eac, true>( x[ i ] );
+	}
+}
+
+template <EXPR_ACCURACY eac>
+static void					KExp( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Exp<eac>( x[ i ] );
+	}
+
+	Fixup( x, y, n, 0, kExpMax, []( double v ) { return std::exp( v ); } );
+}
+
+static void					KSqrt( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = std::sqrt( x[ i ] );
+	}
+}
+
+static void					KCbrt( const double * x, double * y, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		y[ i ] = Cbrt( x[ i ] );
+	}
+
+	Fixup( x, y, n, DBL_MIN, DBL_MAX, []( double v ) { return std::cbrt( v ); } );
+}
+
+/*
+	Split-complex kernels
+*/
+
+// recomputes by libm elements which real or imaginary part is out of its range
+template <class FN>
+static inline void			Fixup( const double * xre, const double * xim, double * yre, double * yim, size_t n,
+								double dMaxRe, double dMaxIm, FN fn )
+{
+	int fOut = 0;
+	for ( size_t i = 0; i < n; ++i )
+	{
+		fOut |= !( ( std::fabs( xre[ i ] ) <= dMaxRe ) & ( std::fabs( xim[ i ] ) <= dMaxIm ) );
+	}
+
+	if ( !fOut )
+	{
+		return;
+	}
+
+	for ( size_t i = 0; i < n; ++i )
+	{
+		if ( !( std::fabs( xre[ i ] ) <= dMaxRe && std::fabs( xim[ i ] ) <= dMaxIm ) )
+		{
+			const std::complex<double> v = fn( std::complex<double>( xre[ i ], xim[ i ] ) );
+			yre[ i ] = v.real();
+			yim[ i ] = v.imag();
+		}
+	}
+}
+
+// recomputes by libm elements for which out( re, im ) is true
+template <class OUT, class FN>
+static inline void			FixupIf( const double * xre, const double * xim, double * yre, double * yim, size_t n, OUT out, FN fn )
+{
+	int fOut = 0;
+	for ( size_t i = 0; i < n; ++i )
+	{
+		fOut |= out( xre[ i ], xim[ i ] );
+	}
+
+	for ( size_t i = 0; fOut && i < n; ++i )
+	{
+		if ( out( xre[ i ], xim[ i ] ) )
+		{
+			const std::complex<double> v = fn( std::complex<double>( xre[ i ], xim[ i ] ) );
+			yre[ i ] = v.real();
+			yim[ i ] = v.imag();
+		}
+	}
+}
+
+// squares of the parts neither overflow nor underflow, z is not zero
+static inline bool			Squarable( double a, double b )
+{
+	const double m = std::max( std::fabs( a ), std::fabs( b ) );
+	return ( m >= 1e-150 ) & ( m <= 1e150 );
+}
+
+// e^( a + ib ) = e^a * ( cos( b ) + i sin( b ) )
+template <EXPR_ACCURACY eac>
+static void					KCExp( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double s, c;
+		const double e = Exp<eac>( xre[ i ] );
+		SinCos<eac>( xim[ i ], s, c );
+		yre[ i ] = e * c;
+		yim[ i ] = e * s;
+	}
+
+	Fixup( xre, xim, yre, yim, n, kExpMax, kTrigMax, []( const std::complex<double> & v ) { return std::exp( v ); } );
+}
+
+// sin( a + ib ) = sin( a ) cosh( b ) + i cos( a ) sinh( b )
+template <EXPR_ACCURACY eac>
+static void					KCSin( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double s, c, sh, ch;
+		SinCos<eac>( xre[ i ], s, c );
+		SinhCosh<eac>( xim[ i ], sh, ch );
+		yre[ i ] = s * ch;
+		yim[ i ] = c * sh;
+	}
+
+	Fixup( xre, xim, yre, yim, n, kTrigMax, kExpMax, []( const std::complex<double> & v ) { return std::sin( v ); } );
+}
+
+// cos( a + ib ) = cos( a ) cosh( b ) - i sin( a ) sinh( b )
+template <EXPR_ACCURACY eac>
+static void					KCCos( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double s, c, sh, ch;
+		SinCos<eac>( xre[ i ], s, c );
+		SinhCosh<eac>( xim[ i ], sh, ch );
+		yre[ i ] = c * ch;
+		yim[ i ] = -s * sh;
+	}
+
+	Fixup( xre, xim, yre, yim, n, kTrigMax, kExpMax, []( const std::complex<double> & v ) { return std::cos( v ); } );
+}
+
+// principal root: t = sqrt( ( |a| + |z| ) / 2 ) goes to the part of the sign of a
+static void					KCSqrt( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double a = xre[ i ], b = xim[ i ];
+		const double t = std::sqrt( 0.5 * ( std::fabs( a ) + std::sqrt( a * a + b * b ) ) );
+		const double u = 0.5 * b / t;
+		yre[ i ] = a >= 0 ? t : std::fabs( u );
+		yim[ i ] = a >= 0 ? u : std::copysign( t, b );
+	}
+
+	// squares must not overflow or underflow, zero gives 0 / 0
+	int fOut = 0;
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double m = std::max( std::fabs( xre[ i ] ), std::fabs( xim[ i ] ) );
+		fOut |= !( ( m >= 1e-150 ) & ( m <= 1e150 ) );
+	}
+
+	for ( size_t i = 0; fOut && i < n; ++i )
+	{
+		const double m = std::max( std::fabs( xre[ i ] ), std::fabs( xim[ i ] ) );
+		if ( !( m >= 1e-150 && m <= 1e150 ) )
+		{
+			const std::complex<double> v = std::sqrt( std::complex<double>( xre[ i ], xim[ i ] ) );
+			yre[ i ] = v.real();
+			yim[ i ] = v.imag();
+		}
+	}
+}
+
+// sin( z ) / z = ( p + iq ) ( a - ib ) / ( a^2 + b^2 ) with the sine p + iq as in KCSin, the
+// products are summed exactly and divided once. cosh and sinh of |b| > 300 would overflow
+template <EXPR_ACCURACY eac>
+static void					KCSinc( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double a = xre[ i ], b = xim[ i ];
+		double s, c, slo, clo, sh, ch, rlo, ilo, dlo;
+		SinCos<eac>( a, s, c, slo, clo );
+		SinhCosh<eac>( b, sh, ch );
+		const double p = s * ch + slo * ch, q = c * sh + clo * sh;
+		const double d = Dot2( a, a, b, b, dlo );
+		const double re = Dot2( p, a, q, b, rlo ), im = Dot2( q, a, -p, b, ilo );
+		yre[ i ] = Quotient( re, rlo, d, dlo );
+		yim[ i ] = Quotient( im, ilo, d, dlo );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return !( Squarable( a, b ) & ( std::fabs( a ) <= kTrigMax ) & ( std::fabs( b ) <= 300 ) ); },
+		[]( const std::complex<double> & v ) { return std::sin( v ) / v; } );
+}
+
+// tan( a + ib ) = ( sin( a ) cos( a ) + i sinh( b ) cosh( b ) ) / ( cos( a )^2 + sinh( b )^2 ), the
+// denominator has no cancellation. For |b| > 1 the roundings of sinh and cosh would add up in
+// the imaginary part near +-i, so both parts are divided by cosh( 2b ) / 2: with t = e^-2|b|
+// tan = ( 4 sin( a ) cos( a ) t + i sign( b ) ( 1 - t^2 ) ) / ( 1 + 2 cos( 2a ) t + t^2 ).
+// Cotangent takes sin( a )^2, -cos( 2a ) and the opposite imaginary part
+template <EXPR_ACCURACY eac, bool fCot>
+static void					KCTan( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double b = xim[ i ];
+		double s, c, slo, clo, sh, ch, e1;
+		SinCos<eac>( xre[ i ], s, c, slo, clo );
+		SinhCosh<eac>( b, sh, ch );
+
+		// sin( a ) cos( a ) and the denominator from the rests of sin and cos, each part is divided once
+		const double sc = TwoProd( s, c, e1 ), sclo = e1 + ( s * clo + slo * c );
+		const double sq = fCot ? s : c, sqlo = fCot ? slo : clo;
+		double dlo, shch;
+		const double d = Dot2( sq, sq, sh, sh, dlo );
+		dlo += 2.0 * sq * sqlo;
+		const double shchhi = TwoProd( sh, ch, shch );
+
+		const double ie = 1.0 / Exp<eac>( std::fabs( b ) ), t = ie * ie;
+		const double c2 = ( c - s ) * ( c + s );
+		const double dt = 1.0 + ( 2.0 * ( fCot ? -c2 : c2 ) * t + t * t );
+		const bool fFar = std::fabs( b ) > 1.0;
+
+		yre[ i ] = fFar ? 4.0 * ( sc + sclo ) * t / dt : Quotient( sc, sclo, d, dlo );
+		yim[ i ] = ( fCot ? -1.0 : 1.0 ) * ( fFar ? std::copysign( 1.0 - t * t, b ) / dt : Quotient( shchhi, shch, d, dlo ) );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return !( ( std::fabs( a ) <= kTrigMax ) & ( std::fabs( b ) <= 300 ) & ( !fCot | ( a != 0 ) | ( b != 0 ) ) ); },
+		[]( const std::complex<double> & v ) { return fCot ? 1.0 / std::tan( v ) : std::tan( v ); } );
+}
+
+// signs of the parts select the quadrant: asin is odd in both parts
+template <EXPR_ACCURACY eac>
+static void					KCArcsin( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double dAsin, dAcos, dIm;
+		AsinAcos<eac>( std::fabs( xre[ i ] ), std::fabs( xim[ i ] ), dAsin, dAcos, dIm );
+		yre[ i ] = std::copysign( dAsin, xre[ i ] );
+		yim[ i ] = std::copysign( dIm, xim[ i ] );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return !Squarable( a, b ); }, []( const std::complex<double> & v ) { return std::asin( v ); } );
+}
+
+// acos( -z ) = pi - acos( z ), the imaginary part is opposite to the one of asin
+template <EXPR_ACCURACY eac>
+static void					KCArccos( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		double dAsin, dAcos, dIm;
+		AsinAcos<eac>( std::fabs( xre[ i ] ), std::fabs( xim[ i ] ), dAsin, dAcos, dIm );
+		yre[ i ] = xre[ i ] < 0 ? ( 3.14159265358979311600e+00 - dAcos ) + 1.22464679914735317723e-16 : dAcos;
+		yim[ i ] = -std::copysign( dIm, xim[ i ] );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return !Squarable( a, b ); }, []( const std::complex<double> & v ) { return std::acos( v ); } );
+}
+
+// poles +-i and their neighbours with underflowing a^2 are left to libm
+template <EXPR_ACCURACY eac>
+static void					KCArctan( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		CAtan<eac, false>( xre[ i ], xim[ i ], yre[ i ], yim[ i ] );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return ( !Squarable( a, b ) ) | ( ( std::fabs( a ) < 1e-150 ) & ( std::fabs( b ) == 1 ) ); },
+		[]( const std::complex<double> & v ) { return std::atan( v ); } );
+}
+
+// atan( 1 / z ) as the parser defines arcctg, the poles are the same as of atan
+template <EXPR_ACCURACY eac>
+static void					KCArccot( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		CAtan<eac, true>( xre[ i ], xim[ i ], yre[ i ], yim[ i ] );
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return ( !Squarable( a, b ) ) | ( ( std::fabs( a ) < 1e-150 ) & ( std::fabs( b ) == 1 ) ); },
+		[]( const std::complex<double> & v ) { return std::atan( 1.0 / v ); } );
+}
+
+// principal root |z|^( 1 / 3 ) e^( i arg( z ) / 3 )
+template <EXPR_ACCURACY eac>
+static void					KCCbrt( const double * xre, const double * xim, double * yre, double * yim, size_t n )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const double a = xre[ i ], b = xim[ i ];
+		const double m = Cbrt( std::sqrt( a * a + b * b ) );
+		double s, c;
+		SinCos<eac>( Atan2<eac>( b, a ) / 3.0, s, c );
+		yre[ i ] = m * c;
+		yim[ i ] = m * s;
+	}
+
+	FixupIf( xre, xim, yre, yim, n, []( double a, double b ) { return !Squarable( a, b ); }, []( const std::complex<double> & v ) { return std::pow( v, 1.0 / 3.0 ); } );
+}
+
+// double-double kernels on the split arrays, see EXPR_DD_OP
+template <class FN>
+static inline void			DDBinary( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n, FN fn )
+{
+	const double * xh = x[ 0 ].hi, * xl = x[ 0 ].lo, * yh = y[ 0 ].hi, * yl = y[ 0 ].lo;
+	double * zh = z[ 0 ].hi, * zl = z[ 0 ].lo;
+
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const DOUBLE_DOUBLE r = fn( DD( xh[ i ], xl[ i ] ), DD( yh[ i ], yl[ i ] ) );
+		zh[ i ] = r.hi;
+		zl[ i ] = r.lo;
+	}
+}
+
+template <class FN>
+static inline void			DDUnary( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * z, size_t n, FN fn )
+{
+	const double * xh = x[ 0 ].hi, * xl = x[ 0 ].lo;
+	double * zh = z[ 0 ].hi, * zl = z[ 0 ].lo;
+
+	for ( size_t i = 0; i < n; ++i )
+	{
+		const DOUBLE_DOUBLE r = fn( DD( xh[ i ], xl[ i ] ) );
+		zh[ i ] = r.hi;
+		zl[ i ] = r.lo;
+	}
+}
+
+// twelve arrays need too many alias checks for the vectorizer, so the parameters are __restrict
+template <class FN>
+static inline void			DDCLoop( const double * __restrict xrh, const double * __restrict xrl, const double * __restrict xih, const double * __restrict xil,
+	const double * __restrict yrh, const double * __restrict yrl, const double * __restrict yih, const double * __restrict yil,
+	double * __restrict zrh, double * __restrict zrl, double * __restrict zih, double * __restrict zil, size_t n, FN fn )
+{
+	for ( size_t i = 0; i < n; ++i )
+	{
+		DOUBLE_DOUBLE zr, zi;
+		fn( DD( xrh[ i ], xrl[ i ] ), DD( xih[ i ], xil[ i ] ), DD( yrh[ i ], yrl[ i ] ), DD( yih[ i ], yil[ i ] ), zr, zi );
+		zrh[ i ] = zr.hi;
+		zrl[ i ] = zr.lo;
+		zih[ i ] = zi.hi;
+		zil[ i ] = zi.lo;
+	}
+}
+
+// fn( ar, ai, br, bi, zr, zi )
+template <class FN>
+static inline void			DDCBinary( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n, FN fn )
+{
+	DDCLoop( x[ 0 ].hi, x[ 0 ].lo, x[ 1 ].hi, x[ 1 ].lo, y[ 0 ].hi, y[ 0 ].lo, y[ 1 ].hi, y[ 1 ].lo, z[ 0 ].hi, z[ 0 ].lo, z[ 1 ].hi, z[ 1 ].lo, n, fn );
+}
+
+static void					KDDAdd( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDBinary( x, y, z, n, DDAdd ); }
+static void					KDDSub( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDBinary( x, y, z, n, DDSub ); }
+static void					KDDMul( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDBinary( x, y, z, n, DDMul ); }
+static void					KDDDiv( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDBinary( x, y, z, n, DDDiv ); }
+static void					KDDSqrt( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n ) { DDUnary( x, z, n, DDSqrt ); }
+static void					KDDExp( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n ) { DDUnary( x, z, n, DDExp ); }
+static void					KDDLog( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n ) { DDUnary( x, z, n, DDLog ); }
+
+static void					KDDSin( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n )
+{
+	DDUnary( x, z, n, []( const DOUBLE_DOUBLE & a ) { return DDSinOrCos( a, false ); } );
+}
+
+static void					KDDCos( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n )
+{
+	DDUnary( x, z, n, []( const DOUBLE_DOUBLE & a ) { return DDSinOrCos( a, true ); } );
+}
+
+static void					KDDAtan( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n ) { DDUnary( x, z, n, DDAtan ); }
+
+static void					KDDCAdd( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n )
+{
+	DDBinary( x, y, z, n, DDAdd );
+	DDBinary( x + 1, y + 1, z + 1, n, DDAdd );
+}
+
+static void					KDDCSub( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n )
+{
+	DDBinary( x, y, z, n, DDSub );
+	DDBinary( x + 1, y + 1, z + 1, n, DDSub );
+}
+
+static void					KDDCMul( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDCBinary( x, y, z, n, DDCMul ); }
+static void					KDDCDiv( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY * y, const EXPR_DD_ARRAY * z, size_t n ) { DDCBinary( x, y, z, n, DDCDiv ); }
+
+static void					KDDCExp( const EXPR_DD_ARRAY * x, const EXPR_DD_ARRAY *, const EXPR_DD_ARRAY * z, size_t n )
+{
+	DDCBinary( x, x, z, n, []( const DOUBLE_DOUBLE & ar, const DOUBLE_DOUBLE & ai, const DOUBLE_DOUBLE &, const DOUBLE_DOUBLE &,
+		DOUBLE_DOUBLE & zr, DOUBLE_DOUBLE & zi ) { DDCExp( ar, ai, zr, zi ); } );
+}
+
+VOID						FillDD( PEXPR_DD_KERNEL vdd[ eddMax ] )
+{
+	static const PEXPR_DD_KERNEL vk[ eddMax ] = { KDDAdd, KDDSub, KDDMul, KDDDiv, KDDSqrt, KDDExp, KDDLog, KDDSin, KDDCos,
+		KDDAtan, KDDCAdd, KDDCSub, KDDCMul, KDDCDiv, KDDCExp };
+
+	for ( int edd = 0; edd < eddMax; ++edd )
+	{
+		vdd[ edd ] = vk[ edd ];
+	}
+}
+
+// instance of the kernels for this instruction set
+VOID						Fill( PEXPR_REAL_KERNEL vreal[ ekMax ][ eacMax ], PEXPR_COMPLEX_KERNEL vcomplex[ ekMax ][ eacMax ] )
+{
+	vreal[ ekSin ][ eacUlp1 ] = KSin<eacUlp1>;				vreal[ ekSin ][ eacFast ] = KSin<eacFast>;
+	vreal[ ekSinc ][ eacUlp1 ] = KSinc<eacUlp1>;			vreal[ ekSinc ][ eacFast ] = KSinc<eacFast>;
+	vreal[ ekCos ][ eacUlp1 ] = KCos<eacUlp1>;				vreal[ ekCos ][ eacFast ] = KCos<eacFast>;
+	vreal[ ekTan ][ eacUlp1 ] = KTan<eacUlp1>;				vreal[ ekTan ][ eacFast ] = KTan<eacFast>;
+	vreal[ ekCot ][ eacUlp1 ] = KCot<eacUlp1>;				vreal[ ekCot ][ eacFast ] = KCot<eacFast>;
+	vreal[ ekArcsin ][ eacUlp1 ] = KArcsin;					vreal[ ekArcsin ][ eacFast ] = KArcsin;
+	vreal[ ekArccos ][ eacUlp1 ] = KArccos;					vreal[ ekArccos ][ eacFast ] = KArccos;
+	vreal[ ekArctan ][ eacUlp1 ] = KArctan<eacUlp1>;		vreal[ ekArctan ][ eacFast ] = KArctan<eacFast>;
+	vreal[ ekArccot ][ eacUlp1 ] = KArccot<eacUlp1>;		vreal[ ekArccot ][ eacFast ] = KArccot<eacFast>;
+	vreal[ ekExp ][ eacUlp1 ] = KExp<eacUlp1>;				vreal[ ekExp ][ eacFast ] = KExp<eacFast>;
+	vreal[ ekSqrt ][ eacUlp1 ] = KSqrt;						vreal[ ekSqrt ][ eacFast ] = KSqrt;
+	vreal[ ekCbrt ][ eacUlp1 ] = KCbrt;						vreal[ ekCbrt ][ eacFast ] = KCbrt;
+
+	vcomplex[ ekSin ][ eacUlp1 ] = KCSin<eacUlp1>;			vcomplex[ ekSin ][ eacFast ] = KCSin<eacFast>;
+	vcomplex[ ekCos ][ eacUlp1 ] = KCCos<eacUlp1>;			vcomplex[ ekCos ][ eacFast ] = KCCos<eacFast>;
+	vcomplex[ ekExp ][ eacUlp1 ] = KCExp<eacUlp1>;			vcomplex[ ekExp ][ eacFast ] = KCExp<eacFast>;
+	vcomplex[ ekSqrt ][ eacUlp1 ] = KCSqrt;					vcomplex[ ekSqrt ][ eacFast ] = KCSqrt;
+	vcomplex[ ekSinc ][ eacUlp1 ] = KCSinc<eacUlp1>;		vcomplex[ ekSinc ][ eacFast ] = KCSinc<eacFast>;
+	vcomplex[ ekTan ][ eacUlp1 ] = KCTan<eacUlp1, false>;	vcomplex[ ekTan ][ eacFast ] = KCTan<eacFast, false>;
+	vcomplex[ ekCot ][ eacUlp1 ] = KCTan<eacUlp1, true>;	vcomplex[ ekCot ][ eacFast ] = KCTan<eacFast, true>;
+	vcomplex[ ekArcsin ][ eacUlp1 ] = KCArcsin<eacUlp1>;	vcomplex[ ekArcsin ][ eacFast ] = KCArcsin<eacFast>;
+	vcomplex[ ekArccos ][ eacUlp1 ] = KCArccos<eacUlp1>;	vcomplex[ ekArccos ][ eacFast ] = KCArccos<eacFast>;
+	vcomplex[ ekArctan ][ eacUlp1 ] = KCArctan<eacUlp1>;	vcomplex[ ekArctan ][ eacFast ] = KCArctan<eacFast>;
+	vcomplex[ ekArccot ][ eacUlp1 ] = KCArccot<eacUlp1>;	vcomplex[ ekArccot ][ eacFast ] = KCArccot<eacFast>;
+	vcomplex[ ekCbrt ][ eacUlp1 ] = KCCbrt<eacUlp1>;		vcomplex[ ekCbrt ][ eacFast ] = KCCbrt<eacFast>;
+}
+
+}
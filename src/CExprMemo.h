@@ -0,0 +1,203 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Bounded cache of the results of a pure function keyed by its arguments. The entries are
+   spread over shards by the hash of the arguments, each shard has its own lock and drops
+   the least recently used entry when it is full. Calls which throw are not cached */
+
+#pragma once
+
+#include "CExprParser.h"
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+#define MEMO_SHARDS			16
+
+template <class NUM>
+class CExprMemo
+{
+public:
+	typedef std::function<size_t( const NUM & )>					HASH;
+	typedef std::function<BOOL( const NUM &, const NUM & )>			EQUAL;
+	typedef std::function<NUM( const std::vector<NUM> & )>			FUNC;
+
+private:
+	typedef struct _tagMEMO_ENTRY
+	{
+		size_t					uHash;
+		std::vector<NUM>		varg;
+		NUM						result;
+	} MEMO_ENTRY;
+
+	typedef struct _tagMEMO_SHARD
+	{
+		std::mutex												lock;
+		std::list<MEMO_ENTRY>									lru;		// the most recent first
+		std::unordered_multimap<size_t, typename std::list<MEMO_ENTRY>::iterator>	mentry;
+	} MEMO_SHARD;
+
+	const size_t						m_nCapacity;		// per shard
+	const HASH							m_hash;
+	const EQUAL							m_equal;
+	MEMO_SHARD							m_vshard[ MEMO_SHARDS ];
+	std::atomic<size_t>					m_nHits;
+	std::atomic<size_t>					m_nMisses;
+
+	CExprMemo( const CExprMemo & );
+	CExprMemo & operator=( const CExprMemo & );
+
+	size_t				Hash( const std::vector<NUM> & varg ) const
+	{
+		size_t uHash = varg.size();
+		for ( const auto & v : varg )
+		{
+			uHash ^= m_hash( v ) + 0x9e3779b97f4a7c15ULL + ( uHash << 6 ) + ( uHash >> 2 );
+		}
+
+		return uHash;
+	}
+
+	BOOL				Same( const std::vector<NUM> & a, const std::vector<NUM> & b ) const
+	{
+		if ( a.size() != b.size() )
+		{
+			return FALSE;
+		}
+
+		for ( size_t n = 0; n < a.size(); ++n )
+		{
+			if ( !m_equal( a[ n ], b[ n ] ) )
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	// entry of the arguments, nullptr if there is none. Shard must be locked
+	MEMO_ENTRY *		Find( MEMO_SHARD & shard, size_t uHash, const std::vector<NUM> & varg ) const
+	{
+		auto range = shard.mentry.equal_range( uHash );
+		for ( auto v = range.first; v != range.second; ++v )
+		{
+			if ( Same( v->second->varg, varg ) )
+			{
+				shard.lru.splice( shard.lru.begin(), shard.lru, v->second );
+				return &*v->second;
+			}
+		}
+
+		return nullptr;
+	}
+
+public:
+	// nCapacity - greatest count of the cached results, hash and equal compare the arguments.
+	// Values which equal treats as the same must give the same results
+	CExprMemo( size_t nCapacity, const HASH & hash, const EQUAL & equal )
+		: m_nCapacity( std::max<size_t>( 1, ( nCapacity + MEMO_SHARDS - 1 ) / MEMO_SHARDS ) ), m_hash( hash ), m_equal( equal ), m_nHits( 0 ), m_nMisses( 0 )
+	{
+	}
+
+	// result of fn for the arguments. May be called by several threads at once, fn is called
+	// without the lock, so threads which miss the same arguments may call it each
+	NUM					Call( const FUNC & fn, const std::vector<NUM> & varg )
+	{
+		const size_t uHash = Hash( varg );
+		MEMO_SHARD & shard = m_vshard[ uHash % MEMO_SHARDS ];
+
+		{
+			std::lock_guard<std::mutex> guard( shard.lock );
+			const MEMO_ENTRY * pentry = Find( shard, uHash, varg );
+			if ( pentry )
+			{
+				m_nHits.fetch_add( 1, std::memory_order_relaxed );
+				return pentry->result;
+			}
+		}
+
+		m_nMisses.fetch_add( 1, std::memory_order_relaxed );
+		const NUM result = fn( varg );
+
+		std::lock_guard<std::mutex> guard( shard.lock );
+		if ( !Find( shard, uHash, varg ) )
+		{
+			if ( shard.lru.size() >= m_nCapacity )
+			{
+				const MEMO_ENTRY & last = shard.lru.back();
+				auto range = shard.mentry.equal_range( last.uHash );
+				for ( auto v = range.first; v != range.second; ++v )
+				{
+					if ( &*v->second == &last )
+					{
+						shard.mentry.erase( v );
+						break;
+					}
+				}
+
+				shard.lru.pop_back();
+			}
+
+			shard.lru.push_front( MEMO_ENTRY{ uHash, varg, result } );
+			shard.mentry.insert( std::make_pair( uHash, shard.lru.begin() ) );
+		}
+
+		return result;
+	}
+
+	VOID				Clear()
+	{
+		for ( auto & shard : m_vshard )
+		{
+			std::lock_guard<std::mutex> guard( shard.lock );
+			shard.lru.clear();
+			shard.mentry.clear();
+		}
+
+		m_nHits = 0;
+		m_nMisses = 0;
+	}
+
+	size_t				Size()
+	{
+		size_t nSize = 0;
+		for ( auto & shard : m_vshard )
+		{
+			std::lock_guard<std::mutex> guard( shard.lock );
+			nSize += shard.lru.size();
+		}
+
+		return nSize;
+	}
+
+	size_t				Hits() const
+	{
+		return m_nHits.load( std::memory_order_relaxed );
+	}
+
+	size_t				Misses() const
+	{
+		return m_nMisses.load( std::memory_order_relaxed );
+	}
+
+	double				HitRate() const
+	{
+		const size_t nHits = Hits(), nCalls = nHits + Misses();
+		return ( nCalls ? double( nHits ) / nCalls : 0.0 );
+	}
+};
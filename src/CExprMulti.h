@@ -0,0 +1,174 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Program of several expressions over the same variables. The expressions are one program,
+   so the optimizer merges their common subexpressions and one evaluation gives all results:
+
+	CExprMulti<TOK> multi;
+	for ( ... ) { parser.Compile( psz ); multi.Add( parser.Tree() ); }
+	multi.Optimize( optimizer );
+	multi.Execute( vslots.data(), vresult.data() );
+*/
+
+#pragma once
+
+#include "CExprOptimizer.h"
+
+template <class NUM>
+class CExprMulti
+{
+	CExprProgram<NUM>					m_prog;
+	std::vector<EXPR_ARG>				m_vout;		// results of the expressions
+	size_t								m_uOutputs;	// node which takes them, size_t( -1 ) before Optimize
+
+	// arguments of the nodes are emitted before
+	EXPR_ARG			Map( const CExprProgram<NUM> & prog, const EXPR_ARG & arg, const std::vector<EXPR_ARG> & vmap )
+	{
+		switch ( arg.eat )
+		{
+			case eatConst: return EXPR_ARG( eatConst, m_prog.AddConst( prog.Const( arg.u ) ) );
+			case eatSlot: return EXPR_ARG( eatSlot, m_prog.AddSlot( prog.Slots()[ arg.u ] ) );
+			default: return vmap[ arg.u ];
+		}
+	}
+
+	// removes the node of the outputs, m_vout are its arguments
+	VOID				DropOutputs()
+	{
+		auto & vnode = m_prog.Nodes();
+		vnode.erase( vnode.begin() + m_uOutputs );
+		for ( auto & node : vnode )
+		{
+			for ( auto & arg : node.varg )
+			{
+				if ( arg.eat == eatNode && arg.u > m_uOutputs ) arg.u--;
+			}
+		}
+
+		for ( auto & arg : m_vout )
+		{
+			if ( arg.eat == eatNode && arg.u > m_uOutputs ) arg.u--;
+		}
+
+		m_uOutputs = size_t( -1 );
+	}
+
+public:
+	CExprMulti()
+		: m_uOutputs( size_t( -1 ) )
+	{
+	}
+
+	// adds the program as the next output and returns its index. Operators and functions are
+	// shared by name, so the programs must be built by the parsers with the same tokens.
+	// Expressions are evaluated in turn over the same slots, as if they were joined by ';',
+	// so the next expressions see the assignments of the previous ones
+	size_t				Add( const CExprProgram<NUM> & prog )
+	{
+		if ( m_uOutputs != size_t( -1 ) )
+		{
+			DropOutputs();
+		}
+
+		std::vector<EXPR_ARG> vmap;
+		for ( const auto & node : prog.Nodes() )
+		{
+			std::vector<EXPR_ARG> varg;
+			for ( const auto & arg : node.varg )
+			{
+				varg.push_back( Map( prog, arg, vmap ) );
+			}
+
+			switch ( node.ent )
+			{
+				case entUnary: vmap.push_back( m_prog.Emit( prog.Unary( node ), varg[ 0 ] ) ); break;
+				case entBinary: vmap.push_back( m_prog.Emit( prog.Binary( node ), varg[ 0 ], varg[ 1 ] ) ); break;
+				default: vmap.push_back( m_prog.Emit( prog.Func( node ), varg ) ); break;
+			}
+		}
+
+		m_vout.push_back( Map( prog, prog.Result(), vmap ) );
+		return m_vout.size() - 1;
+	}
+
+	size_t				Add( const std::vector<PARSER_TREE<NUM>> & vtree )
+	{
+		CExprProgram<NUM> prog;
+		prog.Build( vtree );
+		return Add( prog );
+	}
+
+	// runs the passes over the program of all outputs. The node of the outputs keeps them
+	// from dead code elimination and out of the lazy arguments. Execute requires it after Add
+	VOID				Optimize( const CExprOptimizer<NUM> & opt )
+	{
+		if ( m_uOutputs != size_t( -1 ) )
+		{
+			DropOutputs();
+		}
+
+		m_prog.Result() = m_prog.EmitOutputs( m_vout );
+		opt.Optimize( m_prog );
+
+		// the node of the outputs isn't pure, so the passes keep it
+		m_uOutputs = m_prog.Result().u;
+		m_vout = m_prog.Nodes()[ m_uOutputs ].varg;
+	}
+
+	// pResult[ i ] is the result of the expression i. Throws the first error of any expression
+	VOID				Execute( NUM * pSlots, NUM * pResult ) const
+	{
+		if ( m_uOutputs == size_t( -1 ) )
+		{
+			throw CExprParserTreeNotInitialized();
+		}
+
+		m_prog.Execute( pSlots, m_vout, pResult );
+	}
+
+	// rows of the batch, pRows are nRows x Slots() values and pResult nRows x Outputs()
+	VOID				Evaluate( const NUM * pRows, size_t nRows, NUM * pResult ) const
+	{
+		const size_t nslots = m_prog.Slots().size();
+		std::vector<NUM> vslots( nslots );
+		for ( size_t n = 0; n < nRows; ++n )
+		{
+			std::copy( pRows + n * nslots, pRows + ( n + 1 ) * nslots, vslots.begin() );
+			Execute( vslots.data(), pResult + n * m_vout.size() );
+		}
+	}
+
+	// limits of each Execute of the program of all outputs
+	VOID				SetLimits( const EXPR_LIMITS & limits )
+	{
+		m_prog.SetLimits( limits );
+	}
+
+	size_t				Outputs() const
+	{
+		return m_vout.size();
+	}
+
+	// variables of all expressions
+	const std::vector<CStringOp> &	Slots() const
+	{
+		return m_prog.Slots();
+	}
+
+	const CExprProgram<NUM> &	Program() const
+	{
+		return m_prog;
+	}
+};
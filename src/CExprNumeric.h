@@ -0,0 +1,594 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Numerical methods of the built-in functions over a compiled body. The body is given as a
+   function which evaluates it at a batch of points, so the programs may spread the batch
+   over threads, see CExprLazyArgs::Map. The solver takes the body at one point, its steps
+   depend on the previous ones. Each method fills the report of its call */
+
+#pragma once
+
+#include "CExprParser.h"
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <functional>
+#include <limits>
+
+// greatest count of the evaluations of the integrand
+#define QUAD_MAX_EVALS			1000000
+
+// default absolute tolerance of the integral
+#define QUAD_TOLERANCE			1e-10L
+
+// greatest count of the evaluations of the solver, default absolute tolerance of the root
+// and relative tolerance of the minimum, and the growth of the steps looking for a bracket
+#define SOLVE_MAX_EVALS			200
+#define SOLVE_TOLERANCE			1e-15L
+#define MINIMIZE_TOLERANCE		1e-10L
+#define SOLVE_GROWTH			1.6L
+
+// samples evaluated by one batch of Monte Carlo, and the quantile of the 95% interval
+#define MC_BATCH				65536
+#define MC_Z95					1.95996398454005423552L
+
+typedef struct _tagEXPR_NUMERIC_REPORT
+{
+	LPCTSTR					pszMethod;		// function which made the report, nullptr if none
+	size_t					nEvals;			// evaluations of the body
+	size_t					nIterations;	// rounds of subdivision or iterations
+	long double				error;			// estimate of the absolute error, half of the confidence interval for mc
+	long double				variance;		// variance of the samples for mc
+	BOOL					fConverged;		// error is within the tolerance
+
+	_tagEXPR_NUMERIC_REPORT( LPCTSTR pszMethodName = nullptr )
+		: pszMethod( pszMethodName ), nEvals( 0 ), nIterations( 0 ), error( 0 ), variance( 0 ), fConverged( FALSE ) {}
+} EXPR_NUMERIC_REPORT, *PEXPR_NUMERIC_REPORT;
+
+// adaptive Gauss-Kronrod quadrature with 15 nodes. All intervals whose error exceeds their
+// share of the tolerance are halved at once, so the nodes of a round are one batch. REAL is
+// the type of the points, VALUE of the integrand, it may be complex
+template <class REAL, class VALUE>
+class CExprQuadrature
+{
+public:
+	// py[ n ] = f( px[ n ] ), n < count
+	typedef std::function<VOID( const REAL * px, VALUE * py, size_t count )>	BATCH;
+
+private:
+	typedef struct _tagQUAD_INTERVAL
+	{
+		REAL					a;
+		REAL					b;
+		VALUE					value;
+		REAL					error;
+	} QUAD_INTERVAL;
+
+	// abscissas of Kronrod nodes on [ -1, 1 ], odd ones are the Gauss nodes, and the weights
+	static const long double *	Nodes()
+	{
+		static const long double vx[] =
+		{
+			0.991455371120812639206854697526329L, 0.949107912342758524526189684047851L, 0.864864423359769072789712788640926L,
+			0.741531185599394439863864773280788L, 0.586087235467691130294144845693013L, 0.405845151377397166906606412076961L,
+			0.207784955007898467600689403773245L, 0.0L
+		};
+		return vx;
+	}
+
+	static const long double *	KronrodWeights()
+	{
+		static const long double vw[] =
+		{
+			0.022935322010529224963732008058970L, 0.063092092629978553290700663189204L, 0.104790010322250183839876322541518L,
+			0.140653259715525918745189590510238L, 0.169004726639267902826583426598550L, 0.190350578064785409913256402421014L,
+			0.204432940075298892414161999234649L, 0.209482141084727828012999174891714L
+		};
+		return vw;
+	}
+
+	static const long double *	GaussWeights()
+	{
+		static const long double vw[] =
+		{
+			0.129484966168869693270611432679082L, 0.279705391489276667901467771423780L, 0.381830050505118944950369775488975L,
+			0.417959183673469387755102040816327L
+		};
+		return vw;
+	}
+
+	// 15 points of the interval
+	static VOID			Points( const QUAD_INTERVAL & in, REAL * px )
+	{
+		const REAL c = ( in.a + in.b ) / 2, h = ( in.b - in.a ) / 2;
+		for ( size_t j = 0; j < 7; ++j )
+		{
+			px[ 2 * j ] = c - h * REAL( Nodes()[ j ] );
+			px[ 2 * j + 1 ] = c + h * REAL( Nodes()[ j ] );
+		}
+
+		px[ 14 ] = c;
+	}
+
+	// Kronrod value of the interval and its difference with Gauss one
+	static VOID			Estimate( QUAD_INTERVAL & in, const VALUE * py )
+	{
+		const REAL h = ( in.b - in.a ) / 2;
+		VALUE kronrod = py[ 14 ] * REAL( KronrodWeights()[ 7 ] ), gauss = py[ 14 ] * REAL( GaussWeights()[ 3 ] );
+		for ( size_t j = 0; j < 7; ++j )
+		{
+			const VALUE pair = py[ 2 * j ] + py[ 2 * j + 1 ];
+			kronrod += pair * REAL( KronrodWeights()[ j ] );
+			if ( j & 1 )
+			{
+				gauss += pair * REAL( GaussWeights()[ j / 2 ] );
+			}
+		}
+
+		in.value = kronrod * h;
+		in.error = std::abs( ( kronrod - gauss ) * h );
+	}
+
+public:
+	// integral of f over [ a, b ] with the absolute error tol. When QUAD_MAX_EVALS is reached,
+	// or the intervals can't be halved, the estimate is returned with fConverged = FALSE
+	static VALUE		Integrate( const BATCH & f, REAL a, REAL b, REAL tol, EXPR_NUMERIC_REPORT & report )
+	{
+		std::vector<QUAD_INTERVAL> vin( 1 ), vnext;
+		std::vector<BOOL> vsplit;
+		std::vector<REAL> vx( 15 );
+		std::vector<VALUE> vy( 15 );
+
+		vin[ 0 ].a = a;
+		vin[ 0 ].b = b;
+		Points( vin[ 0 ], vx.data() );
+		f( vx.data(), vy.data(), 15 );
+		Estimate( vin[ 0 ], vy.data() );
+
+		report.nEvals = 15;
+		report.nIterations = 0;
+		report.fConverged = FALSE;
+
+		for ( ;; )
+		{
+			VALUE value = VALUE( 0 );
+			REAL error = 0;
+			for ( const auto & in : vin )
+			{
+				value += in.value;
+				error += in.error;
+			}
+
+			report.error = (long double) error;
+			if ( error <= tol )
+			{
+				report.fConverged = TRUE;
+				return value;
+			}
+
+			// intervals above their share of the tolerance are halved. Their sum is below the
+			// tolerance otherwise
+			const REAL width = std::abs( b - a );
+			vnext.clear();
+			vsplit.assign( vin.size(), FALSE );
+			for ( size_t n = 0; n < vin.size(); ++n )
+			{
+				const QUAD_INTERVAL & in = vin[ n ];
+				const REAL c = ( in.a + in.b ) / 2;
+				if ( in.error > tol * std::abs( in.b - in.a ) / width && c != in.a && c != in.b )
+				{
+					vsplit[ n ] = TRUE;
+					vnext.push_back( QUAD_INTERVAL{ in.a, c, VALUE( 0 ), 0 } );
+					vnext.push_back( QUAD_INTERVAL{ c, in.b, VALUE( 0 ), 0 } );
+				}
+			}
+
+			if ( !vnext.size() || report.nEvals + 15 * vnext.size() > QUAD_MAX_EVALS )
+			{
+				return value;
+			}
+
+			vx.resize( 15 * vnext.size() );
+			vy.resize( vx.size() );
+			for ( size_t n = 0; n < vnext.size(); ++n )
+			{
+				Points( vnext[ n ], vx.data() + 15 * n );
+			}
+
+			f( vx.data(), vy.data(), vx.size() );
+			report.nEvals += vx.size();
+			report.nIterations++;
+
+			// halved intervals are replaced by their halves in place
+			std::vector<QUAD_INTERVAL> vkeep;
+			for ( size_t n = 0, uNext = 0; n < vin.size(); ++n )
+			{
+				if ( !vsplit[ n ] )
+				{
+					vkeep.push_back( vin[ n ] );
+					continue;
+				}
+
+				for ( size_t k = 0; k < 2; ++k, ++uNext )
+				{
+					Estimate( vnext[ uNext ], vy.data() + 15 * uNext );
+					vkeep.push_back( vnext[ uNext ] );
+				}
+			}
+
+			vin.swap( vkeep );
+		}
+	}
+};
+
+// roots and minimums of a real function near the start point. Iterations keep their state
+// on the stack, so they cost the evaluations of the function only
+template <class REAL>
+class CExprSolver
+{
+public:
+	typedef std::function<REAL( REAL x )>				FUNC;
+	// value at x and its derivative df
+	typedef std::function<REAL( REAL x, REAL & df )>	DERIV;
+
+private:
+	static REAL			Eval( const FUNC & f, REAL x, EXPR_NUMERIC_REPORT & report )
+	{
+		report.nEvals++;
+		const REAL fx = f( x );
+		if ( !std::isfinite( fx ) )
+		{
+			throw CExprParserException( TEXT( "The function isn't finite" ) );
+		}
+
+		return fx;
+	}
+
+	static REAL			Sign( REAL a, REAL b )
+	{
+		return ( b >= 0 ? std::abs( a ) : -std::abs( a ) );
+	}
+
+	// Newton steps from x while the derivative is known and |f| decreases. FALSE if they don't
+	// converge, x is the point of the least |f| then
+	static BOOL			Newton( const DERIV & fdf, REAL & x, REAL tol, EXPR_NUMERIC_REPORT & report )
+	{
+		REAL fbest = std::numeric_limits<REAL>::infinity();
+		for ( REAL xn = x; report.nEvals < SOLVE_MAX_EVALS / 2; )
+		{
+			REAL df = 0;
+			const REAL fx = fdf( xn, df );
+			report.nEvals++;
+			report.nIterations++;
+
+			if ( !std::isfinite( fx ) || !std::isfinite( df ) || df == 0 || !( std::abs( fx ) < fbest ) )
+			{
+				return FALSE;
+			}
+
+			x = xn;
+			fbest = std::abs( fx );
+			const REAL step = fx / df;
+			xn -= step;
+			report.error = (long double) std::abs( step );
+			if ( fx == 0 || std::abs( step ) <= tol + 2 * std::numeric_limits<REAL>::epsilon() * std::abs( xn ) )
+			{
+				x = ( fx == 0 ? x : xn );
+				return TRUE;
+			}
+		}
+
+		return FALSE;
+	}
+
+	// Brent's method over [ a, b ], f( a ) and f( b ) have different signs
+	static REAL			Zero( const FUNC & f, REAL a, REAL b, REAL fa, REAL fb, REAL tol, EXPR_NUMERIC_REPORT & report )
+	{
+		REAL c = a, fc = fa, d = b - a, e = d;
+		for ( ;; )
+		{
+			if ( ( fb > 0 ) == ( fc > 0 ) )
+			{
+				c = a;
+				fc = fa;
+				d = e = b - a;
+			}
+
+			if ( std::abs( fc ) < std::abs( fb ) )
+			{
+				a = b; b = c; c = a;
+				fa = fb; fb = fc; fc = fa;
+			}
+
+			const REAL tol1 = 2 * std::numeric_limits<REAL>::epsilon() * std::abs( b ) + tol / 2, xm = ( c - b ) / 2;
+			report.error = ( fb == 0 ? 0 : (long double) std::abs( xm ) );
+			if ( std::abs( xm ) <= tol1 || fb == 0 )
+			{
+				report.fConverged = TRUE;
+				return b;
+			}
+
+			if ( report.nEvals >= SOLVE_MAX_EVALS )
+			{
+				return b;
+			}
+
+			// inverse quadratic or secant step if it stays inside and decreases fast enough
+			if ( std::abs( e ) >= tol1 && std::abs( fa ) > std::abs( fb ) )
+			{
+				REAL p, q, r;
+				const REAL s = fb / fa;
+				if ( a == c )
+				{
+					p = 2 * xm * s;
+					q = 1 - s;
+				}
+				else
+				{
+					q = fa / fc;
+					r = fb / fc;
+					p = s * ( 2 * xm * q * ( q - r ) - ( b - a ) * ( r - 1 ) );
+					q = ( q - 1 ) * ( r - 1 ) * ( s - 1 );
+				}
+
+				q = ( p > 0 ? -q : q );
+				p = std::abs( p );
+				if ( 2 * p < std::min( 3 * xm * q - std::abs( tol1 * q ), std::abs( e * q ) ) )
+				{
+					e = d;
+					d = p / q;
+				}
+				else
+				{
+					d = e = xm;
+				}
+			}
+			else
+			{
+				d = e = xm;
+			}
+
+			a = b;
+			fa = fb;
+			b += ( std::abs( d ) > tol1 ? d : Sign( tol1, xm ) );
+			fb = Eval( f, b, report );
+			report.nIterations++;
+		}
+	}
+
+public:
+	// root of f near x0 with the absolute error tol. Newton steps are made first if fdf isn't
+	// empty, then the steps from x0 grow until the sign of f changes and Brent's method takes
+	// the bracket. Throws if there is no sign change within SOLVE_MAX_EVALS evaluations
+	static REAL			Solve( const FUNC & f, const DERIV & fdf, REAL x0, REAL tol, EXPR_NUMERIC_REPORT & report )
+	{
+		report.nEvals = report.nIterations = 0;
+		report.error = 0;
+		report.fConverged = FALSE;
+
+		REAL x = x0;
+		if ( fdf && Newton( fdf, x, tol, report ) )
+		{
+			report.fConverged = TRUE;
+			return x;
+		}
+
+		REAL a = x, b = x + std::max<REAL>( 1, std::abs( x ) ) / 10;
+		REAL fa = Eval( f, a, report ), fb = Eval( f, b, report );
+		while ( fa != 0 && fb != 0 && ( fa > 0 ) == ( fb > 0 ) )
+		{
+			if ( report.nEvals >= SOLVE_MAX_EVALS )
+			{
+				throw CExprParserException( TEXT( "The sign of the function doesn't change near the start" ) );
+			}
+
+			if ( std::abs( fa ) < std::abs( fb ) )
+			{
+				a += SOLVE_GROWTH * ( a - b );
+				fa = Eval( f, a, report );
+			}
+			else
+			{
+				b += SOLVE_GROWTH * ( b - a );
+				fb = Eval( f, b, report );
+			}
+		}
+
+		if ( fa == 0 || fb == 0 )
+		{
+			report.fConverged = TRUE;
+			return ( fa == 0 ? a : b );
+		}
+
+		return Zero( f, a, b, fa, fb, tol, report );
+	}
+
+	// local minimum of f near x0 with the relative error tol. The steps from x0 grow downhill
+	// until the function rises again, then Brent's method takes the bracket. The result is
+	// returned with fConverged = FALSE when SOLVE_MAX_EVALS is reached
+	static REAL			Minimize( const FUNC & f, REAL x0, REAL tol, EXPR_NUMERIC_REPORT & report )
+	{
+		const REAL gold = ( 3 - std::sqrt( REAL( 5 ) ) ) / 2;
+		const REAL tiny = std::numeric_limits<REAL>::epsilon() * std::numeric_limits<REAL>::epsilon();
+
+		report.nEvals = report.nIterations = 0;
+		report.error = 0;
+		report.fConverged = FALSE;
+
+		// bracket a < x < b with f( x ) below the ends
+		REAL a = x0, x = x0 + std::max<REAL>( 1, std::abs( x0 ) ) / 10;
+		REAL fa = Eval( f, a, report ), fx = Eval( f, x, report );
+		if ( fx > fa )
+		{
+			std::swap( a, x );
+			std::swap( fa, fx );
+		}
+
+		REAL b = x + ( x - a ) / gold / 2, fb = Eval( f, b, report );
+		while ( fb < fx )
+		{
+			if ( report.nEvals >= SOLVE_MAX_EVALS )
+			{
+				report.error = (long double) std::abs( b - x );
+				return b;
+			}
+
+			a = x; fa = fx;
+			x = b; fx = fb;
+			b = x + SOLVE_GROWTH * ( x - a );
+			fb = Eval( f, b, report );
+		}
+
+		if ( a > b )
+		{
+			std::swap( a, b );
+		}
+
+		// parabolic steps through the three best points, golden sections otherwise
+		REAL w = x, v = x, fw = fx, fv = fx, d = 0, e = 0;
+		for ( ;; )
+		{
+			const REAL xm = ( a + b ) / 2, tol1 = tol * std::abs( x ) + tiny, tol2 = 2 * tol1;
+			report.error = (long double) ( ( b - a ) / 2 );
+			if ( std::abs( x - xm ) <= tol2 - ( b - a ) / 2 )
+			{
+				report.fConverged = TRUE;
+				return x;
+			}
+
+			if ( report.nEvals >= SOLVE_MAX_EVALS )
+			{
+				return x;
+			}
+
+			BOOL fGolden = TRUE;
+			if ( std::abs( e ) > tol1 )
+			{
+				const REAL r = ( x - w ) * ( fx - fv );
+				REAL q = ( x - v ) * ( fx - fw ), p = ( x - v ) * q - ( x - w ) * r;
+				q = 2 * ( q - r );
+				p = ( q > 0 ? -p : p );
+				q = std::abs( q );
+
+				const REAL etemp = e;
+				if ( std::abs( p ) < std::abs( q * etemp / 2 ) && p > q * ( a - x ) && p < q * ( b - x ) )
+				{
+					e = d;
+					d = p / q;
+					fGolden = FALSE;
+					if ( x + d - a < tol2 || b - x - d < tol2 )
+					{
+						d = Sign( tol1, xm - x );
+					}
+				}
+			}
+
+			if ( fGolden )
+			{
+				e = ( x >= xm ? a - x : b - x );
+				d = gold * e;
+			}
+
+			const REAL u = ( std::abs( d ) >= tol1 ? x + d : x + Sign( tol1, d ) );
+			const REAL fu = Eval( f, u, report );
+			report.nIterations++;
+
+			if ( fu <= fx )
+			{
+				( u >= x ? a : b ) = x;
+				v = w; fv = fw;
+				w = x; fw = fx;
+				x = u; fx = fu;
+			}
+			else
+			{
+				( u < x ? a : b ) = u;
+				if ( fu <= fw || w == x )
+				{
+					v = w; fv = fw;
+					w = u; fw = fu;
+				}
+				else if ( fu <= fv || v == x || v == w )
+				{
+					v = u; fv = fu;
+				}
+			}
+		}
+	}
+};
+
+// mean of the samples of a body. The samples are evaluated by batches, each batch is summed in
+// two passes and merged into the total in order, so the result doesn't depend on the threads
+// which evaluate the batch. VALUE may be complex, the variance is the mean of |x - mean|^2
+template <class VALUE>
+class CExprMonteCarlo
+{
+public:
+	// py[ n ] = body of the sample first + n, n < count
+	typedef std::function<VOID( size_t first, VALUE * py, size_t count )>	BATCH;
+
+	// mean of count samples, the report takes the variance and half of the 95% interval
+	static VALUE		Mean( const BATCH & f, size_t count, EXPR_NUMERIC_REPORT & report )
+	{
+		report.nEvals = report.nIterations = 0;
+		report.error = report.variance = 0;
+		report.fConverged = FALSE;
+		if ( !count )
+		{
+			throw CExprParserException( TEXT( "There must be at least one sample" ) );
+		}
+
+		std::vector<VALUE> vy( std::min<size_t>( count, MC_BATCH ) );
+		VALUE mean = VALUE();
+		long double m2 = 0;
+		for ( size_t first = 0; first < count; first += vy.size() )
+		{
+			const size_t nBatch = std::min( vy.size(), count - first );
+			f( first, vy.data(), nBatch );
+
+			VALUE sum = VALUE();
+			for ( size_t n = 0; n < nBatch; ++n )
+			{
+				sum += vy[ n ];
+			}
+
+			const VALUE bmean = sum / (long double) nBatch;
+			long double bm2 = 0;
+			for ( size_t n = 0; n < nBatch; ++n )
+			{
+				bm2 += std::norm( vy[ n ] - bmean );
+			}
+
+			// Chan's merge of the batch into the samples before it
+			const long double na = (long double) first, nb = (long double) nBatch, nt = na + nb;
+			const VALUE delta = bmean - mean;
+			mean += delta * ( nb / nt );
+			m2 += bm2 + std::norm( delta ) * ( na * nb / nt );
+
+			report.nEvals += nBatch;
+			report.nIterations++;
+		}
+
+		if ( !std::isfinite( m2 ) )
+		{
+			throw CExprParserException( TEXT( "The samples aren't finite" ) );
+		}
+
+		report.variance = ( count > 1 ? m2 / ( count - 1 ) : 0 );
+		report.error = MC_Z95 * std::sqrt( report.variance / count );
+		report.fConverged = TRUE;
+		return mean;
+	}
+};
@@ -0,0 +1,1112 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Optimizer of compiled programs. Runs the list of passes until the program doesn't change */
+
+#pragma once
+
+#include "CExprProgram.h"
+
+// kinds of the values, see CExprOptimizer::Classify
+typedef enum _tagEXPR_VALUE_KIND
+{
+	evkValue		= 1,		// defined value
+	evkReal			= 2,
+	evkInteger		= 4,
+	evkNonNegative	= 8			// real and not negative
+} EXPR_VALUE_KIND, *PEXPR_VALUE_KIND;
+
+// roles of the operators in arithmetic which passes rewrite, see CExprOptimizer::AddArithmetic
+typedef enum _tagEXPR_ARITHMETIC
+{
+	earAdd,
+	earSub,
+	earMul,
+	earDiv,
+	earPow,			// power, its exponent must be integer constant
+	earNeg			// prefix unary operator
+} EXPR_ARITHMETIC, *PEXPR_ARITHMETIC;
+
+template <class NUM>
+class CExprOptimizer
+{
+public:
+	// pass returns TRUE if it has changed the program
+	typedef std::function<BOOL( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )>	PASS;
+
+private:
+	typedef struct _tagIDENTITY
+	{
+		EXPR_NODE_TYPE					ent;
+		CStringOp						sName;
+		BOOL							fPrefix;
+		size_t							uArg;
+	} IDENTITY;
+
+	// token which computes the same as the general one when arguments are real
+	typedef struct _tagREAL_VARIANT
+	{
+		EXPR_NODE_TYPE								ent;
+		CStringOp									sName;
+		BOOL										fPrefix;
+		UINT										uKindA;		// required kinds of the operands
+		UINT										uKindB;
+		std::function<NUM( const NUM& )>			un;
+		std::function<NUM( NUM&, NUM& )>			op;
+		std::function<NUM( const std::vector<NUM>& )>	fn;
+	} REAL_VARIANT;
+
+	// binary operator which token may be bound to its constant second operand
+	typedef struct _tagBOUND_OP
+	{
+		CStringOp									sName;
+		std::function<std::function<NUM( NUM&, NUM& )>( const NUM& )>	bind;
+	} BOUND_OP;
+
+	// token function of the bound node, its type marks the node as already bound
+	struct BOUND_FUNC
+	{
+		std::function<NUM( NUM&, NUM& )>			op;
+
+		NUM							operator()( NUM & a, NUM & b ) const
+		{
+			return op( a, b );
+		}
+	};
+
+	typedef struct _tagARITHMETIC
+	{
+		EXPR_ARITHMETIC								ear;
+		CStringOp									sName;
+		std::function<NUM( NUM&, NUM& )>			op;
+	} ARITHMETIC;
+
+	// polynomial in one slot found by PassHorner
+	typedef struct _tagPOLYNOMIAL
+	{
+		size_t										uSlot;		// size_t( -1 ) until the slot is met
+		std::vector<BOOL>							vfCoef;		// absent coefficients are zero
+		std::vector<NUM>							vcoef;
+		std::vector<size_t>							vnode;		// nodes of the sum
+	} POLYNOMIAL;
+
+	// argument of the polynomial being emitted, absent one is zero
+	typedef struct _tagPOLY_PART
+	{
+		BOOL										f;
+		BOOL										fOne;
+		EXPR_ARG									arg;
+	} POLY_PART;
+
+	typedef struct _tagPASS_ENTRY
+	{
+		CStringOp						sName;
+		PASS							pass;
+		BOOL							fEnabled;
+	} PASS_ENTRY;
+
+	std::vector<IDENTITY>				m_videntity;
+	std::vector<CStringOp>				m_vwriter;
+	BOOL								m_fWritersKnown;
+	std::vector<PASS_ENTRY>				m_vpass;
+	size_t								m_nMaxRounds;
+	std::vector<REAL_VARIANT>			m_vreal;
+	std::vector<BOUND_OP>				m_vbound;
+	std::vector<ARITHMETIC>				m_varith;
+	size_t								m_nEstrin;
+
+	static const size_t					POLY_MAX_DEGREE = 64;
+	std::function<UINT( const NUM & )>	m_classify;
+	std::function<BOOL( const NUM &, const NUM & )>	m_equal;
+
+	REAL_VARIANT &		AddReal( EXPR_NODE_TYPE ent, LPCTSTR pszName, BOOL fPrefix, UINT uKindA, UINT uKindB )
+	{
+		REAL_VARIANT real;
+		real.ent = ent;
+		real.sName = pszName;
+		real.fPrefix = fPrefix;
+		real.uKindA = uKindA;
+		real.uKindB = uKindB;
+		m_vreal.push_back( real );
+		return m_vreal.back();
+	}
+
+	const IDENTITY *	Identity( const CExprProgram<NUM> & prog, const EXPR_NODE & node ) const
+	{
+		for ( const auto & v : m_videntity )
+		{
+			if ( v.ent == node.ent && v.uArg < node.varg.size() && prog.TokenName( node ) == v.sName &&
+				( node.ent != entUnary || prog.Unary( node ).Prefix() == v.fPrefix ) )
+			{
+				return &v;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// operator of the role which passes emit and use for constants, nullptr if not registered
+	const ARITHMETIC *	Arithmetic( EXPR_ARITHMETIC ear ) const
+	{
+		for ( const auto & v : m_varith )
+		{
+			if ( v.ear == ear && v.op )
+			{
+				return &v;
+			}
+		}
+
+		return nullptr;
+	}
+
+	NUM					Apply( EXPR_ARITHMETIC ear, NUM a, NUM b ) const
+	{
+		return Arithmetic( ear )->op( a, b );
+	}
+
+	// coef * x^nDegree, coefficient is evaluated at once
+	BOOL				Term( const CExprProgram<NUM> & prog, const EXPR_ARG & arg, POLYNOMIAL & poly, size_t & nDegree, NUM & coef ) const
+	{
+		if ( arg.eat == eatConst )
+		{
+			nDegree = 0;
+			coef = prog.Const( arg.u );
+			return TRUE;
+		}
+		else if ( arg.eat == eatSlot )
+		{
+			if ( poly.uSlot != size_t( -1 ) && poly.uSlot != arg.u )
+			{
+				return FALSE;
+			}
+
+			poly.uSlot = arg.u;
+			nDegree = 1;
+			coef = NUM( 1 );
+			return TRUE;
+		}
+
+		const EXPR_NODE & node = prog.Nodes()[ arg.u ];
+		const ARITHMETIC * parith = Arithmetic( prog, node );
+		size_t nA = 0, nB = 0;
+		NUM a, b;
+
+		if ( !parith || !Term( prog, node.varg[ 0 ], poly, nA, a ) )
+		{
+			return FALSE;
+		}
+
+		switch ( parith->ear )
+		{
+			case earMul:
+				{
+					if ( !Term( prog, node.varg[ 1 ], poly, nB, b ) )
+					{
+						return FALSE;
+					}
+
+					nDegree = nA + nB;
+					coef = Apply( earMul, a, b );
+					break;
+				}
+			case earDiv:
+				{
+					if ( !Arithmetic( earDiv ) || !Term( prog, node.varg[ 1 ], poly, nB, b ) || nB )
+					{
+						return FALSE;
+					}
+
+					nDegree = nA;
+					coef = Apply( earDiv, a, b );
+					break;
+				}
+			case earPow:
+				{
+					if ( node.varg[ 1 ].eat != eatConst )
+					{
+						return FALSE;
+					}
+
+					size_t n = 0;
+					while ( n <= POLY_MAX_DEGREE && !Equal( prog.Const( node.varg[ 1 ].u ), NUM( n ) ) ) ++n;
+					if ( n > POLY_MAX_DEGREE )
+					{
+						return FALSE;
+					}
+
+					nDegree = nA * n;
+					coef = NUM( 1 );
+					while ( n-- ) coef = Apply( earMul, coef, a );
+					break;
+				}
+			case earNeg:
+				{
+					nDegree = nA;
+					coef = Apply( earMul, a, NUM( -1 ) );
+					break;
+				}
+			default:
+				{
+					return FALSE;
+				}
+		}
+
+		poly.vnode.push_back( arg.u );
+		return ( nDegree <= POLY_MAX_DEGREE );
+	}
+
+	// sum of the terms, like terms are combined
+	BOOL				Sum( const CExprProgram<NUM> & prog, const EXPR_ARG & arg, BOOL fNegative, POLYNOMIAL & poly ) const
+	{
+		if ( arg.eat == eatNode )
+		{
+			const ARITHMETIC * parith = Arithmetic( prog, prog.Nodes()[ arg.u ] );
+			const auto & varg = prog.Nodes()[ arg.u ].varg;
+
+			if ( parith && ( parith->ear == earAdd || parith->ear == earSub ) )
+			{
+				poly.vnode.push_back( arg.u );
+				return ( Sum( prog, varg[ 0 ], fNegative, poly ) && Sum( prog, varg[ 1 ], ( parith->ear == earSub ) != !!fNegative, poly ) );
+			}
+			else if ( parith && parith->ear == earNeg )
+			{
+				poly.vnode.push_back( arg.u );
+				return Sum( prog, varg[ 0 ], !fNegative, poly );
+			}
+		}
+
+		size_t n = 0;
+		NUM coef;
+		if ( !Term( prog, arg, poly, n, coef ) )
+		{
+			return FALSE;
+		}
+
+		if ( fNegative )
+		{
+			coef = Apply( earMul, coef, NUM( -1 ) );
+		}
+
+		if ( poly.vcoef.size() <= n )
+		{
+			poly.vcoef.resize( n + 1, NUM( 0 ) );
+			poly.vfCoef.resize( n + 1, FALSE );
+		}
+
+		poly.vcoef[ n ] = ( poly.vfCoef[ n ] ? Apply( earAdd, poly.vcoef[ n ], coef ) : coef );
+		poly.vfCoef[ n ] = TRUE;
+		return TRUE;
+	}
+
+	// FALSE if slot may be assigned by the nodes in range [ uFrom, uTo ). Slots bound by the
+	// functions with efaBinds are never stable: they are assigned before the arguments of the
+	// function, which come before it
+	BOOL				SlotStable( const CExprProgram<NUM> & prog, size_t uSlot, size_t uFrom, size_t uTo ) const
+	{
+		const auto & vnode = prog.Nodes();
+		for ( const auto & node : vnode )
+		{
+			if ( node.ent == entFunc && ( prog.Attributes( node ) & efaBinds ) &&
+				std::find( node.varg.begin(), node.varg.end(), EXPR_ARG( eatSlot, uSlot ) ) != node.varg.end() )
+			{
+				return FALSE;
+			}
+		}
+
+		for ( size_t u = uFrom; u < uTo; ++u )
+		{
+			if ( Writes( prog, vnode[ u ] ) &&
+				std::find( vnode[ u ].varg.begin(), vnode[ u ].varg.end(), EXPR_ARG( eatSlot, uSlot ) ) != vnode[ u ].varg.end() )
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	// identity nodes are replaced by their arguments. Variable is forwarded only if it can't
+	// be assigned before the consumer, and never to the operators which may assign it
+	static BOOL			PassForward( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		auto & vnode = prog.Nodes();
+		BOOL fChanged = FALSE;
+
+		auto forward = [ &opt, &prog, &vnode ]( EXPR_ARG & arg, size_t uConsumer, BOOL fWriter )
+		{
+			while ( arg.eat == eatNode )
+			{
+				const IDENTITY * pid = opt.Identity( prog, vnode[ arg.u ] );
+				if ( !pid )
+				{
+					break;
+				}
+
+				const EXPR_ARG src = vnode[ arg.u ].varg[ pid->uArg ];
+				if ( src.eat == eatSlot && ( fWriter || !opt.SlotStable( prog, src.u, arg.u + 1, uConsumer ) ) )
+				{
+					break;
+				}
+
+				arg = src;
+			}
+		};
+
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			const BOOL fWriter = opt.Writes( prog, vnode[ u ] );
+			for ( auto & arg : vnode[ u ].varg )
+			{
+				const EXPR_ARG prev = arg;
+				forward( arg, u, fWriter );
+				fChanged |= ( prev != arg );
+			}
+		}
+
+		const EXPR_ARG prev = prog.Result();
+		forward( prog.Result(), vnode.size(), FALSE );
+		return ( fChanged || prev != prog.Result() );
+	}
+
+	// pure nodes with constant arguments are evaluated. Nodes which throw are left for runtime
+	static BOOL			PassFold( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		auto & vnode = prog.Nodes();
+		std::vector<BOOL> vused( vnode.size(), FALSE );
+		BOOL fChanged = FALSE;
+
+		for ( const auto & node : vnode )
+		{
+			for ( const auto & arg : node.varg )
+			{
+				if ( arg.eat == eatNode ) vused[ arg.u ] = TRUE;
+			}
+		}
+
+		if ( prog.Result().eat == eatNode )
+		{
+			vused[ prog.Result().u ] = TRUE;
+		}
+
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			const EXPR_NODE & node = vnode[ u ];
+			if ( !vused[ u ] || !( prog.Attributes( node ) & efaPure ) ||
+				std::find_if( node.varg.begin(), node.varg.end(), []( const EXPR_ARG & arg ) { return arg.eat != eatConst; } ) != node.varg.end() )
+			{
+				continue;
+			}
+
+			std::vector<NUM> vargs;
+			for ( const auto & v : node.varg )
+			{
+				vargs.push_back( prog.Const( v.u ) );
+			}
+
+			NUM value;
+			try
+			{
+				switch ( node.ent )
+				{
+					case entUnary: value = prog.Unary( node ).Func()( vargs[ 0 ] ); break;
+					case entBinary: value = prog.Binary( node ).Func()( vargs[ 0 ], vargs[ 1 ] ); break;
+					case entFunc: value = prog.Func( node ).Func()( vargs ); break;
+				}
+			}
+			catch ( CExprParserException & e )
+			{
+				UNREFERENCED_PARAMETER( e );
+				continue;
+			}
+
+			const EXPR_ARG konst( eatConst, prog.AddConst( value ) );
+			for ( size_t n = u + 1; n < vnode.size(); ++n )
+			{
+				std::replace( vnode[ n ].varg.begin(), vnode[ n ].varg.end(), EXPR_ARG( eatNode, u ), konst );
+			}
+
+			if ( prog.Result() == EXPR_ARG( eatNode, u ) )
+			{
+				prog.Result() = konst;
+			}
+
+			vused[ u ] = FALSE;
+			fChanged = TRUE;
+		}
+
+		return fChanged;
+	}
+
+	// pure node which has the same token and arguments as an earlier one is replaced by it.
+	// Arguments of commutative tokens are compared in any order, constants by EqualFunc.
+	// Variables must not be assigned between the nodes
+	static BOOL			PassCommonSubexpr( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		auto & vnode = prog.Nodes();
+		std::map<std::vector<size_t>, size_t> mnode;
+		std::vector<size_t> vsame( vnode.size() );
+		BOOL fChanged = FALSE;
+
+		auto same = [ &vsame ]( EXPR_ARG & arg )
+		{
+			if ( arg.eat == eatNode ) arg.u = vsame[ arg.u ];
+		};
+
+		// each literal has its own constant, equal ones are compared by the first of them
+		std::vector<size_t> vconst;
+		auto konst = [ &opt, &prog, &vconst ]( size_t u )
+		{
+			for ( const auto & c : vconst )
+			{
+				if ( opt.Equal( prog.Const( c ), prog.Const( u ) ) ) return c;
+			}
+
+			vconst.push_back( u );
+			return u;
+		};
+
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			EXPR_NODE & node = vnode[ u ];
+			vsame[ u ] = u;
+			std::for_each( node.varg.begin(), node.varg.end(), same );
+
+			const UINT uAttr = prog.Attributes( node );
+			if ( !( uAttr & efaPure ) || opt.Writes( prog, node ) )
+			{
+				continue;
+			}
+
+			std::vector<std::pair<size_t, size_t>> vkey;
+			for ( const auto & arg : node.varg )
+			{
+				vkey.push_back( std::make_pair( size_t( arg.eat ), arg.eat == eatConst ? konst( arg.u ) : arg.u ) );
+			}
+
+			if ( uAttr & efaCommutative )
+			{
+				std::sort( vkey.begin(), vkey.end() );
+			}
+
+			std::vector<size_t> key = { size_t( node.ent ), node.uToken };
+			for ( const auto & v : vkey )
+			{
+				key.push_back( v.first );
+				key.push_back( v.second );
+			}
+
+			auto v = mnode.find( key );
+			BOOL fStable = ( v != mnode.end() );
+			for ( size_t n = 0; fStable && n < node.varg.size(); ++n )
+			{
+				fStable = ( node.varg[ n ].eat != eatSlot || opt.SlotStable( prog, node.varg[ n ].u, v->second + 1, u ) );
+			}
+
+			if ( fStable )
+			{
+				vsame[ u ] = v->second;
+				fChanged = TRUE;
+			}
+			else
+			{
+				mnode[ key ] = u;
+			}
+		}
+
+		same( prog.Result() );
+		return fChanged;
+	}
+
+	// binary nodes with constant second operand get the tokens bound to it, see AddBoundOp
+	static BOOL			PassBind( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		BOOL fChanged = FALSE;
+
+		for ( auto & node : prog.Nodes() )
+		{
+			if ( node.ent != entBinary || node.varg[ 1 ].eat != eatConst || prog.Binary( node ).Func().template target<BOUND_FUNC>() )
+			{
+				continue;
+			}
+
+			for ( const auto & v : opt.m_vbound )
+			{
+				if ( !( prog.TokenName( node ) == v.sName ) )
+				{
+					continue;
+				}
+
+				BOUND_FUNC bound;
+				bound.op = v.bind( prog.Const( node.varg[ 1 ].u ) );
+				if ( bound.op )
+				{
+					CExprTokenOp<NUM> tok = prog.Binary( node );
+					tok.TokFunc() = bound;
+					node.uToken = prog.AddToken( tok );
+					fChanged = TRUE;
+				}
+				break;
+			}
+		}
+
+		return fChanged;
+	}
+
+	// sums of constant multiples of the powers of one variable are evaluated by Horner
+	// scheme, or by Estrin scheme from SetEstrinDegree. The sum is rewritten if the
+	// scheme takes less nodes. Rounding differs from the sum, so the pass is disabled by default
+	static BOOL			PassHorner( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		if ( !opt.Arithmetic( earAdd ) || !opt.Arithmetic( earMul ) )
+		{
+			return FALSE;
+		}
+
+		auto & vnode = prog.Nodes();
+		std::vector<BOOL> vdone( vnode.size(), FALSE );
+		size_t uAdd = size_t( -1 ), uMul = size_t( -1 );
+		BOOL fChanged = FALSE;
+
+		// nodes below the rewritten sum keep their indices
+		for ( size_t uRoot = vnode.size(); uRoot-- > 0; )
+		{
+			const ARITHMETIC * parith = opt.Arithmetic( prog, vnode[ uRoot ] );
+			if ( vdone[ uRoot ] || !parith || ( parith->ear != earAdd && parith->ear != earSub ) )
+			{
+				continue;
+			}
+
+			POLYNOMIAL poly;
+			poly.uSlot = size_t( -1 );
+			try
+			{
+				if ( !opt.Sum( prog, EXPR_ARG( eatNode, uRoot ), FALSE, poly ) || poly.uSlot == size_t( -1 ) || poly.vcoef.size() < 3 ||
+					!opt.SlotStable( prog, poly.uSlot, 0, vnode.size() ) )
+				{
+					continue;
+				}
+			}
+			catch ( CExprParserException & e )
+			{
+				UNREFERENCED_PARAMETER( e );
+				continue;
+			}
+
+			std::vector<EXPR_NODE> vnew;
+			const size_t uAtChar = vnode[ uRoot ].uAtChar;
+			auto emit = [ & ]( EXPR_ARITHMETIC ear, const EXPR_ARG & a, const EXPR_ARG & b )
+			{
+				size_t & uToken = ( ear == earAdd ? uAdd : uMul );
+				if ( uToken == size_t( -1 ) )
+				{
+					CExprTokenOp<NUM> tok;
+					tok.TokName() = opt.Arithmetic( ear )->sName;
+					tok.TokFunc() = opt.Arithmetic( ear )->op;
+					tok.SetAttributes( efaPure | efaRealClosed | efaCommutative, eccCheap );
+					uToken = prog.AddToken( tok );
+				}
+
+				EXPR_NODE node( entBinary, uToken, uAtChar );
+				node.varg = { a, b };
+				vnew.push_back( node );
+				return EXPR_ARG( eatNode, uRoot + vnew.size() - 1 );
+			};
+
+			// a + b * xp
+			auto fma = [ & ]( const POLY_PART & a, const POLY_PART & b, const EXPR_ARG & xp )
+			{
+				if ( !b.f )
+				{
+					return a;
+				}
+
+				POLY_PART r = { TRUE, FALSE, ( b.fOne ? xp : emit( earMul, b.arg, xp ) ) };
+				if ( a.f )
+				{
+					r.arg = emit( earAdd, r.arg, a.arg );
+				}
+
+				return r;
+			};
+
+			std::vector<POLY_PART> vcoef;
+			for ( size_t n = 0; n < poly.vcoef.size(); ++n )
+			{
+				POLY_PART part = { poly.vfCoef[ n ], opt.Equal( poly.vcoef[ n ], NUM( 1 ) ), EXPR_ARG() };
+				if ( part.f )
+				{
+					part.arg = EXPR_ARG( eatConst, prog.AddConst( poly.vcoef[ n ] ) );
+				}
+
+				vcoef.push_back( part );
+			}
+
+			// Estrin scheme falls back to Horner one when it doesn't take less nodes than the sum
+			const EXPR_ARG x( eatSlot, poly.uSlot );
+			BOOL fEstrin = ( opt.m_nEstrin && poly.vcoef.size() > opt.m_nEstrin ), fRewrite = FALSE;
+			for ( ;; )
+			{
+				std::vector<POLY_PART> vpart = vcoef;
+				vnew.clear();
+
+				if ( fEstrin )
+				{
+					// pairs of coefficients, then pairs of pairs with the squared power
+					EXPR_ARG xp = x;
+					while ( vpart.size() > 1 )
+					{
+						std::vector<POLY_PART> vnext;
+						for ( size_t n = 0; n < vpart.size(); n += 2 )
+						{
+							vnext.push_back( n + 1 < vpart.size() ? fma( vpart[ n ], vpart[ n + 1 ], xp ) : vpart[ n ] );
+						}
+
+						vpart = vnext;
+						if ( vpart.size() > 1 )
+						{
+							xp = emit( earMul, xp, xp );
+						}
+					}
+				}
+				else
+				{
+					POLY_PART r = vpart.back();
+					for ( size_t n = vpart.size() - 1; n-- > 0; )
+					{
+						r = fma( vpart[ n ], r, x );
+					}
+
+					vpart.assign( 1, r );
+				}
+
+				fRewrite = ( !vnew.empty() && vnew.size() < poly.vnode.size() && vpart[ 0 ].arg == EXPR_ARG( eatNode, uRoot + vnew.size() - 1 ) );
+				if ( fRewrite || !fEstrin )
+				{
+					break;
+				}
+
+				fEstrin = FALSE;
+			}
+
+			if ( !fRewrite )
+			{
+				continue;
+			}
+
+			// the last new node replaces the root, the others are inserted before it
+			const size_t nShift = vnew.size() - 1;
+			for ( size_t u = uRoot + 1; u < vnode.size(); ++u )
+			{
+				for ( auto & arg : vnode[ u ].varg )
+				{
+					if ( arg.eat == eatNode && arg.u >= uRoot ) arg.u += nShift;
+				}
+			}
+
+			if ( prog.Result().eat == eatNode && prog.Result().u >= uRoot )
+			{
+				prog.Result().u += nShift;
+			}
+
+			vnode[ uRoot ] = vnew.back();
+			vnode.insert( vnode.begin() + uRoot, vnew.begin(), vnew.end() - 1 );
+
+			for ( const auto & u : poly.vnode )
+			{
+				vdone[ u ] = TRUE;
+			}
+
+			fChanged = TRUE;
+		}
+
+		return fChanged;
+	}
+
+	// removes nodes which results are not used, except the assignments of variables and
+	// the nodes of impure tokens
+	static BOOL			PassDeadCode( const CExprOptimizer<NUM> & opt, CExprProgram<NUM> & prog )
+	{
+		auto & vnode = prog.Nodes();
+		std::vector<BOOL> vlive( vnode.size(), FALSE );
+
+		if ( prog.Result().eat == eatNode )
+		{
+			vlive[ prog.Result().u ] = TRUE;
+		}
+
+		for ( size_t u = vnode.size(); u-- > 0; )
+		{
+			if ( !vlive[ u ] && ( !( prog.Attributes( vnode[ u ] ) & efaPure ) || ( opt.Writes( prog, vnode[ u ] ) &&
+				std::find_if( vnode[ u ].varg.begin(), vnode[ u ].varg.end(), []( const EXPR_ARG & arg ) { return arg.eat == eatSlot; } ) != vnode[ u ].varg.end() ) ) )
+			{
+				vlive[ u ] = TRUE;
+			}
+
+			if ( vlive[ u ] )
+			{
+				for ( const auto & arg : vnode[ u ].varg )
+				{
+					if ( arg.eat == eatNode ) vlive[ arg.u ] = TRUE;
+				}
+			}
+		}
+
+		if ( std::find( vlive.begin(), vlive.end(), FALSE ) == vlive.end() )
+		{
+			return FALSE;
+		}
+
+		std::vector<size_t> vindex( vnode.size(), size_t( -1 ) );
+		std::vector<EXPR_NODE> vnew;
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			if ( !vlive[ u ] )
+			{
+				continue;
+			}
+
+			vindex[ u ] = vnew.size();
+			vnew.push_back( vnode[ u ] );
+			for ( auto & arg : vnew.back().varg )
+			{
+				if ( arg.eat == eatNode ) arg.u = vindex[ arg.u ];
+			}
+		}
+
+		if ( prog.Result().eat == eatNode )
+		{
+			prog.Result().u = vindex[ prog.Result().u ];
+		}
+
+		vnode = vnew;
+		return TRUE;
+	}
+
+public:
+	CExprOptimizer()
+		: m_fWritersKnown( FALSE ), m_nMaxRounds( 8 ), m_nEstrin( 8 )
+	{
+		// brackets are the function without name, see CExprParser::CExprParser
+		AddIdentity( entFunc, TEXT( "" ), 0 );
+
+		AddPass( TEXT( "forward" ), PassForward );
+		AddPass( TEXT( "fold" ), PassFold );
+		AddPass( TEXT( "cse" ), PassCommonSubexpr );
+		AddPass( TEXT( "horner" ), PassHorner, FALSE );
+		AddPass( TEXT( "bind" ), PassBind );
+		AddPass( TEXT( "dce" ), PassDeadCode );
+	}
+
+	// node which returns its uArg argument. Checks of the argument made by the token are lost
+	VOID				AddIdentity( EXPR_NODE_TYPE ent, LPCTSTR pszName, size_t uArg, BOOL fPrefix = TRUE )
+	{
+		IDENTITY id;
+		id.ent = ent;
+		id.sName = pszName;
+		id.fPrefix = fPrefix;
+		id.uArg = uArg;
+		m_videntity.push_back( id );
+	}
+
+	// binary operator which may assign its variable arguments. Until any writer is registered
+	// all binary operators are assumed to be writers
+	VOID				AddWriter( LPCTSTR pszName )
+	{
+		m_vwriter.push_back( pszName );
+		m_fWritersKnown = TRUE;
+	}
+
+	BOOL				Writes( const CExprProgram<NUM> & prog, const EXPR_NODE & node ) const
+	{
+		if ( node.ent == entFunc )
+		{
+			return !!( prog.Attributes( node ) & efaBinds );
+		}
+
+		if ( node.ent != entBinary )
+		{
+			return FALSE;
+		}
+
+		return ( !m_fWritersKnown || std::find( m_vwriter.begin(), m_vwriter.end(), prog.TokenName( node ) ) != m_vwriter.end() );
+	}
+
+	// TRUE if the program may assign or bind the slot
+	BOOL				Assigns( const CExprProgram<NUM> & prog, size_t uSlot ) const
+	{
+		return !SlotStable( prog, uSlot, 0, prog.Nodes().size() );
+	}
+
+	// value kinds (EXPR_VALUE_KIND flags) of NUM, used by profiles and specialization
+	std::function<UINT( const NUM & )> &	ClassifyFunc()
+	{
+		return m_classify;
+	}
+
+	UINT				Classify( const NUM & value ) const
+	{
+		return ( m_classify ? m_classify( value ) : 0 );
+	}
+
+	std::function<BOOL( const NUM &, const NUM & )> &	EqualFunc()
+	{
+		return m_equal;
+	}
+
+	BOOL				Equal( const NUM & a, const NUM & b ) const
+	{
+		return ( m_equal ? m_equal( a, b ) : FALSE );
+	}
+
+	// real variants of the tokens, returned functions must be assigned at once.
+	// Specialization uses them for the nodes with real arguments, their results are real
+	std::function<NUM( const NUM& )> &	AddRealUnaryOp( LPCTSTR pszName, BOOL fPrefix )
+	{
+		return AddReal( entUnary, pszName, !!fPrefix, evkReal, evkReal ).un;
+	}
+
+	// uKindB, uKindA - kinds of the second and the first operands which this variant requires.
+	// Variants of the same operator are tried in the order of registration
+	std::function<NUM( NUM&, NUM& )> &	AddRealOp( LPCTSTR pszName, UINT uKindB = evkReal, UINT uKindA = evkReal )
+	{
+		return AddReal( entBinary, pszName, FALSE, uKindA, uKindB ).op;
+	}
+
+	std::function<NUM( const std::vector<NUM>& )> &	AddRealFunc( LPCTSTR pszName )
+	{
+		return AddReal( entFunc, pszName, FALSE, evkReal, evkReal ).fn;
+	}
+
+	// kinds besides evkReal which the real variants of the node require from its argument uArg.
+	// Variants which constant other argument doesn't allow are skipped
+	UINT				Requires( const CExprProgram<NUM> & prog, const EXPR_NODE & node, size_t uArg ) const
+	{
+		const UINT uExtra = ~UINT( evkValue | evkReal );
+		UINT uKind = 0;
+
+		for ( const auto & v : m_vreal )
+		{
+			if ( node.ent != entBinary || v.ent != entBinary || !( prog.TokenName( node ) == v.sName ) )
+			{
+				continue;
+			}
+
+			const EXPR_ARG & other = node.varg[ 1 - uArg ];
+			const UINT uOther = ( uArg ? v.uKindA : v.uKindB ), uThis = ( uArg ? v.uKindB : v.uKindA );
+			if ( other.eat == eatConst )
+			{
+				if ( ( Classify( prog.Const( other.u ) ) & uOther ) != uOther )
+				{
+					continue;
+				}
+				else if ( !( uThis & uExtra ) )
+				{
+					return 0;
+				}
+			}
+
+			uKind |= uThis;
+		}
+
+		return ( uKind & uExtra );
+	}
+
+	// binary operator which token is bound to the constant second operand by "bind" pass,
+	// e.g. power with integer exponent. Returned function must be assigned at once: it gets
+	// the constant and returns the operator for it, or empty function to keep the general one
+	std::function<std::function<NUM( NUM&, NUM& )>( const NUM& )> &	AddBoundOp( LPCTSTR pszName )
+	{
+		BOUND_OP bound;
+		bound.sName = pszName;
+		m_vbound.push_back( bound );
+		return m_vbound.back().bind;
+	}
+
+	// role of the node in arithmetic, nullptr if it has none
+	const ARITHMETIC *	Arithmetic( const CExprProgram<NUM> & prog, const EXPR_NODE & node ) const
+	{
+		for ( const auto & v : m_varith )
+		{
+			if ( ( v.ear == earNeg ? node.ent == entUnary && prog.Unary( node ).Prefix() : node.ent == entBinary ) && prog.TokenName( node ) == v.sName )
+			{
+				return &v;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// replaces token of the node by its real variant if argument kinds allow. vkind are the
+	// kinds of the node arguments
+	BOOL				Realize( CExprProgram<NUM> & prog, size_t uNode, const std::vector<UINT> & vkind ) const
+	{
+		EXPR_NODE & node = prog.Nodes()[ uNode ];
+
+		for ( size_t n = 0; n < vkind.size(); ++n )
+		{
+			if ( !( vkind[ n ] & evkReal ) )
+			{
+				return FALSE;
+			}
+		}
+
+		for ( const auto & v : m_vreal )
+		{
+			if ( v.ent != node.ent || !( prog.TokenName( node ) == v.sName ) ||
+				( node.ent == entUnary && prog.Unary( node ).Prefix() != v.fPrefix ) ||
+				( node.ent == entBinary && ( ( vkind[ 0 ] & v.uKindA ) != v.uKindA || ( vkind[ 1 ] & v.uKindB ) != v.uKindB ) ) )
+			{
+				continue;
+			}
+
+			switch ( node.ent )
+			{
+				case entUnary:
+					{
+						CExprTokenUn<NUM> tok = prog.Unary( node );
+						tok.TokFunc() = v.un;
+						node.uToken = prog.AddToken( tok );
+						break;
+					}
+				case entBinary:
+					{
+						CExprTokenOp<NUM> tok = prog.Binary( node );
+						tok.TokFunc() = v.op;
+						node.uToken = prog.AddToken( tok );
+						break;
+					}
+				case entFunc:
+					{
+						CExprTokenFunc<NUM> tok = prog.Func( node );
+						tok.TokFunc() = v.fn;
+						node.uToken = prog.AddToken( tok );
+						break;
+					}
+			}
+
+			return TRUE;
+		}
+
+		return FALSE;
+	}
+
+	// operator which passes treat as arithmetic, several operators may have the same role.
+	// Returned function must be assigned at once for the first operator of earAdd, earSub,
+	// earMul and earDiv: passes emit the operators and evaluate constants with it
+	std::function<NUM( NUM&, NUM& )> &	AddArithmetic( EXPR_ARITHMETIC ear, LPCTSTR pszName )
+	{
+		ARITHMETIC arith;
+		arith.ear = ear;
+		arith.sName = pszName;
+		m_varith.push_back( arith );
+		return m_varith.back().op;
+	}
+
+	// polynomials of this degree and higher are evaluated by Estrin scheme, which has less
+	// dependencies between the nodes than Horner scheme. 0 - Horner scheme only
+	VOID				SetEstrinDegree( size_t nDegree )
+	{
+		m_nEstrin = nDegree;
+	}
+
+	// passes are run in the order of registration
+	VOID				AddPass( LPCTSTR pszName, const PASS & pass, BOOL fEnabled = TRUE )
+	{
+		PASS_ENTRY entry;
+		entry.sName = pszName;
+		entry.pass = pass;
+		entry.fEnabled = fEnabled;
+		m_vpass.push_back( entry );
+	}
+
+	BOOL				EnablePass( LPCTSTR pszName, BOOL fEnable )
+	{
+		for ( auto & v : m_vpass )
+		{
+			if ( v.sName == CStringOp( pszName ) )
+			{
+				v.fEnabled = fEnable;
+				return TRUE;
+			}
+		}
+
+		return FALSE;
+	}
+
+	// returns TRUE if program has been changed
+	BOOL				Optimize( CExprProgram<NUM> & prog ) const
+	{
+		BOOL fChanged = FALSE;
+
+		for ( size_t n = 0; n < m_nMaxRounds; ++n )
+		{
+			BOOL fRound = FALSE;
+			for ( const auto & v : m_vpass )
+			{
+				if ( v.fEnabled )
+				{
+					fRound |= v.pass( *this, prog );
+				}
+			}
+
+			if ( !fRound )
+			{
+				break;
+			}
+
+			fChanged = TRUE;
+		}
+
+		return fChanged;
+	}
+
+	// partial evaluation: the values of mfixed are substituted for their variables, and the
+	// passes fold the parts which depend on them only. Slots keep their indices, so the rows of
+	// prog fit the result, which ignores the fixed slots. Variables which prog doesn't use are
+	// skipped. Throws if prog assigns or binds a fixed variable
+	CExprProgram<NUM>	Specialize( const CExprProgram<NUM> & prog, const std::map<CStringOp, NUM> & mfixed ) const
+	{
+		CExprProgram<NUM> special = prog;
+		auto & vnode = special.Nodes();
+
+		for ( const auto & v : mfixed )
+		{
+			const size_t uSlot = prog.Slot( v.first );
+			if ( uSlot == size_t( -1 ) )
+			{
+				continue;
+			}
+
+			if ( Assigns( prog, uSlot ) )
+			{
+				throw CExprParserException( TEXT( "The fixed variable is assigned by the expression" ) );
+			}
+
+			const EXPR_ARG slot( eatSlot, uSlot ), konst( eatConst, special.AddConst( v.second ) );
+			for ( auto & node : vnode )
+			{
+				std::replace( node.varg.begin(), node.varg.end(), slot, konst );
+			}
+
+			if ( special.Result() == slot )
+			{
+				special.Result() = konst;
+			}
+		}
+
+		Optimize( special );
+		return special;
+	}
+};
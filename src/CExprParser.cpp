@@ -18,7 +18,7 @@
 #include "Controls.h"
 
 CExprParserException::CExprParserException( LPCTSTR pszMessage, size_t u )
-	: m_uChar( u ), m_sMessage( pszMessage ? pszMessage : TEXT( "" ) )
+	: m_uChar( u ), m_pszStatic( nullptr ), m_psMessage( std::make_shared<const CStringOp>( pszMessage ? pszMessage : TEXT( "" ) ) )
 {
 
 }
@@ -30,14 +30,15 @@ size_t CExprParserException::AtChar()
 
 CStringOp CExprParserException::Message()
 {
+	const LPCTSTR pszMessage = ( m_psMessage ? m_psMessage->GetString() : m_pszStatic );
 	CStringOp msg;
 	if ( m_uChar == size_t( -1 ) )
 	{
-		msg = m_sMessage;
+		msg = pszMessage;
 	}
 	else
 	{
-		msg.Format( TEXT( "%s at position %ld" ), m_sMessage.GetString(), m_uChar + 1 );
+		msg.Format( TEXT( "%" TFMT_S " at position %ld" ), pszMessage, m_uChar + 1 );
 	}
 
 	return msg.GetString();
@@ -18,14 +18,34 @@
 #pragma once
 
 #include "CStringOp.h"
+#include <atomic>
+#include <chrono>
 #include <functional>
 #include <map>
+#include <memory>
 #include <vector>
 
+typedef enum _tagEXPR_LIMIT
+{
+	elmExpressionLength,
+	elmNesting,
+	elmNodes,
+	elmLiterals,
+	elmSteps,
+	elmDeadline,
+	elmCancelled
+} EXPR_LIMIT, *PEXPR_LIMIT;
+
 class CExprParserException
 {
 	const size_t		m_uChar;
-	const CStringOp		m_sMessage;
+	LPCTSTR				m_pszStatic;	// message which is a static text, then m_psMessage is nullptr
+	std::shared_ptr<const CStringOp>	m_psMessage;
+
+protected:
+	// for the exceptions which must be cheap to throw and handle, the message isn't copied
+	CExprParserException( size_t u, LPCTSTR pszStatic )
+		: m_uChar( u ), m_pszStatic( pszStatic ) {}
 
 public:
 	CExprParserException( LPCTSTR pszMessage, size_t u = size_t( -1 ) );
@@ -41,6 +61,13 @@ public:
 		: CExprParserException( TEXT( "Division by zero" ), uChar ) {}
 };
 
+class CExprParserIntegerOverflow : public CExprParserException
+{
+public:
+	CExprParserIntegerOverflow( size_t uChar = size_t( -1 ) )
+		: CExprParserException( TEXT( "Integer overflow" ), uChar ) {}
+};
+
 class CExprParserBracketMismatch : public CExprParserException
 {
 public:
@@ -59,7 +86,7 @@ class CExprParserNoSuchFunction : public CExprParserException
 {
 public:
 	CExprParserNoSuchFunction( LPCTSTR pszFuncname, size_t uChar = size_t( -1 ) )
-		: CExprParserException( CStringOp().Format( TEXT( "No such function '%s'" ), pszFuncname ), uChar ) {}
+		: CExprParserException( CStringOp().Format( TEXT( "No such function '%" TFMT_S "'" ), pszFuncname ), uChar ) {}
 };
 
 class CExprParserNoSuchToken: public CExprParserException
@@ -117,3 +144,35 @@ public:
 	CExprParserCantAssignNumeric( size_t uChar = size_t( -1 ) )
 		: CExprParserException( TEXT( "Can't assign value to an numeric operand" ), uChar ) { }
 };
+
+// thrown when one of EXPR_LIMITS is breached. Parser never rewraps this exception,
+// so caller may catch it by type and check Limit() without parsing the message. It
+// doesn't allocate, the message is the static text
+class CExprParserLimitExceeded : public CExprParserException
+{
+	const EXPR_LIMIT	m_elm;
+
+	static LPCTSTR		LimitMessage( EXPR_LIMIT elm )
+	{
+		switch ( elm )
+		{
+			case elmExpressionLength: return TEXT( "Expression is too long" );
+			case elmNesting: return TEXT( "Expression is nested too deep" );
+			case elmNodes: return TEXT( "Expression has too many tokens" );
+			case elmLiterals: return TEXT( "Expression has too many literals" );
+			case elmSteps: return TEXT( "Evaluation steps limit exceeded" );
+			case elmDeadline: return TEXT( "Evaluation deadline exceeded" );
+			case elmCancelled: return TEXT( "Evaluation cancelled" );
+		}
+		return TEXT( "Limit exceeded" );
+	}
+
+public:
+	CExprParserLimitExceeded( EXPR_LIMIT elm, size_t uChar = size_t( -1 ) )
+		: CExprParserException( uChar, LimitMessage( elm ) ), m_elm( elm ) { }
+
+	EXPR_LIMIT			Limit() const
+	{
+		return m_elm;
+	}
+};
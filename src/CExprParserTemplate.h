@@ -18,6 +18,7 @@
 #pragma once
 
 #include "CExprParser.h"
+#include "CExprMemo.h"
 
 typedef enum _tagEXPR_TOKEN_ASSOC
 {
@@ -25,6 +26,23 @@ typedef enum _tagEXPR_TOKEN_ASSOC
 	etaRightOriented
 } EXPR_TOKEN_ASSOC, *PEXPR_TOKEN_ASSOC;
 
+// properties of the operators and functions which the optimizations rely on. Tokens without
+// efaPure are evaluated at runtime on each call, see AddOp, AddUnaryOp and AddFunc
+typedef enum _tagEXPR_FUNC_ATTR
+{
+	efaPure			= 1,		// result depends only on the arguments, no side effects
+	efaRealClosed	= 2,		// real arguments give real result
+	efaCommutative	= 4,		// arguments may be swapped
+	efaBinds		= 8			// lazy function which assigns its variable arguments while it evaluates the others, see CExprLazyArgs::Bind
+} EXPR_FUNC_ATTR, *PEXPR_FUNC_ATTR;
+
+typedef enum _tagEXPR_COST_CLASS
+{
+	eccCheap,					// arithmetic
+	eccElementary,				// functions of libm
+	eccExpensive				// special functions, table lookups, callbacks of the application
+} EXPR_COST_CLASS, *PEXPR_COST_CLASS;
+
 typedef enum _tagEXPR_TOKEN_TYPE
 {
 	ettNone,
@@ -40,15 +58,34 @@ typedef enum _tagEXPR_TOKEN_TYPE
 	ettComma
 } EXPR_TOKEN_TYPE, *PEXPR_TOKEN_TYPE;
 
+// resource limits of the parser. Zero value of any field means 'unlimited'
+typedef struct _tagEXPR_LIMITS
+{
+	size_t						cchMaxExpression;	// length of the expression string
+	size_t						nMaxNesting;		// depth of the brackets
+	size_t						nMaxNodes;			// count of tokens in the RPN
+	size_t						nMaxLiterals;		// count of numeric literals
+	size_t						nMaxSteps;			// count of evaluated tokens per Compile or Evaluate, nodes per CExprProgram::Execute
+	std::chrono::milliseconds	msTimeout;			// wall-clock time per Compile, Evaluate or Execute
+	const std::atomic<bool> *	pfCancel;			// cooperative cancellation flag, checked while evaluating
+
+	_tagEXPR_LIMITS()
+		: cchMaxExpression( 0 ), nMaxNesting( 0 ), nMaxNodes( 0 ), nMaxLiterals( 0 ), nMaxSteps( 0 ),
+		msTimeout( 0 ), pfCancel( nullptr ) {}
+} EXPR_LIMITS, *PEXPR_LIMITS;
+
 template <class FUNC>
 class CExprToken
 {
 
 protected:
 	FUNC					m_tokFunc;
+	CStringOp				m_sName;
+	UINT					m_uAttr;
+	EXPR_COST_CLASS			m_ecc;
 
 	CExprToken( )
-		: m_tokFunc( nullptr )
+		: m_tokFunc( nullptr ), m_uAttr( 0 ), m_ecc( eccCheap )
 	{
 	}
 
@@ -62,6 +99,38 @@ public:
 	{
 		return m_tokFunc;
 	}
+
+	CStringOp &				TokName()
+	{
+		return m_sName;
+	}
+
+	const CStringOp &		Name() const
+	{
+		return m_sName;
+	}
+
+	// EXPR_FUNC_ATTR flags
+	UINT					Attributes() const
+	{
+		return m_uAttr;
+	}
+
+	EXPR_COST_CLASS			Cost() const
+	{
+		return m_ecc;
+	}
+
+	BOOL					Pure() const
+	{
+		return !!( m_uAttr & efaPure );
+	}
+
+	VOID					SetAttributes( UINT uAttr, EXPR_COST_CLASS ecc )
+	{
+		m_uAttr = uAttr;
+		m_ecc = ecc;
+	}
 };
 
 template <class NUM>
@@ -111,15 +180,184 @@ public:
 template <class NUM>
 class CExprTokenUn: public CExprTokenOperator<std::function<NUM( const NUM& )>>
 {
+	BOOL							m_fPrefix;
+
+public:
+	CExprTokenUn( int prio = -1, BOOL fPrefix = TRUE )
+		: CExprTokenOperator<std::function<NUM( const NUM& )>>( prio ), m_fPrefix( fPrefix ) {}
+
+	BOOL							Prefix() const
+	{
+		return m_fPrefix;
+	}
+};
+
+// pairwise combination of a sequence: the values are the leaves of a binary tree which is
+// combined as they come, so the error of a long sum grows as log n instead of n. Level of
+// the added value is the height of its subtree, so sums of aligned blocks of 2^level values
+// may be added instead of the values, and Append adds the sequence which follows
+template <class NUM>
+class CExprPairwise
+{
+public:
+	typedef std::function<NUM( const NUM &, const NUM & )>		COMBINE;
+
+private:
+	const COMBINE &						m_combine;
+	std::vector<NUM>					m_vval;
+	std::vector<size_t>					m_vlevel;
+
+public:
+	CExprPairwise( const COMBINE & combine )
+		: m_combine( combine ) {}
+
+	VOID				Add( const NUM & value, size_t uLevel = 0 )
+	{
+		m_vval.push_back( value );
+		m_vlevel.push_back( uLevel );
+
+		for ( size_t c = m_vval.size(); c > 1 && m_vlevel[ c - 2 ] == m_vlevel[ c - 1 ]; --c )
+		{
+			m_vval[ c - 2 ] = m_combine( m_vval[ c - 2 ], m_vval[ c - 1 ] );
+			m_vlevel[ c - 2 ]++;
+			m_vval.pop_back();
+			m_vlevel.pop_back();
+		}
+	}
+
+	VOID				Append( const CExprPairwise & next )
+	{
+		for ( size_t n = 0; n < next.m_vval.size(); ++n )
+		{
+			Add( next.m_vval[ n ], next.m_vlevel[ n ] );
+		}
+	}
+
+	// empty is the result of the empty sequence
+	NUM					Result( const NUM & empty ) const
+	{
+		if ( !m_vval.size() )
+		{
+			return empty;
+		}
+
+		NUM r = m_vval.back();
+		for ( size_t n = m_vval.size() - 1; n-- > 0; )
+		{
+			r = m_combine( m_vval[ n ], r );
+		}
+
+		return r;
+	}
+};
+
+template <class NUM>
+class CExprProgram;
+
+// arguments of the lazy functions, see CExprParser::AddLazyFunc. Value evaluates the argument
+// on each call, the arguments which are never asked for are not evaluated at all
+template <class NUM>
+class CExprLazyArgs
+{
+public:
+	typedef typename CExprPairwise<NUM>::COMBINE	COMBINE;
+
+	// values uFrom, ..., uFrom + count - 1 of the variable of Reduce to pOut
+	typedef std::function<VOID( size_t uFrom, size_t count, NUM * pOut )>	INDEX;
+
+	virtual ~CExprLazyArgs() {}
+
+	virtual size_t		Count() const PURE;
+	virtual NUM			Value( size_t n ) const PURE;
+
+	// assigns the variable which is argument n, for the functions with efaBinds. The variable
+	// gets its value back when the function returns
+	virtual VOID		Bind( size_t n, const NUM & value ) const
+	{
+		UNREFERENCED_PARAMETER( n );
+		UNREFERENCED_PARAMETER( value );
+		throw CExprParserException( TEXT( "Argument can't be bound" ) );
+	}
+
+	// pairwise combination of argument nArg evaluated with the variable argument nVar bound to
+	// each of the count values of index. Programs may evaluate pure arguments by several
+	// threads and by chunks of values, index and combine must allow it. The result doesn't
+	// depend on the threads
+	virtual NUM			Reduce( size_t nVar, size_t nArg, size_t count, const INDEX & index, const COMBINE & combine, const NUM & empty ) const
+	{
+		CExprPairwise<NUM> pairwise( combine );
+		NUM value;
+		for ( size_t n = 0; n < count; ++n )
+		{
+			index( n, 1, &value );
+			Bind( nVar, value );
+			pairwise.Add( Value( nArg ) );
+		}
+
+		return pairwise.Result( empty );
+	}
+
+	// argument nArg evaluated with the variable argument nVar bound to each of pin[ 0 ], ...,
+	// pin[ count - 1 ]. Programs may evaluate pure arguments by several threads
+	virtual VOID		Map( size_t nVar, size_t nArg, const NUM * pin, NUM * pout, size_t count ) const
+	{
+		for ( size_t n = 0; n < count; ++n )
+		{
+			Bind( nVar, pin[ n ] );
+			pout[ n ] = Value( nArg );
+		}
+	}
+
+	// argument nArg as the program over the slots of the caller, e.g. for CExprDiff. vslot gets
+	// the values of the slots and uVar is the slot of the variable argument nVar, the nodes
+	// evaluated before the call are the constants of prog. FALSE if the arguments aren't
+	// compiled, nVar isn't a variable or argument nArg has lazy nodes
+	virtual BOOL		Extract( size_t nVar, size_t nArg, CExprProgram<NUM> & prog, std::vector<NUM> & vslot, size_t & uVar ) const
+	{
+		UNREFERENCED_PARAMETER( nVar );
+		UNREFERENCED_PARAMETER( nArg );
+		UNREFERENCED_PARAMETER( prog );
+		UNREFERENCED_PARAMETER( vslot );
+		UNREFERENCED_PARAMETER( uVar );
+		return FALSE;
+	}
+
+	NUM					operator[]( size_t n ) const
+	{
+		return Value( n );
+	}
+};
+
+// arguments which are evaluated already, e.g. by the folding or by the native code
+template <class NUM>
+class CExprEagerArgs: public CExprLazyArgs<NUM>
+{
+	const std::vector<NUM> &	m_varg;
+
 public:
-	CExprTokenUn( int prio = -1 )
-		: CExprTokenOperator<std::function<NUM( const NUM& )>>( prio ) {}
+	CExprEagerArgs( const std::vector<NUM> & varg )
+		: m_varg( varg ) {}
+
+	size_t				Count() const
+	{
+		return m_varg.size();
+	}
+
+	NUM					Value( size_t n ) const
+	{
+		return m_varg[ n ];
+	}
 };
 
 template <class NUM>
 class CExprTokenFunc: public CExprToken<std::function<NUM( const std::vector < NUM >& )>>
 {
+public:
+	typedef std::function<NUM( const CExprLazyArgs<NUM> & )>	LAZY;
+
+private:
 	size_t				m_nArgs;
+	std::shared_ptr<LAZY>	m_plazy;		// the same function with the arguments evaluated on demand
 
 public:
 	CExprTokenFunc( size_t nArgs = 0 )
@@ -129,6 +367,16 @@ public:
 	{
 		return m_nArgs;
 	}
+
+	const std::shared_ptr<LAZY> &	Lazy() const
+	{
+		return m_plazy;
+	}
+
+	VOID				SetLazy( const std::shared_ptr<LAZY> & plazy )
+	{
+		m_plazy = plazy;
+	}
 };
 
 template <class NUM>
@@ -147,6 +395,9 @@ struct PARSER_TREE
 	{
 		std::function<NUM( const std::vector<NUM> & )>		func;
 		size_t												nargs;
+		UINT												uAttr;
+		EXPR_COST_CLASS										ecc;
+		std::shared_ptr<typename CExprTokenFunc<NUM>::LAZY>	plazy;
 	} fn;
 
 	PARSER_TREE( size_t _uAtChar = size_t( -1 ) )
@@ -154,6 +405,8 @@ struct PARSER_TREE
 	{
 		fn.nargs = size_t( 0 );
 		fn.func = nullptr;
+		fn.uAttr = 0;
+		fn.ecc = eccCheap;
 	}
 
 	PARSER_TREE( const NUM & _dValue, size_t _uAtChar = size_t( -1 ) )
@@ -161,6 +414,8 @@ struct PARSER_TREE
 	{
 		fn.nargs = size_t( 0 );
 		fn.func = nullptr;
+		fn.uAttr = 0;
+		fn.ecc = eccCheap;
 	}
 
 	PARSER_TREE( const NUM & _dValue, const std::vector<CExprTokenUn<NUM>> & _uPreOp, const std::vector<CExprTokenUn<NUM>> & _uPostOp, size_t _uAtChar = size_t( -1 ) )
@@ -168,6 +423,8 @@ struct PARSER_TREE
 	{
 		fn.nargs = size_t( 0 );
 		fn.func = nullptr;
+		fn.uAttr = 0;
+		fn.ecc = eccCheap;
 	}
 
 	PARSER_TREE( const CExprTokenOp<NUM> & _op, size_t _uAtChar = size_t( -1 ) )
@@ -175,6 +432,8 @@ struct PARSER_TREE
 	{
 		fn.nargs = size_t( 0 );
 		fn.func = nullptr;
+		fn.uAttr = 0;
+		fn.ecc = eccCheap;
 	}
 
 	PARSER_TREE( const CExprTokenFunc<NUM> & _fn, size_t _uAtChar = size_t( -1 ) )
@@ -182,6 +441,9 @@ struct PARSER_TREE
 	{
 		fn.func = _fn.Func();
 		fn.nargs = _fn.Args();
+		fn.uAttr = _fn.Attributes();
+		fn.ecc = _fn.Cost();
+		fn.plazy = _fn.Lazy();
 	}
 
 	PARSER_TREE( const CExprTokenFunc<NUM> & _fn, const std::vector<CExprTokenUn<NUM>> & _uPreOp, const std::vector<CExprTokenUn<NUM>> & _uPostOp, size_t _uAtChar = size_t( -1 ) )
@@ -189,6 +451,9 @@ struct PARSER_TREE
 	{
 		fn.func = _fn.Func();
 		fn.nargs = _fn.Args();
+		fn.uAttr = _fn.Attributes();
+		fn.ecc = _fn.Cost();
+		fn.plazy = _fn.Lazy();
 	}
 };
 
@@ -206,6 +471,15 @@ class CExprParser
 
 	std::vector<PARSER_TREE<NUM>>				m_vop;
 
+	EXPR_LIMITS		m_limits;
+
+	struct
+	{
+		size_t									nSteps;
+		size_t									nLiterals;
+		std::chrono::steady_clock::time_point	tDeadline;
+	} m_governor;
+
 	struct
 	{
 		std::map < BOOL, std::map<CStringOp, CExprTokenUn<NUM>>>	vUnary;
@@ -221,11 +495,154 @@ class CExprParser
 		} unused;
 	} m_token;
 
+	struct
+	{
+		typename CExprMemo<NUM>::HASH								hash;
+		typename CExprMemo<NUM>::EQUAL								equal;
+		std::map<CStringOp, typename CExprMemo<NUM>::FUNC>			mfunc;		// memoized functions before Memoize
+	} m_memo;
+
+	// call of the lazy function in m_vop. Its arguments are skipped by EvaluateRange and
+	// evaluated by the function when it asks for them
+	typedef struct _tagLAZY_CALL
+	{
+		size_t										uFunc;		// index of the function in m_vop
+		size_t										uInner;		// other call which arguments start at the same index, or size_t( -1 )
+		std::vector<std::pair<size_t, size_t>>		vrange;		// [ begin, end ) of each argument in m_vop
+	} LAZY_CALL;
+
+	struct
+	{
+		std::vector<LAZY_CALL>						vcall;
+		std::vector<size_t>							vstart;		// the outermost call which arguments start at the index of m_vop
+	} m_lazy;
+
+	class CLazyArgs: public CExprLazyArgs<NUM>
+	{
+		CExprParser &					m_parser;
+		const LAZY_CALL &				m_call;
+		mutable std::map<CStringOp, NUM>	m_mbound;		// values of the bound variables before the call
+
+	public:
+		CLazyArgs( CExprParser & parser, const LAZY_CALL & call )
+			: m_parser( parser ), m_call( call ) {}
+
+		~CLazyArgs()
+		{
+			for ( const auto & v : m_mbound )
+			{
+				m_parser.m_token.mvarList[ v.first ] = v.second;
+			}
+		}
+
+		size_t			Count() const
+		{
+			return m_call.vrange.size();
+		}
+
+		NUM				Value( size_t n ) const
+		{
+			return m_parser.EvaluateArgument( m_call.vrange[ n ] );
+		}
+
+		VOID			Bind( size_t n, const NUM & value ) const
+		{
+			const auto & range = m_call.vrange[ n ];
+			const PARSER_TREE<NUM> & pt = m_parser.m_vop[ range.first ];
+			auto v = m_parser.m_token.mvarList.find( pt.sVariableId );
+			if ( range.second != range.first + 1 || pt.ett != ettVariable || pt.uPreOp.size() || pt.uPostOp.size() || v == m_parser.m_token.mvarList.end() )
+			{
+				throw CExprParserException( TEXT( "Argument is not a variable" ), pt.uAtChar );
+			}
+
+			m_mbound.insert( std::make_pair( v->first, v->second ) );
+			v->second = value;
+		}
+
+		// the tokens of the argument are compiled as CExprProgram::Build would compile them in
+		// the whole expression, so both give the same program
+		BOOL			Extract( size_t nVar, size_t nArg, CExprProgram<NUM> & prog, std::vector<NUM> & vslot, size_t & uVar ) const
+		{
+			const auto & var = m_call.vrange[ nVar ], & range = m_call.vrange[ nArg ];
+			const PARSER_TREE<NUM> & pt = m_parser.m_vop[ var.first ];
+			if ( var.second != var.first + 1 || pt.ett != ettVariable || pt.uPreOp.size() || pt.uPostOp.size() )
+			{
+				return FALSE;
+			}
+
+			prog.Build( std::vector<PARSER_TREE<NUM>>( m_parser.m_vop.begin() + range.first, m_parser.m_vop.begin() + range.second ) );
+			prog.SetLimits( m_parser.m_limits );
+			uVar = prog.AddSlot( pt.sVariableId );
+
+			vslot.clear();
+			for ( const auto & sName : prog.Slots() )
+			{
+				auto v = m_parser.m_token.mvarList.find( sName );
+				if ( v == m_parser.m_token.mvarList.end() )
+				{
+					return FALSE;
+				}
+
+				vslot.push_back( v->second );
+			}
+
+			return !prog.Lazy();
+		}
+	};
+
+	VOID			StartGovernor()
+	{
+		m_governor.nSteps = 0;
+		m_governor.nLiterals = 0;
+		if ( m_limits.msTimeout.count() > 0 )
+		{
+			m_governor.tDeadline = std::chrono::steady_clock::now() + m_limits.msTimeout;
+		}
+	}
+
+	VOID			CheckDeadline( size_t uAtChar = size_t( -1 ) )
+	{
+		if ( m_limits.pfCancel && m_limits.pfCancel->load( std::memory_order_relaxed ) )
+		{
+			throw CExprParserLimitExceeded( elmCancelled, uAtChar );
+		}
+
+		if ( m_limits.msTimeout.count() > 0 && std::chrono::steady_clock::now() > m_governor.tDeadline )
+		{
+			throw CExprParserLimitExceeded( elmDeadline, uAtChar );
+		}
+	}
+
+	// called for each evaluated token. Clock is polled once per 64 steps only
+	VOID			CheckStep( size_t uAtChar )
+	{
+		m_governor.nSteps++;
+		if ( m_limits.nMaxSteps && m_governor.nSteps > m_limits.nMaxSteps )
+		{
+			throw CExprParserLimitExceeded( elmSteps, uAtChar );
+		}
+
+		if ( m_limits.pfCancel && m_limits.pfCancel->load( std::memory_order_relaxed ) )
+		{
+			throw CExprParserLimitExceeded( elmCancelled, uAtChar );
+		}
+
+		if ( !( m_governor.nSteps & 63 ) && m_limits.msTimeout.count() > 0 && std::chrono::steady_clock::now() > m_governor.tDeadline )
+		{
+			throw CExprParserLimitExceeded( elmDeadline, uAtChar );
+		}
+	}
+
 	VOID			PreParse()
 	{
 		size_t c = m_sExpression.GetLength();
 		CStringOp & s = m_sExpression;
 
+		if ( m_limits.cchMaxExpression && c > m_limits.cchMaxExpression )
+		{
+			throw CExprParserLimitExceeded( elmExpressionLength );
+		}
+
 		int _lBracket = 0;
 
 		for ( size_t i = 0; i < c; ++i )
@@ -234,6 +651,10 @@ class CExprParser
 			if ( chr == m_opLeftBrace )
 			{
 				_lBracket++;
+				if ( m_limits.nMaxNesting && size_t( _lBracket ) > m_limits.nMaxNesting )
+				{
+					throw CExprParserLimitExceeded( elmNesting, i );
+				}
 			}
 			else if ( chr == m_opRightBrace )
 			{
@@ -304,6 +725,9 @@ class CExprParser
 		const CExprTokenFunc<NUM> & func = FindFunc( uAtChar, pt.sVariableId );
 		pt.fn.nargs = func.Args();
 		pt.fn.func = func.Func();
+		pt.fn.uAttr = func.Attributes();
+		pt.fn.ecc = func.Cost();
+		pt.fn.plazy = func.Lazy();
 
 		if ( !IsNextChar( uAtChar, m_opLeftBrace ) || !pt.fn.func )
 		{
@@ -313,7 +737,11 @@ class CExprParser
 				pt.sVariableId = m_sExpression.Mid( uAtChar, uAtNewChar );
 				if ( pt.sVariableId.GetLength() > 0 && pt.fn.func )
 				{
-					AddFunc( pt.sVariableId.GetString(), pt.fn.nargs ) = pt.fn.func;
+					// nothing is known about the functions of IsFunction
+					AddFunc( pt.sVariableId.GetString(), pt.fn.nargs, 0, eccExpensive ) = pt.fn.func;
+					pt.fn.uAttr = 0;
+					pt.fn.ecc = eccExpensive;
+					pt.fn.plazy = nullptr;
 					pt.ett = ettFunc;
 					uAtChar = uAtNewChar;
 					return TRUE;
@@ -432,6 +860,11 @@ class CExprParser
 				throw CExprParserException( TEXT( "Internal error" ) );
 			}
 		}
+		catch ( CExprParserLimitExceeded & e )
+		{
+			UNREFERENCED_PARAMETER( e );
+			throw;
+		}
 		catch ( CExprParserException & e )
 		{
 			throw CExprParserException( e.Message().GetString(), uAtChar );
@@ -523,6 +956,7 @@ class CExprParser
 
 		while ( uAtChar < length )
 		{
+			CheckDeadline( uAtChar );
 			SkipSpaces( uAtChar );
 			pt.uAtChar = uAtChar;
 //			_tprintf(TEXT("Char[%ld] = %c, Expected: %d\n"), uAtChar, m_sExpression[uAtChar], etExpected);
@@ -616,6 +1050,11 @@ class CExprParser
 							UNREFERENCED_PARAMETER( e );
 							etExpected = ettFunc;
 						}
+
+						if ( pt.ett == ettNumber && m_limits.nMaxLiterals && ++m_governor.nLiterals > m_limits.nMaxLiterals )
+						{
+							throw CExprParserLimitExceeded( elmLiterals, pt.uAtChar );
+						}
 						break;
 					}
 				case ettFunc:
@@ -820,6 +1259,11 @@ class CExprParser
 
 	VOID			SortToken( std::vector<PARSER_TREE<NUM>> & tree, std::vector<PARSER_TREE<NUM>> & stack, PARSER_TREE<NUM> & op )
 	{
+		if ( m_limits.nMaxNodes && tree.size() + stack.size() >= m_limits.nMaxNodes )
+		{
+			throw CExprParserLimitExceeded( elmNodes, op.uAtChar );
+		}
+
 		switch ( op.ett )
 		{
 			case ettNumber:
@@ -928,6 +1372,16 @@ class CExprParser
 		return m_sExpression.Mid( uAtChar );
 	}
 
+	// TRUE if the unary operators of the operand may be evaluated at compile time
+	static BOOL		PureOperand( const PARSER_TREE<NUM> & pt )
+	{
+		auto impure = []( const CExprTokenUn<NUM> & un ) { return !un.Pure(); };
+		return ( std::find_if( pt.uPreOp.begin(), pt.uPreOp.end(), impure ) == pt.uPreOp.end() &&
+			std::find_if( pt.uPostOp.begin(), pt.uPostOp.end(), impure ) == pt.uPostOp.end() );
+	}
+
+	// folds the operators and functions which arguments are numbers. Tokens without efaPure
+	// are left for runtime
 	VOID			PreEvaluate()
 	{
 		size_t cop = m_vop.size();
@@ -940,6 +1394,8 @@ class CExprParser
 
 			try
 			{
+				CheckStep( pt.uAtChar );
+
 				switch ( pt.ett )
 				{
 					case ettNumber:
@@ -962,7 +1418,8 @@ class CExprParser
 							auto v = stack.end() - pt.fn.nargs;
 							NUM ev_result;
 							// if one of operand in the stack is not a number, we cannot evaluate this function
-							if ( std::find_if( v, stack.end(), [] ( const auto & pt ) { return pt.ett != ettNumber; } ) == stack.end() )
+							if ( ( pt.fn.uAttr & efaPure ) &&
+								std::find_if( v, stack.end(), [] ( const auto & pt ) { return pt.ett != ettNumber || !PureOperand( pt ); } ) == stack.end() )
 							{
 								std::vector<NUM> args( pt.fn.nargs, 0 );
 								std::generate( 
@@ -991,7 +1448,7 @@ class CExprParser
 								const PARSER_TREE<NUM> p2 = *( stack.rbegin() + 0 );
 								const PARSER_TREE<NUM> p1 = *( stack.rbegin() + 1 );
 
-								if ( p1.ett == ettNumber && p2.ett == ettNumber )
+								if ( p1.ett == ettNumber && p2.ett == ettNumber && pt.op.Pure() && PureOperand( p1 ) && PureOperand( p2 ) )
 								{
 									PARSER_TREE<NUM> result;
 									stack.pop_back();	// remove operands from stack
@@ -1014,6 +1471,11 @@ class CExprParser
 						}
 				}
 			}
+			catch ( CExprParserLimitExceeded & e )
+			{
+				UNREFERENCED_PARAMETER( e );
+				throw;
+			}
 			catch ( CExprParserException & e )
 			{
 				throw CExprParserException( e.Message(), e.AtChar() == size_t( -1 ) ? pt.uAtChar : e.AtChar() );
@@ -1029,17 +1491,105 @@ class CExprParser
 		throw CExprParserNoSuchToken();
 	}
 
-	VOID			EvaluateVars()
+	// change of the stack size made by the token
+	static long		StackEffect( const PARSER_TREE<NUM> & pt )
+	{
+		switch ( pt.ett )
+		{
+			case ettOpToken: return -1;
+			case ettFunc: return 1 - long( pt.fn.nargs );
+			default: return 1;
+		}
+	}
+
+	// finds the arguments of the lazy functions in m_vop. Each argument is the shortest
+	// sequence of tokens before the next argument which leaves one value on the stack
+	VOID			PrepareLazy()
+	{
+		for ( size_t n = 0; n < m_vop.size(); ++n )
+		{
+			const PARSER_TREE<NUM> & pt = m_vop[ n ];
+			if ( pt.ett != ettFunc || !pt.fn.plazy )
+			{
+				continue;
+			}
+
+			if ( !m_lazy.vstart.size() )
+			{
+				m_lazy.vstart.assign( m_vop.size(), size_t( -1 ) );
+			}
+
+			LAZY_CALL call;
+			call.uFunc = n;
+			call.vrange.resize( pt.fn.nargs );
+
+			size_t uEnd = n;
+			for ( size_t k = pt.fn.nargs; k-- > 0; )
+			{
+				size_t uBegin = uEnd;
+				for ( long nNeed = 1; nNeed > 0; nNeed -= StackEffect( m_vop[ uBegin ] ) )
+				{
+					if ( !uBegin-- )
+					{
+						throw CExprParserWrongArguments( pt.fn.nargs, pt.fn.nargs - k - 1, pt.uAtChar );
+					}
+				}
+
+				call.vrange[ k ] = std::make_pair( uBegin, uEnd );
+				uEnd = uBegin;
+			}
+
+			// calls are found from the inner ones
+			call.uInner = m_lazy.vstart[ uEnd ];
+			m_lazy.vstart[ uEnd ] = m_lazy.vcall.size();
+			m_lazy.vcall.push_back( call );
+		}
+	}
+
+	// value of the argument of the lazy function
+	NUM				EvaluateArgument( const std::pair<size_t, size_t> & range )
 	{
-		size_t cop = m_vop.size();
 		std::vector<PARSER_TREE<NUM>> stack;
+		EvaluateRange( range.first, range.second, stack );
 
-		for ( size_t n = 0; n < cop; ++n )
+		if ( stack.size() != 1 )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		NUM dVal;
+		const PARSER_TREE<NUM> & pt = stack.back();
+		return EvaluateOperand( pt, pt.uPreOp, pt.uPostOp, dVal );
+	}
+
+	// evaluates tokens [ uBegin, uEnd ) of m_vop over the stack
+	VOID			EvaluateRange( size_t uBegin, size_t uEnd, std::vector<PARSER_TREE<NUM>> & stack )
+	{
+		for ( size_t n = uBegin; n < uEnd; ++n )
 		{
 			const PARSER_TREE<NUM> & pt = m_vop[ n ];
 
 			try
 			{
+				CheckStep( pt.uAtChar );
+
+				// arguments of the lazy function are left to the function
+				size_t c = ( m_lazy.vstart.size() ? m_lazy.vstart[ n ] : size_t( -1 ) );
+				while ( c != size_t( -1 ) && m_lazy.vcall[ c ].uFunc >= uEnd )
+				{
+					c = m_lazy.vcall[ c ].uInner;
+				}
+
+				if ( c != size_t( -1 ) )
+				{
+					const LAZY_CALL & call = m_lazy.vcall[ c ];
+					const PARSER_TREE<NUM> & fn = m_vop[ call.uFunc ];
+					const CLazyArgs args( *this, call );
+					stack.push_back( PARSER_TREE<NUM>( ( *fn.fn.plazy )( args ), fn.uPreOp, fn.uPostOp, fn.uAtChar ) );
+					n = call.uFunc;
+					continue;
+				}
+
 				switch ( pt.ett )
 				{
 					case ettNumber:
@@ -1122,11 +1672,22 @@ class CExprParser
 						}
 				}
 			}
+			catch ( CExprParserLimitExceeded & e )
+			{
+				UNREFERENCED_PARAMETER( e );
+				throw;
+			}
 			catch ( CExprParserException & e )
 			{
 				throw CExprParserException( e.Message(), e.AtChar() == size_t( -1 ) ? pt.uAtChar : e.AtChar() );
 			}
 		}
+	}
+
+	VOID			EvaluateVars()
+	{
+		std::vector<PARSER_TREE<NUM>> stack;
+		EvaluateRange( 0, m_vop.size(), stack );
 
 		if ( stack.size() > 0 )
 		{
@@ -1150,7 +1711,10 @@ class CExprParser
 		}
 
 		mtok[ psz ] = tok;
-		return mtok.find( psz )->second;
+
+		T & newtok = mtok.find( psz )->second;
+		newtok.TokName() = psz;
+		return newtok;
 	}
 
 	template <class T>
@@ -1173,34 +1737,41 @@ protected:
 			{
 				return vx[ 0 ];
 			};
+		fn.SetAttributes( efaPure | efaRealClosed, eccCheap );
 
 		m_token.vFunc[ TEXT( "" ) ] = fn;
 	}
 
 	virtual ~CExprParser() {}
 
-	std::function<NUM( NUM&, NUM& )> & AddOp( TCHAR u, int prio, EXPR_TOKEN_ASSOC eta = etaLeftOriented ) //, const std::function<NUM( const NUM &, const NUM& )> & expr, int prio )
+	// uAttr - EXPR_FUNC_ATTR flags. Operators without efaPure, including the ones registered without
+	// attributes, are never folded, merged or cached
+	std::function<NUM( NUM&, NUM& )> & AddOp( TCHAR u, int prio, EXPR_TOKEN_ASSOC eta = etaLeftOriented, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccCheap ) //, const std::function<NUM( const NUM &, const NUM& )> & expr, int prio )
 	{
 		CExprTokenOp<NUM> op( prio, eta );
+		op.SetAttributes( uAttr, ecc );
 		return AddToken( u, m_token.vOp, m_token.unused.vEmptyOp, op, TRUE ).TokFunc();
 	}
 
-	std::function<NUM( NUM&, NUM& )> & AddOp( LPCTSTR psz, int prio, EXPR_TOKEN_ASSOC eta = etaLeftOriented ) //, const std::function<NUM( const NUM &, const NUM& )> & expr, int prio )
+	std::function<NUM( NUM&, NUM& )> & AddOp( LPCTSTR psz, int prio, EXPR_TOKEN_ASSOC eta = etaLeftOriented, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccCheap ) //, const std::function<NUM( const NUM &, const NUM& )> & expr, int prio )
 	{
 		CExprTokenOp<NUM> op( prio, eta );
+		op.SetAttributes( uAttr, ecc );
 		return AddToken( psz, m_token.vOp, m_token.unused.vEmptyOp, op, TRUE ).TokFunc();
 	}
 
-	std::function<NUM( const NUM& )> & AddUnaryOp( TCHAR u, BOOL fPrefix, int prio )
+	std::function<NUM( const NUM& )> & AddUnaryOp( TCHAR u, BOOL fPrefix, int prio, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccCheap )
 	{
-		CExprTokenUn<NUM> unop( prio );
+		CExprTokenUn<NUM> unop( prio, !!fPrefix );
+		unop.SetAttributes( uAttr, ecc );
 
 		return AddToken( u, m_token.vUnary[ !!fPrefix ], m_token.unused.vEmptyUOp, unop ).TokFunc();
 	}
 
-	std::function<NUM( const NUM& )> & AddUnaryOp( LPCTSTR psz, BOOL fPrefix, int prio )
+	std::function<NUM( const NUM& )> & AddUnaryOp( LPCTSTR psz, BOOL fPrefix, int prio, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccCheap )
 	{
-		CExprTokenUn<NUM> unop( prio );
+		CExprTokenUn<NUM> unop( prio, !!fPrefix );
+		unop.SetAttributes( uAttr, ecc );
 
 		return AddToken( psz, m_token.vUnary[ !!fPrefix ], m_token.unused.vEmptyUOp, unop ).TokFunc();
 	}
@@ -1212,7 +1783,10 @@ public:
 		std::vector<PARSER_TREE<NUM>> tree;
 		m_sExpression = pszExpression;
 		m_vop.clear();
+		m_lazy.vcall.clear();
+		m_lazy.vstart.clear();
 
+		StartGovernor();
 		PreParse();
 
 		ParseExpression( tree );
@@ -1221,6 +1795,8 @@ public:
 			m_vop = tree;
 			PreEvaluate();
 		}
+
+		PrepareLazy();
 	}
 
 	VOID			Variables( const std::map<size_t, NUM> & mvarList )
@@ -1240,6 +1816,7 @@ public:
 			return FALSE;
 		}
 
+		StartGovernor();
 		EvaluateVars();
 		return TRUE;
 	}
@@ -1249,14 +1826,89 @@ public:
 		d = m_dResult;
 	}
 
+	VOID			SetLimits( const EXPR_LIMITS & limits )
+	{
+		m_limits = limits;
+	}
+
+	const EXPR_LIMITS &	Limits() const
+	{
+		return m_limits;
+	}
+
+	// RPN of the last compiled expression
+	const std::vector<PARSER_TREE<NUM>> &	Tree() const
+	{
+		return m_vop;
+	}
+
 
 
-	std::function<NUM( const std::vector<NUM>& )> & AddFunc( LPCTSTR pszName, size_t nArgsCount )
+	// uAttr - EXPR_FUNC_ATTR flags. Functions without efaPure are called on each evaluation,
+	// e.g. random numbers or time
+	std::function<NUM( const std::vector<NUM>& )> & AddFunc( LPCTSTR pszName, size_t nArgsCount, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccElementary )
 	{
 		CExprTokenFunc<NUM> fn( nArgsCount );
+		fn.SetAttributes( uAttr, ecc );
 		return AddToken( pszName, m_token.vFunc, m_token.unused.vEmptyFunc, fn ).TokFunc();
 	}
 
+	// function which evaluates its arguments on demand: args[ n ] evaluates argument n each
+	// time it is called, so conditionals skip the branches they don't take. The callers which
+	// have the values already, e.g. the folding, call it through CExprEagerArgs
+	typename CExprTokenFunc<NUM>::LAZY &	AddLazyFunc( LPCTSTR pszName, size_t nArgsCount, UINT uAttr = 0, EXPR_COST_CLASS ecc = eccCheap )
+	{
+		std::shared_ptr<typename CExprTokenFunc<NUM>::LAZY> plazy( new typename CExprTokenFunc<NUM>::LAZY() );
+		CExprTokenFunc<NUM> fn( nArgsCount );
+		fn.SetAttributes( uAttr, ecc );
+		fn.SetLazy( plazy );
+		fn.TokFunc() = [ plazy ]( const std::vector<NUM> & varg ) { return ( *plazy )( CExprEagerArgs<NUM>( varg ) ); };
+
+		AddToken( pszName, m_token.vFunc, m_token.unused.vEmptyFunc, fn );
+		return *plazy;
+	}
+
+	// hash and equality of the arguments of the memoized functions, see Memoize
+	typename CExprMemo<NUM>::HASH &		MemoHashFunc()
+	{
+		return m_memo.hash;
+	}
+
+	typename CExprMemo<NUM>::EQUAL &	MemoEqualFunc()
+	{
+		return m_memo.equal;
+	}
+
+	// caches up to nCapacity results of the function in the programs and expressions compiled
+	// afterwards. Returns the cache for its counters, or nullptr if the function isn't pure,
+	// isn't registered, is lazy, or the parser has no MemoHashFunc. nCapacity = 0 removes the cache
+	std::shared_ptr<CExprMemo<NUM>>	Memoize( LPCTSTR pszName, size_t nCapacity )
+	{
+		auto v = m_token.vFunc.find( pszName );
+		if ( v == m_token.vFunc.end() || !v->second.Pure() || v->second.Lazy() || !m_memo.hash || !m_memo.equal )
+		{
+			return nullptr;
+		}
+
+		auto vorig = m_memo.mfunc.find( pszName );
+		if ( vorig == m_memo.mfunc.end() )
+		{
+			vorig = m_memo.mfunc.insert( std::make_pair( CStringOp( pszName ), v->second.Func() ) ).first;
+		}
+
+		const typename CExprMemo<NUM>::FUNC fn = vorig->second;
+		if ( !nCapacity )
+		{
+			v->second.TokFunc() = fn;
+			m_memo.mfunc.erase( vorig );
+			return nullptr;
+		}
+
+		std::shared_ptr<CExprMemo<NUM>> pmemo( new CExprMemo<NUM>( nCapacity, m_memo.hash, m_memo.equal ) );
+		v->second.TokFunc() = [ pmemo, fn ]( const std::vector<NUM> & varg ) { return pmemo->Call( fn, varg ); };
+		return pmemo;
+	}
+
 	BOOL			AddVariable( LPCTSTR vId, const NUM & value )
 	{
 		m_token.mvarList[ vId ] = value;
@@ -1284,6 +1936,31 @@ public:
 		return FALSE;
 	}
 
+	// registered tokens by name, nullptr if there is no such token
+	const CExprTokenOp<NUM> *	GetOp( LPCTSTR pszName ) const
+	{
+		auto v = m_token.vOp.find( pszName );
+		return ( v != m_token.vOp.end() ? &v->second : nullptr );
+	}
+
+	const CExprTokenUn<NUM> *	GetUnaryOp( LPCTSTR pszName, BOOL fPrefix ) const
+	{
+		auto vmap = m_token.vUnary.find( !!fPrefix );
+		if ( vmap == m_token.vUnary.end() )
+		{
+			return nullptr;
+		}
+
+		auto v = vmap->second.find( pszName );
+		return ( v != vmap->second.end() ? &v->second : nullptr );
+	}
+
+	const CExprTokenFunc<NUM> *	GetFunc( LPCTSTR pszName ) const
+	{
+		auto v = m_token.vFunc.find( pszName );
+		return ( v != m_token.vFunc.end() ? &v->second : nullptr );
+	}
+
 	BOOL GetVariable( size_t vId, NUM & value )
 	{
 		return GetVariable( CStringOp().Format( TEXT( "%ld" ), vId ).GetString(), value );
@@ -1301,3 +1978,5 @@ public:
 	}
 };
 
+// CExprParser::CLazyArgs::Extract compiles the arguments
+#include "CExprProgram.h"
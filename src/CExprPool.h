@@ -0,0 +1,161 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Persistent threads for the ranges of CExprLazyArgs::Reduce and Map. The threads are started
+   on the first use and wait for the tasks; the caller of Run takes the tasks too */
+
+#pragma once
+
+#include "w32def.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class CExprPool
+{
+	typedef struct _tagPOOL_JOB
+	{
+		std::function<VOID( size_t t )>	fn;
+		size_t							nTasks;
+		size_t							uNext;		// next task to take
+		size_t							nDone;
+	} POOL_JOB;
+
+	std::mutex							m_mx;
+	std::condition_variable				m_cvWork;
+	std::condition_variable				m_cvDone;
+	std::deque<std::shared_ptr<POOL_JOB>>	m_qjob;			// jobs which have tasks to take
+	std::vector<std::thread>			m_vthread;
+	BOOL								m_fStop;
+
+	CExprPool() : m_fStop( FALSE ) {}
+	CExprPool( const CExprPool & );
+	CExprPool & operator=( const CExprPool & );
+
+	// takes the next task of the job, m_mx must be locked
+	BOOL				Take( const std::shared_ptr<POOL_JOB> & pjob, size_t & t )
+	{
+		if ( pjob->uNext >= pjob->nTasks )
+		{
+			return FALSE;
+		}
+
+		t = pjob->uNext++;
+		if ( pjob->uNext == pjob->nTasks )
+		{
+			for ( auto it = m_qjob.begin(); it != m_qjob.end(); ++it )
+			{
+				if ( *it == pjob )
+				{
+					m_qjob.erase( it );
+					break;
+				}
+			}
+		}
+
+		return TRUE;
+	}
+
+	VOID				Complete( const std::shared_ptr<POOL_JOB> & pjob )
+	{
+		std::lock_guard<std::mutex> lock( m_mx );
+		if ( ++pjob->nDone == pjob->nTasks )
+		{
+			m_cvDone.notify_all();
+		}
+	}
+
+	VOID				Work()
+	{
+		std::unique_lock<std::mutex> lock( m_mx );
+		for ( ;; )
+		{
+			m_cvWork.wait( lock, [ this ] { return m_fStop || !m_qjob.empty(); } );
+			if ( m_fStop )
+			{
+				return;
+			}
+
+			const std::shared_ptr<POOL_JOB> pjob = m_qjob.front();
+			size_t t = 0;
+			Take( pjob, t );
+			lock.unlock();
+			pjob->fn( t );
+			Complete( pjob );
+			lock.lock();
+		}
+	}
+
+public:
+	~CExprPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mx );
+			m_fStop = TRUE;
+		}
+
+		m_cvWork.notify_all();
+		for ( auto & thread : m_vthread )
+		{
+			thread.join();
+		}
+	}
+
+	static CExprPool &	Instance()
+	{
+		static CExprPool pool;
+		return pool;
+	}
+
+	// calls fn( t ) for t in [ 0, nTasks ) on the threads of the pool and on the calling one,
+	// returns when all the calls have returned. fn must not throw. The pool grows to nTasks - 1
+	// threads and keeps them; tasks which find no free thread are taken by the caller
+	VOID				Run( size_t nTasks, const std::function<VOID( size_t t )> & fn )
+	{
+		if ( !nTasks )
+		{
+			return;
+		}
+
+		const std::shared_ptr<POOL_JOB> pjob( new POOL_JOB );
+		pjob->fn = fn;
+		pjob->nTasks = nTasks;
+		pjob->uNext = 0;
+		pjob->nDone = 0;
+
+		std::unique_lock<std::mutex> lock( m_mx );
+		while ( m_vthread.size() + 1 < nTasks )
+		{
+			m_vthread.push_back( std::thread( [ this ] { Work(); } ) );
+		}
+
+		m_qjob.push_back( pjob );
+		m_cvWork.notify_all();
+
+		for ( size_t t; Take( pjob, t ); )
+		{
+			lock.unlock();
+			fn( t );
+			Complete( pjob );
+			lock.lock();
+		}
+
+		m_cvDone.wait( lock, [ &pjob ] { return pjob->nDone == pjob->nTasks; } );
+	}
+};
@@ -0,0 +1,136 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Value profiles of the program slots: how often the values are real, integer, non-negative or the same */
+
+#pragma once
+
+#include "CExprOptimizer.h"
+#include <memory>
+
+template <class NUM>
+class CExprProfile
+{
+	typedef struct _tagSLOT_PROFILE
+	{
+		std::atomic<size_t>		nValue;
+		std::atomic<size_t>		nReal;
+		std::atomic<size_t>		nInteger;
+		std::atomic<size_t>		nNonNegative;
+		std::atomic<size_t>		nSame;			// equal to the first value
+		std::atomic<int>		nState;			// 0 - no first value, 1 - it is being stored, 2 - stored
+		NUM						first;
+	} SLOT_PROFILE;
+
+	std::unique_ptr<SLOT_PROFILE[]>		m_vslot;
+	size_t								m_nslots;
+	std::atomic<size_t>					m_nSamples;
+	const CExprOptimizer<NUM> &			m_opt;
+
+	CExprProfile( const CExprProfile & );
+	CExprProfile & operator=( const CExprProfile & );
+
+	BOOL				Holds( size_t n, double dRatio ) const
+	{
+		const size_t nSamples = m_nSamples.load( std::memory_order_relaxed );
+		return ( nSamples && n >= dRatio * nSamples );
+	}
+
+public:
+	// opt gives the classification of values and must outlive the profile
+	CExprProfile( size_t nslots, const CExprOptimizer<NUM> & opt )
+		: m_vslot( new SLOT_PROFILE[ nslots ] ), m_nslots( nslots ), m_nSamples( 0 ), m_opt( opt )
+	{
+		for ( size_t u = 0; u < nslots; ++u )
+		{
+			SLOT_PROFILE & slot = m_vslot[ u ];
+			slot.nValue = slot.nReal = slot.nInteger = slot.nNonNegative = slot.nSame = 0;
+			slot.nState = 0;
+		}
+	}
+
+	// may be called by several threads at once
+	VOID				Record( const NUM * pSlots )
+	{
+		for ( size_t u = 0; u < m_nslots; ++u )
+		{
+			SLOT_PROFILE & slot = m_vslot[ u ];
+			const UINT uKind = m_opt.Classify( pSlots[ u ] );
+
+			if ( uKind & evkValue ) slot.nValue.fetch_add( 1, std::memory_order_relaxed );
+			if ( uKind & evkReal ) slot.nReal.fetch_add( 1, std::memory_order_relaxed );
+			if ( uKind & evkInteger ) slot.nInteger.fetch_add( 1, std::memory_order_relaxed );
+			if ( uKind & evkNonNegative ) slot.nNonNegative.fetch_add( 1, std::memory_order_relaxed );
+
+			int nState = slot.nState.load( std::memory_order_acquire );
+			if ( !nState && slot.nState.compare_exchange_strong( nState, 1, std::memory_order_acquire ) )
+			{
+				slot.first = pSlots[ u ];
+				slot.nState.store( 2, std::memory_order_release );
+				slot.nSame.fetch_add( 1, std::memory_order_relaxed );
+			}
+			else if ( nState == 2 && m_opt.Equal( slot.first, pSlots[ u ] ) )
+			{
+				slot.nSame.fetch_add( 1, std::memory_order_relaxed );
+			}
+		}
+
+		m_nSamples.fetch_add( 1, std::memory_order_relaxed );
+	}
+
+	size_t				Samples() const
+	{
+		return m_nSamples.load( std::memory_order_relaxed );
+	}
+
+	// EXPR_VALUE_KIND flags which at least dRatio of the samples have
+	UINT				Kind( size_t uSlot, double dRatio ) const
+	{
+		const SLOT_PROFILE & slot = m_vslot[ uSlot ];
+		UINT uKind = 0;
+
+		if ( Holds( slot.nValue.load( std::memory_order_relaxed ), dRatio ) ) uKind |= evkValue;
+		if ( Holds( slot.nReal.load( std::memory_order_relaxed ), dRatio ) ) uKind |= evkReal;
+		if ( Holds( slot.nInteger.load( std::memory_order_relaxed ), dRatio ) ) uKind |= evkInteger;
+		if ( Holds( slot.nNonNegative.load( std::memory_order_relaxed ), dRatio ) ) uKind |= evkNonNegative;
+		return uKind;
+	}
+
+	// the first recorded value of the slot, FALSE if there is none yet
+	BOOL				First( size_t uSlot, NUM & value ) const
+	{
+		const SLOT_PROFILE & slot = m_vslot[ uSlot ];
+		if ( slot.nState.load( std::memory_order_acquire ) != 2 )
+		{
+			return FALSE;
+		}
+
+		value = slot.first;
+		return TRUE;
+	}
+
+	// TRUE if at least dRatio of the samples are equal to value
+	BOOL				Constant( size_t uSlot, double dRatio, NUM & value ) const
+	{
+		const SLOT_PROFILE & slot = m_vslot[ uSlot ];
+		if ( slot.nState.load( std::memory_order_acquire ) != 2 || !Holds( slot.nSame.load( std::memory_order_relaxed ), dRatio ) )
+		{
+			return FALSE;
+		}
+
+		value = slot.first;
+		return TRUE;
+	}
+};
@@ -0,0 +1,1443 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compiled program: RPN of the parser lowered to the list of nodes */
+
+#pragma once
+
+#include "CExprParserTemplate.h"
+#include "CExprPool.h"
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// ranges of CExprLazyArgs::Reduce are split into blocks of 2^REDUCE_BLOCK_LEVEL values, and
+// evaluated by several threads if there are REDUCE_PARALLEL_BLOCKS blocks at least, at most
+// REDUCE_PART_BLOCKS blocks at once. The same for the values of CExprLazyArgs::Map. Pure
+// bodies are evaluated by chunks of 2^REDUCE_CHUNK_LEVEL values, see CExprProgram::Lanes
+#define REDUCE_BLOCK_LEVEL		10
+#define REDUCE_CHUNK_LEVEL		6
+#define REDUCE_PARALLEL_BLOCKS	16
+#define REDUCE_PART_BLOCKS		65536
+#define MAP_BLOCK_LEVEL			6
+#define MAP_PARALLEL_BLOCKS		8
+
+// steps of Execute which each thread counts before it adds them to the shared count and polls
+// the cancellation flag and the clock of EXPR_LIMITS
+#define EXPR_POLL_STEPS			64
+
+typedef enum _tagEXPR_ARG_TYPE
+{
+	eatConst,		// constant from the pool of the program
+	eatSlot,		// variable slot. Its value is read when the owner node is evaluated
+	eatNode			// result of the previous node
+} EXPR_ARG_TYPE, *PEXPR_ARG_TYPE;
+
+typedef struct _tagEXPR_ARG
+{
+	EXPR_ARG_TYPE			eat;
+	size_t					u;
+
+	constexpr _tagEXPR_ARG( EXPR_ARG_TYPE _eat = eatConst, size_t _u = 0 )
+		: eat( _eat ), u( _u ) {}
+
+	bool operator==( const _tagEXPR_ARG & arg ) const
+	{
+		return ( eat == arg.eat && u == arg.u );
+	}
+
+	bool operator!=( const _tagEXPR_ARG & arg ) const
+	{
+		return !operator==( arg );
+	}
+} EXPR_ARG, *PEXPR_ARG;
+
+typedef enum _tagEXPR_NODE_TYPE
+{
+	entUnary,
+	entBinary,
+	entFunc
+} EXPR_NODE_TYPE, *PEXPR_NODE_TYPE;
+
+typedef struct _tagEXPR_NODE
+{
+	EXPR_NODE_TYPE			ent;
+	size_t					uToken;		// index in the token table of the node type
+	std::vector<EXPR_ARG>	varg;
+	size_t					uAtChar;
+
+	_tagEXPR_NODE( EXPR_NODE_TYPE _ent = entFunc, size_t _uToken = 0, size_t _uAtChar = size_t( -1 ) )
+		: ent( _ent ), uToken( _uToken ), uAtChar( _uAtChar ) {}
+} EXPR_NODE, *PEXPR_NODE;
+
+// Nodes are stored in the order of evaluation, so each node refers to the previous ones only.
+// The lowering keeps the semantic of CExprParser::EvaluateVars: unary operators are applied
+// when operand is consumed, and variables are passed to the binary operators by reference
+template <class NUM>
+class CExprProgram
+{
+	std::vector<EXPR_NODE>				m_vnode;
+	std::vector<NUM>					m_vconst;
+	std::vector<CStringOp>				m_vslot;
+	std::vector<CExprTokenUn<NUM>>		m_vun;
+	std::vector<CExprTokenOp<NUM>>		m_vop;
+	std::vector<CExprTokenFunc<NUM>>	m_vfunc;
+	EXPR_ARG							m_result;
+	EXPR_LIMITS							m_limits;
+
+public:
+	// fused function of two binary operators, see Fuse
+	typedef std::function<NUM( NUM&, NUM&, NUM& )>	FUSED;
+
+private:
+	// superinstruction: node uNode and the next one are executed at once
+	typedef struct _tagSUPER
+	{
+		size_t							uNode;
+		size_t							uArg;		// argument of the next node which is the result of uNode
+		FUSED							fused;
+	} SUPER;
+
+	std::vector<SUPER>					m_vsuper;	// ordered by uNode
+
+	// nodes of the arguments of the lazy functions. Context 0 is the program, context
+	// vfirst[ u ] + n is argument n of the lazy node u. Node belongs to the innermost context
+	// which encloses all of its uses, so it is evaluated only when that context is
+	typedef struct _tagLAZY_PLAN
+	{
+		std::vector<size_t>					vowner;		// context of each node
+		std::vector<size_t>					vfirst;		// first context of each lazy node, size_t( -1 ) for others
+		std::vector<std::vector<size_t>>	vnodes;		// nodes of each context in order of evaluation
+		std::vector<BOOL>					vpure;		// nodes of the context and of the contexts in it are pure
+	} LAZY_PLAN;
+
+	// pure context of the lazy argument compiled for the block loop, see Lanes. Row 0 of the
+	// chunk is the variable, row n + 1 is the node vnode[ n ] and the last row is the result
+	// which isn't a row. Arguments out of the context are the same for all the lanes, their
+	// uRow is size_t( -1 )
+	typedef struct _tagLANE_ARG
+	{
+		EXPR_ARG						arg;
+		size_t							uRow;
+	} LANE_ARG;
+
+	typedef struct _tagBLOCK
+	{
+		std::vector<size_t>					vnode;
+		std::vector<std::vector<LANE_ARG>>	varg;		// arguments of each node
+		LANE_ARG							result;
+	} BLOCK;
+
+	// plan made by the first Execute after the nodes were changed. Copies start without plan
+	class CPlanCache
+	{
+		std::mutex							m_lock;
+		std::atomic<int>					m_state;	// 0 - not made, 1 - no lazy nodes, 2 - m_pplan
+		std::shared_ptr<const LAZY_PLAN>	m_pplan;
+
+	public:
+		CPlanCache()
+			: m_state( 0 ) {}
+
+		CPlanCache( const CPlanCache & )
+			: m_state( 0 ) {}
+
+		CPlanCache & operator=( const CPlanCache & )
+		{
+			Reset();
+			return *this;
+		}
+
+		VOID			Reset()
+		{
+			m_state = 0;
+			m_pplan = nullptr;
+		}
+
+		// nullptr if the program has no lazy nodes
+		template <class MAKE>
+		const LAZY_PLAN *	Get( const MAKE & make )
+		{
+			int state = m_state.load( std::memory_order_acquire );
+			if ( !state )
+			{
+				std::lock_guard<std::mutex> guard( m_lock );
+				state = m_state.load( std::memory_order_relaxed );
+				if ( !state )
+				{
+					m_pplan = make();
+					state = ( m_pplan ? 2 : 1 );
+					m_state.store( state, std::memory_order_release );
+				}
+			}
+
+			return ( state == 2 ? m_pplan.get() : nullptr );
+		}
+	};
+
+	mutable CPlanCache					m_plan;
+
+	typedef struct _tagOPERAND
+	{
+		EXPR_ARG						arg;
+		std::vector<CExprTokenUn<NUM>>	uPreOp;
+		std::vector<CExprTokenUn<NUM>>	uPostOp;
+	} OPERAND;
+
+	template <class T>
+	size_t			TokenIndex( std::vector<T> & vtok, const T & tok )
+	{
+		auto v = std::find_if( vtok.begin(), vtok.end(), [ &tok ]( const T & t ) { return t.Name() == tok.Name(); } );
+		if ( v != vtok.end() )
+		{
+			return v - vtok.begin();
+		}
+
+		vtok.push_back( tok );
+		return vtok.size() - 1;
+	}
+
+	size_t			UnaryIndex( const CExprTokenUn<NUM> & tok )
+	{
+		// prefix and postfix operators may share the name
+		auto v = std::find_if( m_vun.begin(), m_vun.end(), [ &tok ]( const CExprTokenUn<NUM> & t ) { return t.Name() == tok.Name() && t.Prefix() == tok.Prefix(); } );
+		if ( v != m_vun.end() )
+		{
+			return v - m_vun.begin();
+		}
+
+		m_vun.push_back( tok );
+		return m_vun.size() - 1;
+	}
+
+	EXPR_ARG		Emit( EXPR_NODE_TYPE ent, size_t uToken, const std::vector<EXPR_ARG> & varg, size_t uAtChar )
+	{
+		EXPR_NODE node( ent, uToken, uAtChar );
+		node.varg = varg;
+		m_vnode.push_back( node );
+		m_plan.Reset();
+		return EXPR_ARG( eatNode, m_vnode.size() - 1 );
+	}
+
+	// the same as CExprParser::EvaluateOperand, but emits nodes instead of evaluation
+	template <class IT>
+	EXPR_ARG		Operand( const OPERAND & op, IT preBegin, IT preEnd, size_t uAtChar )
+	{
+		EXPR_ARG arg = op.arg;
+
+		for ( const auto & v : op.uPostOp )
+			arg = Emit( entUnary, UnaryIndex( v ), { arg }, uAtChar );
+
+		// reverse order for prefix operands
+		while ( preEnd != preBegin )
+		{
+			--preEnd;
+			arg = Emit( entUnary, UnaryIndex( *preEnd ), { arg }, uAtChar );
+		}
+
+		return arg;
+	}
+
+	EXPR_ARG		Operand( const OPERAND & op, size_t uAtChar )
+	{
+		return Operand( op, op.uPreOp.begin(), op.uPreOp.end(), uAtChar );
+	}
+
+	// limits of one Execute, shared by the threads of its ranges. Threads add their steps
+	// here once per EXPR_POLL_STEPS at most, so each may exceed nMaxSteps by less than that
+	class CGovernor
+	{
+		const EXPR_LIMITS &						m_limits;
+		std::atomic<size_t>						m_nSteps;
+		std::chrono::steady_clock::time_point	m_tDeadline;
+
+	public:
+		CGovernor( const EXPR_LIMITS & limits )
+			: m_limits( limits ), m_nSteps( 0 )
+		{
+			if ( limits.msTimeout.count() > 0 )
+			{
+				m_tDeadline = std::chrono::steady_clock::now() + limits.msTimeout;
+			}
+		}
+
+		BOOL			Active() const
+		{
+			return ( m_limits.nMaxSteps || m_limits.msTimeout.count() > 0 || m_limits.pfCancel );
+		}
+
+		// adds the steps of the thread, returns the steps before its next poll
+		size_t			Poll( size_t nSteps, size_t uAtChar )
+		{
+			const size_t nTotal = m_nSteps.fetch_add( nSteps, std::memory_order_relaxed ) + nSteps;
+			if ( m_limits.nMaxSteps && nTotal > m_limits.nMaxSteps )
+			{
+				throw CExprParserLimitExceeded( elmSteps, uAtChar );
+			}
+
+			if ( m_limits.pfCancel && m_limits.pfCancel->load( std::memory_order_relaxed ) )
+			{
+				throw CExprParserLimitExceeded( elmCancelled, uAtChar );
+			}
+
+			if ( m_limits.msTimeout.count() > 0 && std::chrono::steady_clock::now() > m_tDeadline )
+			{
+				throw CExprParserLimitExceeded( elmDeadline, uAtChar );
+			}
+
+			return ( m_limits.nMaxSteps ? std::min<size_t>( EXPR_POLL_STEPS, m_limits.nMaxSteps - nTotal + 1 ) : EXPR_POLL_STEPS );
+		}
+	};
+
+	// scratch memory of the executor. One frame per nesting level of Execute, so
+	// the evaluation doesn't allocate after the first call in the thread
+	typedef struct _tagFRAME
+	{
+		std::vector<NUM>				vval;		// results of the nodes
+		std::vector<NUM>				vtmp;		// copies of constants passed to binary operators
+		std::vector<NUM>				vargs;		// arguments of the functions
+		std::vector<NUM>				vlane;		// rows of the chunk, see Lanes
+		CGovernor *						pgov;		// nullptr if no limits are set
+		size_t							nSteps;		// steps since the last poll
+		size_t							nPoll;		// steps of the next poll, 0 - never
+	} FRAME;
+
+	class CFrame
+	{
+		static std::deque<FRAME> &		Frames()
+		{
+			static thread_local std::deque<FRAME> vframes;
+			return vframes;
+		}
+
+		static size_t &					Depth()
+		{
+			static thread_local size_t nDepth = 0;
+			return nDepth;
+		}
+
+	public:
+		FRAME &							frame;
+
+		CFrame()
+			: frame( ( Frames().size() <= Depth() ? Frames().emplace_back() : Frames()[ Depth() ] ) )
+		{
+			Depth()++;
+		}
+
+		~CFrame()
+		{
+			Depth()--;
+		}
+	};
+
+	static VOID		Govern( FRAME & frame, CGovernor & gov, size_t uAtChar )
+	{
+		frame.pgov = ( gov.Active() ? &gov : nullptr );
+		frame.nSteps = 0;
+		frame.nPoll = ( frame.pgov ? gov.Poll( 0, uAtChar ) : 0 );
+	}
+
+	// counts the evaluation of the node or of the argument of the lazy node
+	static VOID		Step( FRAME & frame, size_t uAtChar )
+	{
+		if ( ++frame.nSteps == frame.nPoll )
+		{
+			frame.nPoll = frame.pgov->Poll( frame.nSteps, uAtChar );
+			frame.nSteps = 0;
+		}
+	}
+
+	// position of argument n of the node for the limits: of the node which gives it, or of the
+	// node itself for the constants and the slots
+	size_t			ArgChar( const EXPR_NODE & node, size_t n ) const
+	{
+		const EXPR_ARG & arg = node.varg[ n ];
+		return ( arg.eat == eatNode && m_vnode[ arg.u ].uAtChar != size_t( -1 ) ? m_vnode[ arg.u ].uAtChar : node.uAtChar );
+	}
+
+	const NUM &		Value( const EXPR_ARG & arg, const NUM * pSlots, const FRAME & frame ) const
+	{
+		switch ( arg.eat )
+		{
+			case eatConst: return m_vconst[ arg.u ];
+			case eatSlot: return pSlots[ arg.u ];
+			default: return frame.vval[ arg.u ];
+		}
+	}
+
+	// binary operators take arguments by reference, so variables may be assigned
+	NUM &			Reference( const EXPR_ARG & arg, NUM * pSlots, FRAME & frame, size_t uTmp ) const
+	{
+		switch ( arg.eat )
+		{
+			case eatConst: return ( frame.vtmp[ uTmp ] = m_vconst[ arg.u ] );
+			case eatSlot: return pSlots[ arg.u ];
+			default: return frame.vval[ arg.u ];
+		}
+	}
+
+	// result of the node. pArg, if given, is the value of its argument uArg
+	NUM				Compute( const EXPR_NODE & node, NUM * pSlots, FRAME & frame, NUM * pArg = nullptr, size_t uArg = 0 ) const
+	{
+		switch ( node.ent )
+		{
+			case entUnary:
+				{
+					return m_vun[ node.uToken ].Func()( pArg ? *pArg : Value( node.varg[ 0 ], pSlots, frame ) );
+				}
+			case entBinary:
+				{
+					NUM & a = ( pArg && uArg == 0 ? *pArg : Reference( node.varg[ 0 ], pSlots, frame, 0 ) );
+					NUM & b = ( pArg && uArg == 1 ? *pArg : Reference( node.varg[ 1 ], pSlots, frame, 1 ) );
+					return m_vop[ node.uToken ].Func()( a, b );
+				}
+			default:
+				{
+					frame.vargs.resize( node.varg.size() );
+					for ( size_t n = 0; n < node.varg.size(); ++n )
+					{
+						frame.vargs[ n ] = ( pArg && uArg == n ? *pArg : Value( node.varg[ n ], pSlots, frame ) );
+					}
+
+					return m_vfunc[ node.uToken ].Func()( frame.vargs );
+				}
+		}
+	}
+
+	std::shared_ptr<const LAZY_PLAN>	MakePlan() const
+	{
+		const size_t cnode = m_vnode.size();
+		std::shared_ptr<LAZY_PLAN> pplan( new LAZY_PLAN );
+		std::vector<size_t> vparent( 1, size_t( -1 ) ), vdepth( 1, 0 );
+
+		pplan->vfirst.assign( cnode, size_t( -1 ) );
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			if ( m_vnode[ u ].ent == entFunc && m_vfunc[ m_vnode[ u ].uToken ].Lazy() )
+			{
+				pplan->vfirst[ u ] = vparent.size();
+				vparent.resize( vparent.size() + m_vnode[ u ].varg.size() );
+				vdepth.resize( vparent.size() );
+			}
+		}
+
+		if ( vparent.size() == 1 )
+		{
+			return nullptr;
+		}
+
+		auto common = [ &vparent, &vdepth ]( size_t a, size_t b )
+		{
+			while ( vdepth[ a ] > vdepth[ b ] ) a = vparent[ a ];
+			while ( vdepth[ b ] > vdepth[ a ] ) b = vparent[ b ];
+			while ( a != b )
+			{
+				a = vparent[ a ];
+				b = vparent[ b ];
+			}
+
+			return a;
+		};
+
+		// uses come after the node, so its context is known when the node is reached.
+		// Result and the nodes which results aren't used belong to the program
+		std::vector<size_t> & vowner = pplan->vowner;
+		vowner.assign( cnode, size_t( -1 ) );
+		if ( m_result.eat == eatNode )
+		{
+			vowner[ m_result.u ] = 0;
+		}
+
+		for ( size_t u = cnode; u-- > 0; )
+		{
+			if ( vowner[ u ] == size_t( -1 ) )
+			{
+				vowner[ u ] = 0;
+			}
+
+			const EXPR_NODE & node = m_vnode[ u ];
+			const size_t uFirst = pplan->vfirst[ u ];
+			for ( size_t n = 0; n < node.varg.size(); ++n )
+			{
+				size_t uContext = vowner[ u ];
+				if ( uFirst != size_t( -1 ) )
+				{
+					uContext = uFirst + n;
+					vparent[ uContext ] = vowner[ u ];
+					vdepth[ uContext ] = vdepth[ vowner[ u ] ] + 1;
+				}
+
+				const EXPR_ARG & arg = node.varg[ n ];
+				if ( arg.eat == eatNode )
+				{
+					vowner[ arg.u ] = ( vowner[ arg.u ] == size_t( -1 ) ? uContext : common( vowner[ arg.u ], uContext ) );
+				}
+			}
+		}
+
+		pplan->vnodes.resize( vparent.size() );
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			pplan->vnodes[ vowner[ u ] ].push_back( u );
+		}
+
+		// contexts of the inner lazy nodes come first
+		pplan->vpure.assign( vparent.size(), TRUE );
+		for ( size_t c = 0; c < vparent.size(); ++c )
+		{
+			for ( const size_t u : pplan->vnodes[ c ] )
+			{
+				pplan->vpure[ c ] = pplan->vpure[ c ] && ( Attributes( m_vnode[ u ] ) & efaPure );
+				for ( size_t n = 0; pplan->vfirst[ u ] != size_t( -1 ) && n < m_vnode[ u ].varg.size(); ++n )
+				{
+					pplan->vpure[ c ] = pplan->vpure[ c ] && pplan->vpure[ pplan->vfirst[ u ] + n ];
+				}
+			}
+		}
+
+		return pplan;
+	}
+
+	const LAZY_PLAN *	Plan() const
+	{
+		return m_plan.Get( [ this ]() { return MakePlan(); } );
+	}
+
+	// evaluates the nodes of the context. uNode is the node being evaluated, for the errors
+	VOID			Run( const LAZY_PLAN & plan, size_t uContext, NUM * pSlots, FRAME & frame, size_t & uNode ) const
+	{
+		for ( const size_t u : plan.vnodes[ uContext ] )
+		{
+			uNode = u;
+			Step( frame, m_vnode[ u ].uAtChar );
+			if ( plan.vfirst[ u ] == size_t( -1 ) )
+			{
+				frame.vval[ u ] = Compute( m_vnode[ u ], pSlots, frame );
+				continue;
+			}
+
+			const CLazyArgs args( *this, plan, u, pSlots, frame, uNode );
+			frame.vval[ u ] = ( *m_vfunc[ m_vnode[ u ].uToken ].Lazy() )( args );
+		}
+	}
+
+	// block of the context of the argument which variable is slot uVar. FALSE if the context
+	// isn't pure or has lazy nodes
+	BOOL			MakeBlock( const LAZY_PLAN & plan, size_t uContext, size_t uVar, const EXPR_ARG & result, BLOCK & block ) const
+	{
+		std::vector<size_t> vrow( m_vnode.size(), size_t( -1 ) );
+		auto lane = [ &vrow, uVar ]( const EXPR_ARG & arg )
+		{
+			LANE_ARG la;
+			la.arg = arg;
+			la.uRow = ( arg.eat == eatSlot && arg.u == uVar ? 0 : arg.eat == eatNode ? vrow[ arg.u ] : size_t( -1 ) );
+			return la;
+		};
+
+		if ( !plan.vpure[ uContext ] )
+		{
+			return FALSE;
+		}
+
+		block.vnode = plan.vnodes[ uContext ];
+		block.varg.assign( block.vnode.size(), std::vector<LANE_ARG>() );
+		for ( size_t n = 0; n < block.vnode.size(); ++n )
+		{
+			const size_t u = block.vnode[ n ];
+			if ( plan.vfirst[ u ] != size_t( -1 ) )
+			{
+				return FALSE;
+			}
+
+			for ( const auto & arg : m_vnode[ u ].varg )
+			{
+				block.varg[ n ].push_back( lane( arg ) );
+			}
+
+			vrow[ u ] = n + 1;
+		}
+
+		block.result = lane( result );
+		return TRUE;
+	}
+
+	// row 0 of the chunk, the caller puts the values of the variable to it
+	static NUM *	Chunk( const BLOCK & block, FRAME & frame )
+	{
+		frame.vlane.resize( ( block.vnode.size() + 2 ) << REDUCE_CHUNK_LEVEL );
+		return frame.vlane.data();
+	}
+
+	// evaluates the block over the first cLanes values of the chunk: one dispatch per node
+	// evaluates all the lanes, so the nodes are taken from the plan and the arguments are
+	// resolved once per chunk. Returns the row of the result. uNode is the node being
+	// evaluated, for the errors
+	NUM *			Lanes( const BLOCK & block, NUM * pSlots, FRAME & frame, size_t cLanes, size_t & uNode ) const
+	{
+		auto row = [ &frame ]( size_t uRow ) { return &frame.vlane[ uRow << REDUCE_CHUNK_LEVEL ]; };
+		std::vector<std::pair<const NUM *, size_t>> vsrc;
+
+		for ( size_t n = 0; n < block.vnode.size(); ++n )
+		{
+			const EXPR_NODE & node = m_vnode[ uNode = block.vnode[ n ] ];
+			const std::vector<LANE_ARG> & varg = block.varg[ n ];
+			NUM * pOut = row( n + 1 );
+
+			switch ( node.ent )
+			{
+				case entUnary:
+					{
+						const auto & fn = m_vun[ node.uToken ].Func();
+						const size_t sa = ( varg[ 0 ].uRow != size_t( -1 ) );
+						const NUM * pa = ( sa ? row( varg[ 0 ].uRow ) : &Value( varg[ 0 ].arg, pSlots, frame ) );
+						for ( size_t l = 0; l < cLanes; ++l )
+						{
+							Step( frame, node.uAtChar );
+							pOut[ l ] = fn( pa[ l * sa ] );
+						}
+
+						break;
+					}
+				case entBinary:
+					{
+						const auto & fn = m_vop[ node.uToken ].Func();
+						const size_t sa = ( varg[ 0 ].uRow != size_t( -1 ) ), sb = ( varg[ 1 ].uRow != size_t( -1 ) );
+						NUM * pa = ( sa ? row( varg[ 0 ].uRow ) : &Reference( varg[ 0 ].arg, pSlots, frame, 0 ) );
+						NUM * pb = ( sb ? row( varg[ 1 ].uRow ) : &Reference( varg[ 1 ].arg, pSlots, frame, 1 ) );
+						for ( size_t l = 0; l < cLanes; ++l )
+						{
+							Step( frame, node.uAtChar );
+							pOut[ l ] = fn( pa[ l * sa ], pb[ l * sb ] );
+						}
+
+						break;
+					}
+				default:
+					{
+						const auto & fn = m_vfunc[ node.uToken ].Func();
+						vsrc.clear();
+						for ( const auto & la : varg )
+						{
+							vsrc.push_back( la.uRow != size_t( -1 ) ? std::make_pair( (const NUM *) row( la.uRow ), size_t( 1 ) ) : std::make_pair( &Value( la.arg, pSlots, frame ), size_t( 0 ) ) );
+						}
+
+						frame.vargs.resize( vsrc.size() );
+						for ( size_t l = 0; l < cLanes; ++l )
+						{
+							Step( frame, node.uAtChar );
+							for ( size_t a = 0; a < vsrc.size(); ++a )
+							{
+								frame.vargs[ a ] = vsrc[ a ].first[ l * vsrc[ a ].second ];
+							}
+
+							pOut[ l ] = fn( frame.vargs );
+						}
+
+						break;
+					}
+			}
+		}
+
+		if ( block.result.uRow != size_t( -1 ) )
+		{
+			return row( block.result.uRow );
+		}
+
+		NUM * pResult = row( block.vnode.size() + 1 );
+		std::fill( pResult, pResult + cLanes, Value( block.result.arg, pSlots, frame ) );
+		return pResult;
+	}
+
+	class CLazyArgs: public CExprLazyArgs<NUM>
+	{
+		const CExprProgram &			m_prog;
+		const LAZY_PLAN &				m_plan;
+		const size_t					m_uNode;
+		NUM *							m_pSlots;
+		FRAME &							m_frame;
+		size_t &						m_uAt;
+		mutable std::vector<std::pair<size_t, NUM>>	m_vbound;		// values of the bound slots before the call
+
+		// value of argument nArg with the variable argument nVar bound to the value
+		typedef std::function<NUM( const NUM & )>		EVAL;
+
+		// thread of Parallel: its copies of the slots and of the frame
+		typedef struct _tagWORKER
+		{
+			NUM *							pSlots;
+			FRAME &							frame;
+			size_t &						uAt;
+			const EVAL &					eval;
+		} WORKER;
+
+		// the threads of Parallel don't start others
+		static BOOL &					Worker()
+		{
+			static thread_local BOOL fWorker = FALSE;
+			return fWorker;
+		}
+
+		// blocks of 2^uLevel values of the range are taken by the threads of CExprPool and the
+		// caller in turn, the last block is the rest of the range. Each thread has the copies of
+		// the slots and of the frame. FALSE if the range must be evaluated in turn: it has less
+		// than nMinBlocks blocks, the argument isn't pure, or this is a thread of other range already
+		BOOL			Parallel( size_t nVar, size_t nArg, size_t count, size_t uLevel, size_t nMinBlocks,
+			const std::function<VOID( size_t b, size_t uFrom, size_t uTo, const WORKER & worker )> & block ) const
+		{
+			const EXPR_ARG & var = m_prog.m_vnode[ m_uNode ].varg[ nVar ];
+			const EXPR_ARG & arg = m_prog.m_vnode[ m_uNode ].varg[ nArg ];
+			const size_t uContext = m_plan.vfirst[ m_uNode ] + nArg;
+			const size_t nblocks = ( count >> uLevel );
+			const size_t nthreads = std::min<size_t>( ReduceThreads().load( std::memory_order_relaxed ), nblocks );
+
+			if ( Worker() || nblocks < nMinBlocks || nthreads < 2 || var.eat != eatSlot || !m_plan.vpure[ uContext ] )
+			{
+				return FALSE;
+			}
+
+			std::vector<std::exception_ptr> verror( nthreads );
+			std::atomic<size_t> uNext( 0 );
+
+			CExprPool::Instance().Run( nthreads, [ & ]( size_t t )
+				{
+					Worker() = TRUE;
+					try
+					{
+						std::vector<NUM> vslots( m_pSlots, m_pSlots + m_prog.m_vslot.size() );
+						CFrame fr;
+						fr.frame.vval = m_frame.vval;
+						fr.frame.vtmp.resize( 3 );
+						size_t uAt = m_uNode;
+
+						const size_t uAtChar = m_prog.ArgChar( m_prog.m_vnode[ m_uNode ], nArg );
+						const EVAL eval = [ & ]( const NUM & value )
+						{
+							Step( fr.frame, uAtChar );
+							vslots[ var.u ] = value;
+							m_prog.Run( m_plan, uContext, vslots.data(), fr.frame, uAt );
+							return m_prog.Value( arg, vslots.data(), fr.frame );
+						};
+
+						fr.frame.pgov = m_frame.pgov;
+						fr.frame.nSteps = 0;
+						fr.frame.nPoll = ( m_frame.pgov ? m_frame.pgov->Poll( 0, uAtChar ) : 0 );
+						const WORKER worker = { vslots.data(), fr.frame, uAt, eval };
+						for ( size_t b; ( b = uNext.fetch_add( 1 ) ) <= nblocks; )
+						{
+							const size_t uFrom = ( b << uLevel ), uTo = std::min( count, uFrom + ( size_t( 1 ) << uLevel ) );
+							if ( uFrom < uTo )
+							{
+								block( b, uFrom, uTo, worker );
+							}
+						}
+					}
+					catch ( ... )
+					{
+						// the others stop after their blocks
+						verror[ t ] = std::current_exception();
+						uNext.store( nblocks + 1 );
+					}
+
+					// the caller takes tasks too
+					Worker() = FALSE;
+				} );
+
+			for ( const auto & e : verror )
+			{
+				if ( e )
+				{
+					std::rethrow_exception( e );
+				}
+			}
+
+			return TRUE;
+		}
+
+	public:
+		CLazyArgs( const CExprProgram & prog, const LAZY_PLAN & plan, size_t uNode, NUM * pSlots, FRAME & frame, size_t & uAt )
+			: m_prog( prog ), m_plan( plan ), m_uNode( uNode ), m_pSlots( pSlots ), m_frame( frame ), m_uAt( uAt ) {}
+
+		~CLazyArgs()
+		{
+			for ( const auto & v : m_vbound )
+			{
+				m_pSlots[ v.first ] = v.second;
+			}
+		}
+
+		size_t			Count() const
+		{
+			return m_prog.m_vnode[ m_uNode ].varg.size();
+		}
+
+		NUM				Value( size_t n ) const
+		{
+			Step( m_frame, m_prog.ArgChar( m_prog.m_vnode[ m_uNode ], n ) );
+			m_prog.Run( m_plan, m_plan.vfirst[ m_uNode ] + n, m_pSlots, m_frame, m_uAt );
+			return m_prog.Value( m_prog.m_vnode[ m_uNode ].varg[ n ], m_pSlots, m_frame );
+		}
+
+		VOID			Bind( size_t n, const NUM & value ) const
+		{
+			const EXPR_ARG & arg = m_prog.m_vnode[ m_uNode ].varg[ n ];
+			if ( arg.eat != eatSlot )
+			{
+				throw CExprParserException( TEXT( "Argument is not a variable" ) );
+			}
+
+			if ( std::find_if( m_vbound.begin(), m_vbound.end(), [ &arg ]( const std::pair<size_t, NUM> & v ) { return v.first == arg.u; } ) == m_vbound.end() )
+			{
+				m_vbound.push_back( std::make_pair( arg.u, m_pSlots[ arg.u ] ) );
+			}
+
+			m_pSlots[ arg.u ] = value;
+		}
+
+		// values uFrom, ..., uTo - 1 of the range by the block loop. Chunks are aligned to the
+		// start of the range, so the full ones are added to the pairwise combination as the
+		// subtrees of 2^REDUCE_CHUNK_LEVEL values
+		VOID			Chunks( const BLOCK & block, size_t nArg, size_t uFrom, size_t uTo, const typename CExprLazyArgs<NUM>::INDEX & index,
+			const typename CExprLazyArgs<NUM>::COMBINE & combine, CExprPairwise<NUM> & pairwise, NUM * pSlots, FRAME & frame, size_t & uAt ) const
+		{
+			const size_t cChunk = ( size_t( 1 ) << REDUCE_CHUNK_LEVEL );
+			const size_t uAtChar = m_prog.ArgChar( m_prog.m_vnode[ m_uNode ], nArg );
+
+			for ( size_t n = uFrom; n < uTo; n += cChunk )
+			{
+				const size_t cLanes = std::min( cChunk, uTo - n );
+				index( n, cLanes, m_prog.Chunk( block, frame ) );
+				for ( size_t l = 0; l < cLanes; ++l )
+				{
+					Step( frame, uAtChar );
+				}
+
+				NUM * pResult = m_prog.Lanes( block, pSlots, frame, cLanes, uAt );
+				if ( cLanes < cChunk )
+				{
+					for ( size_t l = 0; l < cLanes; ++l )
+					{
+						pairwise.Add( pResult[ l ] );
+					}
+
+					continue;
+				}
+
+				for ( size_t s = 1; s < cChunk; s <<= 1 )
+				{
+					for ( size_t l = 0; l < cChunk; l += 2 * s )
+					{
+						pResult[ l ] = combine( pResult[ l ], pResult[ l + s ] );
+					}
+				}
+
+				pairwise.Add( pResult[ 0 ], REDUCE_CHUNK_LEVEL );
+			}
+		}
+
+		// the blocks are combined in order, as the values would be. Long ranges are taken by
+		// parts of REDUCE_PART_BLOCKS blocks, so the results of the blocks take bounded memory.
+		// Pure arguments without lazy nodes are evaluated by the block loop
+		NUM				Reduce( size_t nVar, size_t nArg, size_t count, const typename CExprLazyArgs<NUM>::INDEX & index,
+			const typename CExprLazyArgs<NUM>::COMBINE & combine, const NUM & empty ) const
+		{
+			const EXPR_NODE & call = m_prog.m_vnode[ m_uNode ];
+			const size_t nPart = ( size_t( REDUCE_PART_BLOCKS ) << REDUCE_BLOCK_LEVEL );
+			std::vector<std::unique_ptr<CExprPairwise<NUM>>> vpart;
+			CExprPairwise<NUM> pairwise( combine );
+			BLOCK block;
+
+			const BOOL fBlock = ( call.varg[ nVar ].eat == eatSlot &&
+				m_prog.MakeBlock( m_plan, m_plan.vfirst[ m_uNode ] + nArg, call.varg[ nVar ].u, call.varg[ nArg ], block ) );
+
+			for ( size_t uBase = 0; uBase < count; uBase += nPart )
+			{
+				const size_t cpart = std::min( nPart, count - uBase );
+				vpart.clear();
+				vpart.resize( ( cpart >> REDUCE_BLOCK_LEVEL ) + 1 );
+
+				auto part = [ & ]( size_t b, size_t uFrom, size_t uTo, const WORKER & worker )
+				{
+					vpart[ b ].reset( new CExprPairwise<NUM>( combine ) );
+					if ( fBlock )
+					{
+						Chunks( block, nArg, uBase + uFrom, uBase + uTo, index, combine, *vpart[ b ], worker.pSlots, worker.frame, worker.uAt );
+						return;
+					}
+
+					NUM value;
+					for ( size_t n = uFrom; n < uTo; ++n )
+					{
+						index( uBase + n, 1, &value );
+						vpart[ b ]->Add( worker.eval( value ) );
+					}
+				};
+
+				if ( Parallel( nVar, nArg, cpart, REDUCE_BLOCK_LEVEL, ( uBase ? 2 : REDUCE_PARALLEL_BLOCKS ), part ) )
+				{
+					for ( const auto & ppart : vpart )
+					{
+						if ( ppart )
+						{
+							pairwise.Append( *ppart );
+						}
+					}
+
+					continue;
+				}
+				else if ( fBlock )
+				{
+					Chunks( block, nArg, uBase, uBase + cpart, index, combine, pairwise, m_pSlots, m_frame, m_uAt );
+					continue;
+				}
+				else if ( !uBase )
+				{
+					return CExprLazyArgs<NUM>::Reduce( nVar, nArg, count, index, combine, empty );
+				}
+
+				// the rest of the range is shorter than two blocks
+				NUM value;
+				for ( size_t n = uBase; n < uBase + cpart; ++n )
+				{
+					index( n, 1, &value );
+					Bind( nVar, value );
+					pairwise.Add( Value( nArg ) );
+				}
+			}
+
+			return pairwise.Result( empty );
+		}
+
+		VOID			Map( size_t nVar, size_t nArg, const NUM * pin, NUM * pout, size_t count ) const
+		{
+			auto block = [ & ]( size_t, size_t uFrom, size_t uTo, const WORKER & worker )
+			{
+				for ( size_t n = uFrom; n < uTo; ++n )
+				{
+					pout[ n ] = worker.eval( pin[ n ] );
+				}
+			};
+
+			if ( !Parallel( nVar, nArg, count, MAP_BLOCK_LEVEL, MAP_PARALLEL_BLOCKS, block ) )
+			{
+				CExprLazyArgs<NUM>::Map( nVar, nArg, pin, pout, count );
+			}
+		}
+
+		// the nodes of the context of the argument, the arguments of them which are evaluated
+		// out of it are in the frame already
+		BOOL			Extract( size_t nVar, size_t nArg, CExprProgram & prog, std::vector<NUM> & vslot, size_t & uVar ) const
+		{
+			const EXPR_NODE & call = m_prog.m_vnode[ m_uNode ];
+			const size_t uContext = m_plan.vfirst[ m_uNode ] + nArg;
+			if ( call.varg[ nVar ].eat != eatSlot )
+			{
+				return FALSE;
+			}
+
+			std::vector<size_t> vmap( m_prog.m_vnode.size(), size_t( -1 ) );
+			auto remap = [ & ]( const EXPR_ARG & arg )
+			{
+				if ( arg.eat != eatNode )
+				{
+					return arg;
+				}
+
+				return ( vmap[ arg.u ] != size_t( -1 ) ? EXPR_ARG( eatNode, vmap[ arg.u ] ) : EXPR_ARG( eatConst, prog.AddConst( m_frame.vval[ arg.u ] ) ) );
+			};
+
+			prog = CExprProgram();
+			prog.m_vconst = m_prog.m_vconst;
+			prog.m_vslot = m_prog.m_vslot;
+			prog.m_vun = m_prog.m_vun;
+			prog.m_vop = m_prog.m_vop;
+			prog.m_vfunc = m_prog.m_vfunc;
+			prog.m_limits = m_prog.m_limits;
+
+			for ( const size_t u : m_plan.vnodes[ uContext ] )
+			{
+				if ( m_plan.vfirst[ u ] != size_t( -1 ) )
+				{
+					return FALSE;
+				}
+
+				EXPR_NODE node = m_prog.m_vnode[ u ];
+				for ( auto & arg : node.varg )
+				{
+					arg = remap( arg );
+				}
+
+				vmap[ u ] = prog.m_vnode.size();
+				prog.m_vnode.push_back( node );
+			}
+
+			prog.m_result = remap( call.varg[ nArg ] );
+			vslot.assign( m_pSlots, m_pSlots + m_prog.m_vslot.size() );
+			uVar = call.varg[ nVar ].u;
+			return TRUE;
+		}
+	};
+
+public:
+	CExprProgram()
+	{
+
+	}
+
+	VOID			Build( const std::vector<PARSER_TREE<NUM>> & vop )
+	{
+		std::vector<OPERAND> stack;
+
+		m_vnode.clear();
+		m_vsuper.clear();
+		m_plan.Reset();
+		m_vconst.clear();
+		m_vslot.clear();
+		m_vun.clear();
+		m_vop.clear();
+		m_vfunc.clear();
+
+		for ( const auto & pt : vop )
+		{
+			switch ( pt.ett )
+			{
+				case ettNumber:
+					{
+						OPERAND op;
+						op.arg = EXPR_ARG( eatConst, AddConst( pt.dValue ) );
+						op.uPreOp = pt.uPreOp;
+						op.uPostOp = pt.uPostOp;
+						stack.push_back( op );
+						break;
+					}
+				case ettVariable:
+					{
+						OPERAND op;
+						op.arg = EXPR_ARG( eatSlot, AddSlot( pt.sVariableId ) );
+						op.uPreOp = pt.uPreOp;
+						op.uPostOp = pt.uPostOp;
+						stack.push_back( op );
+						break;
+					}
+				case ettFunc:
+					{
+						if ( stack.size() < pt.fn.nargs )
+						{
+							throw CExprParserWrongArguments( pt.fn.nargs, stack.size(), pt.uAtChar );
+						}
+
+						std::vector<EXPR_ARG> varg;
+						for ( auto v = stack.end() - pt.fn.nargs; v != stack.end(); v++ )
+						{
+							varg.push_back( Operand( *v, pt.uAtChar ) );
+						}
+						stack.erase( stack.end() - pt.fn.nargs, stack.end() );
+
+						CExprTokenFunc<NUM> fn( pt.fn.nargs );
+						fn.TokFunc() = pt.fn.func;
+						fn.TokName() = pt.sVariableId;
+						fn.SetAttributes( pt.fn.uAttr, pt.fn.ecc );
+						fn.SetLazy( pt.fn.plazy );
+
+						OPERAND op;
+						op.arg = Emit( entFunc, TokenIndex( m_vfunc, fn ), varg, pt.uAtChar );
+						op.uPreOp = pt.uPreOp;
+						op.uPostOp = pt.uPostOp;
+						stack.push_back( op );
+						break;
+					}
+				case ettOpToken:
+					{
+						if ( stack.size() < 2 )
+						{
+							throw CExprParserUnexpectedEndOfExpression( pt.uAtChar );
+						}
+
+						const OPERAND p2 = stack.back(); stack.pop_back();
+						const OPERAND p1 = stack.back(); stack.pop_back();
+						const int ptPrio = pt.op.Prio();
+
+						// all lower priorities prefix tokens will be applied to the result
+						auto v = std::find_if( p1.uPreOp.begin(), p1.uPreOp.end(), [ &ptPrio ]( const auto & pr ) { return pr.Prio() <= ptPrio; } );
+
+						std::vector<EXPR_ARG> varg;
+						varg.push_back( Operand( p1, v, p1.uPreOp.end(), pt.uAtChar ) );
+						varg.push_back( Operand( p2, pt.uAtChar ) );
+
+						OPERAND op;
+						op.arg = Emit( entBinary, TokenIndex( m_vop, pt.op ), varg, pt.uAtChar );
+						op.uPreOp.insert( op.uPreOp.begin(), p1.uPreOp.begin(), v );
+						stack.push_back( op );
+						break;
+					}
+				default:
+					{
+						throw CExprParserException( TEXT( "Internal error while compiling" ), pt.uAtChar );
+					}
+			}
+		}
+
+		if ( !stack.size() )
+		{
+			throw CExprParserNoSuchToken();
+		}
+
+		m_result = Operand( stack.back(), size_t( -1 ) );
+	}
+
+	size_t			AddConst( const NUM & value )
+	{
+		m_vconst.push_back( value );
+		return m_vconst.size() - 1;
+	}
+
+	size_t			AddSlot( const CStringOp & sName )
+	{
+		size_t uSlot = Slot( sName );
+		if ( uSlot != size_t( -1 ) )
+		{
+			return uSlot;
+		}
+
+		m_vslot.push_back( sName );
+		return m_vslot.size() - 1;
+	}
+
+	// nodes of CExprBuilder. Tokens are shared by name as in Build, arguments must be emitted before
+	EXPR_ARG		Emit( const CExprTokenUn<NUM> & tok, const EXPR_ARG & a )
+	{
+		return Emit( entUnary, UnaryIndex( tok ), { a }, size_t( -1 ) );
+	}
+
+	EXPR_ARG		Emit( const CExprTokenOp<NUM> & tok, const EXPR_ARG & a, const EXPR_ARG & b )
+	{
+		return Emit( entBinary, TokenIndex( m_vop, tok ), { a, b }, size_t( -1 ) );
+	}
+
+	EXPR_ARG		Emit( const CExprTokenFunc<NUM> & tok, const std::vector<EXPR_ARG> & varg )
+	{
+		return Emit( entFunc, TokenIndex( m_vfunc, tok ), varg, size_t( -1 ) );
+	}
+
+	// node which takes the outputs of the program with several of them, so they are evaluated
+	// unconditionally and the passes keep them. It isn't pure, so it is never folded or merged
+	EXPR_ARG		EmitOutputs( const std::vector<EXPR_ARG> & varg )
+	{
+		CExprTokenFunc<NUM> tok( varg.size() );
+		tok.TokName() = TEXT( "#outputs" );
+		tok.TokFunc() = []( const std::vector<NUM> & ) { return NUM(); };
+		return Emit( tok, varg );
+	}
+
+	// tokens added by the passes. Unlike Build, they are not shared by name
+	size_t			AddToken( const CExprTokenUn<NUM> & tok )
+	{
+		m_vun.push_back( tok );
+		return m_vun.size() - 1;
+	}
+
+	size_t			AddToken( const CExprTokenOp<NUM> & tok )
+	{
+		m_vop.push_back( tok );
+		return m_vop.size() - 1;
+	}
+
+	size_t			AddToken( const CExprTokenFunc<NUM> & tok )
+	{
+		m_vfunc.push_back( tok );
+		return m_vfunc.size() - 1;
+	}
+
+	// index of variable slot or size_t( -1 ) if program doesn't use this variable
+	size_t			Slot( const CStringOp & sName ) const
+	{
+		auto v = std::find( m_vslot.begin(), m_vslot.end(), sName );
+		return ( v != m_vslot.end() ? v - m_vslot.begin() : size_t( -1 ) );
+	}
+
+	const std::vector<EXPR_NODE> &	Nodes() const
+	{
+		return m_vnode;
+	}
+
+	const std::vector<CStringOp> &	Slots() const
+	{
+		return m_vslot;
+	}
+
+	// nodes may be changed, so superinstructions and the plan of lazy nodes are dropped
+	std::vector<EXPR_NODE> &	Nodes()
+	{
+		m_vsuper.clear();
+		m_plan.Reset();
+		return m_vnode;
+	}
+
+	const NUM &		Const( size_t u ) const
+	{
+		return m_vconst[ u ];
+	}
+
+	// constants may be changed between the evaluations, passes don't expect it
+	NUM &			Const( size_t u )
+	{
+		return m_vconst[ u ];
+	}
+
+	const EXPR_ARG &	Result() const
+	{
+		return m_result;
+	}
+
+	EXPR_ARG &		Result()
+	{
+		m_vsuper.clear();
+		m_plan.Reset();
+		return m_result;
+	}
+
+	const CExprTokenUn<NUM> &	Unary( const EXPR_NODE & node ) const
+	{
+		return m_vun[ node.uToken ];
+	}
+
+	const CExprTokenOp<NUM> &	Binary( const EXPR_NODE & node ) const
+	{
+		return m_vop[ node.uToken ];
+	}
+
+	const CExprTokenFunc<NUM> &	Func( const EXPR_NODE & node ) const
+	{
+		return m_vfunc[ node.uToken ];
+	}
+
+	const CStringOp &	TokenName( const EXPR_NODE & node ) const
+	{
+		switch ( node.ent )
+		{
+			case entUnary: return m_vun[ node.uToken ].Name();
+			case entBinary: return m_vop[ node.uToken ].Name();
+			default: return m_vfunc[ node.uToken ].Name();
+		}
+	}
+
+	// EXPR_FUNC_ATTR flags of the token of the node
+	UINT			Attributes( const EXPR_NODE & node ) const
+	{
+		switch ( node.ent )
+		{
+			case entUnary: return m_vun[ node.uToken ].Attributes();
+			case entBinary: return m_vop[ node.uToken ].Attributes();
+			default: return m_vfunc[ node.uToken ].Attributes();
+		}
+	}
+
+	EXPR_COST_CLASS	Cost( const EXPR_NODE & node ) const
+	{
+		switch ( node.ent )
+		{
+			case entUnary: return m_vun[ node.uToken ].Cost();
+			case entBinary: return m_vop[ node.uToken ].Cost();
+			default: return m_vfunc[ node.uToken ].Cost();
+		}
+	}
+
+	// limits of Execute. nMaxSteps counts the nodes and the arguments evaluated by the lazy
+	// nodes, the flag and the clock are polled once per EXPR_POLL_STEPS of them. The limits of
+	// the compilation are ignored. Copies of the program and the tiers keep them
+	VOID			SetLimits( const EXPR_LIMITS & limits )
+	{
+		m_limits = limits;
+	}
+
+	const EXPR_LIMITS &	Limits() const
+	{
+		return m_limits;
+	}
+
+	// steps of the native code which evaluates the program without loops, and so can't
+	// poll the limits. Throws if the limits don't allow the evaluation of nSteps nodes
+	VOID			Admit( size_t nSteps ) const
+	{
+		if ( m_limits.nMaxSteps && nSteps > m_limits.nMaxSteps )
+		{
+			throw CExprParserLimitExceeded( elmSteps );
+		}
+
+		if ( m_limits.pfCancel && m_limits.pfCancel->load( std::memory_order_relaxed ) )
+		{
+			throw CExprParserLimitExceeded( elmCancelled );
+		}
+	}
+
+	// threads which evaluate the long ranges of CExprLazyArgs::Reduce and Map, the hardware concurrency
+	// by default, 1 evaluates them in turn. May be changed while programs are executed: each range
+	// reads it once
+	static std::atomic<size_t> &	ReduceThreads()
+	{
+		static std::atomic<size_t> nThreads( std::thread::hardware_concurrency() );
+		return nThreads;
+	}
+
+	// TRUE if the program has lazy nodes, see CExprParser::AddLazyFunc
+	BOOL			Lazy() const
+	{
+		return ( Plan() != nullptr );
+	}
+
+	// TRUE if the node is evaluated only when a lazy node asks for its argument
+	BOOL			Conditional( size_t uNode ) const
+	{
+		const LAZY_PLAN * pplan = Plan();
+		return ( pplan && pplan->vowner[ uNode ] != 0 );
+	}
+
+	// argument of node uNode + 1 which is the result of uNode, size_t( -1 ) if the nodes can't
+	// be fused: the result is used by other nodes or by the program, uNode is the last node,
+	// or the program has lazy nodes, which evaluate the nodes out of order
+	size_t			Fusible( size_t uNode ) const
+	{
+		const EXPR_ARG arg( eatNode, uNode );
+		if ( uNode + 1 >= m_vnode.size() || m_result == arg || Lazy() )
+		{
+			return size_t( -1 );
+		}
+
+		size_t uArg = size_t( -1 );
+		for ( size_t u = uNode + 1; u < m_vnode.size(); ++u )
+		{
+			for ( size_t n = 0; n < m_vnode[ u ].varg.size(); ++n )
+			{
+				if ( m_vnode[ u ].varg[ n ] != arg )
+				{
+					continue;
+				}
+				else if ( u != uNode + 1 || uArg != size_t( -1 ) )
+				{
+					return size_t( -1 );
+				}
+
+				uArg = n;
+			}
+		}
+
+		return uArg;
+	}
+
+	// executes node uNode and the next one as one instruction. fused, if given, replaces both
+	// binary operators: fused( a, b, c ) = next( node( a, b ), c ) or next( c, node( a, b ) ) when
+	// node is the second argument. FALSE if nodes can't be fused or belong to other superinstruction
+	BOOL			Fuse( size_t uNode, const FUSED & fused = nullptr )
+	{
+		const size_t uArg = Fusible( uNode );
+		if ( uArg == size_t( -1 ) || ( fused && ( m_vnode[ uNode ].ent != entBinary || m_vnode[ uNode + 1 ].ent != entBinary ) ) )
+		{
+			return FALSE;
+		}
+
+		auto v = std::find_if( m_vsuper.begin(), m_vsuper.end(), [ uNode ]( const SUPER & s ) { return s.uNode + 1 >= uNode; } );
+		if ( v != m_vsuper.end() && v->uNode <= uNode + 1 )
+		{
+			return FALSE;
+		}
+
+		SUPER super;
+		super.uNode = uNode;
+		super.uArg = uArg;
+		super.fused = fused;
+		m_vsuper.insert( v, super );
+		return TRUE;
+	}
+
+	// dispatches of the executor per evaluation
+	size_t			Instructions() const
+	{
+		return m_vnode.size() - m_vsuper.size();
+	}
+
+	// evaluates the program. pSlots[ i ] is the value of variable Slots()[ i ], assignments
+	// change it. Exceptions are the same as of CExprParser::Evaluate
+	NUM				Execute( NUM * pSlots ) const
+	{
+		return Execute( pSlots, std::vector<EXPR_ARG>(), nullptr );
+	}
+
+	// the same, and pOut[ i ] gets the value of vout[ i ] after the evaluation. Conditional
+	// nodes can't be taken
+	NUM				Execute( NUM * pSlots, const std::vector<EXPR_ARG> & vout, NUM * pOut ) const
+	{
+		CFrame fr;
+		FRAME & frame = fr.frame;
+		const size_t cnode = m_vnode.size();
+		const LAZY_PLAN * pplan = Plan();
+		CGovernor gov( m_limits );
+		size_t u = 0, s = 0;
+
+		frame.vval.resize( cnode );
+		frame.vtmp.resize( 3 );
+
+		try
+		{
+			Govern( frame, gov, size_t( -1 ) );
+			if ( pplan )
+			{
+				Run( *pplan, 0, pSlots, frame, u );
+			}
+
+			for ( ; !pplan && u < cnode; ++u )
+			{
+				Step( frame, m_vnode[ u ].uAtChar );
+				if ( s < m_vsuper.size() && m_vsuper[ s ].uNode == u )
+				{
+					const SUPER & super = m_vsuper[ s++ ];
+					Step( frame, m_vnode[ u + 1 ].uAtChar );
+					if ( super.fused )
+					{
+						const EXPR_NODE & node = m_vnode[ u ];
+						NUM & a = Reference( node.varg[ 0 ], pSlots, frame, 0 );
+						NUM & b = Reference( node.varg[ 1 ], pSlots, frame, 1 );
+						NUM & c = Reference( m_vnode[ ++u ].varg[ 1 - super.uArg ], pSlots, frame, 2 );
+						frame.vval[ u ] = super.fused( a, b, c );
+						continue;
+					}
+
+					// the result of the first node is passed to the next one without the frame
+					NUM r = Compute( m_vnode[ u ], pSlots, frame );
+					frame.vval[ u + 1 ] = Compute( m_vnode[ u + 1 ], pSlots, frame, &r, super.uArg );
+					u++;
+					continue;
+				}
+
+				frame.vval[ u ] = Compute( m_vnode[ u ], pSlots, frame );
+			}
+		}
+		catch ( CExprParserLimitExceeded & e )
+		{
+			UNREFERENCED_PARAMETER( e );
+			throw;
+		}
+		catch ( CExprParserException & e )
+		{
+			throw CExprParserException( e.Message(), e.AtChar() == size_t( -1 ) ? m_vnode[ u ].uAtChar : e.AtChar() );
+		}
+
+		for ( size_t n = 0; n < vout.size(); ++n )
+		{
+			pOut[ n ] = Value( vout[ n ], pSlots, frame );
+		}
+
+		return Value( m_result, pSlots, frame );
+	}
+};
@@ -0,0 +1,84 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Counter-based random numbers. The value is a function of the counter and the stream, there
+   is no state, so the samples may be evaluated by any thread in any order and give the same
+   results. The bits are Philox4x32-10 of Salmon et al., "Parallel random numbers: as easy as
+   1, 2, 3" */
+
+#pragma once
+
+#include "w32def.h"
+#include <cmath>
+#include <cstdint>
+
+#define RANDOM_ROUNDS			10
+
+class CExprRandom
+{
+	static VOID			MulHiLo( uint32_t a, uint32_t b, uint32_t & hi, uint32_t & lo )
+	{
+		const uint64_t p = uint64_t( a ) * b;
+		hi = uint32_t( p >> 32 );
+		lo = uint32_t( p );
+	}
+
+public:
+	// 128 bits of the counter and the stream
+	static VOID			Bits( uint64_t counter, uint64_t stream, uint64_t & r0, uint64_t & r1 )
+	{
+		uint32_t c0 = uint32_t( counter ), c1 = uint32_t( counter >> 32 ), c2 = 0, c3 = 0;
+		uint32_t k0 = uint32_t( stream ), k1 = uint32_t( stream >> 32 );
+		for ( int n = 0; n < RANDOM_ROUNDS; ++n )
+		{
+			uint32_t hi0, lo0, hi1, lo1;
+			MulHiLo( 0xD2511F53, c0, hi0, lo0 );
+			MulHiLo( 0xCD9E8D57, c2, hi1, lo1 );
+
+			c0 = hi1 ^ c1 ^ k0;
+			c1 = lo1;
+			c2 = hi0 ^ c3 ^ k1;
+			c3 = lo0;
+
+			k0 += 0x9E3779B9;
+			k1 += 0xBB67AE85;
+		}
+
+		r0 = ( uint64_t( c1 ) << 32 ) | c0;
+		r1 = ( uint64_t( c3 ) << 32 ) | c2;
+	}
+
+	// uniform in ( 0, 1 ), neither end is taken, so the logarithm is finite
+	static long double	Uniform( uint64_t counter, uint64_t stream )
+	{
+		uint64_t r0, r1;
+		Bits( counter, stream, r0, r1 );
+		return Open( r0 );
+	}
+
+	// standard normal by Box-Muller over both halves of the bits
+	static long double	Normal( uint64_t counter, uint64_t stream )
+	{
+		uint64_t r0, r1;
+		Bits( counter, stream, r0, r1 );
+		return std::sqrt( -2 * std::log( Open( r0 ) ) ) * std::cos( 2 * 3.14159265358979323846264338327950288L * Open( r1 ) );
+	}
+
+	// 63 bits and a half fit into the mantissa of long double exactly
+	static long double	Open( uint64_t r )
+	{
+		return std::ldexp( (long double) ( r >> 1 ) + 0.5L, -63 );
+	}
+};
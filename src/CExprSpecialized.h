@@ -0,0 +1,387 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Program specialized for the profiled values of its slots. Guards check the slots before
+   each evaluation, the general program is evaluated when any guard fails. Without native code
+   the specialized program is used only if it folds nodes or makes costly nodes real, and if
+   it is faster than the general one for the profiled values. Otherwise guards would cost more
+   than they save and the general program is evaluated at once */
+
+#pragma once
+
+#include "CExprProfile.h"
+
+// evaluations of each program per round of the calibration of CExprSpecialized, and the rounds
+#define SPECIALIZE_CALIBRATION_EVALS	64
+#define SPECIALIZE_CALIBRATION_ROUNDS	5
+
+typedef enum _tagEXPR_GUARD_TYPE
+{
+	egtReal,
+	egtInteger,
+	egtConst,
+	egtNonNegative
+} EXPR_GUARD_TYPE, *PEXPR_GUARD_TYPE;
+
+template <class NUM>
+struct EXPR_GUARD
+{
+	size_t						uSlot;
+	EXPR_GUARD_TYPE				egt;
+	NUM							value;		// for egtConst
+};
+
+template <class NUM>
+class CExprSpecialized
+{
+public:
+	// native code returns FALSE when it can't evaluate given slots, then the program is executed
+	typedef std::function<BOOL( NUM * pSlots, NUM & result )>		NATIVE;
+	// returns empty NATIVE if program can't be compiled
+	typedef std::function<NATIVE( const CExprProgram<NUM> & prog )>	COMPILER;
+
+private:
+	CExprProgram<NUM>					m_general;
+	CExprProgram<NUM>					m_special;
+	NATIVE								m_native;
+	BOOL								m_fCheaper;
+	const CExprOptimizer<NUM>			m_opt;
+	std::vector<EXPR_GUARD<NUM>>		m_vguard;
+	std::unique_ptr<std::atomic<size_t>[]>	m_vnFailed;
+	std::atomic<size_t>					m_nEvals;
+	std::atomic<size_t>					m_nFallbacks;
+
+	CExprSpecialized( const CExprSpecialized & );
+	CExprSpecialized & operator=( const CExprSpecialized & );
+
+	BOOL				Check( const EXPR_GUARD<NUM> & guard, const NUM & value ) const
+	{
+		switch ( guard.egt )
+		{
+			case egtConst: return m_opt.Equal( value, guard.value );
+			case egtInteger: return !!( m_opt.Classify( value ) & evkInteger );
+			case egtNonNegative: return !!( m_opt.Classify( value ) & evkNonNegative );
+			default: return !!( m_opt.Classify( value ) & evkReal );
+		}
+	}
+
+	BOOL				Passes( const NUM * pSlots ) const
+	{
+		for ( const auto & guard : m_vguard )
+		{
+			if ( !Check( guard, pSlots[ guard.uSlot ] ) )
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	// slots assigned by the program can't be guarded
+	BOOL				Written( size_t uSlot ) const
+	{
+		for ( const auto & node : m_general.Nodes() )
+		{
+			if ( m_opt.Writes( m_general, node ) && std::find( node.varg.begin(), node.varg.end(), EXPR_ARG( eatSlot, uSlot ) ) != node.varg.end() )
+			{
+				return TRUE;
+			}
+		}
+
+		return FALSE;
+	}
+
+	// kinds besides evkReal which the real variants of the nodes require from the slot,
+	// such as integer exponents and non-negative bases of power
+	UINT				Required( size_t uSlot ) const
+	{
+		UINT uKind = 0;
+		for ( const auto & node : m_general.Nodes() )
+		{
+			for ( size_t n = 0; n < node.varg.size(); ++n )
+			{
+				if ( node.varg[ n ] == EXPR_ARG( eatSlot, uSlot ) )
+				{
+					uKind |= m_opt.Requires( m_general, node, n );
+				}
+			}
+		}
+
+		return uKind;
+	}
+
+	VOID				SelectGuards( const CExprProfile<NUM> & profile, double dRatio )
+	{
+		for ( size_t u = 0; u < m_general.Slots().size(); ++u )
+		{
+			if ( Written( u ) )
+			{
+				continue;
+			}
+
+			EXPR_GUARD<NUM> guard;
+			guard.uSlot = u;
+
+			const UINT uKind = profile.Kind( u, dRatio ), uRequired = Required( u );
+			if ( profile.Constant( u, dRatio, guard.value ) && ( m_opt.Classify( guard.value ) & evkValue ) )
+			{
+				guard.egt = egtConst;
+			}
+			else if ( uKind & uRequired & evkInteger )
+			{
+				guard.egt = egtInteger;
+			}
+			else if ( uKind & uRequired & evkNonNegative )
+			{
+				guard.egt = egtNonNegative;
+			}
+			else if ( uKind & evkReal )
+			{
+				guard.egt = egtReal;
+			}
+			else
+			{
+				continue;
+			}
+
+			m_vguard.push_back( guard );
+		}
+	}
+
+	// constants are substituted for the guarded slots, then the nodes which have real
+	// arguments are replaced by the real variants of their tokens. Kinds of the results
+	// follow the real variants and efaRealClosed of the tokens. Returns TRUE if the program
+	// became cheaper: nodes were folded or real variants replaced tokens other than add,
+	// subtract, multiply and negate, which cost about the same in both variants
+	BOOL				Specialize()
+	{
+		BOOL fCheaper = FALSE;
+		std::vector<UINT> vslotKind( m_general.Slots().size(), 0 );
+		auto & vnode = m_special.Nodes();
+
+		for ( const auto & guard : m_vguard )
+		{
+			if ( guard.egt != egtConst )
+			{
+				vslotKind[ guard.uSlot ] = evkValue | evkReal | ( guard.egt == egtInteger ? evkInteger : 0 ) | ( guard.egt == egtNonNegative ? evkNonNegative : 0 );
+				continue;
+			}
+
+			const EXPR_ARG slot( eatSlot, guard.uSlot ), konst( eatConst, m_special.AddConst( guard.value ) );
+			for ( auto & node : vnode )
+			{
+				std::replace( node.varg.begin(), node.varg.end(), slot, konst );
+			}
+
+			if ( m_special.Result() == slot )
+			{
+				m_special.Result() = konst;
+			}
+		}
+
+		m_opt.Optimize( m_special );
+		fCheaper = ( vnode.size() < m_general.Nodes().size() );
+
+		std::vector<UINT> vnodeKind( vnode.size(), 0 );
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			std::vector<UINT> vkind;
+			for ( const auto & arg : vnode[ u ].varg )
+			{
+				switch ( arg.eat )
+				{
+					case eatConst: vkind.push_back( m_opt.Classify( m_special.Const( arg.u ) ) ); break;
+					case eatSlot: vkind.push_back( vslotKind[ arg.u ] ); break;
+					default: vkind.push_back( vnodeKind[ arg.u ] ); break;
+				}
+			}
+
+			const auto * parith = m_opt.Arithmetic( m_special, vnode[ u ] );
+			const BOOL fCheap = ( parith && parith->ear != earPow );
+
+			// real-closed tokens without real variants still give real values to the next nodes
+			if ( m_opt.Realize( m_special, u, vkind ) )
+			{
+				vnodeKind[ u ] = evkValue | evkReal;
+				fCheaper = fCheaper || !fCheap;
+			}
+			else if (
+				( ( m_special.Attributes( vnode[ u ] ) & efaRealClosed ) &&
+				std::find_if( vkind.begin(), vkind.end(), []( UINT uKind ) { return !( uKind & evkReal ); } ) == vkind.end() ) )
+			{
+				vnodeKind[ u ] = evkValue | evkReal;
+			}
+		}
+
+		return fCheaper;
+	}
+
+	// times the guards with the specialized program against the general program over the first
+	// profiled values, the least time of the rounds counts. TRUE if the specialized one is
+	// faster, or if the programs can't be timed: the values fail the guards, or the program has
+	// lazy nodes, which may take long, or nodes without efaPure, which must not be called more
+	BOOL				Calibrate( const CExprProfile<NUM> & profile ) const
+	{
+		std::vector<NUM> vfirst( m_general.Slots().size() ), vslots;
+		for ( size_t u = 0; u < vfirst.size(); ++u )
+		{
+			if ( !profile.First( u, vfirst[ u ] ) )
+			{
+				return TRUE;
+			}
+		}
+
+		if ( !Passes( vfirst.data() ) || m_general.Lazy() ||
+			std::find_if( m_general.Nodes().begin(), m_general.Nodes().end(), [ this ]( const EXPR_NODE & node ) { return !( m_general.Attributes( node ) & efaPure ); } ) != m_general.Nodes().end() )
+		{
+			return TRUE;
+		}
+
+		auto time = [ &vfirst, &vslots ]( const std::function<VOID( NUM * pSlots )> & fn )
+		{
+			const auto t0 = std::chrono::steady_clock::now();
+			for ( size_t n = 0; n < SPECIALIZE_CALIBRATION_EVALS; ++n )
+			{
+				vslots = vfirst;
+				fn( vslots.data() );
+			}
+
+			return std::chrono::steady_clock::now() - t0;
+		};
+
+		auto general = std::chrono::steady_clock::duration::max(), special = general;
+		try
+		{
+			for ( size_t r = 0; r < SPECIALIZE_CALIBRATION_ROUNDS; ++r )
+			{
+				general = std::min( general, time( [ this ]( NUM * pSlots ) { m_general.Execute( pSlots ); } ) );
+				special = std::min( special, time( [ this ]( NUM * pSlots ) { if ( Passes( pSlots ) ) m_special.Execute( pSlots ); } ) );
+			}
+		}
+		catch ( CExprParserException & e )
+		{
+			UNREFERENCED_PARAMETER( e );
+			return TRUE;
+		}
+
+		return ( special < general );
+	}
+
+public:
+	// prog - general program, opt - optimizer of the parser. Guards are set for the slots
+	// which values had the same kind in at least dRatio of the profiled evaluations
+	CExprSpecialized( const CExprProgram<NUM> & prog, const CExprProfile<NUM> & profile, const CExprOptimizer<NUM> & opt,
+		const COMPILER & compiler = nullptr, double dRatio = 0.99 )
+		: m_general( prog ), m_special( prog ), m_fCheaper( FALSE ), m_opt( opt ), m_nEvals( 0 ), m_nFallbacks( 0 )
+	{
+		SelectGuards( profile, dRatio );
+		m_fCheaper = Specialize();
+
+		m_vnFailed.reset( new std::atomic<size_t>[ m_vguard.size() ] );
+		for ( size_t u = 0; u < m_vguard.size(); ++u )
+		{
+			m_vnFailed[ u ] = 0;
+		}
+
+		if ( compiler )
+		{
+			m_native = compiler( m_special );
+		}
+
+		if ( !m_native && m_fCheaper )
+		{
+			m_fCheaper = Calibrate( profile );
+		}
+	}
+
+	// may be called by several threads at once
+	NUM					Evaluate( NUM * pSlots )
+	{
+		BOOL fPassed = TRUE;
+
+		m_nEvals.fetch_add( 1, std::memory_order_relaxed );
+		if ( !Specialized() )
+		{
+			return m_general.Execute( pSlots );
+		}
+
+		for ( size_t u = 0; u < m_vguard.size(); ++u )
+		{
+			if ( !Check( m_vguard[ u ], pSlots[ m_vguard[ u ].uSlot ] ) )
+			{
+				m_vnFailed[ u ].fetch_add( 1, std::memory_order_relaxed );
+				fPassed = FALSE;
+			}
+		}
+
+		if ( !fPassed )
+		{
+			m_nFallbacks.fetch_add( 1, std::memory_order_relaxed );
+			return m_general.Execute( pSlots );
+		}
+
+		NUM result;
+		if ( m_native )
+		{
+			m_special.Admit( m_special.Nodes().size() );
+			if ( m_native( pSlots, result ) )
+			{
+				return result;
+			}
+		}
+
+		return m_special.Execute( pSlots );
+	}
+
+	const std::vector<EXPR_GUARD<NUM>> &	Guards() const
+	{
+		return m_vguard;
+	}
+
+	// count of evaluations when guard uGuard has failed, 0 if the guards are skipped
+	size_t				Failures( size_t uGuard ) const
+	{
+		return m_vnFailed[ uGuard ].load( std::memory_order_relaxed );
+	}
+
+	size_t				Evaluations() const
+	{
+		return m_nEvals.load( std::memory_order_relaxed );
+	}
+
+	// evaluations of the general program because a guard has failed. The evaluations of the
+	// program which isn't specialized aren't counted
+	size_t				Fallbacks() const
+	{
+		return m_nFallbacks.load( std::memory_order_relaxed );
+	}
+
+	BOOL				Native() const
+	{
+		return !!m_native;
+	}
+
+	// FALSE if Evaluate skips the guards and executes the general program
+	BOOL				Specialized() const
+	{
+		return ( m_native || m_fCheaper );
+	}
+
+	const CExprProgram<NUM> &	Program() const
+	{
+		return m_special;
+	}
+};
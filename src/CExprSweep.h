@@ -0,0 +1,324 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Evaluation of the program over rows in which only some variables vary, such as the sweep
+   of one variable over the grid. The nodes which don't depend on the varying variables are
+   evaluated once per batch, the rest of the program is evaluated for each row and takes
+   their results as constants:
+
+	CExprSweep<TOK> sweep( prog, { prog.Slot( TEXT("x") ) }, optimizer );
+	sweep.Batch( vslots.data() );
+	for ( ... ) { vrow = vslots; vrow[ uX ] = x; result = sweep.Execute( vrow.data() ); }
+*/
+
+#pragma once
+
+#include "CExprOptimizer.h"
+
+template <class NUM>
+class CExprSweep
+{
+	CExprProgram<NUM>					m_batch;	// invariant nodes, evaluated once per batch
+	CExprProgram<NUM>					m_row;		// the rest of the nodes, evaluated for each row
+	std::vector<EXPR_ARG>				m_vhoisted;	// nodes of m_batch which results the rows take
+	std::vector<size_t>					m_vconst;	// and their constants in m_row
+	std::vector<size_t>					m_vvarying;	// varying slots
+	std::vector<size_t>					m_vwritten;	// slots assigned by the rows
+	std::vector<NUM>					m_vvalues;	// results of m_vhoisted
+	size_t								m_nNodes;	// of the optimized program
+	BOOL								m_fHoisted;	// FALSE if m_row is the optimized program
+
+	// program of the nodes vkeep. Arguments of the kept nodes must be kept too, the result
+	// is set by the caller if its node isn't kept
+	static CExprProgram<NUM>	Select( const CExprProgram<NUM> & prog, const std::vector<BOOL> & vkeep, std::vector<size_t> & vindex )
+	{
+		CExprProgram<NUM> sel = prog;
+		auto & vnode = sel.Nodes();
+		std::vector<EXPR_NODE> vnew;
+
+		vindex.assign( vnode.size(), size_t( -1 ) );
+		for ( size_t u = 0; u < vnode.size(); ++u )
+		{
+			if ( !vkeep[ u ] )
+			{
+				continue;
+			}
+
+			vindex[ u ] = vnew.size();
+			vnew.push_back( vnode[ u ] );
+			for ( auto & arg : vnew.back().varg )
+			{
+				if ( arg.eat == eatNode ) arg.u = vindex[ arg.u ];
+			}
+		}
+
+		vnode = vnew;
+		if ( sel.Result().eat == eatNode )
+		{
+			sel.Result().u = vindex[ sel.Result().u ];
+		}
+
+		return sel;
+	}
+
+public:
+	// vvarying - slots which differ between the rows, opt - optimizer of the parser, which is run
+	// over the copy of prog first. Assignments are side effects of the writers, and not of the
+	// other nodes without efaPure, so the writers of the invariant values are evaluated once
+	// per batch when the rows read their slots after them only. Otherwise the slots vary too
+	CExprSweep( const CExprProgram<NUM> & general, const std::vector<size_t> & vvarying, const CExprOptimizer<NUM> & opt )
+		: m_vvarying( vvarying ), m_fHoisted( FALSE )
+	{
+		CExprProgram<NUM> optimized = general;
+		opt.Optimize( optimized );
+
+		const CExprProgram<NUM> & prog = optimized;
+		const auto & vnode = prog.Nodes();
+		const size_t cnode = vnode.size();
+		std::vector<BOOL> vslotVaries( prog.Slots().size(), FALSE ), vvaries( cnode ), vbatch( cnode );
+		for ( const size_t uSlot : vvarying )
+		{
+			vslotVaries[ uSlot ] = TRUE;
+		}
+
+		m_nNodes = cnode;
+		for ( BOOL fChanged = TRUE; fChanged; )
+		{
+			fChanged = FALSE;
+			for ( size_t u = 0; u < cnode; ++u )
+			{
+				const EXPR_NODE & node = vnode[ u ];
+				vvaries[ u ] = !( prog.Attributes( node ) & efaPure ) && !( node.ent == entBinary && opt.Writes( prog, node ) );
+				for ( const auto & arg : node.varg )
+				{
+					vvaries[ u ] = vvaries[ u ] || ( arg.eat == eatSlot && vslotVaries[ arg.u ] ) || ( arg.eat == eatNode && vvaries[ arg.u ] );
+				}
+			}
+
+			// invariant nodes evaluated by the program anyway, and the arguments of the lazy ones
+			std::fill( vbatch.begin(), vbatch.end(), FALSE );
+			for ( size_t u = cnode; u-- > 0; )
+			{
+				vbatch[ u ] = vbatch[ u ] || ( !vvaries[ u ] && !prog.Conditional( u ) );
+				for ( const auto & arg : vnode[ u ].varg )
+				{
+					if ( vbatch[ u ] && arg.eat == eatNode ) vbatch[ arg.u ] = TRUE;
+				}
+			}
+
+			// the last write of the batch to each slot. Slots written by the rows, or read by them
+			// before the batch writes them, vary
+			std::vector<size_t> vlast( vslotVaries.size(), 0 );
+			for ( size_t u = 0; u < cnode; ++u )
+			{
+				if ( vnode[ u ].ent != entBinary || !opt.Writes( prog, vnode[ u ] ) )
+				{
+					continue;
+				}
+
+				for ( const auto & arg : vnode[ u ].varg )
+				{
+					if ( arg.eat == eatSlot && vbatch[ u ] )
+					{
+						vlast[ arg.u ] = u + 1;
+					}
+					else if ( arg.eat == eatSlot && !vslotVaries[ arg.u ] )
+					{
+						vslotVaries[ arg.u ] = TRUE;
+						fChanged = TRUE;
+					}
+				}
+			}
+
+			for ( size_t u = 0; u < cnode; ++u )
+			{
+				for ( const auto & arg : vnode[ u ].varg )
+				{
+					if ( !vbatch[ u ] && arg.eat == eatSlot && vlast[ arg.u ] > u && !vslotVaries[ arg.u ] )
+					{
+						vslotVaries[ arg.u ] = TRUE;
+						fChanged = TRUE;
+					}
+				}
+			}
+		}
+
+		// the batch saves nothing if it takes only the arguments of the lazy nodes, which the
+		// rows may never evaluate, or nothing at all. The rows are the plain program then
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			m_fHoisted = m_fHoisted || ( vbatch[ u ] && !prog.Conditional( u ) );
+		}
+
+		if ( !m_fHoisted )
+		{
+			m_row = prog;
+			return;
+		}
+
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			for ( const auto & arg : vnode[ u ].varg )
+			{
+				if ( !vbatch[ u ] && vnode[ u ].ent == entBinary && opt.Writes( prog, vnode[ u ] ) && arg.eat == eatSlot &&
+					std::find( m_vwritten.begin(), m_vwritten.end(), arg.u ) == m_vwritten.end() )
+				{
+					m_vwritten.push_back( arg.u );
+				}
+			}
+		}
+
+		// nodes of the rows take the results of the batch as constants
+		CExprProgram<NUM> row = prog;
+		auto & vrow = row.Nodes();
+		std::vector<size_t> vconst( cnode, size_t( -1 ) );
+		auto hoist = [ & ]( EXPR_ARG & arg )
+		{
+			if ( arg.eat == eatNode && vbatch[ arg.u ] )
+			{
+				if ( vconst[ arg.u ] == size_t( -1 ) )
+				{
+					vconst[ arg.u ] = row.AddConst( NUM() );
+				}
+
+				arg = EXPR_ARG( eatConst, vconst[ arg.u ] );
+			}
+		};
+
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			for ( auto & arg : vrow[ u ].varg )
+			{
+				if ( !vbatch[ u ] ) hoist( arg );
+			}
+		}
+
+		hoist( row.Result() );
+
+		std::vector<size_t> vindex;
+		std::vector<BOOL> vrowNodes( cnode );
+		std::transform( vbatch.begin(), vbatch.end(), vrowNodes.begin(), []( BOOL f ) { return !f; } );
+		m_row = Select( row, vrowNodes, vindex );
+
+		m_batch = Select( prog, vbatch, vindex );
+		for ( size_t u = 0; u < cnode; ++u )
+		{
+			if ( vconst[ u ] != size_t( -1 ) )
+			{
+				m_vhoisted.push_back( EXPR_ARG( eatNode, vindex[ u ] ) );
+				m_vconst.push_back( vconst[ u ] );
+			}
+		}
+
+		// the nodes taken by the rows may be used by the lazy nodes of the batch too
+		if ( m_batch.Nodes().size() )
+		{
+			m_batch.Result() = m_batch.EmitOutputs( m_vhoisted );
+		}
+
+		m_vvalues.resize( m_vhoisted.size() );
+	}
+
+	// evaluates the invariant nodes with the values of pSlots, the varying slots are ignored.
+	// The batch may assign the slots, the rows are evaluated with the slots after it. Rows
+	// must not be evaluated by other threads meanwhile
+	VOID				Batch( NUM * pSlots )
+	{
+		if ( !m_batch.Nodes().size() )
+		{
+			return;
+		}
+
+		m_batch.Execute( pSlots, m_vhoisted, m_vvalues.data() );
+		for ( size_t n = 0; n < m_vconst.size(); ++n )
+		{
+			m_row.Const( m_vconst[ n ] ) = m_vvalues[ n ];
+		}
+	}
+
+	// evaluates the row. Slots are the slots after Batch with the values of the varying ones
+	NUM					Execute( NUM * pSlots ) const
+	{
+		return m_row.Execute( pSlots );
+	}
+
+	// evaluates the rows of the batch, pRows are nRows x Slots() values. The invariant
+	// slots are taken from the first row, or from each row by the plain program
+	VOID				Evaluate( const NUM * pRows, size_t nRows, NUM * pResult )
+	{
+		const size_t nslots = m_row.Slots().size();
+		if ( !nRows )
+		{
+			return;
+		}
+		else if ( !m_fHoisted )
+		{
+			std::vector<NUM> vslots( nslots );
+			for ( size_t n = 0; n < nRows; ++n )
+			{
+				std::copy( pRows + n * nslots, pRows + ( n + 1 ) * nslots, vslots.begin() );
+				pResult[ n ] = m_row.Execute( vslots.data() );
+			}
+
+			return;
+		}
+
+		std::vector<NUM> vbatch( pRows, pRows + nslots );
+		Batch( vbatch.data() );
+
+		std::vector<NUM> vslots = vbatch;
+		for ( size_t n = 0; n < nRows; ++n )
+		{
+			for ( const size_t uSlot : m_vwritten )
+			{
+				vslots[ uSlot ] = vbatch[ uSlot ];
+			}
+
+			for ( const size_t uSlot : m_vvarying )
+			{
+				vslots[ uSlot ] = pRows[ n * nslots + uSlot ];
+			}
+
+			pResult[ n ] = m_row.Execute( vslots.data() );
+		}
+	}
+
+	// nodes evaluated once per batch and for each row, and of the optimized program
+	size_t				BatchNodes() const
+	{
+		return m_batch.Nodes().size() - ( m_batch.Nodes().size() ? 1 : 0 );
+	}
+
+	size_t				RowNodes() const
+	{
+		return m_row.Nodes().size();
+	}
+
+	size_t				Nodes() const
+	{
+		return m_nNodes;
+	}
+
+	// FALSE if no node is taken out of the rows, and they are evaluated by the plain program
+	BOOL				Hoisted() const
+	{
+		return m_fHoisted;
+	}
+
+	const std::vector<CStringOp> &	Slots() const
+	{
+		return m_row.Slots();
+	}
+};
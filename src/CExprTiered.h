@@ -0,0 +1,351 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Tiered execution of compiled programs. Program starts on the plain executor and is
+   promoted to the optimized program and then to the native or specialized code when it becomes hot */
+
+#pragma once
+
+#include "CExprSpecialized.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+typedef enum _tagEXPR_TIER
+{
+	etProgram,			// program as it was compiled
+	etOptimized,		// program after CExprOptimizer
+	etNative,			// code of the native compiler
+	etSpecialized,		// CExprSpecialized for the profile of the lower tiers
+	etMax
+} EXPR_TIER, *PEXPR_TIER;
+
+typedef struct _tagEXPR_TIER_POLICY
+{
+	size_t						nOptimize;		// evaluations before optimization, 0 - never
+	size_t						nNative;		// evaluations before native compilation or specialization, 0 - never
+	BOOL						fBackground;	// promote in the background thread, otherwise in the evaluating one
+	BOOL						fProfile;		// record value profile on the lower tiers and specialize the program
+	double						dGuardRatio;	// see CExprSpecialized
+
+	_tagEXPR_TIER_POLICY()
+		: nOptimize( 64 ), nNative( 4096 ), fBackground( TRUE ), fProfile( FALSE ), dGuardRatio( 0.99 ) {}
+} EXPR_TIER_POLICY, *PEXPR_TIER_POLICY;
+
+template <class NUM>
+class CExprTiered
+{
+public:
+	typedef typename CExprSpecialized<NUM>::NATIVE		NATIVE;
+	typedef typename CExprSpecialized<NUM>::COMPILER	COMPILER;
+
+private:
+	typedef struct _tagCODE
+	{
+		EXPR_TIER				et;
+		CExprProgram<NUM>		prog;
+		NATIVE					native;
+		std::shared_ptr<CExprSpecialized<NUM>>	pspec;
+	} CODE;
+
+	// tiers are never released until destruction, so evaluators may keep raw pointer
+	std::unique_ptr<CODE>		m_vcode[ etMax ];
+	std::atomic<const CODE *>	m_pcode;
+	std::atomic<size_t>			m_nEvals;		// counted by samples, see Evaluate
+	std::atomic<size_t>			m_uSample;		// evaluation is sampled when Random() & m_uSample is 0
+	std::atomic<size_t>			m_nPromoteAt;
+	std::atomic<bool>			m_fBusy;
+
+	// the background thread lives as long as the object and promotes on request, so the
+	// evaluator which has reached the threshold doesn't wait for it
+	std::thread					m_thread;
+	std::mutex					m_mxRequest;
+	std::condition_variable		m_cvRequest;
+	BOOL						m_fRequest;
+	BOOL						m_fStop;
+
+	const CExprOptimizer<NUM>	m_optimizer;
+	const COMPILER				m_compiler;
+	const EXPR_TIER_POLICY		m_policy;
+	std::unique_ptr<CExprProfile<NUM>>	m_pprofile;
+
+	CExprTiered( const CExprTiered & );
+	CExprTiered & operator=( const CExprTiered & );
+
+	static size_t	Threshold( size_t n )
+	{
+		return ( n ? n : size_t( -1 ) );
+	}
+
+	// mask of the samples for the next threshold: 1 of up to 64 evaluations is counted, but
+	// the threshold is reached in 64 samples at least
+	static size_t	SampleMask( size_t nNext )
+	{
+		size_t uMask = 0;
+		while ( uMask < 63 && ( uMask + 1 ) * 128 <= nNext )
+		{
+			uMask = uMask * 2 + 1;
+		}
+
+		return uMask;
+	}
+
+	// xorshift generator of the thread. Samples are random, so the threads which evaluate
+	// several objects in turn count each of them right on average
+	static size_t	Random()
+	{
+		static thread_local unsigned long long x = 0x9E3779B97F4A7C15ull ^ std::hash<std::thread::id>()( std::this_thread::get_id() );
+		x ^= x << 13;
+		x ^= x >> 7;
+		x ^= x << 17;
+		return size_t( x );
+	}
+
+	VOID			Schedule( size_t nNext )
+	{
+		m_uSample.store( SampleMask( nNext ), std::memory_order_relaxed );
+		m_nPromoteAt.store( nNext, std::memory_order_relaxed );
+	}
+
+	VOID			Publish( CODE * pcode )
+	{
+		m_vcode[ pcode->et ].reset( pcode );
+		m_pcode.store( pcode, std::memory_order_release );
+	}
+
+	// builds the next tiers which thresholds are reached. Called by one thread at once
+	VOID			Upgrade()
+	{
+		try
+		{
+			for ( ;; )
+			{
+				const CODE * pcode = m_pcode.load( std::memory_order_acquire );
+				const size_t nEvals = m_nEvals.load( std::memory_order_relaxed );
+
+				if ( pcode->et == etProgram && nEvals >= Threshold( m_policy.nOptimize ) )
+				{
+					CODE * pnew = new CODE( *pcode );
+					pnew->et = etOptimized;
+					m_optimizer.Optimize( pnew->prog );
+					Publish( pnew );
+				}
+				else if ( pcode->et < etNative && ( m_compiler || m_pprofile ) && nEvals >= Threshold( m_policy.nNative ) )
+				{
+					CODE * pnew = new CODE( *pcode );
+					if ( m_pprofile )
+					{
+						pnew->et = etSpecialized;
+						pnew->pspec = std::make_shared<CExprSpecialized<NUM>>( pcode->prog, *m_pprofile, m_optimizer, m_compiler, m_policy.dGuardRatio );
+					}
+					else
+					{
+						pnew->et = etNative;
+						pnew->native = m_compiler( pnew->prog );
+					}
+
+					if ( pnew->native || pnew->pspec )
+					{
+						Publish( pnew );
+					}
+					else
+					{
+						delete pnew;
+					}
+
+					// the last tier
+					Schedule( size_t( -1 ) );
+					return;
+				}
+				else
+				{
+					break;
+				}
+			}
+		}
+		catch ( ... )
+		{
+			Schedule( size_t( -1 ) );
+			return;
+		}
+
+		const EXPR_TIER et = m_pcode.load( std::memory_order_relaxed )->et;
+		size_t nNext = size_t( -1 );
+		if ( et == etProgram )
+		{
+			nNext = Threshold( m_policy.nOptimize );
+		}
+		else if ( et == etOptimized && ( m_compiler || m_pprofile ) )
+		{
+			nNext = Threshold( m_policy.nNative );
+		}
+
+		Schedule( nNext );
+	}
+
+	VOID			Work()
+	{
+		std::unique_lock<std::mutex> lock( m_mxRequest );
+		for ( ;; )
+		{
+			m_cvRequest.wait( lock, [ this ] { return m_fRequest || m_fStop; } );
+			if ( m_fStop )
+			{
+				return;
+			}
+
+			m_fRequest = FALSE;
+			lock.unlock();
+			Upgrade();
+			m_fBusy.store( false, std::memory_order_release );
+			lock.lock();
+		}
+	}
+
+	VOID			Promote()
+	{
+		if ( m_fBusy.load( std::memory_order_relaxed ) || m_fBusy.exchange( true, std::memory_order_acquire ) )
+		{
+			return;
+		}
+
+		if ( !m_policy.fBackground )
+		{
+			Upgrade();
+			m_fBusy.store( false, std::memory_order_release );
+			return;
+		}
+
+		// the thread holds the lock only while it takes the request
+		{
+			std::lock_guard<std::mutex> lock( m_mxRequest );
+			m_fRequest = TRUE;
+		}
+
+		m_cvRequest.notify_one();
+	}
+
+public:
+	// compiler - native compiler for etNative tier, may be nullptr
+	CExprTiered( const CExprProgram<NUM> & prog, const CExprOptimizer<NUM> & optimizer,
+		const COMPILER & compiler = nullptr, const EXPR_TIER_POLICY & policy = EXPR_TIER_POLICY() )
+		: m_nEvals( 0 ), m_fBusy( false ), m_fRequest( FALSE ), m_fStop( FALSE ), m_optimizer( optimizer ), m_compiler( compiler ), m_policy( policy )
+	{
+		CODE * pcode = new CODE;
+		pcode->et = etProgram;
+		pcode->prog = prog;
+		Publish( pcode );
+
+		if ( policy.fProfile )
+		{
+			m_pprofile.reset( new CExprProfile<NUM>( prog.Slots().size(), m_optimizer ) );
+		}
+
+		Schedule( policy.nOptimize || !( compiler || policy.fProfile ) ? Threshold( policy.nOptimize ) : Threshold( policy.nNative ) );
+		if ( policy.fBackground && m_nPromoteAt.load( std::memory_order_relaxed ) != size_t( -1 ) )
+		{
+			m_thread = std::thread( [ this ] { Work(); } );
+		}
+	}
+
+	~CExprTiered()
+	{
+		Wait();
+		if ( m_thread.joinable() )
+		{
+			{
+				std::lock_guard<std::mutex> lock( m_mxRequest );
+				m_fStop = TRUE;
+			}
+
+			m_cvRequest.notify_one();
+			m_thread.join();
+		}
+	}
+
+	// may be called by several threads at once, slots must be separate per thread. The sampled
+	// evaluation adds the count of evaluations it stands for, so the threads rarely write the
+	// shared counter
+	NUM				Evaluate( NUM * pSlots )
+	{
+		const size_t uSample = m_uSample.load( std::memory_order_relaxed );
+		if ( !( Random() & uSample ) )
+		{
+			const size_t n = m_nEvals.fetch_add( uSample + 1, std::memory_order_relaxed ) + uSample + 1;
+			if ( n >= m_nPromoteAt.load( std::memory_order_relaxed ) )
+			{
+				Promote();
+			}
+		}
+
+		const CODE * pcode = m_pcode.load( std::memory_order_acquire );
+		if ( pcode->pspec )
+		{
+			return pcode->pspec->Evaluate( pSlots );
+		}
+
+		if ( m_pprofile && pcode->et < etNative )
+		{
+			m_pprofile->Record( pSlots );
+		}
+
+		NUM result;
+		if ( pcode->native )
+		{
+			pcode->prog.Admit( pcode->prog.Nodes().size() );
+			if ( pcode->native( pSlots, result ) )
+			{
+				return result;
+			}
+		}
+
+		return pcode->prog.Execute( pSlots );
+	}
+
+	// waits for the background promotion
+	VOID			Wait()
+	{
+		while ( m_fBusy.load( std::memory_order_acquire ) )
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	EXPR_TIER		Tier() const
+	{
+		return m_pcode.load( std::memory_order_acquire )->et;
+	}
+
+	// estimate of the evaluations, they are counted by samples. It is exact while the next
+	// threshold is below 128
+	size_t			Evaluations() const
+	{
+		return m_nEvals.load( std::memory_order_relaxed );
+	}
+
+	// program of the current tier
+	const CExprProgram<NUM> &	Program() const
+	{
+		const CODE * pcode = m_pcode.load( std::memory_order_acquire );
+		return ( pcode->pspec ? pcode->pspec->Program() : pcode->prog );
+	}
+
+	// specialized program with its guard counters, nullptr until etSpecialized tier
+	const CExprSpecialized<NUM> *	Specialized() const
+	{
+		return m_pcode.load( std::memory_order_acquire )->pspec.get();
+	}
+};
@@ -0,0 +1,509 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Functions of real arguments which values are complex, such as the logarithm of a negative number,
+   give NaN. NaN reaches the result of the row, which is then evaluated again by the program. The
+   roots of negative numbers are complex and stay in the columns */
+
+#include "CMyBatchDD.h"
+#include <algorithm>
+
+static BOOL IsName( const CStringOp & name, LPCTSTR pszName )
+{
+	return ( name == CStringOp( pszName ) );
+}
+
+CMyBatchDD::CMyBatchDD( const CExprProgram<TOKDD> & prog, EXPR_ISA eisa )
+	: m_prog( prog ), m_uSlots( 0 ), m_uNodes( 0 ), m_uScratch( 0 ), m_nEvals( 0 ), m_nFallbacks( 0 )
+{
+	for ( int edd = 0; edd < eddMax; ++edd )
+	{
+		m_vpfn[ edd ] = CExprKernels::DoubleDouble( EXPR_DD_OP( edd ), eisa );
+	}
+
+	m_vslots.resize( m_prog.Slots().size() );
+	m_fNative = Translate();
+}
+
+BOOL CMyBatchDD::Translate()
+{
+	static const struct
+	{
+		EXPR_NODE_TYPE		ent;
+		LPCTSTR				pszName;
+		BATCH_OP			ebd;
+	} vop[] =
+	{
+		{ entBinary, TEXT( "+" ), ebdAdd },
+		{ entBinary, TEXT( "-" ), ebdSub },
+		{ entBinary, TEXT( "*" ), ebdMul },
+		{ entBinary, TEXT( "" ), ebdMul },
+		{ entBinary, TEXT( "/" ), ebdDiv },
+		{ entBinary, TEXT( "^" ), ebdPow },
+		{ entBinary, TEXT( ";" ), ebdSecond },
+		{ entUnary, TEXT( "+" ), ebdCopy },
+		{ entUnary, TEXT( "~" ), ebdConj },
+		{ entUnary, TEXT( "-" ), ebdNeg },
+		{ entUnary, TEXT( "!" ), ebdFact },
+		{ entFunc, TEXT( "" ), ebdCopy },
+		{ entFunc, TEXT( "sin" ), ebdSin },
+		{ entFunc, TEXT( "sinc" ), ebdSinc },
+		{ entFunc, TEXT( "cos" ), ebdCos },
+		{ entFunc, TEXT( "tg" ), ebdTan },
+		{ entFunc, TEXT( "ctg" ), ebdCot },
+		{ entFunc, TEXT( "arcsin" ), ebdArcsin },
+		{ entFunc, TEXT( "arccos" ), ebdArccos },
+		{ entFunc, TEXT( "arctg" ), ebdArctan },
+		{ entFunc, TEXT( "arcctg" ), ebdArccot },
+		{ entFunc, TEXT( "exp" ), ebdExp },
+		{ entFunc, TEXT( "sqrt" ), ebdSqrt },
+		{ entFunc, TEXT( "cbrt" ), ebdCbrt },
+		{ entFunc, TEXT( "pi" ), ebdPi },
+		{ entFunc, TEXT( "e" ), ebdE },
+	};
+
+	// constants referred by the program
+	size_t nConsts = ( m_prog.Result().eat == eatConst ? m_prog.Result().u + 1 : 0 );
+	for ( const auto & node : m_prog.Nodes() )
+	{
+		for ( const auto & arg : node.varg )
+		{
+			if ( arg.eat == eatConst )
+			{
+				nConsts = std::max( nConsts, arg.u + 1 );
+			}
+		}
+	}
+
+	for ( size_t u = 0; u < nConsts; ++u )
+	{
+		if ( m_prog.Const( u ).undef )
+		{
+			return FALSE;
+		}
+	}
+
+	for ( const auto & node : m_prog.Nodes() )
+	{
+		const CStringOp & name = m_prog.TokenName( node );
+		BATCH_NODE bnode;
+		BOOL fFound = FALSE;
+
+		for ( const auto & v : vop )
+		{
+			if ( v.ent == node.ent && IsName( name, v.pszName ) && ( node.varg.size() <= 2 ) )
+			{
+				bnode.ebd = v.ebd;
+				fFound = TRUE;
+				break;
+			}
+		}
+
+		// assignments and the functions of several arguments stay in the program
+		if ( !fFound || node.varg.size() != ( node.ent == entBinary ? 2 : ( bnode.ebd == ebdPi || bnode.ebd == ebdE ? 0 : 1 ) ) )
+		{
+			return FALSE;
+		}
+
+		for ( size_t n = 0; n < node.varg.size(); ++n )
+		{
+			bnode.varg[ n ] = node.varg[ n ];
+		}
+
+		m_vnode.push_back( bnode );
+	}
+
+	m_uSlots = nConsts;
+	m_uNodes = m_uSlots + m_prog.Slots().size();
+	m_uScratch = m_uNodes + m_vnode.size();
+	m_vhi.resize( ( m_uScratch + 5 ) * BATCH_DD_ROWS );
+	m_vlo.resize( m_vhi.size() );
+	m_vihi.resize( m_vhi.size() );
+	m_vilo.resize( m_vhi.size() );
+	m_vcomplex.resize( m_uScratch + 5 );
+
+	// columns of the constants are filled once
+	for ( size_t u = 0; u < nConsts; ++u )
+	{
+		const TOKDD & c = m_prog.Const( u );
+		std::fill_n( m_vhi.begin() + u * BATCH_DD_ROWS, BATCH_DD_ROWS, c.v.re.hi );
+		std::fill_n( m_vlo.begin() + u * BATCH_DD_ROWS, BATCH_DD_ROWS, c.v.re.lo );
+		std::fill_n( m_vihi.begin() + u * BATCH_DD_ROWS, BATCH_DD_ROWS, c.v.im.hi );
+		std::fill_n( m_vilo.begin() + u * BATCH_DD_ROWS, BATCH_DD_ROWS, c.v.im.lo );
+		m_vcomplex[ u ] = ( c.v.im.hi != 0 );
+	}
+
+	m_vfallback.resize( BATCH_DD_ROWS );
+	return TRUE;
+}
+
+size_t CMyBatchDD::Column( const EXPR_ARG & arg ) const
+{
+	switch ( arg.eat )
+	{
+		case eatConst: return arg.u;
+		case eatSlot: return m_uSlots + arg.u;
+		default: return m_uNodes + arg.u;
+	}
+}
+
+EXPR_DD_ARRAY CMyBatchDD::Array( size_t uColumn )
+{
+	EXPR_DD_ARRAY a = { m_vhi.data() + uColumn * BATCH_DD_ROWS, m_vlo.data() + uColumn * BATCH_DD_ROWS };
+	return a;
+}
+
+EXPR_DD_ARRAY CMyBatchDD::Imag( size_t uColumn )
+{
+	EXPR_DD_ARRAY a = { m_vihi.data() + uColumn * BATCH_DD_ROWS, m_vilo.data() + uColumn * BATCH_DD_ROWS };
+	return a;
+}
+
+// z = f( x, y ) over the rows of the chunk, uY is ignored by the functions of one argument
+VOID CMyBatchDD::Kernel( EXPR_DD_OP edd, size_t uX, size_t uY, size_t uZ, size_t cRows )
+{
+	const EXPR_DD_ARRAY x[ 2 ] = { Array( uX ), Imag( uX ) }, y[ 2 ] = { Array( uY ), Imag( uY ) }, z[ 2 ] = { Array( uZ ), Imag( uZ ) };
+	m_vpfn[ edd ]( x, y, z, cRows );
+}
+
+// arithmetic of real columns by the real kernel, otherwise the real one gets zero imaginary part
+VOID CMyBatchDD::Binary( EXPR_DD_OP edd, EXPR_DD_OP eddComplex, size_t uX, size_t uY, size_t uZ, size_t cRows )
+{
+	m_vcomplex[ uZ ] = ( m_vcomplex[ uX ] || m_vcomplex[ uY ] );
+	if ( !m_vcomplex[ uZ ] )
+	{
+		Kernel( edd, uX, uY, uZ, cRows );
+		return;
+	}
+
+	for ( const size_t u : { uX, uY } )
+	{
+		if ( !m_vcomplex[ u ] )
+		{
+			std::fill_n( Imag( u ).hi, cRows, 0.0 );
+			std::fill_n( Imag( u ).lo, cRows, 0.0 );
+		}
+	}
+
+	Kernel( eddComplex, uX, uY, uZ, cRows );
+}
+
+// real argument of a function in column uQ: NaN where the value is complex or fnInside( x ) fails
+template <class FN>
+size_t CMyBatchDD::Domain( size_t uX, size_t uQ, size_t cRows, FN fnInside )
+{
+	const EXPR_DD_ARRAY x = Array( uX ), xi = Imag( uX ), q = Array( uQ );
+	const BOOL fComplex = m_vcomplex[ uX ];
+	for ( size_t i = 0; i < cRows; ++i )
+	{
+		const bool fReal = ( !fComplex || xi.hi[ i ] == 0 );
+		q.hi[ i ] = ( fReal && fnInside( x.hi[ i ] ) ? x.hi[ i ] : std::numeric_limits<double>::quiet_NaN() );
+		q.lo[ i ] = x.lo[ i ];
+	}
+
+	m_vcomplex[ uQ ] = FALSE;
+	return uQ;
+}
+
+VOID CMyBatchDD::Node( const BATCH_NODE & node, size_t uZ, size_t cRows )
+{
+	const size_t uT = m_uScratch, uS = m_uScratch + 1, uR = m_uScratch + 2, uP = m_uScratch + 3, uX = m_uScratch + 4;
+	const size_t uA = Column( node.varg[ 0 ] ), uB = Column( node.varg[ 1 ] );
+	const BOOL fA = m_vcomplex[ uA ], fB = m_vcomplex[ uB ];
+	const EXPR_DD_ARRAY z = Array( uZ ), zi = Imag( uZ ), t = Array( uT );
+
+	// functions take the real argument q
+	const size_t uQ = ( node.ebd >= ebdFact && node.ebd < ebdPi ? Domain( uA, uX, cRows, [ &node ]( double x )
+		{
+			switch ( node.ebd )
+			{
+				case ebdArcsin: case ebdArccos: return ( std::fabs( x ) <= 1 );
+				case ebdArccot: case ebdCbrt: return ( x != 0 );
+				default: return true;
+			}
+		} ) : uA );
+	const EXPR_DD_ARRAY q = Array( uQ );
+
+	m_vcomplex[ uZ ] = FALSE;
+	switch ( node.ebd )
+	{
+		case ebdAdd: Binary( eddAdd, eddCAdd, uA, uB, uZ, cRows ); break;
+		case ebdSub: Binary( eddSub, eddCSub, uA, uB, uZ, cRows ); break;
+		case ebdMul: Binary( eddMul, eddCMul, uA, uB, uZ, cRows ); break;
+		case ebdDiv: Binary( eddDiv, eddCDiv, uA, uB, uZ, cRows ); break;
+		case ebdPow:
+			{
+				// real base and exponent, zero base is left to the program
+				const EXPR_DD_ARRAY x = Array( Domain( uA, uX, cRows, []( double d ) { return d != 0; } ) );
+				const EXPR_DD_ARRAY y = Array( Domain( uB, uP, cRows, []( double ) { return true; } ) );
+
+				// integer exponents by repeated squaring as the program
+				size_t nInt = 0;
+				for ( size_t i = 0; i < cRows; ++i )
+				{
+					const double n = y.hi[ i ];
+					nInt += ( y.lo[ i ] == 0 && n == std::floor( n ) && n != 0 && std::fabs( n ) <= POW_INT_MAX ? 1 : 0 );
+				}
+
+				if ( nInt < cRows )
+				{
+					// a^b = exp( b log a ), NaN for negative base
+					Kernel( eddLog, uX, uX, uS, cRows );
+					Kernel( eddMul, uP, uS, uR, cRows );
+					Kernel( eddExp, uR, uR, uZ, cRows );
+				}
+
+				for ( size_t i = 0; i < cRows && nInt; ++i )
+				{
+					const double n = y.hi[ i ];
+					if ( y.lo[ i ] == 0 && n == std::floor( n ) && n != 0 && std::fabs( n ) <= POW_INT_MAX )
+					{
+						const CDoubleDouble r = PowInt( CDoubleDouble( x.hi[ i ], x.lo[ i ] ), long( n ) );
+						z.hi[ i ] = r.hi;
+						z.lo[ i ] = r.lo;
+					}
+				}
+				break;
+			}
+		case ebdSecond:
+		case ebdCopy:
+		case ebdNeg:
+		case ebdConj:
+			{
+				const size_t uV = ( node.ebd == ebdSecond ? uB : uA );
+				const EXPR_DD_ARRAY v = Array( uV ), vi = Imag( uV );
+				const double dRe = ( node.ebd == ebdNeg ? -1.0 : 1.0 ), dIm = ( node.ebd == ebdNeg || node.ebd == ebdConj ? -1.0 : 1.0 );
+				m_vcomplex[ uZ ] = ( node.ebd == ebdSecond ? fB : fA );
+				for ( size_t i = 0; i < cRows; ++i )
+				{
+					z.hi[ i ] = dRe * v.hi[ i ];
+					z.lo[ i ] = dRe * v.lo[ i ];
+				}
+
+				for ( size_t i = 0; i < cRows && m_vcomplex[ uZ ]; ++i )
+				{
+					zi.hi[ i ] = dIm * vi.hi[ i ];
+					zi.lo[ i ] = dIm * vi.lo[ i ];
+				}
+				break;
+			}
+		case ebdFact:
+			for ( size_t i = 0; i < cRows; ++i )
+			{
+				// gamma function has long double precision as in the program
+				const CDoubleDouble r( std::tgamma( static_cast<long double>( CDoubleDouble( q.hi[ i ], q.lo[ i ] ) ) + 1.0L ) );
+				z.hi[ i ] = r.hi;
+				z.lo[ i ] = r.lo;
+			}
+			break;
+		case ebdSin: Kernel( eddSin, uQ, uQ, uZ, cRows ); break;
+		case ebdSinc:
+			Kernel( eddSin, uQ, uQ, uT, cRows );
+			Kernel( eddDiv, uT, uQ, uZ, cRows );
+			break;
+		case ebdCos: Kernel( eddCos, uQ, uQ, uZ, cRows ); break;
+		case ebdTan:
+		case ebdCot:
+			Kernel( eddSin, uQ, uQ, uT, cRows );
+			Kernel( eddCos, uQ, uQ, uS, cRows );
+			Kernel( eddDiv, ( node.ebd == ebdTan ? uT : uS ), ( node.ebd == ebdTan ? uS : uT ), uZ, cRows );
+			break;
+		case ebdArctan: Kernel( eddAtan, uQ, uQ, uZ, cRows ); break;
+		case ebdArccot:
+			std::fill_n( t.hi, cRows, 1.0 );
+			std::fill_n( t.lo, cRows, 0.0 );
+			Kernel( eddDiv, uT, uQ, uS, cRows );
+			Kernel( eddAtan, uS, uS, uZ, cRows );
+			break;
+		case ebdArcsin:
+		case ebdArccos:
+			{
+				// s = sqrt( 1 - x^2 ), arcsin( x ) = 2 atan( x / ( 1 + s ) ) and arccos( x ) = 2 atan( s / ( 1 + x ) )
+				std::fill_n( t.hi, cRows, 1.0 );
+				std::fill_n( t.lo, cRows, 0.0 );
+				Kernel( eddSub, uT, uQ, uS, cRows );
+				Kernel( eddAdd, uT, uQ, uR, cRows );
+				Kernel( eddMul, uS, uR, uZ, cRows );
+				Kernel( eddSqrt, uZ, uZ, uS, cRows );
+				if ( node.ebd == ebdArcsin )
+				{
+					Kernel( eddAdd, uT, uS, uZ, cRows );
+					Kernel( eddDiv, uQ, uZ, uR, cRows );
+					Kernel( eddAtan, uR, uR, uZ, cRows );
+				}
+				else
+				{
+					Kernel( eddDiv, uS, uR, uT, cRows );
+					Kernel( eddAtan, uT, uT, uZ, cRows );
+				}
+
+				for ( size_t i = 0; i < cRows; ++i )
+				{
+					z.hi[ i ] *= 2;
+					z.lo[ i ] *= 2;
+				}
+				break;
+			}
+		case ebdExp: Kernel( eddExp, uQ, uQ, uZ, cRows ); break;
+		case ebdSqrt:
+		case ebdCbrt:
+			{
+				// roots of |x|, the principal root of a negative number is turned by pi/2 or by pi/3
+				BOOL fNegative = FALSE;
+				for ( size_t i = 0; i < cRows; ++i )
+				{
+					const double dSign = ( q.hi[ i ] < 0 ? -1.0 : 1.0 );
+					fNegative |= ( dSign < 0 );
+					t.hi[ i ] = dSign * q.hi[ i ];
+					t.lo[ i ] = dSign * q.lo[ i ];
+				}
+
+				if ( node.ebd == ebdSqrt )
+				{
+					Kernel( eddSqrt, uT, uT, uS, cRows );
+				}
+				else
+				{
+					// exp( log( |x| ) / 3 )
+					const CDoubleDouble third = CDoubleDouble( 1.0 ) / CDoubleDouble( 3.0 );
+					Kernel( eddLog, uT, uT, uS, cRows );
+					std::fill_n( t.hi, cRows, third.hi );
+					std::fill_n( t.lo, cRows, third.lo );
+					Kernel( eddMul, uS, uT, uR, cRows );
+					Kernel( eddExp, uR, uR, uS, cRows );
+				}
+
+				// cos and sin of the turn
+				const EXPR_DD_ARRAY r = Array( uS );
+				const double dCos = ( node.ebd == ebdSqrt ? 0.0 : 0.5 );
+				const CDoubleDouble sin = ( node.ebd == ebdSqrt ? CDoubleDouble( 1.0 ) : CDoubleDouble::Sqrt( CDoubleDouble( 0.75 ) ) );
+				m_vcomplex[ uZ ] = fNegative;
+				for ( size_t i = 0; i < cRows; ++i )
+				{
+					const double d = ( q.hi[ i ] < 0 ? dCos : 1.0 );
+					z.hi[ i ] = d * r.hi[ i ];
+					z.lo[ i ] = d * r.lo[ i ];
+				}
+
+				for ( size_t i = 0; i < cRows && fNegative; ++i )
+				{
+					const CDoubleDouble v = ( q.hi[ i ] < 0 ? CDoubleDouble( r.hi[ i ], r.lo[ i ] ) * sin : CDoubleDouble( 0.0 ) );
+					zi.hi[ i ] = v.hi;
+					zi.lo[ i ] = v.lo;
+				}
+				break;
+			}
+		case ebdPi:
+		case ebdE:
+			{
+				const CDoubleDouble c = ( node.ebd == ebdPi ? CDoubleDouble::Pi() : CDoubleDouble::E() );
+				std::fill_n( z.hi, cRows, c.hi );
+				std::fill_n( z.lo, cRows, c.lo );
+				break;
+			}
+	}
+}
+
+VOID CMyBatchDD::Chunk( const TOKDD * pRows, size_t cRows, TOKDD * pResult )
+{
+	const size_t nslots = m_vslots.size();
+	for ( size_t u = 0; u < nslots; ++u )
+	{
+		m_vcomplex[ m_uSlots + u ] = FALSE;
+	}
+
+	for ( size_t i = 0; i < cRows; ++i )
+	{
+		m_vfallback[ i ] = FALSE;
+		for ( size_t u = 0; u < nslots; ++u )
+		{
+			const TOKDD & tok = pRows[ i * nslots + u ];
+			const EXPR_DD_ARRAY c = Array( m_uSlots + u ), ci = Imag( m_uSlots + u );
+			m_vfallback[ i ] |= tok.undef;
+			m_vcomplex[ m_uSlots + u ] |= ( tok.v.im.hi != 0 );
+			c.hi[ i ] = tok.v.re.hi;
+			c.lo[ i ] = tok.v.re.lo;
+			ci.hi[ i ] = tok.v.im.hi;
+			ci.lo[ i ] = tok.v.im.lo;
+		}
+	}
+
+	for ( size_t u = 0; u < m_vnode.size(); ++u )
+	{
+		Node( m_vnode[ u ], m_uNodes + u, cRows );
+	}
+
+	const size_t uResult = Column( m_prog.Result() );
+	const EXPR_DD_ARRAY r = Array( uResult ), ri = Imag( uResult );
+	const BOOL fComplex = m_vcomplex[ uResult ];
+	for ( size_t i = 0; i < cRows; ++i )
+	{
+		const CDoubleDouble re( r.hi[ i ], r.lo[ i ] ), im = ( fComplex ? CDoubleDouble( ri.hi[ i ], ri.lo[ i ] ) : CDoubleDouble( 0.0 ) );
+		if ( !m_vfallback[ i ] && std::isfinite( re.hi ) && std::isfinite( re.lo ) && std::isfinite( im.hi ) && std::isfinite( im.lo ) )
+		{
+			pResult[ i ] = TOKDD( re, im );
+			continue;
+		}
+
+		m_nFallbacks.fetch_add( 1, std::memory_order_relaxed );
+		std::copy( pRows + i * nslots, pRows + ( i + 1 ) * nslots, m_vslots.begin() );
+		pResult[ i ] = m_prog.Execute( m_vslots.data() );
+	}
+}
+
+VOID CMyBatchDD::Evaluate( const TOKDD * pRows, size_t nRows, TOKDD * pResult )
+{
+	m_nEvals.fetch_add( nRows, std::memory_order_relaxed );
+
+	const size_t nslots = m_vslots.size();
+	if ( !m_fNative )
+	{
+		m_nFallbacks.fetch_add( nRows, std::memory_order_relaxed );
+		for ( size_t n = 0; n < nRows; ++n )
+		{
+			std::copy( pRows + n * nslots, pRows + ( n + 1 ) * nslots, m_vslots.begin() );
+			pResult[ n ] = m_prog.Execute( m_vslots.data() );
+		}
+
+		return;
+	}
+
+	for ( size_t n = 0; n < nRows; n += BATCH_DD_ROWS )
+	{
+		const size_t cRows = std::min<size_t>( BATCH_DD_ROWS, nRows - n );
+		Chunk( pRows + n * nslots, cRows, pResult + n );
+	}
+}
+
+BOOL CMyBatchDD::Native() const
+{
+	return m_fNative;
+}
+
+size_t CMyBatchDD::Evaluations() const
+{
+	return m_nEvals.load( std::memory_order_relaxed );
+}
+
+size_t CMyBatchDD::Fallbacks() const
+{
+	return m_nFallbacks.load( std::memory_order_relaxed );
+}
+
+double CMyBatchDD::FallbackRate() const
+{
+	const size_t nEvals = Evaluations();
+	return ( nEvals ? double( Fallbacks() ) / nEvals : 0.0 );
+}
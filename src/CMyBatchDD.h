@@ -0,0 +1,108 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Batch evaluation of CMyParserDD programs. The program is evaluated over chunks of rows by the
+   double-double kernels of CExprKernels, one kernel call per node and chunk. Arithmetic takes
+   complex values, functions take real ones. Rows with undefined variables, with complex
+   arguments of functions or which result is not finite are evaluated again by the program */
+
+#pragma once
+
+#include "CMyParserDD.h"
+#include "CExprKernels.h"
+#include <atomic>
+
+// rows of a chunk, the columns of a chunk fit in L1 for programs of a few dozens of nodes
+#define BATCH_DD_ROWS		256
+
+class CMyBatchDD
+{
+	typedef enum _tagBATCH_OP
+	{
+		ebdAdd,
+		ebdSub,
+		ebdMul,
+		ebdDiv,
+		ebdPow,
+		ebdSecond,		// ';'
+		ebdCopy,		// unary '+' and brackets
+		ebdNeg,
+		ebdConj,
+		ebdFact,
+		ebdSin,
+		ebdSinc,
+		ebdCos,
+		ebdTan,
+		ebdCot,
+		ebdArcsin,
+		ebdArccos,
+		ebdArctan,
+		ebdArccot,
+		ebdExp,
+		ebdSqrt,
+		ebdCbrt,
+		ebdPi,
+		ebdE
+	} BATCH_OP;
+
+	typedef struct _tagBATCH_NODE
+	{
+		BATCH_OP		ebd;
+		EXPR_ARG		varg[ 2 ];
+	} BATCH_NODE;
+
+	CExprProgram<TOKDD>					m_prog;
+	BOOL								m_fNative;
+	std::vector<BATCH_NODE>				m_vnode;
+	PEXPR_DD_KERNEL						m_vpfn[ eddMax ];
+	// columns of BATCH_DD_ROWS values: constants, slots, nodes and five scratch ones. Imaginary
+	// parts of a column are read only if it is complex in the current chunk
+	std::vector<double>					m_vhi, m_vlo, m_vihi, m_vilo;
+	std::vector<BOOL>					m_vcomplex;
+	size_t								m_uSlots, m_uNodes, m_uScratch;
+	std::vector<BOOL>					m_vfallback;
+	std::vector<TOKDD>					m_vslots;
+	std::atomic<size_t>					m_nEvals;
+	std::atomic<size_t>					m_nFallbacks;
+
+	CMyBatchDD( const CMyBatchDD & );
+	CMyBatchDD & operator=( const CMyBatchDD & );
+
+	BOOL			Translate();
+	size_t			Column( const EXPR_ARG & arg ) const;
+	EXPR_DD_ARRAY	Array( size_t uColumn );
+	EXPR_DD_ARRAY	Imag( size_t uColumn );
+	VOID			Kernel( EXPR_DD_OP edd, size_t uX, size_t uY, size_t uZ, size_t cRows );
+	VOID			Binary( EXPR_DD_OP edd, EXPR_DD_OP eddComplex, size_t uX, size_t uY, size_t uZ, size_t cRows );
+	template <class FN>
+	size_t			Domain( size_t uX, size_t uQ, size_t cRows, FN fnInside );
+	VOID			Node( const BATCH_NODE & node, size_t uZ, size_t cRows );
+	VOID			Chunk( const TOKDD * pRows, size_t cRows, TOKDD * pResult );
+
+public:
+	// prog - program in complex double-double, eisa - instruction set of the kernels.
+	// Programs with assignments or complex constants are never run by the kernels
+	CMyBatchDD( const CExprProgram<TOKDD> & prog, EXPR_ISA eisa = CExprKernels::Isa() );
+
+	// evaluates the rows, pRows are nRows x Slots() values of the program. Not thread
+	// safe: the columns are members, use one instance per thread
+	VOID			Evaluate( const TOKDD * pRows, size_t nRows, TOKDD * pResult );
+
+	BOOL			Native() const;
+	size_t			Evaluations() const;
+	// rows evaluated by the program
+	size_t			Fallbacks() const;
+	double			FallbackRate() const;
+};
@@ -0,0 +1,329 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Ahead-of-time code generator. Emits the program of CMyParser as standalone C++ function,
+   each node becomes one statement calling the same math as lambdas of CMyParser */
+
+#include "CMyCodeGen.h"
+
+CMyCodeGen::CMyCodeGen( const CExprProgram<TOK> & prog, BOOL fReal )
+	: m_prog( prog ), m_fReal( fReal )
+{
+
+}
+
+CStringOp CMyCodeGen::Number( const TOK & d ) const
+{
+	// hexadecimal literals keep the value exact
+	if ( m_fReal )
+	{
+		if ( d.v.imag() != 0 )
+		{
+			throw CExprParserException( TEXT( "Complex constant in the real function" ) );
+		}
+
+		return CStringOp().Format( TEXT( "%a" ), double( d.v.real() ) );
+	}
+
+	CStringOp s = m_sName;
+	s += CStringOp().Format( TEXT( "_num( %LaL, %LaL )" ), d.v.real(), d.v.imag() );
+	return s;
+}
+
+CStringOp CMyCodeGen::Arg( const EXPR_ARG & arg ) const
+{
+	switch ( arg.eat )
+	{
+		case eatConst: return Number( m_prog.Const( arg.u ) );
+		case eatSlot: return CStringOp( TEXT( "v_" ) ) += m_prog.Slots()[ arg.u ];
+		default: return CStringOp().Format( TEXT( "r%ld" ), arg.u );
+	}
+}
+
+CStringOp CMyCodeGen::Unary( const EXPR_NODE & node, const CStringOp & a ) const
+{
+	const CStringOp & name = m_prog.TokenName( node );
+	CStringOp s;
+
+	if ( name == CStringOp( TEXT( "+" ) ) )
+	{
+		s += a;
+	}
+	else if ( name == CStringOp( TEXT( "-" ) ) )
+	{
+		s += TEXT( "-" ); s += a;
+	}
+	else if ( name == CStringOp( TEXT( "~" ) ) )
+	{
+		if ( m_fReal )
+		{
+			s += a;
+		}
+		else
+		{
+			s += TEXT( "std::conj( " ); s += a; s += TEXT( " )" );
+		}
+	}
+	else if ( name == CStringOp( TEXT( "!" ) ) )
+	{
+		s += m_sName; s += TEXT( "_fact( " ); s += a; s += TEXT( " )" );
+	}
+	else
+	{
+		throw CExprParserException( TEXT( "Unsupported unary operator" ), node.uAtChar );
+	}
+
+	return s;
+}
+
+CStringOp CMyCodeGen::Binary( const EXPR_NODE & node, const CStringOp & a, const CStringOp & b ) const
+{
+	const CStringOp & name = m_prog.TokenName( node );
+	CStringOp s;
+
+	if ( name == CStringOp( TEXT( "+" ) ) || name == CStringOp( TEXT( "-" ) ) || name == CStringOp( TEXT( "*" ) ) || name == CStringOp( TEXT( "/" ) ) )
+	{
+		s += a; s += TEXT( " " ); s += name; s += TEXT( " " ); s += b;
+	}
+	else if ( !name.GetLength() )
+	{
+		// implicit multiplication
+		s += a; s += TEXT( " * " ); s += b;
+	}
+	else if ( name == CStringOp( TEXT( "^" ) ) )
+	{
+		s += TEXT( "std::pow( " ); s += a; s += TEXT( ", " ); s += b; s += TEXT( " )" );
+	}
+	else if ( name == CStringOp( TEXT( ";" ) ) )
+	{
+		s += b;
+	}
+	else if ( name == CStringOp( TEXT( "<" ) ) || name == CStringOp( TEXT( ">" ) ) )
+	{
+		// real parts are compared as by CMyParser
+		s += TEXT( "( std::real( " ); s += a; s += TEXT( " ) " ); s += name; s += TEXT( " std::real( " ); s += b; s += TEXT( " ) ? " );
+		s += Number( 1.0 ); s += TEXT( " : " ); s += Number( 0.0 ); s += TEXT( " )" );
+	}
+	else
+	{
+		throw CExprParserException( TEXT( "Unsupported operator" ), node.uAtChar );
+	}
+
+	return s;
+}
+
+CStringOp CMyCodeGen::Func( const EXPR_NODE & node, const std::vector<CStringOp> & vargs ) const
+{
+	static const struct
+	{
+		LPCTSTR		pszName;
+		LPCTSTR		pszPrefix;
+		LPCTSTR		pszSuffix;
+	} vfunc[] =
+	{
+		{ TEXT( "" ), TEXT( "( " ), TEXT( " )" ) },
+		{ TEXT( "sin" ), TEXT( "std::sin( " ), TEXT( " )" ) },
+		{ TEXT( "cos" ), TEXT( "std::cos( " ), TEXT( " )" ) },
+		{ TEXT( "tg" ), TEXT( "std::tan( " ), TEXT( " )" ) },
+		{ TEXT( "arcsin" ), TEXT( "std::asin( " ), TEXT( " )" ) },
+		{ TEXT( "arccos" ), TEXT( "std::acos( " ), TEXT( " )" ) },
+		{ TEXT( "arctg" ), TEXT( "std::atan( " ), TEXT( " )" ) },
+		{ TEXT( "exp" ), TEXT( "std::exp( " ), TEXT( " )" ) },
+		{ TEXT( "sqrt" ), TEXT( "std::sqrt( " ), TEXT( " )" ) },
+		{ TEXT( "cbrt" ), TEXT( "std::pow( " ), TEXT( ", 1.0 / 3.0 )" ) },
+	};
+
+	const CStringOp & name = m_prog.TokenName( node );
+	CStringOp s;
+
+	if ( name == CStringOp( TEXT( "sinc" ) ) && vargs.size() == 1 )
+	{
+		s += TEXT( "std::sin( " ); s += vargs[ 0 ]; s += TEXT( " ) / " ); s += vargs[ 0 ];
+		return s;
+	}
+	else if ( ( name == CStringOp( TEXT( "ctg" ) ) || name == CStringOp( TEXT( "arcctg" ) ) ) && vargs.size() == 1 )
+	{
+		CStringOp one = Number( 1.0 );
+		if ( name == CStringOp( TEXT( "ctg" ) ) )
+		{
+			s += one; s += TEXT( " / std::tan( " ); s += vargs[ 0 ]; s += TEXT( " )" );
+		}
+		else
+		{
+			s += TEXT( "std::atan( " ); s += one; s += TEXT( " / " ); s += vargs[ 0 ]; s += TEXT( " )" );
+		}
+		return s;
+	}
+	else if ( name == CStringOp( TEXT( "pi" ) ) && !vargs.size() )
+	{
+		return Number( M_PIC );
+	}
+	else if ( name == CStringOp( TEXT( "e" ) ) && !vargs.size() )
+	{
+		return Number( std::exp( 1 ) );
+	}
+
+	// arguments of the lazy functions are evaluated by the statements before, so the choice
+	// is a select without branches and the batch loop may be vectorized
+	auto truth = [ this ]( const CStringOp & a )
+	{
+		CStringOp s( TEXT( "( " ) );
+		s += a; s += TEXT( " != " ); s += Number( 0.0 ); s += TEXT( " )" );
+		return s;
+	};
+
+	if ( name == CStringOp( TEXT( "select" ) ) && vargs.size() == 3 )
+	{
+		s += TEXT( "( " ); s += truth( vargs[ 0 ] ); s += TEXT( " ? " ); s += vargs[ 1 ]; s += TEXT( " : " ); s += vargs[ 2 ]; s += TEXT( " )" );
+		return s;
+	}
+	else if ( ( name == CStringOp( TEXT( "and" ) ) || name == CStringOp( TEXT( "or" ) ) ) && vargs.size() == 2 )
+	{
+		s += TEXT( "( ( " ); s += truth( vargs[ 0 ] ); s += ( name == CStringOp( TEXT( "and" ) ) ? TEXT( " & " ) : TEXT( " | " ) ); s += truth( vargs[ 1 ] );
+		s += TEXT( " ) ? " ); s += Number( 1.0 ); s += TEXT( " : " ); s += Number( 0.0 ); s += TEXT( " )" );
+		return s;
+	}
+
+	for ( const auto & v : vfunc )
+	{
+		if ( name == CStringOp( v.pszName ) && vargs.size() == 1 )
+		{
+			s += v.pszPrefix; s += vargs[ 0 ]; s += v.pszSuffix;
+			return s;
+		}
+	}
+
+	throw CExprParserNoSuchFunction( name.GetString(), node.uAtChar );
+}
+
+CStringOp CMyCodeGen::Statement( size_t uNode ) const
+{
+	const EXPR_NODE & node = m_prog.Nodes()[ uNode ];
+	std::vector<CStringOp> vargs;
+	for ( const auto & v : node.varg )
+	{
+		vargs.push_back( Arg( v ) );
+	}
+
+	CStringOp s( TEXT( "\t" ) );
+
+	// the arguments of lazy functions are evaluated unconditionally, see Func
+	if ( m_prog.Conditional( uNode ) && !( m_prog.Attributes( node ) & efaPure ) )
+	{
+		throw CExprParserException( TEXT( "Impure operator in the argument of lazy function" ), node.uAtChar );
+	}
+
+	// assignment changes the local copy of variable, result is the new value
+	if ( node.ent == entBinary && m_prog.TokenName( node ) == CStringOp( TEXT( "=" ) ) )
+	{
+		if ( node.varg[ 0 ].eat != eatSlot )
+		{
+			throw CExprParserCantAssignNumeric( node.uAtChar );
+		}
+
+		s += vargs[ 0 ]; s += TEXT( " = " ); s += vargs[ 1 ]; s += TEXT( ";\n\t" );
+	}
+
+	s += TEXT( "const " ); s += m_sName; s += TEXT( "_num " ); s += Arg( EXPR_ARG( eatNode, uNode ) ); s += TEXT( " = " );
+
+	switch ( node.ent )
+	{
+		case entUnary: s += Unary( node, vargs[ 0 ] ); break;
+		case entBinary: s += ( m_prog.TokenName( node ) == CStringOp( TEXT( "=" ) ) ? vargs[ 0 ] : Binary( node, vargs[ 0 ], vargs[ 1 ] ) ); break;
+		case entFunc: s += Func( node, vargs ); break;
+	}
+
+	s += TEXT( ";\n" );
+	return s;
+}
+
+CStringOp CMyCodeGen::Generate( LPCTSTR pszName, LPCTSTR pszExpression )
+{
+	const size_t nslots = m_prog.Slots().size();
+	const CStringOp & name = m_sName = pszName;
+	CStringOp s;
+
+	s += TEXT( "/* Generated by mexprgen from: " ); s += pszExpression; s += TEXT( " */\n\n" );
+	s += TEXT( "#pragma once\n\n#include <complex>\n#include <cmath>\n#include <stddef.h>\n\n" );
+
+	s += TEXT( "typedef " ); s += ( m_fReal ? TEXT( "double" ) : TEXT( "std::complex<long double>" ) ); s += TEXT( " " ); s += name; s += TEXT( "_num;\n\n" );
+
+	// expression and variables list for the caller
+	s += TEXT( "static const char * const " ); s += name; s += TEXT( "_expression = \"" );
+	for ( LPCTSTR psz = pszExpression; *psz; ++psz )
+	{
+		if ( *psz == _T( '"' ) || *psz == _T( '\\' ) )
+		{
+			s += _T( '\\' );
+		}
+		s += *psz;
+	}
+	s += TEXT( "\";\n" );
+
+	s += TEXT( "static const size_t " ); s += name; s += CStringOp().Format( TEXT( "_nvars = %ld;\n" ), nslots );
+	s += TEXT( "static const char * const " ); s += name; s += TEXT( "_vars[] = { " );
+	for ( const auto & v : m_prog.Slots() )
+	{
+		s += TEXT( "\"" ); s += v; s += TEXT( "\", " );
+	}
+	s += TEXT( "nullptr };\n\n" );
+
+	// factorial is the same as unFact of CMyParser
+	s += TEXT( "static inline " ); s += name; s += TEXT( "_num " ); s += name; s += TEXT( "_fact( const " ); s += name; s += TEXT( "_num & a )\n{\n" );
+	if ( m_fReal )
+	{
+		s += TEXT( "\treturn std::tgamma( a + 1.0 );\n}\n\n" );
+	}
+	else
+	{
+		s += TEXT( "\treturn ( std::abs( a.imag() ) < 1e-11 ? " ); s += name; s += TEXT( "_num( std::tgamma( a.real() + 1.0L ) ) : " );
+		s += name; s += TEXT( "_num( NAN, NAN ) );\n}\n\n" );
+	}
+
+	// x[ i ] is the value of variable _vars[ i ]
+	s += TEXT( "static inline " ); s += name; s += TEXT( "_num " ); s += name; s += TEXT( "( const " ); s += name; s += TEXT( "_num * x )\n{\n" );
+	for ( size_t u = 0; u < nslots; ++u )
+	{
+		s += TEXT( "\t" ); s += name; s += TEXT( "_num " ); s += Arg( EXPR_ARG( eatSlot, u ) ); s += CStringOp().Format( TEXT( " = x[ %ld ];\n" ), u );
+	}
+	s += TEXT( "\n" );
+
+	for ( size_t u = 0; u < m_prog.Nodes().size(); ++u )
+	{
+		s += Statement( u );
+	}
+
+	s += TEXT( "\treturn " ); s += Arg( m_prog.Result() ); s += TEXT( ";\n}\n\n" );
+
+	// batch over columns, cols[ i ] are the values of variable _vars[ i ]
+	s += TEXT( "static void " ); s += name; s += TEXT( "_batch( const " ); s += name; s += TEXT( "_num * const * cols, " );
+	s += name; s += TEXT( "_num * out, size_t n )\n{\n\tfor ( size_t i = 0; i < n; ++i )\n\t{\n" );
+	if ( nslots )
+	{
+		s += TEXT( "\t\tconst " ); s += name; s += TEXT( "_num x[] = { " );
+		for ( size_t u = 0; u < nslots; ++u )
+		{
+			s += CStringOp().Format( TEXT( "cols[ %ld ][ i ], " ), u );
+		}
+		s += TEXT( "};\n\t\tout[ i ] = " ); s += name; s += TEXT( "( x );\n" );
+	}
+	else
+	{
+		s += TEXT( "\t\tout[ i ] = " ); s += name; s += TEXT( "( nullptr );\n" );
+	}
+	s += TEXT( "\t}\n}\n" );
+
+	return s;
+}
@@ -0,0 +1,41 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Header of ahead-of-time C++ code generator for programs of CMyParser */
+
+#pragma once
+
+#include "CMyParser.h"
+#include "CExprProgram.h"
+
+class CMyCodeGen
+{
+	const CExprProgram<TOK> &	m_prog;
+	BOOL						m_fReal;
+	CStringOp					m_sName;
+
+	CStringOp		Number( const TOK & d ) const;
+	CStringOp		Arg( const EXPR_ARG & arg ) const;
+	CStringOp		Unary( const EXPR_NODE & node, const CStringOp & a ) const;
+	CStringOp		Binary( const EXPR_NODE & node, const CStringOp & a, const CStringOp & b ) const;
+	CStringOp		Func( const EXPR_NODE & node, const std::vector<CStringOp> & vargs ) const;
+	CStringOp		Statement( size_t uNode ) const;
+
+public:
+	// fReal - generate function of doubles instead of std::complex<long double>
+	CMyCodeGen( const CExprProgram<TOK> & prog, BOOL fReal = FALSE );
+
+	CStringOp		Generate( LPCTSTR pszName, LPCTSTR pszExpression );
+};
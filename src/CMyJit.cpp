@@ -0,0 +1,661 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* x86-64 JIT compiler. Emits SSE2 scalar code for the real subset of CMyParser programs:
+   node values live in xmm2..xmm15 and spill to the stack frame, variables are read from
+   the slots array (rbx), transcendental functions are called from libm */
+
+#include "CMyJit.h"
+#include <string.h>
+
+#if defined( __x86_64__ ) && defined( __linux__ )
+#include <sys/mman.h>
+#define MYJIT_SUPPORTED
+#endif
+
+#define JIT_FREE			size_t( -1 )
+#define JIT_FIRSTREG		2
+#define JIT_LASTREG			15
+
+// SSE2 opcodes
+#define SSE_F2				0xF2
+#define SSE_66				0x66
+#define SSE_MOVSD_LOAD		0x10
+#define SSE_MOVSD_STORE		0x11
+#define SSE_MOVAPD			0x28
+#define SSE_SQRTSD			0x51
+#define SSE_ANDPD			0x54
+#define SSE_ANDNPD			0x55
+#define SSE_ORPD			0x56
+#define SSE_XORPD			0x57
+#define SSE_ADDSD			0x58
+#define SSE_MULSD			0x59
+#define SSE_SUBSD			0x5C
+#define SSE_DIVSD			0x5E
+#define SSE_CMPSD			0xC2
+
+// predicates of cmpsd
+#define SSE_CMP_LT			1
+#define SSE_CMP_NEQ			4
+
+static double JitFact( double x ) { return std::tgamma( x + 1.0 ); }
+static double JitSinc( double x ) { return std::sin( x ) / x; }
+static double JitCtg( double x ) { return 1.0 / std::tan( x ); }
+static double JitArcctg( double x ) { return std::atan( 1.0 / x ); }
+static double JitCbrt( double x ) { return std::pow( x, 1.0 / 3.0 ); }
+
+static const struct
+{
+	LPCTSTR			pszName;
+	double			( *pfn )( double );
+} g_vJitFunc[] =
+{
+	{ TEXT( "sin" ), ::sin },
+	{ TEXT( "cos" ), ::cos },
+	{ TEXT( "tg" ), ::tan },
+	{ TEXT( "ctg" ), JitCtg },
+	{ TEXT( "arcsin" ), ::asin },
+	{ TEXT( "arccos" ), ::acos },
+	{ TEXT( "arctg" ), ::atan },
+	{ TEXT( "arcctg" ), JitArcctg },
+	{ TEXT( "exp" ), ::exp },
+	{ TEXT( "cbrt" ), JitCbrt },
+	{ TEXT( "sinc" ), JitSinc },
+};
+
+static BOOL IsName( const CStringOp & name, LPCTSTR pszName )
+{
+	return ( name == CStringOp( pszName ) );
+}
+
+CMyJit::CMyJit()
+	: m_pMem( nullptr ), m_cbMem( 0 ), m_pfn( nullptr )
+{
+
+}
+
+CMyJit::~CMyJit()
+{
+	Release();
+}
+
+VOID CMyJit::Release()
+{
+#ifdef MYJIT_SUPPORTED
+	if ( m_pMem )
+	{
+		munmap( m_pMem, m_cbMem );
+	}
+#endif
+
+	m_pMem = nullptr;
+	m_cbMem = 0;
+	m_pfn = nullptr;
+}
+
+VOID CMyJit::Byte( unsigned char b )
+{
+	m_code.push_back( b );
+}
+
+VOID CMyJit::Dword( unsigned long u )
+{
+	for ( int i = 0; i < 4; ++i, u >>= 8 )
+		Byte( u & 0xFF );
+}
+
+VOID CMyJit::Qword( unsigned long long u )
+{
+	for ( int i = 0; i < 8; ++i, u >>= 8 )
+		Byte( u & 0xFF );
+}
+
+// prefix [REX] 0F op ModRM [SIB] [disp32]
+VOID CMyJit::Sse( unsigned char prefix, unsigned char op, size_t r, const JIT_OPERAND & rm )
+{
+	unsigned char rex = ( r >= 8 ? 0x44 : 0 );
+	if ( rm.jl == jlReg && rm.u >= 8 )
+	{
+		rex |= 0x41;
+	}
+
+	Byte( prefix );
+	if ( rex )
+	{
+		Byte( rex );
+	}
+	Byte( 0x0F );
+	Byte( op );
+
+	const unsigned char reg = ( r & 7 ) << 3;
+	switch ( rm.jl )
+	{
+		case jlReg:
+			Byte( 0xC0 | reg | ( rm.u & 7 ) );
+			break;
+		case jlSlot:
+			Byte( 0x83 | reg );			// [rbx + disp32]
+			Dword( (unsigned long)( 8 * rm.u ) );
+			break;
+		case jlFrame:
+			Byte( 0x84 | reg );			// [rsp + disp32]
+			Byte( 0x24 );
+			Dword( (unsigned long)( 8 * rm.u ) );
+			break;
+		case jlConst:
+			Byte( 0x05 | reg );			// [rip + disp32], patched by Finalize
+			m_vfixup.push_back( std::make_pair( m_code.size(), rm.u ) );
+			Dword( 0 );
+			break;
+	}
+}
+
+VOID CMyJit::Load( size_t r, const JIT_OPERAND & rm )
+{
+	if ( rm.jl == jlReg )
+	{
+		if ( rm.u != r )
+		{
+			Sse( SSE_66, SSE_MOVAPD, r, rm );
+		}
+	}
+	else
+	{
+		Sse( SSE_F2, SSE_MOVSD_LOAD, r, rm );
+	}
+}
+
+VOID CMyJit::Call( const void * pfn )
+{
+	// mov rax, imm64; call rax
+	Byte( 0x48 ); Byte( 0xB8 ); Qword( (unsigned long long)pfn );
+	Byte( 0xFF ); Byte( 0xD0 );
+}
+
+size_t CMyJit::Pool( double d )
+{
+	// two first entries are the sign mask for xorpd
+	for ( size_t u = 2; u < m_vpool.size(); ++u )
+	{
+		if ( !memcmp( &m_vpool[ u ], &d, sizeof( d ) ) )
+		{
+			return u;
+		}
+	}
+
+	m_vpool.push_back( d );
+	return m_vpool.size() - 1;
+}
+
+EXPR_ARG CMyJit::Resolve( const EXPR_ARG & arg ) const
+{
+	return ( arg.eat == eatNode ? m_valias[ arg.u ] : arg );
+}
+
+CMyJit::JIT_OPERAND CMyJit::Operand( const CExprProgram<TOK> & prog, const EXPR_ARG & arg )
+{
+	EXPR_ARG r = Resolve( arg );
+	switch ( r.eat )
+	{
+		case eatConst: return JIT_OPERAND( jlConst, Pool( double( prog.Const( r.u ).v.real() ) ) );
+		case eatSlot: return JIT_OPERAND( jlSlot, r.u );
+		default: return m_vloc[ r.u ];
+	}
+}
+
+VOID CMyJit::FreeRegs( size_t uNode )
+{
+	for ( size_t r = JIT_FIRSTREG; r <= JIT_LASTREG; ++r )
+	{
+		if ( m_vregOwner[ r ] != JIT_FREE && m_vlastUse[ m_vregOwner[ r ] ] < uNode )
+		{
+			m_vregOwner[ r ] = JIT_FREE;
+		}
+	}
+}
+
+size_t CMyJit::AllocReg( size_t uNode, const std::vector<size_t> & vkeep )
+{
+	size_t victim = JIT_FREE;
+	for ( size_t r = JIT_FIRSTREG; r <= JIT_LASTREG; ++r )
+	{
+		if ( m_vregOwner[ r ] == JIT_FREE )
+		{
+			m_vregOwner[ r ] = uNode;
+			return r;
+		}
+		else if ( std::find( vkeep.begin(), vkeep.end(), r ) == vkeep.end() &&
+			( victim == JIT_FREE || m_vlastUse[ m_vregOwner[ r ] ] > m_vlastUse[ m_vregOwner[ victim ] ] ) )
+		{
+			victim = r;
+		}
+	}
+
+	// spill the value which is needed most later
+	const size_t owner = m_vregOwner[ victim ];
+	Sse( SSE_F2, SSE_MOVSD_STORE, victim, JIT_OPERAND( jlFrame, owner ) );
+	m_vloc[ owner ] = JIT_OPERAND( jlFrame, owner );
+	m_vregOwner[ victim ] = uNode;
+	return victim;
+}
+
+// all xmm registers are volatile across calls
+VOID CMyJit::SpillAll( size_t uNode )
+{
+	for ( size_t r = JIT_FIRSTREG; r <= JIT_LASTREG; ++r )
+	{
+		const size_t owner = m_vregOwner[ r ];
+		if ( owner != JIT_FREE && m_vlastUse[ owner ] > uNode )
+		{
+			Sse( SSE_F2, SSE_MOVSD_STORE, r, JIT_OPERAND( jlFrame, owner ) );
+			m_vloc[ owner ] = JIT_OPERAND( jlFrame, owner );
+		}
+		m_vregOwner[ r ] = JIT_FREE;
+	}
+}
+
+BOOL CMyJit::Analyze( const CExprProgram<TOK> & prog )
+{
+	const auto & vnode = prog.Nodes();
+
+	m_valias.assign( vnode.size(), EXPR_ARG() );
+	m_vlastUse.assign( vnode.size(), 0 );
+
+	for ( size_t u = 0; u < vnode.size(); ++u )
+	{
+		const EXPR_NODE & node = vnode[ u ];
+		const CStringOp & name = prog.TokenName( node );
+
+		for ( const auto & arg : node.varg )
+		{
+			if ( arg.eat == eatConst && prog.Const( arg.u ).v.imag() != 0 )
+			{
+				return FALSE;
+			}
+		}
+
+		// identity operators don't produce the code
+		m_valias[ u ] = EXPR_ARG( eatNode, u );
+		if ( ( node.ent == entUnary && ( IsName( name, TEXT( "+" ) ) || IsName( name, TEXT( "~" ) ) ) ) ||
+			( node.ent == entFunc && !name.GetLength() && node.varg.size() == 1 ) )
+		{
+			m_valias[ u ] = Resolve( node.varg[ 0 ] );
+		}
+		else if ( node.ent == entBinary && IsName( name, TEXT( ";" ) ) )
+		{
+			m_valias[ u ] = Resolve( node.varg[ 1 ] );
+		}
+
+		m_vlastUse[ u ] = u;
+		if ( m_valias[ u ] == EXPR_ARG( eatNode, u ) )
+		{
+			for ( const auto & arg : node.varg )
+			{
+				const EXPR_ARG r = Resolve( arg );
+				if ( r.eat == eatNode )
+				{
+					m_vlastUse[ r.u ] = u;
+				}
+			}
+		}
+	}
+
+	const EXPR_ARG r = Resolve( prog.Result() );
+	if ( r.eat == eatNode )
+	{
+		m_vlastUse[ r.u ] = vnode.size();
+	}
+	else if ( r.eat == eatConst && prog.Const( r.u ).v.imag() != 0 )
+	{
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+VOID CMyJit::EmitPowInt( size_t dst, const JIT_OPERAND & base, long n )
+{
+	if ( !n )
+	{
+		Load( dst, JIT_OPERAND( jlConst, Pool( 1.0 ) ) );
+		return;
+	}
+
+	unsigned long m = ( n < 0 ? -n : n ), bit = 1;
+	while ( ( bit << 1 ) <= m ) bit <<= 1;
+
+	// left-to-right binary exponentiation, xmm0 keeps the base
+	Load( 0, base );
+	Load( dst, JIT_OPERAND( jlReg, 0 ) );
+	for ( bit >>= 1; bit; bit >>= 1 )
+	{
+		Sse( SSE_F2, SSE_MULSD, dst, JIT_OPERAND( jlReg, dst ) );
+		if ( m & bit )
+		{
+			Sse( SSE_F2, SSE_MULSD, dst, JIT_OPERAND( jlReg, 0 ) );
+		}
+	}
+
+	if ( n < 0 )
+	{
+		Load( 1, JIT_OPERAND( jlConst, Pool( 1.0 ) ) );
+		Sse( SSE_F2, SSE_DIVSD, 1, JIT_OPERAND( jlReg, dst ) );
+		Load( dst, JIT_OPERAND( jlReg, 1 ) );
+	}
+}
+
+BOOL CMyJit::EmitNode( const CExprProgram<TOK> & prog, size_t uNode )
+{
+	const EXPR_NODE & node = prog.Nodes()[ uNode ];
+	const CStringOp & name = prog.TokenName( node );
+
+	if ( m_valias[ uNode ] != EXPR_ARG( eatNode, uNode ) )
+	{
+		return TRUE;
+	}
+
+	FreeRegs( uNode );
+
+	std::vector<JIT_OPERAND> vop;
+	std::vector<size_t> vkeep;
+	for ( const auto & arg : node.varg )
+	{
+		vop.push_back( Operand( prog, arg ) );
+		if ( vop.back().jl == jlReg )
+		{
+			vkeep.push_back( vop.back().u );
+		}
+	}
+
+	// destination register: first operand register if it dies here, otherwise a new one
+	auto dest = [ this, &vop, &vkeep, uNode ]()
+	{
+		if ( vop.size() && vop[ 0 ].jl == jlReg && m_vlastUse[ m_vregOwner[ vop[ 0 ].u ] ] == uNode )
+		{
+			m_vregOwner[ vop[ 0 ].u ] = uNode;
+			return vop[ 0 ].u;
+		}
+		return AllocReg( uNode, vkeep );
+	};
+
+	// call of double( double ) or double( double, double ) function
+	auto call = [ this, &vop, uNode ]( const void * pfn )
+	{
+		for ( size_t u = 0; u < vop.size(); ++u )
+		{
+			Load( u, vop[ u ] );
+		}
+		SpillAll( uNode );
+		Call( pfn );
+		size_t dst = AllocReg( uNode, std::vector<size_t>() );
+		Load( dst, JIT_OPERAND( jlReg, 0 ) );
+		return dst;
+	};
+
+	size_t dst = JIT_FREE;
+	switch ( node.ent )
+	{
+		case entUnary:
+			{
+				if ( IsName( name, TEXT( "-" ) ) )
+				{
+					dst = dest();
+					Load( dst, vop[ 0 ] );
+					Sse( SSE_66, SSE_XORPD, dst, JIT_OPERAND( jlConst, 0 ) );
+				}
+				else if ( IsName( name, TEXT( "!" ) ) )
+				{
+					dst = call( (const void *)JitFact );
+				}
+				break;
+			}
+		case entBinary:
+			{
+				static const struct
+				{
+					LPCTSTR			pszName;
+					unsigned char	op;
+				} vop2[] =
+				{
+					{ TEXT( "+" ), SSE_ADDSD },
+					{ TEXT( "-" ), SSE_SUBSD },
+					{ TEXT( "*" ), SSE_MULSD },
+					{ TEXT( "" ), SSE_MULSD },
+					{ TEXT( "/" ), SSE_DIVSD },
+				};
+
+				for ( const auto & v : vop2 )
+				{
+					if ( IsName( name, v.pszName ) )
+					{
+						dst = dest();
+						Load( dst, vop[ 0 ] );
+						Sse( SSE_F2, v.op, dst, vop[ 1 ] );
+						break;
+					}
+				}
+
+				// mask of the comparison selects 1.0
+				if ( dst == JIT_FREE && ( IsName( name, TEXT( "<" ) ) || IsName( name, TEXT( ">" ) ) ) )
+				{
+					const size_t uLess = ( IsName( name, TEXT( "<" ) ) ? 0 : 1 );
+					Load( 0, vop[ uLess ] );
+					Load( 1, vop[ 1 - uLess ] );
+					Sse( SSE_F2, SSE_CMPSD, 0, JIT_OPERAND( jlReg, 1 ) );
+					Byte( SSE_CMP_LT );
+					dst = dest();
+					Load( dst, JIT_OPERAND( jlConst, Pool( 1.0 ) ) );
+					Sse( SSE_66, SSE_ANDPD, dst, JIT_OPERAND( jlReg, 0 ) );
+				}
+
+				if ( dst == JIT_FREE && IsName( name, TEXT( "^" ) ) )
+				{
+					const EXPR_ARG e = Resolve( node.varg[ 1 ] );
+					const long double n = ( e.eat == eatConst ? prog.Const( e.u ).v.real() : 0.5L );
+
+					if ( n == std::floor( n ) && std::fabs( n ) < 2147483648.0L )
+					{
+						dst = dest();
+						EmitPowInt( dst, vop[ 0 ], long( n ) );
+					}
+					else
+					{
+						dst = call( (const void *)static_cast<double( * )( double, double )>( ::pow ) );
+					}
+				}
+				break;
+			}
+		case entFunc:
+			{
+				if ( node.varg.size() == 1 && IsName( name, TEXT( "sqrt" ) ) )
+				{
+					dst = dest();
+					Sse( SSE_F2, SSE_SQRTSD, dst, vop[ 0 ] );
+				}
+				else if ( !node.varg.size() && ( IsName( name, TEXT( "pi" ) ) || IsName( name, TEXT( "e" ) ) ) )
+				{
+					dst = dest();
+					Load( dst, JIT_OPERAND( jlConst, Pool( IsName( name, TEXT( "pi" ) ) ? double( M_PIC ) : std::exp( 1.0 ) ) ) );
+				}
+				else if ( node.varg.size() == 3 && IsName( name, TEXT( "select" ) ) )
+				{
+					// both branches are evaluated, the mask of the condition chooses one of them
+					Load( 0, vop[ 0 ] );
+					Sse( SSE_66, SSE_XORPD, 1, JIT_OPERAND( jlReg, 1 ) );
+					Sse( SSE_F2, SSE_CMPSD, 0, JIT_OPERAND( jlReg, 1 ) );
+					Byte( SSE_CMP_NEQ );
+					Load( 1, vop[ 1 ] );
+					Sse( SSE_66, SSE_ANDPD, 1, JIT_OPERAND( jlReg, 0 ) );
+					dst = dest();
+					Load( dst, vop[ 2 ] );
+					Sse( SSE_66, SSE_ANDNPD, 0, JIT_OPERAND( jlReg, dst ) );
+					Sse( SSE_66, SSE_ORPD, 0, JIT_OPERAND( jlReg, 1 ) );
+					Load( dst, JIT_OPERAND( jlReg, 0 ) );
+				}
+				else if ( node.varg.size() == 1 )
+				{
+					for ( const auto & v : g_vJitFunc )
+					{
+						if ( IsName( name, v.pszName ) )
+						{
+							dst = call( (const void *)v.pfn );
+							break;
+						}
+					}
+				}
+				break;
+			}
+	}
+
+	if ( dst == JIT_FREE )
+	{
+		return FALSE;
+	}
+
+	m_vloc[ uNode ] = JIT_OPERAND( jlReg, dst );
+	m_vregOwner[ dst ] = uNode;
+	return TRUE;
+}
+
+BOOL CMyJit::Finalize()
+{
+#ifdef MYJIT_SUPPORTED
+	const size_t cbCode = ( m_code.size() + 15 ) & ~size_t( 15 );
+	const size_t cbTotal = cbCode + m_vpool.size() * sizeof( double );
+
+	for ( const auto & v : m_vfixup )
+	{
+		const long disp = long( cbCode + v.second * sizeof( double ) ) - long( v.first + 4 );
+		for ( int i = 0; i < 4; ++i )
+			m_code[ v.first + i ] = ( (unsigned long)disp >> ( 8 * i ) ) & 0xFF;
+	}
+
+	void * pMem = mmap( nullptr, cbTotal, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+	if ( pMem == MAP_FAILED )
+	{
+		return FALSE;
+	}
+
+	memset( pMem, 0xCC, cbCode );
+	memcpy( pMem, m_code.data(), m_code.size() );
+	memcpy( (unsigned char *)pMem + cbCode, m_vpool.data(), m_vpool.size() * sizeof( double ) );
+
+	if ( mprotect( pMem, cbTotal, PROT_READ | PROT_EXEC ) )
+	{
+		munmap( pMem, cbTotal );
+		return FALSE;
+	}
+
+	m_pMem = pMem;
+	m_cbMem = cbTotal;
+	m_pfn = (PJITFUNC)pMem;
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+BOOL CMyJit::Compile( const CExprProgram<TOK> & prog )
+{
+	const size_t nnodes = prog.Nodes().size();
+
+	Release();
+	m_code.clear();
+	m_vfixup.clear();
+	m_vpool.assign( 2, -0.0 );
+	m_vloc.assign( nnodes, JIT_OPERAND() );
+	std::fill( m_vregOwner, m_vregOwner + 16, JIT_FREE );
+
+	if ( !Analyze( prog ) )
+	{
+		return FALSE;
+	}
+
+	// keep rsp aligned to 16 bytes at the calls
+	unsigned long cbFrame = (unsigned long)( 8 * nnodes );
+	if ( !( cbFrame & 15 ) )
+	{
+		cbFrame += 8;
+	}
+
+	Byte( 0x55 );										// push rbp
+	Byte( 0x48 ); Byte( 0x89 ); Byte( 0xE5 );			// mov rbp, rsp
+	Byte( 0x53 );										// push rbx
+	Byte( 0x48 ); Byte( 0x81 ); Byte( 0xEC ); Dword( cbFrame );	// sub rsp, cbFrame
+	Byte( 0x48 ); Byte( 0x89 ); Byte( 0xFB );			// mov rbx, rdi
+
+	for ( size_t u = 0; u < nnodes; ++u )
+	{
+		if ( !EmitNode( prog, u ) )
+		{
+			return FALSE;
+		}
+	}
+
+	Load( 0, Operand( prog, prog.Result() ) );
+
+	Byte( 0x48 ); Byte( 0x81 ); Byte( 0xC4 ); Dword( cbFrame );	// add rsp, cbFrame
+	Byte( 0x5B );										// pop rbx
+	Byte( 0x5D );										// pop rbp
+	Byte( 0xC3 );										// ret
+
+	return Finalize();
+}
+
+BOOL CMyJit::Compiled() const
+{
+	return ( m_pfn != nullptr );
+}
+
+BOOL CMyJit::Evaluate( double * pSlots, double & dResult ) const
+{
+	dResult = m_pfn( pSlots );
+	return !std::isnan( dResult );
+}
+
+CExprTiered<TOK>::NATIVE CMyJit::Native( const CExprProgram<TOK> & prog )
+{
+	std::shared_ptr<CMyJit> pjit = std::make_shared<CMyJit>();
+	if ( !pjit->Compile( prog ) )
+	{
+		return nullptr;
+	}
+
+	const size_t nslots = prog.Slots().size();
+	return [ pjit, nslots ]( TOK * pSlots, TOK & result )
+	{
+		static thread_local std::vector<double> vslots;
+		vslots.resize( nslots );
+
+		for ( size_t u = 0; u < nslots; ++u )
+		{
+			if ( pSlots[ u ].undef || pSlots[ u ].v.imag() != 0 )
+			{
+				return FALSE;
+			}
+
+			vslots[ u ] = double( pSlots[ u ].v.real() );
+		}
+
+		double d;
+		if ( !pjit->Evaluate( vslots.data(), d ) )
+		{
+			return FALSE;
+		}
+
+		result = TOK( d );
+		return TRUE;
+	};
+}
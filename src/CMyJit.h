@@ -0,0 +1,95 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Header of x86-64 JIT compiler for the real subset of CMyParser programs */
+
+#pragma once
+
+#include "CMyParser.h"
+#include "CExprTiered.h"
+
+class CMyJit
+{
+	typedef double ( *PJITFUNC )( double * pSlots );
+
+	typedef enum _tagJIT_LOC
+	{
+		jlSlot,			// [rbx + 8 * u]
+		jlConst,		// [rip + pool]
+		jlReg,			// xmm register
+		jlFrame			// [rsp + 8 * u]
+	} JIT_LOC;
+
+	typedef struct _tagJIT_OPERAND
+	{
+		JIT_LOC			jl;
+		size_t			u;
+
+		_tagJIT_OPERAND( JIT_LOC _jl = jlConst, size_t _u = 0 )
+			: jl( _jl ), u( _u ) {}
+	} JIT_OPERAND;
+
+	std::vector<unsigned char>			m_code;
+	std::vector<double>					m_vpool;
+	std::vector<std::pair<size_t, size_t>>	m_vfixup;		// offset of rip displacement, index in the pool
+
+	std::vector<JIT_OPERAND>			m_vloc;				// locations of node values
+	std::vector<size_t>					m_vlastUse;
+	std::vector<EXPR_ARG>				m_valias;			// nodes which don't generate the code
+	size_t								m_vregOwner[ 16 ];
+
+	void *								m_pMem;
+	size_t								m_cbMem;
+	PJITFUNC							m_pfn;
+
+	CMyJit( const CMyJit & );
+	CMyJit & operator=( const CMyJit & );
+
+	VOID			Byte( unsigned char b );
+	VOID			Dword( unsigned long u );
+	VOID			Qword( unsigned long long u );
+	VOID			Sse( unsigned char prefix, unsigned char op, size_t r, const JIT_OPERAND & rm );
+	VOID			Load( size_t r, const JIT_OPERAND & rm );
+	VOID			Call( const void * pfn );
+
+	size_t			Pool( double d );
+	EXPR_ARG		Resolve( const EXPR_ARG & arg ) const;
+	JIT_OPERAND		Operand( const CExprProgram<TOK> & prog, const EXPR_ARG & arg );
+	size_t			AllocReg( size_t uNode, const std::vector<size_t> & vkeep );
+	VOID			FreeRegs( size_t uNode );
+	VOID			SpillAll( size_t uNode );
+
+	BOOL			Analyze( const CExprProgram<TOK> & prog );
+	BOOL			EmitNode( const CExprProgram<TOK> & prog, size_t uNode );
+	VOID			EmitPowInt( size_t dst, const JIT_OPERAND & base, long n );
+	BOOL			Finalize();
+	VOID			Release();
+
+public:
+	CMyJit();
+	~CMyJit();
+
+	// FALSE if program has complex constants or operators which are not supported,
+	// so it must be evaluated by the interpreter
+	BOOL			Compile( const CExprProgram<TOK> & prog );
+	BOOL			Compiled() const;
+
+	// pSlots are real values of the program slots. FALSE if the result is out of the
+	// real domain (NaN), in that case expression must be evaluated by the interpreter
+	BOOL			Evaluate( double * pSlots, double & dResult ) const;
+
+	// native tier for CExprTiered. Slots with complex or undefined values are left to the program
+	static CExprTiered<TOK>::NATIVE	Native( const CExprProgram<TOK> & prog );
+};
@@ -0,0 +1,297 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Running error analysis: each value carries the bound of its absolute error, which is the
+   propagated error of the arguments ( derivative times their bounds ) plus the rounding of
+   the operation. libm functions are taken to be accurate within 1 ulp */
+
+#include "CMyMixed.h"
+#include <float.h>
+#include <algorithm>
+
+#define MIXED_U				( DBL_EPSILON / 2 )
+#define MIXED_LIBM			( 2 * MIXED_U )
+
+static BOOL IsName( const CStringOp & name, LPCTSTR pszName )
+{
+	return ( name == CStringOp( pszName ) );
+}
+
+// value and the error of its rounding to double
+static VOID Round( long double x, double & v, double & e )
+{
+	v = double( x );
+	e = double( std::fabs( x - v ) );
+}
+
+CMyMixed::CMyMixed( const CExprProgram<TOK> & prog, long double tol )
+	: m_prog( prog ), m_tol( tol ), m_nEvals( 0 ), m_nFallbacks( 0 )
+{
+	m_fNative = Translate();
+}
+
+BOOL CMyMixed::Translate()
+{
+	static const struct
+	{
+		EXPR_NODE_TYPE		ent;
+		LPCTSTR				pszName;
+		MIXED_OP			emo;
+	} vop[] =
+	{
+		{ entBinary, TEXT( "+" ), emoAdd },
+		{ entBinary, TEXT( "-" ), emoSub },
+		{ entBinary, TEXT( "*" ), emoMul },
+		{ entBinary, TEXT( "" ), emoMul },
+		{ entBinary, TEXT( "/" ), emoDiv },
+		{ entBinary, TEXT( "^" ), emoPow },
+		{ entBinary, TEXT( ";" ), emoSecond },
+		{ entUnary, TEXT( "+" ), emoCopy },
+		{ entUnary, TEXT( "~" ), emoCopy },
+		{ entUnary, TEXT( "-" ), emoNeg },
+		{ entUnary, TEXT( "!" ), emoFact },
+		{ entFunc, TEXT( "" ), emoCopy },
+		{ entFunc, TEXT( "sin" ), emoSin },
+		{ entFunc, TEXT( "sinc" ), emoSinc },
+		{ entFunc, TEXT( "cos" ), emoCos },
+		{ entFunc, TEXT( "tg" ), emoTan },
+		{ entFunc, TEXT( "ctg" ), emoCot },
+		{ entFunc, TEXT( "arcsin" ), emoArcsin },
+		{ entFunc, TEXT( "arccos" ), emoArccos },
+		{ entFunc, TEXT( "arctg" ), emoArctan },
+		{ entFunc, TEXT( "arcctg" ), emoArccot },
+		{ entFunc, TEXT( "exp" ), emoExp },
+		{ entFunc, TEXT( "sqrt" ), emoSqrt },
+		{ entFunc, TEXT( "cbrt" ), emoCbrt },
+		{ entFunc, TEXT( "pi" ), emoPi },
+		{ entFunc, TEXT( "e" ), emoE },
+	};
+
+	// constants referred by the program
+	size_t nConsts = ( m_prog.Result().eat == eatConst ? m_prog.Result().u + 1 : 0 );
+	for ( const auto & node : m_prog.Nodes() )
+	{
+		for ( const auto & arg : node.varg )
+		{
+			if ( arg.eat == eatConst )
+			{
+				nConsts = std::max( nConsts, arg.u + 1 );
+			}
+		}
+	}
+
+	for ( size_t u = 0; u < nConsts; ++u )
+	{
+		const TOK & c = m_prog.Const( u );
+		if ( c.undef || c.v.imag() != 0 )
+		{
+			return FALSE;
+		}
+
+		double v, e;
+		Round( c.v.real(), v, e );
+		m_vconst.push_back( v );
+		m_vconstErr.push_back( e );
+	}
+
+	for ( const auto & node : m_prog.Nodes() )
+	{
+		const CStringOp & name = m_prog.TokenName( node );
+		MIXED_NODE mnode;
+		BOOL fFound = FALSE;
+
+		for ( const auto & v : vop )
+		{
+			if ( v.ent == node.ent && IsName( name, v.pszName ) && ( node.varg.size() <= 2 ) )
+			{
+				mnode.emo = v.emo;
+				fFound = TRUE;
+				break;
+			}
+		}
+
+		// assignments and the functions of several arguments stay in long double
+		if ( !fFound || node.varg.size() != ( node.ent == entBinary ? 2 : ( mnode.emo == emoPi || mnode.emo == emoE ? 0 : 1 ) ) )
+		{
+			return FALSE;
+		}
+
+		for ( size_t n = 0; n < node.varg.size(); ++n )
+		{
+			mnode.varg[ n ] = node.varg[ n ];
+		}
+
+		m_vnode.push_back( mnode );
+	}
+
+	m_vslot.resize( m_prog.Slots().size() );
+	m_vslotErr.resize( m_prog.Slots().size() );
+	m_vvalue.resize( m_vnode.size() );
+	m_verr.resize( m_vnode.size() );
+	return TRUE;
+}
+
+VOID CMyMixed::Node( const MIXED_NODE & node, double & v, double & e ) const
+{
+	double a = 0, ea = 0, b = 0, eb = 0;
+	const size_t nargs = ( node.emo <= emoSecond ? 2 : ( node.emo >= emoPi ? 0 : 1 ) );
+
+	for ( size_t n = 0; n < nargs; ++n )
+	{
+		const EXPR_ARG & arg = node.varg[ n ];
+		double & x = ( n ? b : a ), & ex = ( n ? eb : ea );
+		switch ( arg.eat )
+		{
+			case eatConst: x = m_vconst[ arg.u ]; ex = m_vconstErr[ arg.u ]; break;
+			case eatSlot: x = m_vslot[ arg.u ]; ex = m_vslotErr[ arg.u ]; break;
+			default: x = m_vvalue[ arg.u ]; ex = m_verr[ arg.u ]; break;
+		}
+	}
+
+	// derivative of the function, the rounding is added at the end
+	double d = 0;
+	switch ( node.emo )
+	{
+		case emoAdd: v = a + b; e = ea + eb + MIXED_U * std::fabs( v ); return;
+		case emoSub: v = a - b; e = ea + eb + MIXED_U * std::fabs( v ); return;
+		case emoMul: v = a * b; e = std::fabs( a ) * eb + std::fabs( b ) * ea + ea * eb + MIXED_U * std::fabs( v ); return;
+		case emoDiv:
+			{
+				v = a / b;
+				e = ( eb < std::fabs( b ) ? ( ea + std::fabs( v ) * eb ) / ( std::fabs( b ) - eb ) + MIXED_U * std::fabs( v ) : HUGE_VAL );
+				return;
+			}
+		case emoPow:
+			{
+				if ( b == std::floor( b ) && a != 0 && std::fabs( b ) <= POW_INT_MAX && eb == 0 )
+				{
+					// each of |n| products rounds once
+					v = ( b ? PowInt( a, long( b ) ) : 1.0 );
+					e = std::fabs( b * v / a ) * ea + 2 * std::fabs( b ) * MIXED_U * std::fabs( v );
+					return;
+				}
+
+				// negative base is complex for real exponent
+				v = ( a > 0 ? std::pow( a, b ) : NAN );
+				e = std::fabs( v ) * ( std::fabs( b / a ) * ea + std::fabs( std::log( a ) ) * eb ) + MIXED_LIBM * std::fabs( v );
+				return;
+			}
+		case emoSecond: v = b; e = eb; return;
+		case emoCopy: v = a; e = ea; return;
+		case emoNeg: v = -a; e = ea; return;
+		case emoFact:
+			{
+				// psi( x ) lies between log( x ) - 1 / x and log( x ) for x > 0
+				const double x = a + 1;
+				v = std::tgamma( x );
+				d = ( x > 0 ? std::fabs( v ) * ( std::fabs( std::log( x ) ) + 1 / x ) : HUGE_VAL );
+				break;
+			}
+		case emoSin: v = std::sin( a ); d = std::fabs( std::cos( a ) ); break;
+		case emoSinc:
+			{
+				v = std::sin( a ) / a;
+				d = ( std::fabs( a ) > 1e-4 ? std::fabs( ( std::cos( a ) - v ) / a ) : std::fabs( a ) / 3 );
+				e = d * ea + 2 * MIXED_LIBM * std::fabs( v );
+				return;
+			}
+		case emoCos: v = std::cos( a ); d = std::fabs( std::sin( a ) ); break;
+		case emoTan: v = std::tan( a ); d = 1 + v * v; break;
+		case emoCot: v = 1 / std::tan( a ); d = 1 + v * v; break;
+		case emoArcsin: v = std::asin( a ); d = 1 / std::sqrt( 1 - a * a ); break;
+		case emoArccos: v = std::acos( a ); d = 1 / std::sqrt( 1 - a * a ); break;
+		case emoArctan: v = std::atan( a ); d = 1 / ( 1 + a * a ); break;
+		case emoArccot: v = std::atan( 1 / a ); d = 1 / ( 1 + a * a ); break;
+		case emoExp: v = std::exp( a ); d = v; break;
+		case emoSqrt: v = ( a >= 0 ? std::sqrt( a ) : NAN ); d = ( ea ? 0.5 / v : 0 ); break;
+		case emoCbrt: v = ( a >= 0 ? std::cbrt( a ) : NAN ); d = ( ea ? 1 / ( 3 * v * v ) : 0 ); break;
+		case emoPi: Round( M_PIC, v, e ); return;
+		case emoE: Round( std::exp( 1.0L ), v, e ); return;
+	}
+
+	e = d * ea + MIXED_LIBM * std::fabs( v );
+}
+
+// FALSE if the row must be evaluated in long double
+BOOL CMyMixed::Native( const TOK * pSlots, long double & result )
+{
+	for ( size_t u = 0; u < m_vslot.size(); ++u )
+	{
+		if ( pSlots[ u ].undef || pSlots[ u ].v.imag() != 0 )
+		{
+			return FALSE;
+		}
+
+		Round( pSlots[ u ].v.real(), m_vslot[ u ], m_vslotErr[ u ] );
+	}
+
+	for ( size_t u = 0; u < m_vnode.size(); ++u )
+	{
+		Node( m_vnode[ u ], m_vvalue[ u ], m_verr[ u ] );
+	}
+
+	double v, e;
+	const EXPR_ARG & r = m_prog.Result();
+	switch ( r.eat )
+	{
+		case eatConst: v = m_vconst[ r.u ]; e = m_vconstErr[ r.u ]; break;
+		case eatSlot: v = m_vslot[ r.u ]; e = m_vslotErr[ r.u ]; break;
+		default: v = m_vvalue[ r.u ]; e = m_verr[ r.u ]; break;
+	}
+
+	// NaN fails the comparison as well
+	if ( !( e <= m_tol * std::fabs( v ) ) || !std::isfinite( v ) )
+	{
+		return FALSE;
+	}
+
+	result = v;
+	return TRUE;
+}
+
+TOK CMyMixed::Evaluate( TOK * pSlots )
+{
+	m_nEvals.fetch_add( 1, std::memory_order_relaxed );
+
+	long double result;
+	if ( m_fNative && Native( pSlots, result ) )
+	{
+		return TOK( result );
+	}
+
+	m_nFallbacks.fetch_add( 1, std::memory_order_relaxed );
+	return m_prog.Execute( pSlots );
+}
+
+BOOL CMyMixed::Native() const
+{
+	return m_fNative;
+}
+
+size_t CMyMixed::Evaluations() const
+{
+	return m_nEvals.load( std::memory_order_relaxed );
+}
+
+size_t CMyMixed::Fallbacks() const
+{
+	return m_nFallbacks.load( std::memory_order_relaxed );
+}
+
+double CMyMixed::FallbackRate() const
+{
+	const size_t nEvals = Evaluations();
+	return ( nEvals ? double( Fallbacks() ) / nEvals : 0.0 );
+}
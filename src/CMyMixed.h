@@ -0,0 +1,90 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Mixed precision evaluation of CMyParser programs. The real subset of the program is evaluated
+   in double with a running error bound of each value, the rows which bound exceeds the tolerance
+   are evaluated again by the program in complex long double */
+
+#pragma once
+
+#include "CMyParser.h"
+#include <atomic>
+
+class CMyMixed
+{
+	typedef enum _tagMIXED_OP
+	{
+		emoAdd,
+		emoSub,
+		emoMul,
+		emoDiv,
+		emoPow,
+		emoSecond,		// ';'
+		emoCopy,		// unary '+', '~' and brackets
+		emoNeg,
+		emoFact,
+		emoSin,
+		emoSinc,
+		emoCos,
+		emoTan,
+		emoCot,
+		emoArcsin,
+		emoArccos,
+		emoArctan,
+		emoArccot,
+		emoExp,
+		emoSqrt,
+		emoCbrt,
+		emoPi,
+		emoE
+	} MIXED_OP;
+
+	typedef struct _tagMIXED_NODE
+	{
+		MIXED_OP		emo;
+		EXPR_ARG		varg[ 2 ];
+	} MIXED_NODE;
+
+	CExprProgram<TOK>					m_prog;
+	const long double					m_tol;
+	BOOL								m_fNative;
+	std::vector<MIXED_NODE>				m_vnode;
+	std::vector<double>					m_vconst, m_vconstErr;
+	std::vector<double>					m_vslot, m_vslotErr;		// values of the current row
+	std::vector<double>					m_vvalue, m_verr;
+	std::atomic<size_t>					m_nEvals;
+	std::atomic<size_t>					m_nFallbacks;
+
+	CMyMixed( const CMyMixed & );
+	CMyMixed & operator=( const CMyMixed & );
+
+	BOOL			Translate();
+	VOID			Node( const MIXED_NODE & node, double & v, double & e ) const;
+	BOOL			Native( const TOK * pSlots, long double & result );
+
+public:
+	// prog - program in complex long double, tol - greatest relative error bound of the
+	// double result. Programs with assignments or complex constants are never run in double
+	CMyMixed( const CExprProgram<TOK> & prog, long double tol = 1e-12L );
+
+	// not thread safe: the buffers of the row are members, use one instance per thread
+	TOK				Evaluate( TOK * pSlots );
+
+	BOOL			Native() const;
+	size_t			Evaluations() const;
+	// evaluations of the long double program
+	size_t			Fallbacks() const;
+	double			FallbackRate() const;
+};
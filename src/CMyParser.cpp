@@ -17,11 +17,9 @@
 
 #include "CMyParser.h"
 
-#define M_PIC 	3.14159265358979323846264338327950288419716939937510582097494459230781640628620899862803482534211706798214808651328230664709384460955058223172535940812848111745028410270193852110555964462294895493038196442881097566593344612847564823378678316527120
-
 #define D(x, a)		{}; // printf("%s(%Lf,%Lf)\n", (x), (a).v.real(), (a).v.imag() ); }
 #define D2(x, a, b)	{}; // printf("(%Lf,%Lf)%s(%Lf,%Lf)\n", (a).v.real(), (a).v.imag(), (x), (b).v.real(), (b).v.imag() ); }
-#define ASSERT_UNDEF(a)	{ if ( (a).undef ) throw CExprParserException(CStringOp().Format(TEXT("The variable %s is undefined"), a.name.GetString()).GetString()); }
+#define ASSERT_UNDEF(a)	{ if ( (a).undef ) throw CExprParserException(CStringOp().Format(TEXT("The variable %" TFMT_S " is undefined"), a.name.GetString()).GetString()); }
 #define ASSERT_NOTVAR(a) { if ( !(a).var ) throw CExprParserException(TEXT("Assignment is not valid for non-variable tokens")); }
 
 CMyParser::CMyParser()
@@ -34,6 +32,8 @@ CMyParser::CMyParser()
 	auto opPow = []( TOK & a, TOK & b ) { D2("^", a, b); ASSERT_UNDEF(a); ASSERT_UNDEF(b); return std::pow(a.v, b.v); };
 	auto opSemicolon = []( TOK & a, TOK & b ) { D2(";", a, b); ASSERT_UNDEF(a); ASSERT_UNDEF(b); return b; };
 	auto opEqu = []( TOK & a, TOK & b ) { D2("=", a, b); ASSERT_NOTVAR(a); ASSERT_UNDEF(b); a = b; return a; };
+	auto opLess = []( TOK & a, TOK & b ) { D2("<", a, b); ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v.real() < b.v.real() ? 1.0L : 0.0L ); };
+	auto opGreater = []( TOK & a, TOK & b ) { D2(">", a, b); ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v.real() > b.v.real() ? 1.0L : 0.0L ); };
 
 	auto unPlus = []( const TOK & a ) { D("+", a); ASSERT_UNDEF(a); return a; };
 	auto unNegt = []( const TOK & a ) { D("-", a); ASSERT_UNDEF(a); return -a.v; };
@@ -68,37 +68,493 @@ CMyParser::CMyParser()
 	auto fcbrt = []( const std::vector<TOK> & varg ) { ASSERT_UNDEF(varg[0]); return std::pow(varg[0].v, 1.0/3.0); };
 	// auto ctest = []( const std::vector<TOK> & varg ) { ASSERT_UNDEF(varg[0]); return varg[0].v / 5; };
 
-	AddOp( _T( '+' ), 10 ) = opPlus;
-	AddOp( _T( '-' ), 10 ) = opSubs;
-	AddOp( _T( '*' ), 5 ) = opMult;
-	AddOp( nullptr, 5 ) = opMult;
-	AddOp( _T( '/' ), 5 ) = opDivd;
-	AddOp( _T( '^' ), 4, etaRightOriented ) = opPow;
-	AddOp( _T( ';' ), 40, etaRightOriented ) = opSemicolon;
+	// conditionals take their arguments lazily, so only the chosen branch is evaluated.
+	// select( c, a, b ) is a if c isn't zero, otherwise b ( "if" would be read as the imaginary unit )
+	auto truth = []( const TOK & a ) { ASSERT_UNDEF(a); return ( a.v != 0.0L ); };
+	auto fselect = [ truth ]( const CExprLazyArgs<TOK> & args ) { return ( truth( args[0] ) ? args[1] : args[2] ); };
+	auto flogand = [ truth ]( const CExprLazyArgs<TOK> & args ) { return TOK( truth( args[0] ) && truth( args[1] ) ? 1.0L : 0.0L ); };
+	auto flogor = [ truth ]( const CExprLazyArgs<TOK> & args ) { return TOK( truth( args[0] ) || truth( args[1] ) ? 1.0L : 0.0L ); };
+
+	// sum( k, a, b, body ) and prod( k, a, b, body ) bind k to a, a + 1, ... while it isn't
+	// greater than b, and combine the values of body pairwise. The body is compiled once
+	auto reduce = []( const CExprLazyArgs<TOK> & args, const CExprLazyArgs<TOK>::COMBINE & combine, const TOK & empty )
+	{
+		const TOK a = args[1], b = args[2];
+		ASSERT_UNDEF(a); ASSERT_UNDEF(b);
+		const long double from = a.v.real(), to = b.v.real();
+		if ( !std::isfinite( from ) || !std::isfinite( to ) || to - from >= std::ldexp( 1.0L, 62 ) )
+		{
+			throw CExprParserException(TEXT("The range must have finite bounds"));
+		}
+
+		const size_t count = ( to >= from ? size_t( std::floor( to - from ) ) + 1 : 0 );
+		auto index = [ from ]( size_t uFrom, size_t c, TOK * pOut )
+		{
+			for ( size_t n = 0; n < c; ++n )
+			{
+				pOut[ n ] = TOK( from + ( uFrom + n ) );
+				pOut[ n ].var = TRUE;
+			}
+		};
+
+		return args.Reduce( 0, 3, count, index, combine, empty );
+	};
+	auto fsum = [ reduce ]( const CExprLazyArgs<TOK> & args ) { return reduce( args, []( const TOK & a, const TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v + b.v ); }, TOK( 0.0L ) ); };
+	auto fprod = [ reduce ]( const CExprLazyArgs<TOK> & args ) { return reduce( args, []( const TOK & a, const TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v * b.v ); }, TOK( 1.0L ) ); };
+
+	// integrate( x, a, b, body[, tol] ) is the integral of body over x from a to b with the
+	// absolute error tol. The nodes of each round are evaluated by one batch
+	auto fintegrate = []( const CExprLazyArgs<TOK> & args )
+	{
+		if ( args.Count() < 4 || args.Count() > 5 )
+		{
+			throw CExprParserException(TEXT("integrate takes the variable, the bounds, the body and the tolerance"));
+		}
+
+		const TOK a = args[1], b = args[2], tol = ( args.Count() > 4 ? args[4] : TOK( QUAD_TOLERANCE ) );
+		ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(tol);
+		if ( !std::isfinite( a.v.real() ) || !std::isfinite( b.v.real() ) || !( tol.v.real() > 0 ) )
+		{
+			throw CExprParserException(TEXT("The range must have finite bounds and the tolerance must be positive"));
+		}
+
+		std::vector<TOK> vin, vout;
+		auto batch = [ &args, &vin, &vout ]( const long double * px, std::complex<long double> * py, size_t count )
+		{
+			vin.resize( count );
+			vout.resize( count );
+			for ( size_t n = 0; n < count; ++n )
+			{
+				vin[n] = TOK( px[n] );
+				vin[n].var = TRUE;
+			}
+
+			args.Map( 0, 3, vin.data(), vout.data(), count );
+			for ( size_t n = 0; n < count; ++n )
+			{
+				ASSERT_UNDEF(vout[n]);
+				py[n] = vout[n].v;
+			}
+		};
+
+		// the body may integrate too, so the report is taken at the end
+		EXPR_NUMERIC_REPORT report( TEXT("integrate") );
+		const TOK result = CExprQuadrature<long double, std::complex<long double>>::Integrate( batch, a.v.real(), b.v.real(), tol.v.real(), report );
+		Report() = report;
+		return result;
+	};
+
+	// solve( x, body, x0[, tol] ) is the root of the real part of body near x0 with the absolute
+	// error tol, minimize( x, body, x0[, tol] ) is the point of the local minimum near x0 with the
+	// relative error tol. Both take Brent's steps over the body bound to x, one point at a time.
+	// With fTangent, fdf is the body and its tangent by x when the body is compiled and each of
+	// its operators has the derivative, and is empty otherwise
+	auto numeric = []( const CExprLazyArgs<TOK> & args, LPCTSTR pszMethod, long double defTol, BOOL fTangent,
+		const std::function<long double( const CExprSolver<long double>::FUNC &, const CExprSolver<long double>::DERIV &, long double, long double, EXPR_NUMERIC_REPORT & )> & method )
+	{
+		if ( args.Count() < 3 || args.Count() > 4 )
+		{
+			throw CExprParserException(TEXT("The solver takes the variable, the body, the start and the tolerance"));
+		}
+
+		const TOK x0 = args[2], tol = ( args.Count() > 3 ? args[3] : TOK( defTol ) );
+		ASSERT_UNDEF(x0); ASSERT_UNDEF(tol);
+		if ( !std::isfinite( x0.v.real() ) || !( tol.v.real() > 0 ) )
+		{
+			throw CExprParserException(TEXT("The start must be finite and the tolerance must be positive"));
+		}
+
+		TOK x;
+		x.var = TRUE;
+		auto f = [ &args, &x ]( long double v )
+		{
+			x.v = v;
+			args.Bind( 0, x );
+			const TOK y = args[1];
+			ASSERT_UNDEF(y);
+			return y.v.real();
+		};
+
+		// the program of the body, its slots and the direction are made once, so the steps
+		// only write the slot of x, which may be undefined before, and take the scratch memory
+		// of CExprDiff
+		static const CExprDerivatives<TOK> rules = []() { CExprDerivatives<TOK> rules; CMyParser::Derivatives( rules ); return rules; }();
+		CExprProgram<TOK> body;
+		std::vector<TOK> vslot, vdir;
+		std::unique_ptr<CExprDiff<TOK>> pdiff;
+		size_t uVar = 0;
+		if ( fTangent && args.Extract( 0, 1, body, vslot, uVar ) )
+		{
+			try
+			{
+				pdiff.reset( new CExprDiff<TOK>( rules, body ) );
+				vdir.assign( vslot.size(), TOK( 0.0L ) );
+				vdir[uVar] = TOK( 1.0L );
+			}
+			catch ( CExprParserException & e )
+			{
+				UNREFERENCED_PARAMETER( e );
+			}
+		}
+
+		CExprSolver<long double>::DERIV fdf;
+		if ( pdiff )
+		{
+			fdf = [ &pdiff, &vslot, &vdir, &x, uVar ]( long double v, long double & df )
+			{
+				x.v = v;
+				vslot[uVar] = x;
+				TOK y;
+				const TOK dy = pdiff->Tangent( vslot.data(), vdir.data(), y );
+				ASSERT_UNDEF(y);
+				df = dy.v.real();
+				return y.v.real();
+			};
+		}
+
+		// the body may solve too, so the report is taken at the end
+		EXPR_NUMERIC_REPORT report( pszMethod );
+		const long double result = method( f, fdf, x0.v.real(), tol.v.real(), report );
+		Report() = report;
+		return TOK( result );
+	};
+	auto fsolve = [ numeric ]( const CExprLazyArgs<TOK> & args )
+		{
+			return numeric( args, TEXT("solve"), SOLVE_TOLERANCE, TRUE, []( const CExprSolver<long double>::FUNC & f, const CExprSolver<long double>::DERIV & fdf, long double x0, long double tol, EXPR_NUMERIC_REPORT & report )
+				{ return CExprSolver<long double>::Solve( f, fdf, x0, tol, report ); } );
+		};
+	auto fminimize = [ numeric ]( const CExprLazyArgs<TOK> & args )
+		{
+			return numeric( args, TEXT("minimize"), MINIMIZE_TOLERANCE, FALSE, []( const CExprSolver<long double>::FUNC & f, const CExprSolver<long double>::DERIV & fdf, long double x0, long double tol, EXPR_NUMERIC_REPORT & report )
+				{ UNREFERENCED_PARAMETER( fdf ); return CExprSolver<long double>::Minimize( f, x0, tol, report ); } );
+		};
+
+	// uniform( k[, s] ) and normal( k[, s] ) are the variates number k of the stream s, 0 by
+	// default. They are functions of the counters, so the same arguments give the same value
+	auto counter = []( const TOK & a )
+	{
+		ASSERT_UNDEF(a);
+		const long double v = a.v.real();
+		if ( a.v.imag() != 0 || !( v >= 0 ) || v >= std::ldexp( 1.0L, 64 ) || v != std::floor( v ) )
+		{
+			throw CExprParserException(TEXT("The counter must be a non-negative integer"));
+		}
+
+		return uint64_t( v );
+	};
+	auto variate = [ counter ]( const std::vector<TOK> & varg, long double ( *pfn )( uint64_t, uint64_t ) )
+	{
+		if ( varg.size() < 1 || varg.size() > 2 )
+		{
+			throw CExprParserException(TEXT("The variate takes the counter and the stream"));
+		}
+
+		return TOK( pfn( counter( varg[0] ), varg.size() > 1 ? counter( varg[1] ) : 0 ) );
+	};
+	auto funiform = [ variate ]( const std::vector<TOK> & varg ) { return variate( varg, CExprRandom::Uniform ); };
+	auto fnormal = [ variate ]( const std::vector<TOK> & varg ) { return variate( varg, CExprRandom::Normal ); };
+
+	// mc( k, n, body ) is the mean of body over k = 0, 1, ... n - 1, each batch of the samples
+	// is evaluated by one Map. Report() takes the variance and half of the 95% interval
+	auto fmc = [ counter ]( const CExprLazyArgs<TOK> & args )
+	{
+		if ( args.Count() != 3 )
+		{
+			throw CExprParserException(TEXT("mc takes the variable, the count of samples and the body"));
+		}
+
+		const uint64_t count = counter( args[1] );
+		std::vector<TOK> vin, vout;
+		auto batch = [ &args, &vin, &vout ]( size_t first, std::complex<long double> * py, size_t count )
+		{
+			vin.resize( count );
+			vout.resize( count );
+			for ( size_t n = 0; n < count; ++n )
+			{
+				vin[n] = TOK( (long double) ( first + n ) );
+				vin[n].var = TRUE;
+			}
+
+			args.Map( 0, 2, vin.data(), vout.data(), count );
+			for ( size_t n = 0; n < count; ++n )
+			{
+				ASSERT_UNDEF(vout[n]);
+				py[n] = vout[n].v;
+			}
+		};
+
+		EXPR_NUMERIC_REPORT report( TEXT("mc") );
+		const TOK result = CExprMonteCarlo<std::complex<long double>>::Mean( batch, size_t( count ), report );
+		Report() = report;
+		return result;
+	};
+
+	// assignment changes its variable, so it isn't pure
+	const UINT uArith = efaPure | efaRealClosed;
+	AddOp( _T( '+' ), 10, etaLeftOriented, uArith | efaCommutative ) = opPlus;
+	AddOp( _T( '-' ), 10, etaLeftOriented, uArith ) = opSubs;
+	AddOp( _T( '*' ), 5, etaLeftOriented, uArith | efaCommutative ) = opMult;
+	AddOp( nullptr, 5, etaLeftOriented, uArith | efaCommutative ) = opMult;
+	AddOp( _T( '/' ), 5, etaLeftOriented, uArith ) = opDivd;
+	AddOp( _T( '^' ), 4, etaRightOriented, efaPure, eccElementary ) = opPow;
+	AddOp( _T( ';' ), 40, etaRightOriented, uArith ) = opSemicolon;
+	AddOp( _T( '<' ), 15, etaLeftOriented, uArith ) = opLess;
+	AddOp( _T( '>' ), 15, etaLeftOriented, uArith ) = opGreater;
 	AddOp( _T( '=' ), 20, etaRightOriented ) = opEqu;
 
-	AddUnaryOp( _T('+'), TRUE, 10 ) = unPlus;
-	AddUnaryOp( _T('-'), TRUE, 10 ) = unNegt;
-	AddUnaryOp( _T('~'), TRUE, 1 ) = unRevr;
-	AddUnaryOp( _T('!'), FALSE, 1 ) = unFact;
-
-	AddFunc( TEXT("sin"), 1 ) = fsin;
-	AddFunc( TEXT("sinc"), 1 ) = fsinc;
-	AddFunc( TEXT("cos"), 1 ) = fcos;
-	AddFunc( TEXT("tg"), 1 ) = ftan;
-	AddFunc( TEXT("ctg"), 1 ) = fctan;
-	AddFunc( TEXT("arcsin"), 1 ) = fasin;
-	AddFunc( TEXT("arccos"), 1 ) = facos;
-	AddFunc( TEXT("arctg"), 1 ) = fatan;
-	AddFunc( TEXT("arcctg"), 1 ) = factan;
-	AddFunc( TEXT("pi"), 0 ) = fpi;
-	AddFunc( TEXT("e"), 0 ) = fe;
-	AddFunc( TEXT("exp"), 1 ) = fexp;
-	AddFunc( TEXT("sqrt"), 1 ) = fsqrt;
-	AddFunc( TEXT("cbrt"), 1 ) = fcbrt;
+	AddUnaryOp( _T('+'), TRUE, 10, uArith ) = unPlus;
+	AddUnaryOp( _T('-'), TRUE, 10, uArith ) = unNegt;
+	AddUnaryOp( _T('~'), TRUE, 1, uArith ) = unRevr;
+	AddUnaryOp( _T('!'), FALSE, 1, uArith, eccElementary ) = unFact;
+
+	// arcsin, arccos and the roots of negative numbers are complex
+	AddFunc( TEXT("sin"), 1, uArith ) = fsin;
+	AddFunc( TEXT("sinc"), 1, uArith ) = fsinc;
+	AddFunc( TEXT("cos"), 1, uArith ) = fcos;
+	AddFunc( TEXT("tg"), 1, uArith ) = ftan;
+	AddFunc( TEXT("ctg"), 1, uArith ) = fctan;
+	AddFunc( TEXT("arcsin"), 1, efaPure ) = fasin;
+	AddFunc( TEXT("arccos"), 1, efaPure ) = facos;
+	AddFunc( TEXT("arctg"), 1, uArith ) = fatan;
+	AddFunc( TEXT("arcctg"), 1, uArith ) = factan;
+	AddFunc( TEXT("pi"), 0, uArith, eccCheap ) = fpi;
+	AddFunc( TEXT("e"), 0, uArith, eccCheap ) = fe;
+	AddFunc( TEXT("exp"), 1, uArith ) = fexp;
+	AddFunc( TEXT("sqrt"), 1, efaPure ) = fsqrt;
+	AddFunc( TEXT("cbrt"), 1, efaPure ) = fcbrt;
+	AddLazyFunc( TEXT("select"), 3, uArith ) = fselect;
+	AddLazyFunc( TEXT("and"), 2, uArith ) = flogand;
+	AddLazyFunc( TEXT("or"), 2, uArith ) = flogor;
+	AddLazyFunc( TEXT("sum"), 4, efaPure | efaBinds, eccExpensive ) = fsum;
+	AddLazyFunc( TEXT("prod"), 4, efaPure | efaBinds, eccExpensive ) = fprod;
+	AddLazyFunc( TEXT("integrate"), size_t( -1 ), efaPure | efaBinds, eccExpensive ) = fintegrate;
+	AddLazyFunc( TEXT("solve"), size_t( -1 ), efaPure | efaBinds, eccExpensive ) = fsolve;
+	AddLazyFunc( TEXT("minimize"), size_t( -1 ), efaPure | efaBinds, eccExpensive ) = fminimize;
+	AddFunc( TEXT("uniform"), size_t( -1 ), uArith, eccElementary ) = funiform;
+	AddFunc( TEXT("normal"), size_t( -1 ), uArith, eccElementary ) = fnormal;
+	AddLazyFunc( TEXT("mc"), 3, efaPure | efaBinds, eccExpensive ) = fmc;
+
+	// zeros of different signs give different results, e.g. 1/x
+	MemoHashFunc() = []( const TOK & a )
+		{
+			return std::hash<long double>()( a.v.real() ) * 31 + std::hash<long double>()( a.v.imag() ) + a.undef;
+		};
+	MemoEqualFunc() = []( const TOK & a, const TOK & b )
+		{
+			return BOOL( a.undef == b.undef && a.v == b.v &&
+				std::signbit( a.v.real() ) == std::signbit( b.v.real() ) && std::signbit( a.v.imag() ) == std::signbit( b.v.imag() ) );
+		};
 	// AddFunc( TEXT("ctest"), 1 ) = ctest;
 }
 
+EXPR_NUMERIC_REPORT & CMyParser::Report()
+{
+	static thread_local EXPR_NUMERIC_REPORT report;
+	return report;
+}
+
+VOID CMyParser::Optimizer( CExprOptimizer<TOK> & opt )
+{
+	// '~' is identity for real numbers only
+	opt.AddIdentity( entUnary, TEXT( "+" ), 0 );
+	opt.AddIdentity( entBinary, TEXT( ";" ), 1 );
+	opt.AddWriter( TEXT( "=" ) );
+
+	opt.ClassifyFunc() = []( const TOK & a )
+		{
+			if ( a.undef )
+			{
+				return UINT( 0 );
+			}
+			else if ( a.v.imag() != 0 )
+			{
+				return UINT( evkValue );
+			}
+
+			const long double re = a.v.real();
+			return UINT( evkValue | evkReal | ( std::isfinite( re ) && re == std::floor( re ) ? evkInteger : 0 ) | ( re >= 0 ? evkNonNegative : 0 ) );
+		};
+	opt.EqualFunc() = []( const TOK & a, const TOK & b ) { return BOOL( a.undef == b.undef && a.v == b.v ); };
+
+	// operators of the polynomials, see "horner" pass
+	opt.AddArithmetic( earAdd, TEXT( "+" ) ) = []( TOK & a, TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v + b.v ); };
+	opt.AddArithmetic( earSub, TEXT( "-" ) ) = []( TOK & a, TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v - b.v ); };
+	opt.AddArithmetic( earMul, TEXT( "*" ) ) = []( TOK & a, TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v * b.v ); };
+	opt.AddArithmetic( earMul, TEXT( "" ) );
+	opt.AddArithmetic( earDiv, TEXT( "/" ) ) = []( TOK & a, TOK & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return TOK( a.v / b.v ); };
+	opt.AddArithmetic( earPow, TEXT( "^" ) );
+	opt.AddArithmetic( earNeg, TEXT( "-" ) );
+
+	// integer exponent up to POW_INT_MAX is evaluated by repeated squaring instead of exp( b log( a ) ).
+	// Real bases are squared in long double: complex products of infinities give NaN parts
+	opt.AddBoundOp( TEXT( "^" ) ) = []( const TOK & b ) -> std::function<TOK( TOK&, TOK& )>
+		{
+			const long double n = b.v.real();
+			if ( b.undef || b.v.imag() != 0 || n != std::floor( n ) || n == 0 || std::fabs( n ) > POW_INT_MAX )
+			{
+				return nullptr;
+			}
+
+			const long e = long( n );
+			return [ e ]( TOK & a, TOK & b )
+				{
+					D2("^", a, b);
+					ASSERT_UNDEF(a);
+					if ( a.v == 0.0L )
+					{
+						return TOK( std::pow( a.v, b.v ) );
+					}
+
+					return ( a.v.imag() == 0 ? TOK( PowInt( a.v.real(), e ) ) : TOK( PowInt( a.v, e ) ) );
+				};
+		};
+
+	// real variants compute in long double instead of complex. Functions which may leave
+	// the real axis for real arguments (sqrt, cbrt, arcsin, arccos) have no variants
+	opt.AddRealOp( TEXT( "+" ) ) = []( TOK & a, TOK & b ) { return TOK( a.v.real() + b.v.real() ); };
+	opt.AddRealOp( TEXT( "-" ) ) = []( TOK & a, TOK & b ) { return TOK( a.v.real() - b.v.real() ); };
+	opt.AddRealOp( TEXT( "*" ) ) = []( TOK & a, TOK & b ) { return TOK( a.v.real() * b.v.real() ); };
+	opt.AddRealOp( TEXT( "" ) ) = []( TOK & a, TOK & b ) { return TOK( a.v.real() * b.v.real() ); };
+	opt.AddRealOp( TEXT( "/" ) ) = []( TOK & a, TOK & b ) { return TOK( a.v.real() / b.v.real() ); };
+	opt.AddRealOp( TEXT( "^" ), evkReal | evkInteger ) = []( TOK & a, TOK & b )
+		{
+			const long double x = a.v.real(), n = b.v.real();
+			return TOK( x != 0 && n != 0 && std::fabs( n ) <= POW_INT_MAX ? PowInt( x, long( n ) ) : std::pow( x, n ) );
+		};
+	// power of negative base is complex for real exponent. exp( b log( a ) ) is faster than
+	// complex std::pow and more accurate, long double std::pow is slower than both
+	opt.AddRealOp( TEXT( "^" ), evkReal, evkReal | evkNonNegative ) = []( TOK & a, TOK & b )
+		{
+			const long double x = a.v.real(), y = b.v.real();
+			return TOK( x != 0 ? std::exp( y * std::log( x ) ) : std::pow( x, y ) );
+		};
+	opt.AddRealOp( TEXT( ";" ) ) = []( TOK & a, TOK & b ) { return b; };
+
+	opt.AddRealUnaryOp( TEXT( "+" ), TRUE ) = []( const TOK & a ) { return a; };
+	opt.AddRealUnaryOp( TEXT( "-" ), TRUE ) = []( const TOK & a ) { return TOK( -a.v.real() ); };
+	opt.AddRealUnaryOp( TEXT( "~" ), TRUE ) = []( const TOK & a ) { return a; };
+	opt.AddRealUnaryOp( TEXT( "!" ), FALSE ) = []( const TOK & a ) { return TOK( std::tgamma( a.v.real() + 1.0L ) ); };
+
+	opt.AddRealFunc( TEXT( "" ) ) = []( const std::vector<TOK> & varg ) { return varg[0]; };
+	opt.AddRealFunc( TEXT( "sin" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::sin( varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "sinc" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::sin( varg[0].v.real() ) / varg[0].v.real() ); };
+	opt.AddRealFunc( TEXT( "cos" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::cos( varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "tg" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::tan( varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "ctg" ) ) = []( const std::vector<TOK> & varg ) { return TOK( 1.0L / std::tan( varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "arctg" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::atan( varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "arcctg" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::atan( 1.0L / varg[0].v.real() ) ); };
+	opt.AddRealFunc( TEXT( "exp" ) ) = []( const std::vector<TOK> & varg ) { return TOK( std::exp( varg[0].v.real() ) ); };
+}
+
+VOID CMyParser::Fusion( CExprFusion<TOK> & fusion )
+{
+	// products followed by sums in one call. Complex long double has no fused multiply-add,
+	// so the results are rounded as by the separate operators
+	for ( LPCTSTR pszMul : { TEXT( "*" ), TEXT( "" ) } )
+	{
+		fusion.AddFused( pszMul, TEXT( "+" ), 0 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( a.v * b.v + c.v ); };
+		fusion.AddFused( pszMul, TEXT( "+" ), 1 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( c.v + a.v * b.v ); };
+		fusion.AddFused( pszMul, TEXT( "-" ), 0 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( a.v * b.v - c.v ); };
+		fusion.AddFused( pszMul, TEXT( "-" ), 1 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( c.v - a.v * b.v ); };
+		fusion.AddFused( pszMul, TEXT( "*" ), 0 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( a.v * b.v * c.v ); };
+		fusion.AddFused( pszMul, TEXT( "*" ), 1 ) = []( TOK & a, TOK & b, TOK & c ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); ASSERT_UNDEF(c); return TOK( c.v * ( a.v * b.v ) ); };
+	}
+}
+
+// digamma of real x by the recurrence up to 10 and the asymptotic series, the derivative of
+// the logarithm of tgamma
+static long double Digamma( long double x )
+{
+	if ( x <= 0 && x == std::floor( x ) )
+	{
+		return NAN;
+	}
+	else if ( x < 0.5L )
+	{
+		return Digamma( 1 - x ) - M_PIC / std::tan( M_PIC * x );
+	}
+
+	long double r = 0;
+	for ( ; x < 10; x += 1 )
+	{
+		r -= 1 / x;
+	}
+
+	const long double x2 = 1 / ( x * x );
+	return r + std::log( x ) - 0.5L / x - x2 * ( 1.0L / 12 - x2 * ( 1.0L / 120 - x2 * ( 1.0L / 252 - x2 * ( 1.0L / 240 - x2 / 132 ) ) ) );
+}
+
+VOID CMyParser::Derivatives( CExprDerivatives<TOK> & rules )
+{
+	rules.AddFunc() = []( const TOK & a, const TOK & b ) { return TOK( a.v + b.v ); };
+	rules.MulFunc() = []( const TOK & a, const TOK & b ) { return TOK( a.v * b.v ); };
+
+	for ( LPCTSTR pszMul : { TEXT( "*" ), TEXT( "" ) } )
+	{
+		rules.AddRule( entBinary, pszMul ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = a[1]; p[1] = a[0]; };
+	}
+
+	rules.AddRule( entBinary, TEXT( "+" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 1.0L ); p[1] = TOK( 1.0L ); };
+	rules.AddRule( entBinary, TEXT( "-" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 1.0L ); p[1] = TOK( -1.0L ); };
+	rules.AddRule( entBinary, TEXT( "/" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 1.0L / a[1].v ); p[1] = TOK( -r.v / a[1].v ); };
+	rules.AddRule( entBinary, TEXT( ";" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 0.0L ); p[1] = TOK( 1.0L ); };
+
+	// zero power of zero base doesn't depend on the exponent. Integer exponents take b a^(b - 1)
+	// as the bound power does, zero real base takes the real std::pow: the complex one gives
+	// NaN for 0^0 of b = 1
+	rules.AddRule( entBinary, TEXT( "^" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p )
+		{
+			const long double x = a[0].v.real(), e = a[1].v.real();
+			if ( a[1].v.imag() != 0 || e != std::floor( e ) || std::fabs( e ) > POW_INT_MAX )
+			{
+				p[0] = ( a[0].v == 0.0L && a[1].v.imag() == 0 ? TOK( e * std::pow( x, e - 1 ) ) : TOK( a[1].v * std::pow( a[0].v, a[1].v - 1.0L ) ) );
+			}
+			else if ( e == 0 || e == 1 )
+			{
+				p[0] = TOK( e );
+			}
+			else if ( a[0].v.imag() == 0 )
+			{
+				p[0] = TOK( e * ( x != 0 ? PowInt( x, long( e ) - 1 ) : std::pow( x, e - 1 ) ) );
+			}
+			else
+			{
+				p[0] = TOK( e * PowInt( a[0].v, long( e ) - 1 ) );
+			}
+
+			p[1] = TOK( r.v == 0.0L ? std::complex<long double>() : r.v * std::log( a[0].v ) );
+		};
+
+	// comparisons and the variates are steps of their arguments
+	auto zero = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { std::fill( p, p + n, TOK( 0.0L ) ); };
+	rules.AddRule( entBinary, TEXT( "<" ) ) = zero;
+	rules.AddRule( entBinary, TEXT( ">" ) ) = zero;
+	rules.AddRule( entFunc, TEXT( "uniform" ) ) = zero;
+	rules.AddRule( entFunc, TEXT( "normal" ) ) = zero;
+
+	// the complex derivatives, '~' is taken as identity, as for real numbers
+	rules.AddRule( entUnary, TEXT( "+" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 1.0L ); };
+	rules.AddRule( entUnary, TEXT( "-" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( -1.0L ); };
+	rules.AddRule( entUnary, TEXT( "~" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 1.0L ); };
+	rules.AddRule( entUnary, TEXT( "!" ), FALSE ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( r.v * Digamma( a[0].v.real() + 1 ) ); };
+
+	const std::complex<long double> one( 1.0L );
+	rules.AddRule( entFunc, TEXT( "sin" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( std::cos( a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "sinc" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( ( std::cos( a[0].v ) - r.v ) / a[0].v ); };
+	rules.AddRule( entFunc, TEXT( "cos" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( -std::sin( a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "tg" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( one + r.v * r.v ); };
+	rules.AddRule( entFunc, TEXT( "ctg" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( -( one + r.v * r.v ) ); };
+	rules.AddRule( entFunc, TEXT( "arcsin" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( one / std::sqrt( one - a[0].v * a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "arccos" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( -one / std::sqrt( one - a[0].v * a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "arctg" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( one / ( one + a[0].v * a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "arcctg" ) ) = [ one ]( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( -one / ( one + a[0].v * a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "exp" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = r; };
+	rules.AddRule( entFunc, TEXT( "sqrt" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( 0.5L / r.v ); };
+	rules.AddRule( entFunc, TEXT( "cbrt" ) ) = []( const TOK * a, size_t n, const TOK & r, TOK * p ) { p[0] = TOK( r.v / ( 3.0L * a[0].v ) ); };
+	rules.AddRule( entFunc, TEXT( "pi" ) ) = zero;
+	rules.AddRule( entFunc, TEXT( "e" ) ) = zero;
+}
+
 void CMyParser::ParseDouble( const CStringOp & sExpression, size_t & uAtChar, long double & d )
 {
 	size_t length = sExpression.GetLength();
@@ -202,11 +658,25 @@ void CMyParser::ParseDouble( const CStringOp & sExpression, size_t & uAtChar, lo
 	}
 }
 
+static BOOL IsNameChar( TCHAR chr )
+{
+	return ( chr >= _T('A') && chr <= _T('Z') || chr >= _T('a') && chr <= _T('z') || chr >= _T('0') && chr <= _T('9') || chr == _T('_') );
+}
+
 void CMyParser::ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOK & d)
 {
 	size_t length = sExpression.GetLength();
 	if ( sExpression[ uAtChar ] == _T('i') )
 	{
+		// 'i' which starts the name of a function, e.g. integrate( ... ), isn't the imaginary unit
+		size_t u = uAtChar + 1, uBrace;
+		for ( ; u < length && IsNameChar( sExpression[ u ] ); ++u );
+		for ( uBrace = u; uBrace < length && sExpression[ uBrace ] == _T(' '); ++uBrace );
+		if ( u > uAtChar + 1 && uBrace < length && sExpression[ uBrace ] == _T('(') && GetFunc( sExpression.Mid( uAtChar, u ).GetString() ) )
+		{
+			throw CExprParserInvalidNumeric();
+		}
+
 		uAtChar++;
 		d = TOK(0.0, 1.0);
 		return;
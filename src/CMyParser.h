@@ -18,9 +18,16 @@
 #pragma once
 
 #include "CExprParserTemplate.h"
+#include "CExprOptimizer.h"
+#include "CExprFusion.h"
+#include "CExprDiff.h"
+#include "CExprNumeric.h"
+#include "CExprRandom.h"
 #include <complex>
 #include <math.h>
 
+#define M_PIC 	3.14159265358979323846264338327950288419716939937510582097494459230781640628620899862803482534211706798214808651328230664709384460955058223172535940812848111745028410270193852110555964462294895493038196442881097566593344612847564823378678316527120
+
 typedef struct _tag_CComplex
 {
 	BOOL				undef;
@@ -44,6 +51,30 @@ typedef struct _tag_CComplex
 
 typedef CComplex TOK;
 
+// greatest exponent evaluated by repeated squaring, the error grows with the exponent
+#define POW_INT_MAX		64
+
+// left-to-right binary exponentiation, n != 0. Zero base is left to std::pow
+template <class T>
+static inline T PowInt( const T & a, long n )
+{
+	unsigned long m = ( n < 0 ? -n : n ), bit = 1;
+	while ( ( bit << 1 ) <= m ) bit <<= 1;
+
+	T r = a;
+	for ( bit >>= 1; bit; bit >>= 1 )
+	{
+		r *= r;
+		if ( m & bit )
+		{
+			r *= a;
+		}
+	}
+
+	return ( n < 0 ? T( 1 ) / r : r );
+}
+
+
 class CMyParser : public CExprParser<TOK>
 {
 	void ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOK & d );
@@ -52,4 +83,16 @@ class CMyParser : public CExprParser<TOK>
 
 public:
 	CMyParser( );
+
+	// registers the operators of this parser which optimizer can rely on
+	static VOID Optimizer( CExprOptimizer<TOK> & opt );
+
+	// registers the fused functions of the operator pairs
+	static VOID Fusion( CExprFusion<TOK> & fusion );
+
+	// registers the derivatives of the operators and functions, see CExprDiff
+	static VOID Derivatives( CExprDerivatives<TOK> & rules );
+
+	// report of the last numerical built-in on this thread
+	static EXPR_NUMERIC_REPORT & Report();
 };
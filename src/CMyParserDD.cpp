@@ -0,0 +1,277 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The operators and functions of CMyParser in complex double-double numbers */
+
+#include "CMyParserDD.h"
+
+#define ASSERT_UNDEF(a)	{ if ( (a).undef ) throw CExprParserException(CStringOp().Format(TEXT("The variable %" TFMT_S " is undefined"), a.name.GetString()).GetString()); }
+#define ASSERT_NOTVAR(a) { if ( !(a).var ) throw CExprParserException(TEXT("Assignment is not valid for non-variable tokens")); }
+
+typedef CComplexDD CDD;
+
+// 10^n, exact up to 10^22
+static CDoubleDouble Pow10( long n )
+{
+	return ( n ? PowInt( CDoubleDouble( 10.0 ), n ) : CDoubleDouble( 1.0 ) );
+}
+
+CMyParserDD::CMyParserDD()
+	: CExprParser<TOKDD>( _T('('), _T(')'), _T(','), 0 )
+{
+	auto opPlus = []( TOKDD & a, TOKDD & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v + b.v; };
+	auto opSubs = []( TOKDD & a, TOKDD & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v - b.v; };
+	auto opMult = []( TOKDD & a, TOKDD & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v * b.v; };
+	auto opDivd = []( TOKDD & a, TOKDD & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v / b.v; };
+	auto opPow = []( TOKDD & a, TOKDD & b )
+		{
+			ASSERT_UNDEF(a);
+			ASSERT_UNDEF(b);
+
+			// integer exponents by repeated squaring as the bound "^" of CMyParser
+			const double n = b.v.re.hi;
+			if ( b.v.im.hi == 0 && b.v.re.lo == 0 && n == std::floor( n ) && n != 0 && std::fabs( n ) <= POW_INT_MAX && a.v != CDD() )
+			{
+				return PowInt( a.v, long( n ) );
+			}
+
+			return CDD::Pow( a.v, b.v );
+		};
+	auto opSemicolon = []( TOKDD & a, TOKDD & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return b; };
+	auto opEqu = []( TOKDD & a, TOKDD & b ) { ASSERT_NOTVAR(a); ASSERT_UNDEF(b); a = b; return a; };
+
+	auto unPlus = []( const TOKDD & a ) { ASSERT_UNDEF(a); return a; };
+	auto unNegt = []( const TOKDD & a ) { ASSERT_UNDEF(a); return -a.v; };
+	auto unRevr = []( const TOKDD & a ) { ASSERT_UNDEF(a); return TOKDD( a.v.re, -a.v.im ); };
+	auto unFact = []( const TOKDD & a )
+		{
+			ASSERT_UNDEF(a);
+			if ( std::fabs( a.v.im.hi ) < 1e-11 )
+			{
+				// gamma function has long double precision
+				return TOKDD( CDoubleDouble( std::tgamma( static_cast<long double>( a.v.re ) + 1.0L ) ) );
+			}
+			else
+			{
+				throw CExprParserException(TEXT("Factorial takes only real numbers"));
+			}
+		};
+
+	auto fsin = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Sin( varg[0].v ); };
+	auto fsinc = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Sin( varg[0].v ) / varg[0].v; };
+	auto fcos = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Cos( varg[0].v ); };
+	auto ftan = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Tan( varg[0].v ); };
+	auto fctan = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD( 1.0 ) / CDD::Tan( varg[0].v ); };
+	auto fasin = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Asin( varg[0].v ); };
+	auto facos = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Acos( varg[0].v ); };
+	auto fatan = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Atan( varg[0].v ); };
+	auto factan = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Atan( CDD( 1.0 ) / varg[0].v ); };
+	auto fpi = []( const std::vector<TOKDD> & varg ) { return TOKDD( CDoubleDouble::Pi() ); };
+	auto fe = []( const std::vector<TOKDD> & varg ) { return TOKDD( CDoubleDouble::E() ); };
+	auto fexp = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Exp( varg[0].v ); };
+	auto fsqrt = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Sqrt( varg[0].v ); };
+	auto fcbrt = []( const std::vector<TOKDD> & varg ) { ASSERT_UNDEF(varg[0]); return CDD::Pow( varg[0].v, CDoubleDouble( 1.0 ) / CDoubleDouble( 3.0 ) ); };
+
+	// double-double has no imaginary part, domain errors give NaN
+	const UINT uReal = efaPure | efaRealClosed;
+	AddOp( _T( '+' ), 10, etaLeftOriented, uReal | efaCommutative ) = opPlus;
+	AddOp( _T( '-' ), 10, etaLeftOriented, uReal ) = opSubs;
+	AddOp( _T( '*' ), 5, etaLeftOriented, uReal | efaCommutative ) = opMult;
+	AddOp( nullptr, 5, etaLeftOriented, uReal | efaCommutative ) = opMult;
+	AddOp( _T( '/' ), 5, etaLeftOriented, uReal ) = opDivd;
+	AddOp( _T( '^' ), 4, etaRightOriented, uReal, eccElementary ) = opPow;
+	AddOp( _T( ';' ), 40, etaRightOriented, uReal ) = opSemicolon;
+	AddOp( _T( '=' ), 20, etaRightOriented ) = opEqu;
+
+	AddUnaryOp( _T('+'), TRUE, 10, uReal ) = unPlus;
+	AddUnaryOp( _T('-'), TRUE, 10, uReal ) = unNegt;
+	AddUnaryOp( _T('~'), TRUE, 1, uReal ) = unRevr;
+	AddUnaryOp( _T('!'), FALSE, 1, uReal, eccElementary ) = unFact;
+
+	AddFunc( TEXT("sin"), 1, uReal ) = fsin;
+	AddFunc( TEXT("sinc"), 1, uReal ) = fsinc;
+	AddFunc( TEXT("cos"), 1, uReal ) = fcos;
+	AddFunc( TEXT("tg"), 1, uReal ) = ftan;
+	AddFunc( TEXT("ctg"), 1, uReal ) = fctan;
+	AddFunc( TEXT("arcsin"), 1, uReal ) = fasin;
+	AddFunc( TEXT("arccos"), 1, uReal ) = facos;
+	AddFunc( TEXT("arctg"), 1, uReal ) = fatan;
+	AddFunc( TEXT("arcctg"), 1, uReal ) = factan;
+	AddFunc( TEXT("pi"), 0, uReal, eccCheap ) = fpi;
+	AddFunc( TEXT("e"), 0, uReal, eccCheap ) = fe;
+	AddFunc( TEXT("exp"), 1, uReal ) = fexp;
+	AddFunc( TEXT("sqrt"), 1, uReal ) = fsqrt;
+	AddFunc( TEXT("cbrt"), 1, uReal ) = fcbrt;
+}
+
+// digits are collected as integers, so numbers up to 31 digits are exact before the scaling
+void CMyParserDD::ParseDouble( const CStringOp & sExpression, size_t & uAtChar, CDoubleDouble & d )
+{
+	size_t length = sExpression.GetLength();
+	int mode = 0;		// 0 - before dot, 1 - after dot, 2 - after 'e'
+	CDoubleDouble dDigits;
+	long nFraction = 0, ex = 0, exSign = 1;
+	bool fContinue = true;
+
+	size_t u = uAtChar;
+
+	for ( ; u < length && fContinue; ++u )
+	{
+		const TCHAR & s = sExpression[ LODWORD( u ) ];
+		if ( s >= _T( '0' ) && s <= _T( '9' ) )
+		{
+			switch ( mode )
+			{
+				case 0:
+				case 1:
+					{
+						dDigits = dDigits * CDoubleDouble( 10.0 ) + CDoubleDouble( double( s - _T( '0' ) ) );
+						nFraction += mode;
+						break;
+					}
+				case 2:		// exponenta
+				case 3:
+					{
+						ex = 10 * ex + ( s - _T( '0' ) );
+						// switch to mode '3' to identify complete exponenta
+						mode = 3;
+						break;
+					}
+			}
+		}
+		else
+		{
+			switch ( s )
+			{
+				case _T( '.' ):
+					{
+						if ( mode > 0 )	// duplicate dot? Bail out...
+						{
+							fContinue = false;
+							break;
+						}
+						mode = 1;
+						break;
+					}
+				case _T( 'e' ):
+				case _T( 'E' ):
+					{
+						if ( mode > 1 )	// duplicate 'e'? Bail out...
+						{
+							fContinue = false;
+							break;
+						}
+						mode = 2;
+
+						// check for sign
+						if ( u + 1 < length )
+						{
+							if ( _T( '-' ) == sExpression[ LODWORD( u + 1 ) ] )
+							{
+								exSign *= -1;
+								u++;
+							}
+							else if ( _T( '+' ) == sExpression[ LODWORD( u + 1 ) ] )
+							{
+								u++;
+							}
+						}
+						break;
+					}
+				default:
+					{
+						// unknown character
+						fContinue = false;
+						break;
+					}
+			}
+		}
+
+		if ( !fContinue )
+		{
+			break;
+		}
+	}
+
+	if ( u > uAtChar && 2 != mode )	// complete exponenta have mode==3
+	{
+		uAtChar = u;
+		const long nScale = exSign * ex - nFraction;
+		d = ( nScale < 0 ? dDigits / Pow10( -nScale ) : dDigits * Pow10( nScale ) );
+	}
+	else
+	{
+		throw CExprParserInvalidNumeric();
+	}
+}
+
+void CMyParserDD::ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOKDD & d)
+{
+	if ( sExpression[ uAtChar ] == _T('i') )
+	{
+		uAtChar++;
+		d = TOKDD(0.0, 1.0);
+		return;
+	}
+
+	CDoubleDouble dd;
+	ParseDouble( sExpression, uAtChar, dd );
+	d = TOKDD(dd);
+}
+
+BOOL CMyParserDD::IsVariable( const CStringOp & sExpression, size_t & uAtChar, TOKDD & dPossibleValue )
+{
+	size_t length = sExpression.GetLength();
+	size_t i = uAtChar, c = 0;
+
+	for(; i < length; ++i, ++c)
+	{
+		const TCHAR & chr = sExpression[i];
+		if ( c < 1 )
+		{
+			if ( chr >= _T('A') && chr <= _T('Z') || chr >= _T('a') && chr <= _T('z') || chr == _T('_') )
+			{
+				continue;
+			}
+			else
+			{
+				break;
+			}
+		}
+		else
+		{
+			if ( chr >= _T('A') && chr <= _T('Z') || chr >= _T('a') && chr <= _T('z') || chr >= _T('0') && chr <= _T('9') || chr == _T('_') )
+			{
+				continue;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	if ( c < 1 || c == 1 && sExpression[ uAtChar ] == _T('i') )	// dont allow to use 'i' as variable
+	{
+		return FALSE;
+	}
+
+	dPossibleValue = TOKDD(0.0);
+	dPossibleValue.undef = TRUE;
+	dPossibleValue.var = TRUE;
+	dPossibleValue.name = sExpression.Mid(uAtChar, c);
+	uAtChar = i;
+	return TRUE;
+}
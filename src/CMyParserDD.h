@@ -0,0 +1,56 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Parser of CMyParser expressions in complex double-double numbers */
+
+#pragma once
+
+#include "CMyParser.h"
+#include "CDoubleDouble.h"
+
+typedef struct _tag_CComplexDDToken
+{
+	BOOL				undef;
+	CComplexDD			v;
+	CStringOp			name;
+	BOOL				var;
+
+	_tag_CComplexDDToken(const CComplexDD & xv)
+		: v( xv ), undef( FALSE ), var(FALSE) { }
+
+	_tag_CComplexDDToken()
+		: undef( FALSE ), var(FALSE) {}
+
+	_tag_CComplexDDToken(const CDoubleDouble & real, const CDoubleDouble & imag)
+		: v(real, imag), undef(FALSE), var(FALSE) {}
+
+	_tag_CComplexDDToken(const CDoubleDouble & real)
+		: v(real), undef(FALSE), var(FALSE) {}
+
+	_tag_CComplexDDToken(double real)
+		: v(real), undef(FALSE), var(FALSE) {}
+} CComplexDDToken, *PCComplexDDToken;
+
+typedef CComplexDDToken TOKDD;
+
+class CMyParserDD : public CExprParser<TOKDD>
+{
+	void ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOKDD & d );
+	void ParseDouble( const CStringOp & sExpression, size_t & uAtChar, CDoubleDouble & d );
+	BOOL IsVariable( const CStringOp & sExpression, size_t & uAtChar, TOKDD & dPossibleValue );
+
+public:
+	CMyParserDD( );
+};
@@ -0,0 +1,220 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* The operators of CMyParser in checked integers */
+
+#include "CMyParserInt.h"
+
+#define ASSERT_UNDEF(a)	{ if ( (a).undef ) throw CExprParserException(CStringOp().Format(TEXT("The variable %" TFMT_S " is undefined"), a.name.GetString()).GetString()); }
+#define ASSERT_NOTVAR(a) { if ( !(a).var ) throw CExprParserException(TEXT("Assignment is not valid for non-variable tokens")); }
+
+// 33! is the greatest factorial below 2^127
+#define FACTORIAL_MAX		33
+
+CExprInteger CExprInteger::Pow( const CExprInteger & a, const CExprInteger & n )
+{
+	if ( a.m_n == 0 )
+	{
+		if ( n.m_n < 0 )
+		{
+			throw CExprParserDivisionByZero();
+		}
+
+		return ( n.m_n ? 0 : 1 );
+	}
+
+	if ( a.m_n == 1 || a.m_n == -1 )
+	{
+		return ( a.m_n == -1 && ( n.m_n & 1 ) ? -1 : 1 );
+	}
+
+	// 1 / a^n truncates to zero for |a| >= 2, a^127 overflows
+	if ( n.m_n < 0 )
+	{
+		return 0;
+	}
+
+	if ( n.m_n >= 127 )
+	{
+		throw CExprParserIntegerOverflow();
+	}
+
+	// left-to-right binary exponentiation
+	CExprInteger r = 1;
+	for ( int bit = 6; bit >= 0; --bit )
+	{
+		r *= r;
+		if ( ( n.m_n >> bit ) & 1 )
+		{
+			r *= a;
+		}
+	}
+
+	return r;
+}
+
+CExprInteger CExprInteger::Factorial( const CExprInteger & n )
+{
+	static const struct _tagFACTORIALS
+	{
+		__int128			v[ FACTORIAL_MAX + 1 ];
+
+		_tagFACTORIALS()
+		{
+			v[ 0 ] = 1;
+			for ( int k = 1; k <= FACTORIAL_MAX; ++k )
+			{
+				v[ k ] = v[ k - 1 ] * k;
+			}
+		}
+	} table;
+
+	if ( n.m_n < 0 )
+	{
+		throw CExprParserException(TEXT("Factorial takes only non-negative integers"));
+	}
+
+	if ( n.m_n > FACTORIAL_MAX )
+	{
+		throw CExprParserIntegerOverflow();
+	}
+
+	return table.v[ static_cast<int>( n.m_n ) ];
+}
+
+CStringOp CExprInteger::String() const
+{
+	TCHAR sz[ 48 ];
+	size_t u = sizeof( sz ) / sizeof( sz[ 0 ] ) - 1;
+	unsigned __int128 m = ( m_n < 0 ? -static_cast<unsigned __int128>( m_n ) : m_n );
+
+	sz[ u ] = 0;
+	do
+	{
+		sz[ --u ] = TCHAR( _T('0') + int( m % 10 ) );
+		m /= 10;
+	} while ( m );
+
+	if ( m_n < 0 )
+	{
+		sz[ --u ] = _T('-');
+	}
+
+	return CStringOp( sz + u );
+}
+
+CMyParserInt::CMyParserInt()
+	: CExprParser<TOKINT>( _T('('), _T(')'), _T(','), 0 )
+{
+	auto opPlus = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v + b.v; };
+	auto opSubs = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v - b.v; };
+	auto opMult = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v * b.v; };
+	auto opDivd = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v / b.v; };
+	auto opRem = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return a.v % b.v; };
+	auto opPow = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return CExprInteger::Pow( a.v, b.v ); };
+	auto opSemicolon = []( TOKINT & a, TOKINT & b ) { ASSERT_UNDEF(a); ASSERT_UNDEF(b); return b; };
+	auto opEqu = []( TOKINT & a, TOKINT & b ) { ASSERT_NOTVAR(a); ASSERT_UNDEF(b); a = b; return a; };
+
+	auto unPlus = []( const TOKINT & a ) { ASSERT_UNDEF(a); return a; };
+	auto unNegt = []( const TOKINT & a ) { ASSERT_UNDEF(a); return -a.v; };
+	auto unRevr = []( const TOKINT & a ) { ASSERT_UNDEF(a); return a.v; };
+	auto unFact = []( const TOKINT & a ) { ASSERT_UNDEF(a); return CExprInteger::Factorial( a.v ); };
+
+	AddOp( _T( '+' ), 10, etaLeftOriented, efaPure | efaCommutative ) = opPlus;
+	AddOp( _T( '-' ), 10, etaLeftOriented, efaPure ) = opSubs;
+	AddOp( _T( '*' ), 5, etaLeftOriented, efaPure | efaCommutative ) = opMult;
+	AddOp( nullptr, 5, etaLeftOriented, efaPure | efaCommutative ) = opMult;
+	AddOp( _T( '/' ), 5, etaLeftOriented, efaPure ) = opDivd;
+	AddOp( _T( '%' ), 5, etaLeftOriented, efaPure ) = opRem;
+	AddOp( _T( '^' ), 4, etaRightOriented, efaPure ) = opPow;
+	AddOp( _T( ';' ), 40, etaRightOriented, efaPure ) = opSemicolon;
+	AddOp( _T( '=' ), 20, etaRightOriented ) = opEqu;
+
+	AddUnaryOp( _T('+'), TRUE, 10, efaPure ) = unPlus;
+	AddUnaryOp( _T('-'), TRUE, 10, efaPure ) = unNegt;
+	AddUnaryOp( _T('~'), TRUE, 1, efaPure ) = unRevr;
+	AddUnaryOp( _T('!'), FALSE, 1, efaPure ) = unFact;
+}
+
+// decimal literal, overflow of 128 bits throws
+void CMyParserInt::ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOKINT & d )
+{
+	size_t length = sExpression.GetLength(), u = uAtChar;
+	CExprInteger n;
+
+	for ( ; u < length; ++u )
+	{
+		const TCHAR & s = sExpression[ LODWORD( u ) ];
+		if ( s < _T( '0' ) || s > _T( '9' ) )
+		{
+			break;
+		}
+
+		n = n * 10 + CExprInteger( s - _T( '0' ) );
+	}
+
+	if ( u == uAtChar )
+	{
+		throw CExprParserInvalidNumeric();
+	}
+
+	uAtChar = u;
+	d = TOKINT( n );
+}
+
+BOOL CMyParserInt::IsVariable( const CStringOp & sExpression, size_t & uAtChar, TOKINT & dPossibleValue )
+{
+	size_t length = sExpression.GetLength();
+	size_t i = uAtChar, c = 0;
+
+	for(; i < length; ++i, ++c)
+	{
+		const TCHAR & chr = sExpression[i];
+		if ( c < 1 )
+		{
+			if ( chr >= _T('A') && chr <= _T('Z') || chr >= _T('a') && chr <= _T('z') || chr == _T('_') )
+			{
+				continue;
+			}
+			else
+			{
+				break;
+			}
+		}
+		else
+		{
+			if ( chr >= _T('A') && chr <= _T('Z') || chr >= _T('a') && chr <= _T('z') || chr >= _T('0') && chr <= _T('9') || chr == _T('_') )
+			{
+				continue;
+			}
+			else
+			{
+				break;
+			}
+		}
+	}
+
+	if ( c < 1 )
+	{
+		return FALSE;
+	}
+
+	dPossibleValue = TOKINT( CExprInteger() );
+	dPossibleValue.undef = TRUE;
+	dPossibleValue.var = TRUE;
+	dPossibleValue.name = sExpression.Mid(uAtChar, c);
+	uAtChar = i;
+	return TRUE;
+}
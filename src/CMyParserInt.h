@@ -0,0 +1,191 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Parser of integer expressions: the operators of CMyParser and remainder in exact integers */
+
+#pragma once
+
+#include "CExprParserTemplate.h"
+#include <stdint.h>
+
+// signed integer with checked arithmetic. Operations on values which fit 64 bits run in 64 bits,
+// results which don't fit are computed in 128 bits, overflow of 128 bits throws
+class CExprInteger
+{
+	__int128				m_n;
+
+	static BOOL				Narrow( __int128 n )
+	{
+		return ( n == static_cast<int64_t>( n ) );
+	}
+
+public:
+	CExprInteger( __int128 n = 0 )
+		: m_n( n )
+	{
+	}
+
+	__int128				Value() const
+	{
+		return m_n;
+	}
+
+	// value doesn't fit 64 bits
+	BOOL					Wide() const
+	{
+		return !Narrow( m_n );
+	}
+
+	CExprInteger operator-() const
+	{
+		return CExprInteger() - *this;
+	}
+
+	CExprInteger operator+( const CExprInteger & b ) const
+	{
+		int64_t r;
+		__int128 w;
+		if ( Narrow( m_n ) && Narrow( b.m_n ) && !__builtin_add_overflow( static_cast<int64_t>( m_n ), static_cast<int64_t>( b.m_n ), &r ) )
+		{
+			return r;
+		}
+
+		if ( __builtin_add_overflow( m_n, b.m_n, &w ) )
+		{
+			throw CExprParserIntegerOverflow();
+		}
+
+		return w;
+	}
+
+	CExprInteger operator-( const CExprInteger & b ) const
+	{
+		int64_t r;
+		__int128 w;
+		if ( Narrow( m_n ) && Narrow( b.m_n ) && !__builtin_sub_overflow( static_cast<int64_t>( m_n ), static_cast<int64_t>( b.m_n ), &r ) )
+		{
+			return r;
+		}
+
+		if ( __builtin_sub_overflow( m_n, b.m_n, &w ) )
+		{
+			throw CExprParserIntegerOverflow();
+		}
+
+		return w;
+	}
+
+	CExprInteger operator*( const CExprInteger & b ) const
+	{
+		int64_t r;
+		__int128 w;
+		if ( Narrow( m_n ) && Narrow( b.m_n ) && !__builtin_mul_overflow( static_cast<int64_t>( m_n ), static_cast<int64_t>( b.m_n ), &r ) )
+		{
+			return r;
+		}
+
+		if ( __builtin_mul_overflow( m_n, b.m_n, &w ) )
+		{
+			throw CExprParserIntegerOverflow();
+		}
+
+		return w;
+	}
+
+	// quotient is truncated toward zero
+	CExprInteger operator/( const CExprInteger & b ) const
+	{
+		if ( !b.m_n )
+		{
+			throw CExprParserDivisionByZero();
+		}
+
+		if ( Narrow( m_n ) && Narrow( b.m_n ) && ( m_n != INT64_MIN || b.m_n != -1 ) )
+		{
+			return static_cast<int64_t>( m_n ) / static_cast<int64_t>( b.m_n );
+		}
+
+		if ( b.m_n == -1 )
+		{
+			return -*this;
+		}
+
+		return m_n / b.m_n;
+	}
+
+	// remainder has the sign of the dividend
+	CExprInteger operator%( const CExprInteger & b ) const
+	{
+		if ( !b.m_n )
+		{
+			throw CExprParserDivisionByZero();
+		}
+
+		if ( b.m_n == -1 )
+		{
+			return CExprInteger();
+		}
+
+		if ( Narrow( m_n ) && Narrow( b.m_n ) )
+		{
+			return static_cast<int64_t>( m_n ) % static_cast<int64_t>( b.m_n );
+		}
+
+		return m_n % b.m_n;
+	}
+
+	CExprInteger & operator*=( const CExprInteger & b ) { return ( *this = *this * b ); }
+
+	bool operator==( const CExprInteger & b ) const { return ( m_n == b.m_n ); }
+	bool operator!=( const CExprInteger & b ) const { return ( m_n != b.m_n ); }
+
+	// a^n, negative exponents truncate as the division
+	static CExprInteger		Pow( const CExprInteger & a, const CExprInteger & n );
+
+	// n! from the table, n <= 33
+	static CExprInteger		Factorial( const CExprInteger & n );
+
+	CStringOp				String() const;
+};
+
+typedef struct _tag_CIntegerToken
+{
+	BOOL				undef;
+	CExprInteger		v;
+	CStringOp			name;
+	BOOL				var;
+
+	_tag_CIntegerToken(const CExprInteger & xv)
+		: v( xv ), undef( FALSE ), var(FALSE) { }
+
+	_tag_CIntegerToken()
+		: undef( FALSE ), var(FALSE) {}
+
+	_tag_CIntegerToken(int64_t n)
+		: v(n), undef(FALSE), var(FALSE) {}
+} CIntegerToken, *PCIntegerToken;
+
+typedef CIntegerToken TOKINT;
+
+// '/' truncates, '%' is the remainder, '^' is exact and '!' is taken from the table.
+// Literals are decimal integers, 'i' is a variable
+class CMyParserInt : public CExprParser<TOKINT>
+{
+	void ParseNumeric( const CStringOp & sExpression, size_t & uAtChar, TOKINT & d );
+	BOOL IsVariable( const CStringOp & sExpression, size_t & uAtChar, TOKINT & dPossibleValue );
+
+public:
+	CMyParserInt( );
+};
@@ -183,8 +183,19 @@ CStringOp CStringOp::FormatV( LPCTSTR psz, va_list va )
 		size_t length = 4 * _tcslen( psz ) + 1;
 		sfmt.m_s.insert( sfmt.m_s.begin(), length, 0 );
 
-		while ( -1 == _vsntprintf( sfmt.m_s.data(), sfmt.m_s.size(), psz, va ) )
+		// each attempt takes its own copy of the arguments, the failed one has consumed them
+		for ( ;; )
 		{
+			va_list vacopy;
+			va_copy( vacopy, va );
+			const int nWritten = _vsntprintf( sfmt.m_s.data(), sfmt.m_s.size(), psz, vacopy );
+			va_end( vacopy );
+
+			if ( nWritten >= 0 && size_t( nWritten ) < sfmt.m_s.size() )
+			{
+				break;
+			}
+
 			sfmt.m_s.insert( sfmt.m_s.end(), length, 0 );
 		}
 
@@ -0,0 +1,124 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Compares the function generated by mexprgen (aot_expr.h) with CMyParser by results and speed */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+
+#include "Controls.h"
+#include "aot_expr.h"
+
+static std::complex<long double> ToComplex( double d ) { return std::complex<long double>( d, 0.0 ); }
+static std::complex<long double> ToComplex( const std::complex<long double> & d ) { return d; }
+
+int main(int argc, char ** argv, char ** env)
+{
+	size_t nRows = 100000;
+	long double tol = 1e-9;
+
+	for(int i = 1; i < argc - 1; i += 2)
+	{
+		if ( !strcmp(argv[i], "-n") ) nRows = strtoul(argv[i + 1], nullptr, 10);
+		else if ( !strcmp(argv[i], "-t") ) tol = strtold(argv[i + 1], nullptr);
+	}
+
+	std::vector<CStringOp> vnames;
+	std::vector<std::vector<mexpr_fn_num>> vcols( mexpr_fn_nvars, std::vector<mexpr_fn_num>( nRows ) );
+	std::vector<const mexpr_fn_num *> vpcols;
+	std::mt19937_64 rng( 1 );
+	std::uniform_real_distribution<double> dist( 0.5, 2.0 );
+
+	for(size_t v = 0; v < mexpr_fn_nvars; ++v)
+	{
+		vnames.push_back( CStringOp( mexpr_fn_vars[v] ) );
+		for(auto & x : vcols[v]) x = dist( rng );
+		vpcols.push_back( vcols[v].data() );
+	}
+
+	CMyParser parser;
+	std::vector<std::complex<long double>> vinterp( nRows );
+	std::vector<mexpr_fn_num> vaot( nRows );
+
+	try
+	{
+		parser.Compile( CStringOp( mexpr_fn_expression ).GetString() );
+	}
+	catch( CExprParserException & e )
+	{
+		tprintf(TEXT("Error compiling expression\n"));
+		return 1;
+	}
+
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		for(size_t v = 0; v < mexpr_fn_nvars; ++v)
+		{
+			TOK tok( ToComplex( vcols[v][n] ) );
+			tok.var = TRUE;
+			tok.name = vnames[v];
+			parser.AddVariable( vnames[v].GetString(), tok );
+		}
+
+		try
+		{
+			TOK result;
+			parser.Evaluate();
+			parser.Result( result );
+			vinterp[n] = result.v;
+		}
+		catch( CExprParserException & e )
+		{
+			vinterp[n] = std::complex<long double>( NAN, NAN );
+		}
+	}
+	auto t1 = std::chrono::steady_clock::now();
+	mexpr_fn_batch( vpcols.data(), vaot.data(), nRows );
+	auto t2 = std::chrono::steady_clock::now();
+
+	size_t nMismatch = 0;
+	long double maxErr = 0;
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		const std::complex<long double> a = ToComplex( vaot[n] ), b = vinterp[n];
+		const bool fFinA = std::isfinite( a.real() ) && std::isfinite( a.imag() );
+		const bool fFinB = std::isfinite( b.real() ) && std::isfinite( b.imag() );
+
+		if ( fFinA != fFinB )
+		{
+			nMismatch++;
+			continue;
+		}
+		else if ( fFinA )
+		{
+			long double err = std::abs( a - b ) / std::max( 1.0L, std::abs( b ) );
+			maxErr = std::max( maxErr, err );
+			if ( err > tol ) nMismatch++;
+		}
+	}
+
+	double nsInterp = std::chrono::duration<double, std::nano>( t1 - t0 ).count() / nRows;
+	double nsAot = std::chrono::duration<double, std::nano>( t2 - t1 ).count() / nRows;
+
+	tprintf(TEXT("rows: %ld, variables: %ld\n"), nRows, mexpr_fn_nvars);
+	tprintf(TEXT("interpreter: %.1f ns/eval, aot: %.2f ns/eval, speedup: %.1fx\n"), nsInterp, nsAot, nsInterp / nsAot);
+	tprintf(TEXT("max relative error: %Lg, mismatches (tolerance %Lg): %ld\n"), maxErr, tol, nMismatch);
+
+	return ( nMismatch ? 1 : 0 );
+}
@@ -14,12 +14,89 @@
 */
 
 #include <stdio.h>
+#include <string.h>
 
 // #define _DEBUG
 #include "Controls.h"
 #include "CMyParser.h"
+#include "CMyParserInt.h"
+#include "CExprSweep.h"
 #include <exception>
 
+// value of the row of the sweep
+static VOID PrintRow( const CStringOp & sVar, long double x, const TOK & result )
+{
+	if ( abs(result.v.imag()) < 1e-15 )
+	{
+		tprintf(
+#ifdef _UNICODE
+		TEXT("  %ls = %Lf: %Lf\n")
+#else
+		TEXT("  %s = %Lf: %Lf\n")
+#endif
+		, sVar.GetString(), x, result.v.real());
+	}
+	else
+	{
+		tprintf(
+#ifdef _UNICODE
+		TEXT("  %ls = %Lf: %Lf%c%Lfi\n")
+#else
+		TEXT("  %s = %Lf: %Lf%c%Lfi\n")
+#endif
+		, sVar.GetString(), x, result.v.real(), ( result.v.imag() > 0 ? _T('+') : _T('-') ), std::abs( result.v.imag() ) );
+	}
+}
+
+// evaluates the compiled expression for count values of sVar from start to stop. The nodes
+// which don't depend on it are evaluated once, other variables must be assigned by the expression
+static VOID Sweep( const CMyParser & parser, const CStringOp & sVar, long double start, long double stop, size_t count )
+{
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+
+	CExprOptimizer<TOK> opt;
+	CMyParser::Optimizer( opt );
+
+	const size_t uVar = prog.Slot( sVar );
+	CExprSweep<TOK> sweep( prog, uVar != size_t( -1 ) ? std::vector<size_t>( 1, uVar ) : std::vector<size_t>(), opt );
+
+	// variables without values are undefined, as in the parser
+	std::vector<TOK> vbatch( prog.Slots().size(), TOK( 0.0L ) ), vslots;
+	for(size_t v = 0; v < vbatch.size(); ++v)
+	{
+		vbatch[v].undef = ( v != uVar );
+		vbatch[v].var = TRUE;
+		vbatch[v].name = prog.Slots()[v];
+	}
+
+	sweep.Batch( vbatch.data() );
+	for(size_t n = 0; n < count; ++n)
+	{
+		const long double x = ( count > 1 ? start + ( stop - start ) * n / ( count - 1 ) : start );
+		vslots = vbatch;
+		if ( uVar != size_t( -1 ) )
+		{
+			vslots[ uVar ].v = x;
+		}
+
+		try
+		{
+			PrintRow( sVar, x, sweep.Execute( vslots.data() ) );
+		}
+		catch( CExprParserException & e )
+		{
+			tprintf(
+#ifdef _UNICODE
+			TEXT("  %ls = %Lf: Error evaluating: %ls\n")
+#else
+			TEXT("  %s = %Lf: Error evaluating: %s\n")
+#endif
+			, sVar.GetString(), x, e.Message().GetString());
+		}
+	}
+}
+
 int main(int argc, char ** argv, char ** env)
 {
 	if ( argc < 2 )
@@ -29,12 +106,70 @@ int main(int argc, char ** argv, char ** env)
 	}
 
 	CMyParser parser;
+	CMyParserInt parserInt;
+	BOOL fInteger = FALSE;		// expressions after -i are evaluated in integers
+	BOOL fSweep = FALSE;		// expressions after --sweep var=start:stop:count are evaluated over the grid
+	CStringOp sSweepVar;
+	long double sweepStart = 0, sweepStop = 0;
+	size_t nSweepCount = 0;
 	for(int i = 1; i < argc; ++i)
 	{
+		if ( !strcmp( argv[i], "-i" ) )
+		{
+			fInteger = TRUE;
+			continue;
+		}
+
+		if ( !strcmp( argv[i], "--sweep" ) )
+		{
+			char szVar[ 64 ];
+			if ( i + 1 >= argc || sscanf( argv[ i + 1 ], "%63[^=]=%Lf:%Lf:%zu", szVar, &sweepStart, &sweepStop, &nSweepCount ) != 4 || !nSweepCount )
+			{
+				tprintf(TEXT("ERROR: --sweep takes var=start:stop:count!\n"));
+				return 255;
+			}
+
+			sSweepVar = CStringOp( szVar );
+			fSweep = TRUE;
+			i++;
+			continue;
+		}
+
 		try
 		{
+			if ( fInteger )
+			{
+				TOKINT result;
+				parserInt.Compile( CStringOp( argv[i] ).GetString() );
+				parserInt.Evaluate();
+				parserInt.Result( result );
+
+				tprintf(
+#ifdef _UNICODE
+				TEXT("%ls = %ls\n")
+#else
+				TEXT("%s = %s\n")
+#endif
+				, CStringOp( argv[i] ).GetString(), result.v.String().GetString());
+				continue;
+			}
+
 			TOK result;
+			CMyParser::Report().pszMethod = nullptr;
 			parser.Compile( CStringOp( argv[i] ).GetString() );
+			if ( fSweep )
+			{
+				tprintf(
+#ifdef _UNICODE
+				TEXT("%ls:\n")
+#else
+				TEXT("%s:\n")
+#endif
+				, CStringOp( argv[i] ).GetString());
+				Sweep( parser, sSweepVar, sweepStart, sweepStop, nSweepCount );
+				continue;
+			}
+
 			parser.Evaluate();
 			parser.Result( result );
 
@@ -62,6 +197,25 @@ int main(int argc, char ** argv, char ** env)
 					( result.v.imag() > 0 ? _T('+') : _T('-') ),
 					std::abs( result.v.imag() ) );
 			}
+
+			// numerical functions report the last call
+			const EXPR_NUMERIC_REPORT & report = CMyParser::Report();
+			if ( report.pszMethod )
+			{
+				tprintf(
+#ifdef _UNICODE
+				TEXT("  %ls: %ld evaluations, %ld rounds, error %.3Lg%ls\n")
+#else
+				TEXT("  %s: %ld evaluations, %ld rounds, error %.3Lg%s\n")
+#endif
+				, report.pszMethod, report.nEvals, report.nIterations, report.error, report.fConverged ? TEXT("") : TEXT(", not converged"));
+
+				// samples tell their spread, the error is half of the 95% interval
+				if ( report.variance )
+				{
+					tprintf( TEXT("  variance %.6Lg, 95%% interval [%.6Lg, %.6Lg]\n"), report.variance, result.v.real() - report.error, result.v.real() + report.error );
+				}
+			}
 		}
 		catch( CExprParserException & e )
 		{
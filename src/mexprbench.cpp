@@ -0,0 +1,3033 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Benchmarks of the evaluation backends. Each mode compares results of a backend
+   with the interpreter on random inputs, prints the speed and fails on mismatches */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <quadmath.h>
+
+#include "Controls.h"
+#include "CMyJit.h"
+#include "CExprSpecialized.h"
+#include "CExprKernels.h"
+#include "CMyParserDD.h"
+#include "CMyBatchDD.h"
+#include "CMyParserInt.h"
+#include "CMyMixed.h"
+#include "CExprConst.h"
+#include "CExprBuilder.h"
+#include "CExprSweep.h"
+#include "CExprMulti.h"
+
+static LPCTSTR g_vszCorpus[] =
+{
+	TEXT("x^2 + 3x - 7"),
+	TEXT("ax^2 + bx + c"),
+	TEXT("sin(x)cos(y) + exp(-x^2)"),
+	TEXT("sqrt(x^2 + y^2)/(1 + x)"),
+	TEXT("(x - y)^3 / (x + y)^-2"),
+	TEXT("arctg(x/y) + arcctg(x) + ctg(y) + tg(x)"),
+	TEXT("x! + sinc(y) + cbrt(x - y)"),
+	TEXT("-x^2 - -y + ~x"),
+	TEXT("arcsin(x - 1) + arccos(y/2)"),
+	TEXT("x^y + 2^x + e()*pi()"),
+	TEXT("sqrt(x - y)"),
+	TEXT("x; y*2"),
+	TEXT("(a + b)(a - b)/(c + 1) + ((a*b + c)*x - (b*c - a)*y)^2"),
+	TEXT("4x^4 - 3x^3 + 2x^2 - x + 1"),
+	TEXT("0.5x^9 - 1.25x^8 + 2x^7 - x^6 + 0.75x^5 + 3x^4 - 2x^3 + x^2 - 4x + 1"),
+	TEXT("1 + x + x^2/2 + x^3/6 + x^4/24 + x^5/120 + x^6/720 + x^7/5040 + x^8/40320"),
+};
+
+// integer formulas for "int" mode when no expressions are given
+static LPCTSTR g_vszIntCorpus[] =
+{
+	TEXT("x^2 + 3x - 7"),
+	TEXT("ax^2 + bx + c"),
+	TEXT("((a*31 + b)*17 + c) % 1024"),
+	TEXT("(a + b)(a - b) + a*b*c - (c - a)^3"),
+	TEXT("(x + y)!/(x!*y!)"),
+	TEXT("x^25 - y^20"),
+	TEXT("4x^4 - 3x^3 + 2x^2 - x + 1"),
+	TEXT("i = i*i + j; i*k % 97"),
+};
+
+// ill-conditioned formulas added to the corpus in "mixed" mode: their double results are rejected
+static LPCTSTR g_vszMixedCorpus[] =
+{
+	TEXT("(x + 1e8) - 1e8 - x"),
+	TEXT("sin(1e10x)"),
+	TEXT("1/(x - y)"),
+	TEXT("(x - 1)^7 - (x^7 - 7x^6 + 21x^5 - 35x^4 + 35x^3 - 21x^2 + 7x - 1)"),
+};
+
+// formulas with repeated subexpressions added to the corpus in "cse" mode
+static LPCTSTR g_vszCseCorpus[] =
+{
+	TEXT("sin(x)^2 + cos(x)^2 + sin(x)cos(x)"),
+	TEXT("exp(-(x - y)^2)(x - y) + exp(-(x - y)^2)"),
+	TEXT("sqrt(x^2 + y^2) + 1/sqrt(y^2 + x^2)"),
+	TEXT("(a*b + c)x + (c + b*a)y + sin(a*b + c)"),
+	TEXT("x*y + (x = x + 1; x*y)"),
+};
+
+// conditionals of "lazy" mode: costly branches taken for a part of the rows, and cheap ones for the JIT
+static LPCTSTR g_vszLazyCorpus[] =
+{
+	TEXT("select(x > 1.8, zeta(x + y), x - y)"),
+	TEXT("select(x > 1, select(y > 1.8, zeta(x), zeta(y + 1)), x*y)"),
+	TEXT("or(x < 1.8, zeta(x + y) > 1.1) + and(y > 1.9, zeta(y) > 1)"),
+	TEXT("select(x > y, x - y, y - x)*select(x < 1, x^2, 2 - x)"),
+	TEXT("select(x > 1, sqrt(x - 1), -sqrt(1 - x)) + (x > y) - (y < 1)"),
+};
+
+// long reductions of "series" mode, evaluated by the interpreter and by the program
+static LPCTSTR g_vszSeriesCorpus[] =
+{
+	TEXT("sum(k, 1, 1000000, 1/k^2)"),
+	TEXT("sum(k, 1, 200000, sin(k*x)/k)"),
+	TEXT("prod(k, 1, 100000, 1 + x/k^2)"),
+	TEXT("sum(k, 0, 300, sum(n, 0, k, x^n*y^(k - n)))"),
+};
+
+// integrands of "integrate" mode over x, exact is NAN when it isn't known
+typedef struct _tagBENCH_INTEGRAL
+{
+	LPCTSTR					pszBody;
+	long double				a;
+	long double				b;
+	long double				tol;
+	long double				exact;
+} BENCH_INTEGRAL;
+
+static const BENCH_INTEGRAL g_vIntegralCorpus[] =
+{
+	{ TEXT("x^2"), 0, 1, 1e-10L, 1.0L / 3 },
+	{ TEXT("sin(x)"), 0, M_PIC, 1e-10L, 2 },
+	{ TEXT("1/sqrt(x)"), 0, 1, 1e-10L, 2 },
+	{ TEXT("exp(-x^2)"), 0, 10, 1e-14L, 0.886226925452758013649083741671L },
+	{ TEXT("1/(1 + 25x^2)"), -1, 1, 1e-12L, 0.4L * 1.373400766945015860861271926444L },
+	{ TEXT("sin(x)^2*exp(-x/5)*cos(3x)"), 0, 40, 1e-10L, NAN },
+	{ TEXT("integrate(y, 0, x, x*y)"), 0, 2, 1e-10L, 2 },
+};
+
+// equations and minimums of "solve" mode over x. fdf is the value and the derivative of the
+// body for the host Newton steps, nullptr if there are none
+typedef struct _tagBENCH_SOLVE
+{
+	BOOL					fMinimize;
+	LPCTSTR					pszBody;
+	long double				x0;
+	long double				exact;
+	long double				( *fdf )( long double x, long double & df );
+} BENCH_SOLVE;
+
+static const BENCH_SOLVE g_vSolveCorpus[] =
+{
+	{ FALSE, TEXT("x^2 - 2"), 1, 1.41421356237309504880168872420969808L, []( long double x, long double & df ) { df = 2 * x; return x * x - 2; } },
+	{ FALSE, TEXT("cos(x) - x"), 0, 0.739085133215160641655312087673873405L, []( long double x, long double & df ) { df = -std::sin( x ) - 1; return std::cos( x ) - x; } },
+	{ FALSE, TEXT("exp(x) - 5"), 0, 1.60943791243410037460075933322618764L, []( long double x, long double & df ) { df = std::exp( x ); return std::exp( x ) - 5; } },
+	{ FALSE, TEXT("x^3 - 2x - 5"), 3, 2.09455148154232659148238654057930296L, []( long double x, long double & df ) { df = 3 * x * x - 2; return x * x * x - 2 * x - 5; } },
+	{ FALSE, TEXT("arctg(x) - 0.5"), -4, 0.546302489843790513255179465780285383L, []( long double x, long double & df ) { df = 1 / ( 1 + x * x ); return std::atan( x ) - 0.5L; } },
+	{ FALSE, TEXT("integrate(t, 0, x, t) - 2"), 1, 2, nullptr },
+	{ TRUE, TEXT("(x - 2)^2 + 1"), 0, 2, nullptr },
+	{ TRUE, TEXT("x^4 - 3x"), 0, 0.908560296416069829445605878163630252L, nullptr },
+	{ TRUE, TEXT("cos(x)"), 3, M_PIC, nullptr },
+	{ TRUE, TEXT("exp(x) - 2x"), -5, 0.693147180559945309417232121458176568L, nullptr },
+	{ TRUE, TEXT("sum(k, 1, 20, (x - k)^2)"), 0, 10.5L, nullptr },
+};
+
+// bodies of "mc" mode over the sample k and their exact means
+typedef struct _tagBENCH_MC
+{
+	LPCTSTR					pszBody;
+	size_t					count;
+	long double				exact;
+} BENCH_MC;
+
+static const BENCH_MC g_vMcCorpus[] =
+{
+	{ TEXT("uniform(k)"), 200000, 0.5L },
+	{ TEXT("4*(uniform(k)^2 + uniform(k, 1)^2 < 1)"), 200000, M_PIC },
+	{ TEXT("normal(k)^2"), 200000, 1 },
+	{ TEXT("exp(0.2normal(k) - 0.02)"), 200000, 1 },
+	// call at the money, rate 5%, volatility 20%, one year by Black and Scholes
+	{ TEXT("exp(-0.05)*select(exp(0.03 + 0.2normal(k)) > 1, 100*exp(0.03 + 0.2normal(k)) - 100, 0)"), 200000, 10.4505835721856054964L },
+};
+
+typedef struct _tagBENCH_OPTIONS
+{
+	size_t					nRows;
+	long double				tol;
+	std::vector<CStringOp>	vexpr;
+	BOOL					fCorpus;		// vexpr is the built-in corpus
+} BENCH_OPTIONS;
+
+typedef struct _tagBENCH_INPUT
+{
+	CMyParser				parser;
+	CExprProgram<TOK>		prog;
+	std::vector<std::complex<long double>>	vvalues;		// nRows x slots
+} BENCH_INPUT;
+
+static double Elapsed( const std::chrono::steady_clock::time_point & t0, size_t n )
+{
+	return std::chrono::duration<double, std::nano>( std::chrono::steady_clock::now() - t0 ).count() / n;
+}
+
+static BOOL Close( const std::complex<long double> & a, const std::complex<long double> & b, long double tol, long double & maxErr )
+{
+	const bool fFinA = std::isfinite( a.real() ) && std::isfinite( a.imag() );
+	const bool fFinB = std::isfinite( b.real() ) && std::isfinite( b.imag() );
+	if ( !fFinA || !fFinB )
+	{
+		return ( fFinA == fFinB );
+	}
+
+	long double err = std::abs( a - b ) / std::max( 1.0L, std::abs( b ) );
+	maxErr = std::max( maxErr, err );
+	return ( err <= tol );
+}
+
+// compiles expression and generates random values of its variables
+static BOOL Prepare( const CStringOp & sExpression, size_t nRows, BENCH_INPUT & in )
+{
+	try
+	{
+		in.parser.Compile( sExpression.GetString() );
+		in.prog.Build( in.parser.Tree() );
+	}
+	catch( CExprParserException & e )
+	{
+		tprintf(TEXT("Error compiling '%" TFMT_S "': %" TFMT_S "\n"), sExpression.GetString(), e.Message().GetString());
+		return FALSE;
+	}
+
+	std::mt19937_64 rng( 1 );
+	std::uniform_real_distribution<double> dist( 0.5, 2.0 );
+	in.vvalues.resize( nRows * in.prog.Slots().size() );
+	for(auto & v : in.vvalues) v = dist( rng );
+	return TRUE;
+}
+
+static std::complex<long double> Interpret( BENCH_INPUT & in, size_t nRow )
+{
+	const auto & vslots = in.prog.Slots();
+	for(size_t v = 0; v < vslots.size(); ++v)
+	{
+		TOK tok( in.vvalues[ nRow * vslots.size() + v ] );
+		tok.var = TRUE;
+		tok.name = vslots[v];
+		in.parser.AddVariable( vslots[v].GetString(), tok );
+	}
+
+	try
+	{
+		TOK result;
+		in.parser.Evaluate();
+		in.parser.Result( result );
+		return result.v;
+	}
+	catch( CExprParserException & e )
+	{
+		return std::complex<long double>( NAN, NAN );
+	}
+}
+
+// values of the slots for the program: variables may be assigned, so they are marked as variables
+static VOID Row( const BENCH_INPUT & in, size_t nRow, std::vector<TOK> & vslots )
+{
+	const auto & vnames = in.prog.Slots();
+	vslots.resize( vnames.size() );
+	for(size_t v = 0; v < vnames.size(); ++v)
+	{
+		vslots[v] = TOK( in.vvalues[ nRow * vnames.size() + v ] );
+		vslots[v].var = TRUE;
+		vslots[v].name = vnames[v];
+	}
+}
+
+template <class FN>
+static std::complex<long double> Run( FN fn, TOK * pSlots )
+{
+	try
+	{
+		return fn( pSlots ).v;
+	}
+	catch( CExprParserException & e )
+	{
+		return std::complex<long double>( NAN, NAN );
+	}
+}
+
+// times fn over all rows and counts its mismatches with the interpreter
+template <class FN>
+static double Measure( const BENCH_INPUT & in, const BENCH_OPTIONS & opt, const std::vector<std::complex<long double>> & vinterp, FN fn, size_t & nMismatch,
+	long double * pmaxErr = nullptr )
+{
+	std::vector<TOK> vrows, vslots;
+	const size_t nslots = in.prog.Slots().size();
+	for(size_t n = 0; n < opt.nRows; ++n)
+	{
+		Row( in, n, vslots );
+		vrows.insert( vrows.end(), vslots.begin(), vslots.end() );
+	}
+
+	std::vector<std::complex<long double>> vres( opt.nRows );
+	vslots.resize( nslots );
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < opt.nRows; ++n)
+	{
+		std::copy( vrows.begin() + n * nslots, vrows.begin() + ( n + 1 ) * nslots, vslots.begin() );
+		vres[n] = Run( fn, vslots.data() );
+	}
+	double ns = Elapsed( t0, opt.nRows );
+
+	long double maxErr = 0;
+	for(size_t n = 0; n < opt.nRows; ++n)
+	{
+		if ( !Close( vres[n], vinterp[n], opt.tol, maxErr ) ) nMismatch++;
+	}
+
+	if ( pmaxErr )
+	{
+		*pmaxErr = maxErr;
+	}
+
+	return ns;
+}
+
+// fn must throw CExprParserLimitExceeded of kind elm. pfCancel, if given, is set by other
+// thread after 20 ms and cleared after fn
+template <class FN>
+static BOOL Breach( LPCTSTR pszBackend, LPCTSTR pszExpression, EXPR_LIMIT elm, std::atomic<bool> * pfCancel, FN fn )
+{
+	static LPCTSTR vszLimit[] = { TEXT("length"), TEXT("nesting"), TEXT("nodes"), TEXT("literals"), TEXT("steps"), TEXT("deadline"), TEXT("cancelled") };
+	std::thread canceller;
+	if ( pfCancel )
+	{
+		canceller = std::thread( [ pfCancel ] { std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) ); *pfCancel = true; } );
+	}
+
+	int nLimit = -1;
+	CStringOp sMessage = TEXT("no exception");
+	const auto t0 = std::chrono::steady_clock::now();
+	try
+	{
+		fn();
+	}
+	catch( CExprParserLimitExceeded & e )
+	{
+		nLimit = e.Limit();
+		sMessage = e.Message();
+	}
+	catch( CExprParserException & e )
+	{
+		sMessage = e.Message();
+	}
+
+	const double ms = Elapsed( t0, 1000000 );
+	if ( pfCancel )
+	{
+		canceller.join();
+		*pfCancel = false;
+	}
+
+	tprintf(TEXT("%-9" TFMT_S " %-14" TFMT_S " %-28" TFMT_S " %8.2f ms  %" TFMT_S "%" TFMT_S "\n"), vszLimit[ elm ], pszBackend, pszExpression, ms,
+		sMessage.GetString(), nLimit == int( elm ) ? TEXT("") : TEXT(" FAILED"));
+	return ( nLimit == int( elm ) );
+}
+
+// each kind of EXPR_LIMITS is breached, the exception must have it. The evaluation limits stop
+// the long range of sum in the interpreter and in each backend built on the program
+static int BenchLimits( const BENCH_OPTIONS & opt )
+{
+	static const struct
+	{
+		EXPR_LIMIT		elm;
+		LPCTSTR			pszExpression;
+	} vcompile[] =
+	{
+		{ elmExpressionLength, TEXT("x^2 + 3x - 7 + sin(x)cos(x)") },
+		{ elmNesting, TEXT("((x + 1)*(y - (x + 2)))") },
+		{ elmNodes, TEXT("x + y + x*y + x/y + x - y") },
+		{ elmLiterals, TEXT("1 + 2 + 3 + 4") },
+	};
+
+	size_t nFailed = 0;
+	for(const auto & v : vcompile)
+	{
+		EXPR_LIMITS limits;
+		limits.cchMaxExpression = ( v.elm == elmExpressionLength ? 16 : 0 );
+		limits.nMaxNesting = ( v.elm == elmNesting ? 2 : 0 );
+		limits.nMaxNodes = ( v.elm == elmNodes ? 8 : 0 );
+		limits.nMaxLiterals = ( v.elm == elmLiterals ? 3 : 0 );
+
+		CMyParser parser;
+		parser.SetLimits( limits );
+		nFailed += !Breach( TEXT("compile"), v.pszExpression, v.elm, nullptr, [ & ] { parser.Compile( v.pszExpression ); } );
+	}
+
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	std::atomic<bool> fCancel( false );
+	LPCTSTR pszRange = TEXT("sum(k, 1, 1e12, k*x)");
+	const size_t nThreads = CExprProgram<TOK>::ReduceThreads();
+	for(const EXPR_LIMIT elm : { elmSteps, elmDeadline, elmCancelled })
+	{
+		EXPR_LIMITS limits;
+		limits.nMaxSteps = ( elm == elmSteps ? 1000000 : 0 );
+		limits.msTimeout = std::chrono::milliseconds( elm == elmDeadline ? 20 : 0 );
+		limits.pfCancel = ( elm == elmCancelled ? &fCancel : nullptr );
+		std::atomic<bool> * pfCancel = limits.pfCancel ? &fCancel : nullptr;
+
+		CMyParser parser;
+		parser.SetLimits( limits );
+		parser.Compile( pszRange );
+		TOK x( 0.5L );
+		x.var = TRUE;
+		x.name = TEXT("x");
+		parser.AddVariable( TEXT("x"), x );
+		nFailed += !Breach( TEXT("interpreter"), pszRange, elm, pfCancel, [ & ] { parser.Evaluate(); } );
+
+		CExprProgram<TOK> prog;
+		prog.Build( parser.Tree() );
+		prog.SetLimits( parser.Limits() );
+		std::vector<TOK> vslots( prog.Slots().size(), TOK( 0.0L ) );
+		vslots[ prog.Slot( TEXT("x") ) ] = x;
+
+		CExprProgram<TOK>::ReduceThreads() = 1;
+		nFailed += !Breach( TEXT("program"), pszRange, elm, pfCancel, [ & ] { prog.Execute( vslots.data() ); } );
+		CExprProgram<TOK>::ReduceThreads() = std::max<size_t>( nThreads, 4 );
+		nFailed += !Breach( TEXT("threads"), pszRange, elm, pfCancel, [ & ] { prog.Execute( vslots.data() ); } );
+		CExprProgram<TOK>::ReduceThreads() = nThreads;
+
+		CExprProgram<TOK> optimized = prog;
+		optimizer.Optimize( optimized );
+		nFailed += !Breach( TEXT("optimized"), pszRange, elm, pfCancel, [ & ] { optimized.Execute( vslots.data() ); } );
+
+		EXPR_TIER_POLICY policy;
+		policy.nOptimize = 1;
+		policy.fBackground = FALSE;
+		CExprTiered<TOK> tiered( prog, optimizer, CMyJit::Native, policy );
+		nFailed += !Breach( TEXT("tiered"), pszRange, elm, pfCancel, [ & ] { tiered.Evaluate( vslots.data() ); } );
+
+		CExprSweep<TOK> sweep( prog, { prog.Slot( TEXT("x") ) }, optimizer );
+		nFailed += !Breach( TEXT("sweep"), pszRange, elm, pfCancel, [ & ] { sweep.Batch( vslots.data() ); sweep.Execute( vslots.data() ); } );
+
+		CExprMulti<TOK> multi;
+		multi.Add( prog );
+		multi.SetLimits( limits );
+		multi.Optimize( optimizer );
+		std::vector<TOK> vresult( multi.Outputs() );
+		nFailed += !Breach( TEXT("multi"), pszRange, elm, pfCancel, [ & ] { multi.Execute( vslots.data(), vresult.data() ); } );
+	}
+
+	// the native code has no loops, it is admitted or not before the call
+	LPCTSTR pszNative = TEXT("x^2 + 3x - 7");
+	for(const EXPR_LIMIT elm : { elmSteps, elmCancelled })
+	{
+		EXPR_LIMITS limits;
+		limits.nMaxSteps = ( elm == elmSteps ? 2 : 0 );
+		limits.pfCancel = ( elm == elmCancelled ? &fCancel : nullptr );
+
+		CMyParser parser;
+		parser.Compile( pszNative );
+		CExprProgram<TOK> prog;
+		prog.Build( parser.Tree() );
+		prog.SetLimits( limits );
+
+		EXPR_TIER_POLICY policy;
+		policy.nOptimize = 0;
+		policy.nNative = 1;
+		policy.fBackground = FALSE;
+		CExprTiered<TOK> tiered( prog, optimizer, CMyJit::Native, policy );
+
+		// the first evaluation promotes the program, the program throws too
+		std::vector<TOK> vslots( prog.Slots().size(), TOK( 0.5L ) );
+		Run( [ &tiered ]( TOK * pSlots ) { return tiered.Evaluate( pSlots ); }, vslots.data() );
+		fCancel = ( elm == elmCancelled );
+		const BOOL fNative = ( tiered.Tier() == etNative );
+		nFailed += !( Breach( TEXT("native"), pszNative, elm, nullptr, [ & ] { tiered.Evaluate( vslots.data() ); } ) && fNative );
+		fCancel = false;
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// plain program, optimized program and tiered execution against the interpreter.
+// Tiered program is evaluated by several threads while it is promoted
+static int BenchTier( const BENCH_OPTIONS & opt )
+{
+	const size_t nThreads = 4;
+	size_t nFailed = 0;
+
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+		double nsInterp = Elapsed( t0, opt.nRows );
+
+		CExprOptimizer<TOK> optimizer;
+		CMyParser::Optimizer( optimizer );
+		CExprProgram<TOK> optimized = in.prog;
+		optimizer.Optimize( optimized );
+
+		size_t nMismatch = 0;
+		double nsProgram = Measure( in, opt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch );
+		double nsOptimized = Measure( in, opt, vinterp, [ &optimized ]( TOK * pSlots ) { return optimized.Execute( pSlots ); }, nMismatch );
+
+		EXPR_TIER_POLICY policy;
+		policy.nOptimize = opt.nRows / 16;
+		policy.nNative = opt.nRows / 4;
+		CExprTiered<TOK> tiered( in.prog, optimizer, CMyJit::Native, policy );
+
+		std::vector<std::complex<long double>> vtiered( opt.nRows );
+		std::vector<std::thread> vthread;
+		t0 = std::chrono::steady_clock::now();
+		for(size_t t = 0; t < nThreads; ++t)
+		{
+			vthread.push_back( std::thread( [ &, t ]
+				{
+					std::vector<TOK> vslots;
+					for(size_t n = t; n < opt.nRows; n += nThreads)
+					{
+						Row( in, n, vslots );
+						vtiered[n] = Run( [ &tiered ]( TOK * pSlots ) { return tiered.Evaluate( pSlots ); }, vslots.data() );
+					}
+				} ) );
+		}
+		for(auto & v : vthread) v.join();
+		double nsTiered = Elapsed( t0, opt.nRows );
+		tiered.Wait();
+
+		long double maxErr = 0;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			if ( !Close( vtiered[n], vinterp[n], opt.tol, maxErr ) ) nMismatch++;
+		}
+
+		static LPCTSTR vszTier[] = { TEXT("program"), TEXT("optimized"), TEXT("native") };
+		tprintf(TEXT("%-56" TFMT_S " nodes %2ld -> %2ld, interp %8.1f ns, program %8.1f ns, optimized %8.1f ns, tiered %7.1f ns (%" TFMT_S ")%" TFMT_S "\n"),
+			sExpression.GetString(), in.prog.Nodes().size(), optimized.Nodes().size(), nsInterp, nsProgram, nsOptimized, nsTiered,
+			vszTier[ tiered.Tier() ], nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// Profile guided specialization against the interpreter. Slot 1 has integer values, the last
+// of three or more slots is constant, and 0.5% of rows have complex value of slot 0
+static int BenchProfile( const BENCH_OPTIONS & opt )
+{
+	static LPCTSTR vszGuard[] = { TEXT("real"), TEXT("integer"), TEXT("const"), TEXT("nonnegative") };
+	size_t nFailed = 0;
+
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		const size_t nslots = in.prog.Slots().size();
+		std::mt19937_64 rng( 2 );
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			auto * pv = in.vvalues.data() + n * nslots;
+			if ( nslots > 1 ) pv[1] = 1 + rng() % 4;
+			if ( nslots > 2 ) pv[nslots - 1] = 1.5;
+			if ( nslots && !( rng() % 200 ) ) pv[0] = std::complex<long double>( 0.5, 0.25 );
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		CExprOptimizer<TOK> optimizer;
+		CMyParser::Optimizer( optimizer );
+		CExprProgram<TOK> general = in.prog;
+		optimizer.Optimize( general );
+
+		// the first tenth of rows is the training set
+		CExprProfile<TOK> profile( nslots, optimizer );
+		std::vector<TOK> vslots;
+		for(size_t n = 0; n < opt.nRows / 10; ++n)
+		{
+			Row( in, n, vslots );
+			profile.Record( vslots.data() );
+		}
+
+		CExprSpecialized<TOK> special( general, profile, optimizer );
+		CExprSpecialized<TOK> native( general, profile, optimizer, CMyJit::Native );
+
+		size_t nMismatch = 0;
+		double nsGeneral = Measure( in, opt, vinterp, [ &general ]( TOK * pSlots ) { return general.Execute( pSlots ); }, nMismatch );
+		double nsSpecial = Measure( in, opt, vinterp, [ &special ]( TOK * pSlots ) { return special.Evaluate( pSlots ); }, nMismatch );
+		double nsNative = Measure( in, opt, vinterp, [ &native ]( TOK * pSlots ) { return native.Evaluate( pSlots ); }, nMismatch );
+
+		CStringOp sGuards;
+		for(size_t u = 0; u < special.Guards().size(); ++u)
+		{
+			const auto & guard = special.Guards()[u];
+			sGuards += CStringOp().Format( TEXT("%" TFMT_S ":%" TFMT_S " %.1f%% "), in.prog.Slots()[ guard.uSlot ].GetString(),
+				vszGuard[ guard.egt ], 100.0 * special.Failures( u ) / special.Evaluations() );
+		}
+
+		tprintf(TEXT("%-56" TFMT_S " general %7.1f ns, specialized %7.1f ns%" TFMT_S ", native %7.1f ns%" TFMT_S ", fallback %.1f%%, guards: %" TFMT_S "%" TFMT_S "\n"),
+			sExpression.GetString(), nsGeneral, nsSpecial, special.Specialized() ? TEXT("") : TEXT(" (general)"), nsNative, native.Native() ? TEXT("") : TEXT(" (not compiled)"),
+			100.0 * special.Fallbacks() / special.Evaluations(), sGuards.GetString(), nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// JIT against the interpreter. Rows with NaN from JIT are evaluated by the interpreter
+static int BenchJit( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		CMyJit jit;
+		if ( !jit.Compile( in.prog ) )
+		{
+			tprintf(TEXT("%-56" TFMT_S " not compiled, interpreter only\n"), sExpression.GetString());
+			continue;
+		}
+
+		const size_t nslots = in.prog.Slots().size();
+		std::vector<double> vslots;
+		for(const auto & v : in.vvalues) vslots.push_back( double( v.real() ) );
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		std::vector<double> vjit( opt.nRows );
+		std::vector<BOOL> vreal( opt.nRows );
+
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+		double nsInterp = Elapsed( t0, opt.nRows );
+
+		t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n) vreal[n] = jit.Evaluate( vslots.data() + n * nslots, vjit[n] );
+		double nsJit = Elapsed( t0, opt.nRows );
+
+		size_t nMismatch = 0, nFallback = 0;
+		long double maxErr = 0;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			std::complex<long double> r = vjit[n];
+			if ( !vreal[n] )
+			{
+				nFallback++;
+				r = Interpret( in, n );
+			}
+
+			if ( !Close( r, vinterp[n], opt.tol, maxErr ) ) nMismatch++;
+		}
+
+		tprintf(TEXT("%-56" TFMT_S " interp %8.1f ns, jit %6.2f ns, x%-7.1f fallback %5.1f%%, max err %.2Lg%" TFMT_S "\n"),
+			sExpression.GetString(), nsInterp, nsJit, nsInterp / nsJit, 100.0 * nFallback / opt.nRows, maxErr,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// error of y in units in the last place of the exact value
+static long double Ulp( long double y, long double exact )
+{
+	if ( std::isnan( exact ) || std::isinf( exact ) )
+	{
+		return ( std::isnan( y ) == std::isnan( exact ) && ( std::isnan( y ) || y == exact ) ? 0 : INFINITY );
+	}
+
+	const double d = double( exact );
+	const long double ulp = ( d ? std::ldexp( 1.0L, std::max( std::ilogb( d ), DBL_MIN_EXP - 1 ) - 52 ) : std::ldexp( 1.0L, DBL_MIN_EXP - 53 ) );
+	return std::fabs( y - exact ) / ulp;
+}
+
+static long double Reference( EXPR_KERNEL ek, long double x )
+{
+	switch ( ek )
+	{
+		case ekSin: return std::sin( x );
+		case ekSinc: return std::sin( x ) / x;
+		case ekCos: return std::cos( x );
+		case ekTan: return std::tan( x );
+		case ekCot: return 1 / std::tan( x );
+		case ekArcsin: return std::asin( x );
+		case ekArccos: return std::acos( x );
+		case ekArctan: return std::atan( x );
+		case ekArccot: return std::atan( 1 / x );
+		case ekExp: return std::exp( x );
+		case ekSqrt: return std::sqrt( x );
+		default: return std::cbrt( x );
+	}
+}
+
+static std::complex<long double> Reference( EXPR_KERNEL ek, const std::complex<long double> & z )
+{
+	switch ( ek )
+	{
+		case ekSin: return std::sin( z );
+		case ekSinc: return std::sin( z ) / z;
+		case ekCos: return std::cos( z );
+		case ekTan: return std::tan( z );
+		case ekCot: return 1.0L / std::tan( z );
+		case ekArcsin: return std::asin( z );
+		case ekArccos: return std::acos( z );
+		case ekArctan: return std::atan( z );
+		case ekArccot: return std::atan( 1.0L / z );
+		case ekExp: return std::exp( z );
+		case ekSqrt: return std::sqrt( z );
+		default: return std::pow( z, 1.0L / 3 );
+	}
+}
+
+// random arguments in the domain of the kernel
+static VOID Arguments( EXPR_KERNEL ek, size_t n, std::vector<double> & vx )
+{
+	std::mt19937_64 rng( 3 );
+	std::uniform_real_distribution<double> unit( -1.0, 1.0 );
+	vx.resize( n );
+	for(auto & x : vx)
+	{
+		const double u = unit( rng );
+		switch ( ek )
+		{
+			case ekArcsin: case ekArccos: x = u; break;
+			case ekArctan: case ekArccot: x = std::copysign( std::pow( 10.0, 4 * unit( rng ) ), u ); break;
+			case ekExp: x = 700 * u; break;
+			case ekSqrt: x = 1e6 * std::fabs( u ); break;
+			case ekCbrt: x = std::copysign( std::pow( 10.0, 8 * unit( rng ) ), u ); break;
+			default: x = 100 * u; break;
+		}
+	}
+}
+
+// ns per element of the kernel over vx
+template <class FN>
+static double Throughput( FN fn, size_t n )
+{
+	const size_t nRepeat = std::max( size_t( 1 ), 4000000 / n );
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t r = 0; r < nRepeat; ++r) fn();
+	return Elapsed( t0, nRepeat * n );
+}
+
+// Kernels of each instruction set and accuracy tier against long double libm: maximum
+// error in ulp (norm of the difference for complex kernels) and the speed against double libm.
+// Fails if 1-ulp tier has real error above 1 ulp or complex error above EXPR_COMPLEX_ULP, or
+// fast tier has relative error above 1e-8
+static int BenchKernels( const BENCH_OPTIONS & opt )
+{
+	const size_t n = opt.nRows;
+	size_t nFailed = 0;
+
+	for(int ek = 0; ek < ekMax; ++ek)
+	{
+		std::vector<double> vx, vxi, vy( n ), vyi( n );
+		Arguments( EXPR_KERNEL( ek ), n, vx );
+		Arguments( EXPR_KERNEL( ( ek + 1 ) % ekMax ), n, vxi );
+		for(auto & x : vxi) x = std::fmod( x, 4.0 );
+		std::vector<double> vxc( vx );
+		for(auto & x : vxc) x = std::fmod( x, 4.0 );
+
+		double nsLibm = 0, nsLibmC = 0;
+		for(int eisa = 0; eisa < eisaMax; ++eisa)
+		{
+			if ( !CExprKernels::Supported( EXPR_ISA( eisa ) ) )
+			{
+				continue;
+			}
+
+			for(int eac = 0; eac < eacMax; ++eac)
+			{
+				PEXPR_REAL_KERNEL pfn = CExprKernels::Real( EXPR_KERNEL( ek ), EXPR_ACCURACY( eac ), EXPR_ISA( eisa ) );
+				PEXPR_COMPLEX_KERNEL pfnc = CExprKernels::Complex( EXPR_KERNEL( ek ), EXPR_ACCURACY( eac ), EXPR_ISA( eisa ) );
+
+				long double maxUlp = 0, maxRel = 0, maxUlpC = 0, maxRelC = 0;
+				pfn( vx.data(), vy.data(), n );
+				for(size_t i = 0; i < n; ++i)
+				{
+					const long double exact = Reference( EXPR_KERNEL( ek ), (long double) vx[i] );
+					maxUlp = std::max( maxUlp, Ulp( vy[i], exact ) );
+					if ( std::isfinite( exact ) && exact ) maxRel = std::max( maxRel, std::fabs( ( vy[i] - exact ) / exact ) );
+				}
+
+				if ( pfnc ) pfnc( vxc.data(), vxi.data(), vy.data(), vyi.data(), n );
+				for(size_t i = 0; pfnc && i < n; ++i)
+				{
+					const auto exact = Reference( EXPR_KERNEL( ek ), std::complex<long double>( vxc[i], vxi[i] ) );
+					const long double diff = std::abs( std::complex<long double>( vy[i], vyi[i] ) - exact );
+					maxUlpC = std::max( maxUlpC, Ulp( std::abs( exact ) + diff, std::abs( exact ) ) );
+					if ( std::abs( exact ) ) maxRelC = std::max( maxRelC, diff / std::abs( exact ) );
+				}
+
+				const double ns = Throughput( [ & ] { pfn( vx.data(), vy.data(), n ); }, n );
+				const double nsC = ( pfnc ? Throughput( [ & ] { pfnc( vxc.data(), vxi.data(), vy.data(), vyi.data(), n ); }, n ) : 0 );
+				if ( eisa == eisaGeneric && eac == eacExact )
+				{
+					nsLibm = ns;
+					nsLibmC = nsC;
+				}
+
+				const BOOL fFailed = ( eac == eacUlp1 && ( maxUlp > 1 || maxUlpC > EXPR_COMPLEX_ULP ) ) ||
+					( eac == eacFast && ( maxRel > 1e-8 || maxRelC > 1e-8 ) );
+				CStringOp sComplex( TEXT("-") );
+				if ( pfnc ) sComplex.Format( TEXT("%7.3Lg ulp %7.2f ns x%-5.1f"), maxUlpC, nsC, nsLibmC / nsC );
+				tprintf(TEXT("%-7" TFMT_S " %-8" TFMT_S " %-6" TFMT_S " real %7.3Lg ulp %7.2f ns x%-5.1f complex %" TFMT_S "%" TFMT_S "\n"),
+					CExprKernels::Name( EXPR_KERNEL( ek ) ), CExprKernels::Name( EXPR_ISA( eisa ) ), CExprKernels::Name( EXPR_ACCURACY( eac ) ),
+					maxUlp, ns, nsLibm / ns, sComplex.GetString(), fFailed ? TEXT(" FAILED") : TEXT(""));
+				nFailed += ( fFailed ? 1 : 0 );
+			}
+		}
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// exact power z^n by multiplication in __float128, rounded to long double
+static std::complex<long double> PowExact( const std::complex<long double> & z, long n )
+{
+	__float128 re = 1, im = 0;
+	for(long k = 0; k < std::labs( n ); ++k)
+	{
+		const __float128 t = re * z.real() - im * z.imag();
+		im = re * z.imag() + im * z.real();
+		re = t;
+	}
+
+	if ( n < 0 )
+	{
+		const __float128 d = re * re + im * im;
+		re = re / d;
+		im = -im / d;
+	}
+
+	return std::complex<long double>( (long double) re, (long double) im );
+}
+
+// ns per evaluation of fn over the values of x and the maximum error of the results
+// in units of LDBL_EPSILON relative to the modulus of the exact ones
+template <class FN>
+static double PowPath( FN fn, const std::vector<std::complex<long double>> & vx, const std::vector<std::complex<long double>> & vexact, long double & maxErr )
+{
+	std::vector<std::complex<long double>> vy( vx.size() );
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t i = 0; i < vx.size(); ++i)
+	{
+		TOK x( vx[i] );
+		vy[i] = fn( &x ).v;
+	}
+	double ns = Elapsed( t0, vx.size() );
+
+	maxErr = 0;
+	for(size_t i = 0; i < vx.size(); ++i) maxErr = std::max( maxErr, std::abs( vy[i] - vexact[i] ) / std::abs( vexact[i] ) / LDBL_EPSILON );
+	return ns;
+}
+
+// Power: generic std::pow against repeated squaring for complex bases and integer exponents,
+// and against the real variants of the specialized program for real bases. Exact integer
+// powers are computed in __float128, powers with real exponents by long double std::pow.
+// Then the expressions are evaluated without "bind" pass, with it and specialized for their
+// real values. Fails if squaring is less accurate than the generic path or if overflowing
+// powers of real bases are not real infinities
+static int BenchPow( const BENCH_OPTIONS & opt )
+{
+	static const long double vn[] = { 2, 3, 4, 5, 7, 10, 16, 31, 64, -1, -2, -3, -10, 0.5, 2.5, -1.5, 7.25 };
+	size_t nFailed = 0;
+
+	CExprOptimizer<TOK> generic, optimizer;
+	CMyParser::Optimizer( generic );
+	CMyParser::Optimizer( optimizer );
+	generic.EnablePass( TEXT("bind"), FALSE );
+
+	std::mt19937_64 rng( 4 );
+	std::uniform_real_distribution<long double> modulus( 0.5, 2.0 ), arg( -M_PI, M_PI );
+	std::vector<std::complex<long double>> vcomplex( opt.nRows ), vreal( opt.nRows ), vexact( opt.nRows ), vexactR( opt.nRows );
+	for(auto & z : vcomplex) z = std::polar( modulus( rng ), arg( rng ) );
+	for(auto & x : vreal) x = std::copysign( modulus( rng ), arg( rng ) );
+
+	for(const long double n : vn)
+	{
+		const BOOL fInteger = ( n == std::floor( n ) );
+		CMyParser parser;
+		CExprProgram<TOK> prog;
+		parser.Compile( CStringOp().Format( TEXT("x^%Lg"), n ).GetString() );
+		prog.Build( parser.Tree() );
+
+		CExprProgram<TOK> pgeneric = prog, pbound = prog;
+		generic.Optimize( pgeneric );
+		optimizer.Optimize( pbound );
+
+		// negative bases are complex powers for real exponents
+		if ( !fInteger )
+		{
+			for(auto & x : vreal) x = std::fabs( x.real() );
+		}
+
+		CExprProfile<TOK> profile( 1, optimizer );
+		for(size_t i = 0; i < vreal.size() / 10; ++i)
+		{
+			TOK x( vreal[i] );
+			profile.Record( &x );
+		}
+		CExprSpecialized<TOK> special( prog, profile, optimizer );
+
+		for(size_t i = 0; i < opt.nRows; ++i)
+		{
+			vexact[i] = ( fInteger ? PowExact( vcomplex[i], long( n ) ) : std::pow( vcomplex[i], std::complex<long double>( n ) ) );
+			vexactR[i] = ( fInteger ? PowExact( vreal[i], long( n ) ) : std::pow( vreal[i].real(), n ) );
+		}
+
+		long double errGeneric = 0, errBound = 0, errGenericR, errReal;
+		double nsGeneric = 0, nsBound = 0;
+		if ( fInteger )
+		{
+			nsGeneric = PowPath( [ &pgeneric ]( TOK * pSlots ) { return pgeneric.Execute( pSlots ); }, vcomplex, vexact, errGeneric );
+			nsBound = PowPath( [ &pbound ]( TOK * pSlots ) { return pbound.Execute( pSlots ); }, vcomplex, vexact, errBound );
+		}
+		const double nsGenericR = PowPath( [ &pgeneric ]( TOK * pSlots ) { return pgeneric.Execute( pSlots ); }, vreal, vexactR, errGenericR );
+		const double nsReal = PowPath( [ &special ]( TOK * pSlots ) { return special.Evaluate( pSlots ); }, vreal, vexactR, errReal );
+
+		const BOOL fFailed = ( errBound > std::max( errGeneric, 4.0L ) );
+		CStringOp sComplex( TEXT("-") );
+		if ( fInteger )
+		{
+			sComplex = CStringOp().Format( TEXT("generic %6.2Lf eps %6.1f ns, squaring %6.2Lf eps %6.1f ns x%-4.1f"),
+				errGeneric, nsGeneric, errBound, nsBound, nsGeneric / nsBound );
+		}
+
+		tprintf(TEXT("x^%-5Lg complex base: %-65" TFMT_S " real base: generic %6.2Lf eps %6.1f ns, real %6.2Lf eps %6.1f ns x%-4.1f%" TFMT_S "\n"),
+			n, sComplex.GetString(), errGenericR, nsGenericR, errReal, nsReal, nsGenericR / nsReal, fFailed ? TEXT(" FAILED") : TEXT(""));
+		nFailed += ( fFailed ? 1 : 0 );
+	}
+
+	// powers of real bases which overflow must stay real infinities
+	static const struct { long double x; long n; } voverflow[] = { { 1e4000L, 64 }, { -1e4000L, 63 }, { 1e-4000L, -64 } };
+	for(const auto & v : voverflow)
+	{
+		CMyParser parser;
+		CExprProgram<TOK> prog;
+		parser.Compile( CStringOp().Format( TEXT("x^%ld"), v.n ).GetString() );
+		prog.Build( parser.Tree() );
+		optimizer.Optimize( prog );
+
+		TOK x( v.x );
+		const std::complex<long double> r = prog.Execute( &x ).v;
+		const BOOL fFailed = ( !std::isinf( r.real() ) || std::signbit( r.real() ) != ( v.x < 0 && v.n % 2 ) || r.imag() != 0 );
+		tprintf(TEXT("x^%-5ld x = %Lg: %Lg%+Lgi%" TFMT_S "\n"), v.n, v.x, r.real(), r.imag(), fFailed ? TEXT(" FAILED") : TEXT(""));
+		nFailed += ( fFailed ? 1 : 0 );
+	}
+
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		CExprProgram<TOK> pgeneric = in.prog, pbound = in.prog;
+		generic.Optimize( pgeneric );
+		optimizer.Optimize( pbound );
+
+		CExprProfile<TOK> profile( in.prog.Slots().size(), optimizer );
+		std::vector<TOK> vslots;
+		for(size_t n = 0; n < opt.nRows / 10; ++n)
+		{
+			Row( in, n, vslots );
+			profile.Record( vslots.data() );
+		}
+		CExprSpecialized<TOK> special( pbound, profile, optimizer );
+
+		size_t nMismatch = 0;
+		double nsGeneric = Measure( in, opt, vinterp, [ &pgeneric ]( TOK * pSlots ) { return pgeneric.Execute( pSlots ); }, nMismatch );
+		double nsBound = Measure( in, opt, vinterp, [ &pbound ]( TOK * pSlots ) { return pbound.Execute( pSlots ); }, nMismatch );
+		double nsReal = Measure( in, opt, vinterp, [ &special ]( TOK * pSlots ) { return special.Evaluate( pSlots ); }, nMismatch );
+
+		tprintf(TEXT("%-56" TFMT_S " generic %7.1f ns, bound %7.1f ns x%-4.1f real %7.1f ns x%-4.1f%" TFMT_S "\n"),
+			sExpression.GetString(), nsGeneric, nsBound, nsGeneric / nsBound, nsReal, nsGeneric / nsReal, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// Polynomials: programs optimized without "horner" pass, with Horner scheme only and with
+// Estrin scheme from degree 2, evaluated by the executor and by the JIT. Error is relative
+// to the interpreter in units of LDBL_EPSILON, fails on mismatches
+static int BenchPoly( const BENCH_OPTIONS & opt )
+{
+	static LPCTSTR vszScheme[] = { TEXT("sum"), TEXT("horner"), TEXT("estrin") };
+	size_t nFailed = 0;
+
+	CExprOptimizer<TOK> voptimizer[ 3 ];
+	for(size_t k = 0; k < 3; ++k)
+	{
+		CMyParser::Optimizer( voptimizer[k] );
+		voptimizer[k].EnablePass( TEXT("horner"), k > 0 );
+		voptimizer[k].SetEstrinDegree( k > 1 ? 2 : 0 );
+	}
+
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		std::vector<double> vslots;
+		for(const auto & v : in.vvalues) vslots.push_back( double( v.real() ) );
+		const size_t nslots = in.prog.Slots().size();
+
+		CStringOp sLine;
+		size_t nMismatch = 0;
+		for(size_t k = 0; k < 3; ++k)
+		{
+			CExprProgram<TOK> prog = in.prog;
+			voptimizer[k].Optimize( prog );
+
+			long double maxErr = 0;
+			const double ns = Measure( in, opt, vinterp, [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, nMismatch, &maxErr );
+
+			CMyJit jit;
+			double nsJit = 0, d;
+			if ( jit.Compile( prog ) )
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				for(size_t n = 0; n < opt.nRows; ++n) jit.Evaluate( vslots.data() + n * nslots, d );
+				nsJit = Elapsed( t0, opt.nRows );
+			}
+
+			sLine += CStringOp().Format( TEXT("%" TFMT_S " %2ld nodes %7.1f ns jit %5.2f ns %6.2Lf eps  "), vszScheme[k], prog.Nodes().size(), ns, nsJit, maxErr / LDBL_EPSILON );
+		}
+
+		tprintf(TEXT("%-56" TFMT_S " %" TFMT_S "%" TFMT_S "\n"), sExpression.GetString(), sLine.GetString(), nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// superinstructions chosen from the profile of all expressions: dispatches of the executor
+// per evaluation and time of the optimized program before and after fusion
+static int BenchFusion( const BENCH_OPTIONS & opt )
+{
+	const size_t nMaxPatterns = 8;
+	size_t nFailed = 0;
+
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+	CExprFusion<TOK> fusion;
+	CMyParser::Fusion( fusion );
+
+	std::vector<std::unique_ptr<BENCH_INPUT>> vin;
+	std::vector<CExprProgram<TOK>> vprog;
+	for(const auto & sExpression : opt.vexpr)
+	{
+		std::unique_ptr<BENCH_INPUT> pin( new BENCH_INPUT );
+		if ( !Prepare( sExpression, opt.nRows, *pin ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		vprog.push_back( pin->prog );
+		optimizer.Optimize( vprog.back() );
+		fusion.Record( vprog.back() );
+		vin.push_back( std::move( pin ) );
+	}
+
+	static LPCTSTR vszType[] = { TEXT("unary"), TEXT("binary"), TEXT("func") };
+	auto print = [ & ]( LPCTSTR pszTitle, const std::vector<CExprFusion<TOK>::PATTERN> & vpattern )
+	{
+		tprintf(TEXT("%" TFMT_S "\n"), pszTitle);
+		for(const auto & pattern : vpattern)
+		{
+			tprintf(TEXT("%-6" TFMT_S " '%" TFMT_S "' -> %-6" TFMT_S " '%" TFMT_S "' arg %ld: %3ld pairs%" TFMT_S "\n"), vszType[ pattern.entFirst ], pattern.sFirst.GetString(),
+				vszType[ pattern.entSecond ], pattern.sSecond.GetString(), pattern.uArg, pattern.nCount, pattern.fused ? TEXT(", fused function") : TEXT(""));
+		}
+	};
+
+	// the best of 3 runs of the first rows of each program, enough to tell the pairs apart
+	const size_t nSample = std::min<size_t>( opt.nRows, 256 );
+	auto time = [ & ]( const CExprFusion<TOK> & candidate )
+	{
+		double ns = 0;
+		std::vector<TOK> vslots;
+		for(size_t u = 0; u < vin.size(); ++u)
+		{
+			CExprProgram<TOK> fused = vprog[u];
+			candidate.Apply( fused );
+
+			double nsBest = std::numeric_limits<double>::infinity();
+			for(size_t r = 0; r < 3; ++r)
+			{
+				auto t0 = std::chrono::steady_clock::now();
+				for(size_t n = 0; n < nSample; ++n)
+				{
+					Row( *vin[u], n, vslots );
+					Run( [ &fused ]( TOK * pSlots ) { return fused.Execute( pSlots ); }, vslots.data() );
+				}
+
+				nsBest = std::min( nsBest, Elapsed( t0, nSample ) );
+			}
+
+			ns += nsBest;
+		}
+
+		return ns;
+	};
+
+	fusion.Select( nMaxPatterns );
+	print( TEXT("frequent pairs:"), fusion.Selected() );
+	fusion.Prune( time );
+	print( TEXT("pairs which pay:"), fusion.Selected() );
+
+	size_t nNodes = 0, nDispatches = 0;
+	double nsPlain = 0, nsFused = 0;
+	for(size_t u = 0; u < vin.size(); ++u)
+	{
+		const BENCH_INPUT & in = *vin[u];
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( *vin[u], n );
+
+		const CExprProgram<TOK> & plain = vprog[u];
+		CExprProgram<TOK> fused = plain;
+		fusion.Apply( fused );
+
+		size_t nMismatch = 0;
+		const double ns = Measure( in, opt, vinterp, [ &plain ]( TOK * pSlots ) { return plain.Execute( pSlots ); }, nMismatch );
+		const double nsSuper = Measure( in, opt, vinterp, [ &fused ]( TOK * pSlots ) { return fused.Execute( pSlots ); }, nMismatch );
+
+		nNodes += plain.Instructions();
+		nDispatches += fused.Instructions();
+		nsPlain += ns;
+		nsFused += nsSuper;
+
+		tprintf(TEXT("%-56" TFMT_S " dispatches %2ld -> %2ld, %7.1f ns -> %7.1f ns x%-4.2f%" TFMT_S "\n"), opt.vexpr[u].GetString(), plain.Instructions(), fused.Instructions(),
+			ns, nsSuper, ns / nsSuper, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	if ( nNodes )
+	{
+		tprintf(TEXT("total: dispatches %ld -> %ld (-%.1f%%), %.1f ns -> %.1f ns x%.2f\n"), nNodes, nDispatches, 100.0 * ( nNodes - nDispatches ) / nNodes,
+			nsPlain, nsFused, nsPlain / nsFused);
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// random arguments of the double-double kernel, representable in long double so both types
+// start from the same exact values
+static VOID Arguments( EXPR_DD_OP edd, size_t n, std::vector<long double> & vx, std::vector<long double> & vxi, std::vector<long double> & vy, std::vector<long double> & vyi )
+{
+	std::mt19937_64 rng( 5 );
+	std::uniform_real_distribution<long double> unit( -1.0L, 1.0L );
+	vx.resize( n );
+	vxi.resize( n );
+	vy.resize( n );
+	vyi.resize( n );
+	for(size_t i = 0; i < n; ++i)
+	{
+		const long double u = unit( rng );
+		switch ( edd )
+		{
+			case eddSqrt: vx[i] = 1e6L * std::fabs( u ); break;
+			case eddExp: vx[i] = ( u < 0 ? 650 : 700 ) * u; break;		// low parts of results below 2^-969 are subnormal
+			case eddLog: vx[i] = std::pow( 10.0L, 300 * u ); break;
+			case eddSin: case eddCos: vx[i] = 100 * u; break;
+			case eddAtan: vx[i] = std::pow( 10.0L, 3 * u ) * ( i % 2 ? -1 : 1 ); break;
+			case eddCExp: vx[i] = 50 * u; break;
+			default: vx[i] = 2 * u; break;
+		}
+
+		vxi[i] = ( edd == eddCExp ? 10 : 2 ) * unit( rng );
+		vy[i] = 2 * unit( rng );
+		vyi[i] = 2 * unit( rng );
+	}
+}
+
+static VOID Split( const std::vector<long double> & v, std::vector<double> & vhi, std::vector<double> & vlo )
+{
+	vhi.resize( v.size() );
+	vlo.resize( v.size() );
+	for(size_t i = 0; i < v.size(); ++i)
+	{
+		const CDoubleDouble d( v[i] );
+		vhi[i] = d.hi;
+		vlo[i] = d.lo;
+	}
+}
+
+static BOOL ComplexOp( EXPR_DD_OP edd )
+{
+	return ( edd >= eddCAdd );
+}
+
+static __complex128 Complex128( long double re, long double im )
+{
+	__complex128 z;
+	__real__ z = re;
+	__imag__ z = im;
+	return z;
+}
+
+// exact result in __float128
+static __complex128 Reference( EXPR_DD_OP edd, long double x, long double xi, long double y, long double yi )
+{
+	const __complex128 a = Complex128( x, xi ), b = Complex128( y, yi );
+	switch ( edd )
+	{
+		case eddAdd: return Complex128( 0, 0 ) + ( (__float128) x + y );
+		case eddSub: return Complex128( 0, 0 ) + ( (__float128) x - y );
+		case eddMul: return Complex128( 0, 0 ) + ( (__float128) x * y );
+		case eddDiv: return Complex128( 0, 0 ) + ( (__float128) x / y );
+		case eddSqrt: return Complex128( 0, 0 ) + sqrtq( x );
+		case eddExp: return Complex128( 0, 0 ) + expq( x );
+		case eddLog: return Complex128( 0, 0 ) + logq( x );
+		case eddSin: return Complex128( 0, 0 ) + sinq( x );
+		case eddCos: return Complex128( 0, 0 ) + cosq( x );
+		case eddAtan: return Complex128( 0, 0 ) + atanq( x );
+		case eddCAdd: return a + b;
+		case eddCSub: return a - b;
+		case eddCMul: return a * b;
+		case eddCDiv: return a / b;
+		default: return cexpq( a );
+	}
+}
+
+// the same operation in long double
+static VOID LongDouble( EXPR_DD_OP edd, const std::vector<long double> & vx, const std::vector<long double> & vxi, const std::vector<long double> & vy,
+	const std::vector<long double> & vyi, std::vector<std::complex<long double>> & vz )
+{
+	const size_t n = vx.size();
+	vz.resize( n );
+	switch ( edd )
+	{
+		case eddAdd: for(size_t i = 0; i < n; ++i) vz[i] = vx[i] + vy[i]; break;
+		case eddSub: for(size_t i = 0; i < n; ++i) vz[i] = vx[i] - vy[i]; break;
+		case eddMul: for(size_t i = 0; i < n; ++i) vz[i] = vx[i] * vy[i]; break;
+		case eddDiv: for(size_t i = 0; i < n; ++i) vz[i] = vx[i] / vy[i]; break;
+		case eddSqrt: for(size_t i = 0; i < n; ++i) vz[i] = std::sqrt( vx[i] ); break;
+		case eddExp: for(size_t i = 0; i < n; ++i) vz[i] = std::exp( vx[i] ); break;
+		case eddLog: for(size_t i = 0; i < n; ++i) vz[i] = std::log( vx[i] ); break;
+		case eddSin: for(size_t i = 0; i < n; ++i) vz[i] = std::sin( vx[i] ); break;
+		case eddCos: for(size_t i = 0; i < n; ++i) vz[i] = std::cos( vx[i] ); break;
+		case eddAtan: for(size_t i = 0; i < n; ++i) vz[i] = std::atan( vx[i] ); break;
+		case eddCAdd: for(size_t i = 0; i < n; ++i) vz[i] = std::complex<long double>( vx[i], vxi[i] ) + std::complex<long double>( vy[i], vyi[i] ); break;
+		case eddCSub: for(size_t i = 0; i < n; ++i) vz[i] = std::complex<long double>( vx[i], vxi[i] ) - std::complex<long double>( vy[i], vyi[i] ); break;
+		case eddCMul: for(size_t i = 0; i < n; ++i) vz[i] = std::complex<long double>( vx[i], vxi[i] ) * std::complex<long double>( vy[i], vyi[i] ); break;
+		case eddCDiv: for(size_t i = 0; i < n; ++i) vz[i] = std::complex<long double>( vx[i], vxi[i] ) / std::complex<long double>( vy[i], vyi[i] ); break;
+		default: for(size_t i = 0; i < n; ++i) vz[i] = std::exp( std::complex<long double>( vx[i], vxi[i] ) ); break;
+	}
+}
+
+// relative error of re + i im against the exact value
+static long double RelError( __float128 re, __float128 im, const __complex128 & exact )
+{
+	const __float128 norm = cabsq( exact ), diff = hypotq( re - __real__ exact, im - __imag__ exact );
+	return (long double) ( norm ? diff / norm : diff );
+}
+
+// Double-double kernels of each instruction set against the long double loops: maximum relative
+// error against __float128 and ns per element, fails if double-double is less accurate.
+// Then the expressions are evaluated by CMyParserDD programs, by CMyBatchDD and by CMyParser
+// programs, results must agree and the batch must be faster than the long double program
+static int BenchDD( const BENCH_OPTIONS & opt )
+{
+	const size_t n = opt.nRows;
+	size_t nFailed = 0;
+
+	for(int edd = 0; edd < eddMax; ++edd)
+	{
+		std::vector<long double> vx, vxi, vy, vyi;
+		std::vector<std::complex<long double>> vld;
+		Arguments( EXPR_DD_OP( edd ), n, vx, vxi, vy, vyi );
+
+		std::vector<double> vin[ 8 ], vout[ 4 ];
+		Split( vx, vin[0], vin[1] );
+		Split( vxi, vin[2], vin[3] );
+		Split( vy, vin[4], vin[5] );
+		Split( vyi, vin[6], vin[7] );
+		for(auto & v : vout) v.resize( n );
+
+		const EXPR_DD_ARRAY x[ 2 ] = { { vin[0].data(), vin[1].data() }, { vin[2].data(), vin[3].data() } };
+		const EXPR_DD_ARRAY y[ 2 ] = { { vin[4].data(), vin[5].data() }, { vin[6].data(), vin[7].data() } };
+		const EXPR_DD_ARRAY z[ 2 ] = { { vout[0].data(), vout[1].data() }, { vout[2].data(), vout[3].data() } };
+
+		std::vector<__complex128> vexact( n );
+		long double maxLd = 0;
+		LongDouble( EXPR_DD_OP( edd ), vx, vxi, vy, vyi, vld );
+		for(size_t i = 0; i < n; ++i)
+		{
+			vexact[i] = Reference( EXPR_DD_OP( edd ), vx[i], vxi[i], vy[i], vyi[i] );
+			maxLd = std::max( maxLd, RelError( vld[i].real(), vld[i].imag(), vexact[i] ) );
+		}
+
+		const double nsLd = Throughput( [ & ] { LongDouble( EXPR_DD_OP( edd ), vx, vxi, vy, vyi, vld ); }, n );
+		for(int eisa = 0; eisa < eisaMax; ++eisa)
+		{
+			if ( !CExprKernels::Supported( EXPR_ISA( eisa ) ) )
+			{
+				continue;
+			}
+
+			PEXPR_DD_KERNEL pfn = CExprKernels::DoubleDouble( EXPR_DD_OP( edd ), EXPR_ISA( eisa ) );
+			pfn( x, y, z, n );
+
+			long double maxDd = 0;
+			for(size_t i = 0; i < n; ++i)
+			{
+				const __float128 re = (__float128) vout[0][i] + vout[1][i];
+				const __float128 im = ( ComplexOp( EXPR_DD_OP( edd ) ) ? (__float128) vout[2][i] + vout[3][i] : 0 );
+				maxDd = std::max( maxDd, RelError( re, im, vexact[i] ) );
+			}
+
+			const double ns = Throughput( [ & ] { pfn( x, y, z, n ); }, n );
+			const BOOL fFailed = ( maxDd > maxLd );
+			tprintf(TEXT("%-5" TFMT_S " %-8" TFMT_S " dd %9.3Lg %7.2f ns  long double %9.3Lg %7.2f ns  x%-5.2f%" TFMT_S "\n"), CExprKernels::Name( EXPR_DD_OP( edd ) ),
+				CExprKernels::Name( EXPR_ISA( eisa ) ), maxDd, ns, maxLd, nsLd, nsLd / ns, fFailed ? TEXT(" FAILED") : TEXT(""));
+			nFailed += ( fFailed ? 1 : 0 );
+		}
+	}
+
+	for(const auto & sExpression : opt.vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		CMyParserDD parser;
+		CExprProgram<TOKDD> prog;
+		try
+		{
+			parser.Compile( sExpression.GetString() );
+			prog.Build( parser.Tree() );
+		}
+		catch( CExprParserException & e )
+		{
+			tprintf(TEXT("Error compiling '%" TFMT_S "' in double-double: %" TFMT_S "\n"), sExpression.GetString(), e.Message().GetString());
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		size_t nMismatch = 0;
+		const double nsLd = Measure( in, opt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch );
+
+		const auto & vnames = prog.Slots();
+		std::vector<TOKDD> vrows, vslots( vnames.size() );
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			for(size_t v = 0; v < vnames.size(); ++v)
+			{
+				TOKDD tok( double( in.vvalues[ n * vnames.size() + v ].real() ) );
+				tok.var = TRUE;
+				tok.name = vnames[v];
+				vrows.push_back( tok );
+			}
+		}
+
+		std::vector<std::complex<long double>> vres( opt.nRows );
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			std::copy( vrows.begin() + n * vnames.size(), vrows.begin() + ( n + 1 ) * vnames.size(), vslots.begin() );
+			try
+			{
+				const TOKDD r = prog.Execute( vslots.data() );
+				vres[n] = std::complex<long double>( (long double) r.v.re, (long double) r.v.im );
+			}
+			catch( CExprParserException & e )
+			{
+				vres[n] = std::complex<long double>( NAN, NAN );
+			}
+		}
+		const double ns = Elapsed( t0, opt.nRows );
+
+		CMyBatchDD batch( prog );
+		std::vector<TOKDD> vbatch( opt.nRows );
+		t0 = std::chrono::steady_clock::now();
+		try
+		{
+			batch.Evaluate( vrows.data(), opt.nRows, vbatch.data() );
+		}
+		catch( CExprParserException & e )
+		{
+			std::fill( vbatch.begin(), vbatch.end(), TOKDD( std::numeric_limits<double>::quiet_NaN() ) );
+		}
+		const double nsBatch = Elapsed( t0, opt.nRows );
+
+		long double maxErr = 0;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			if ( !Close( vres[n], vinterp[n], opt.tol, maxErr ) ) nMismatch++;
+			const std::complex<long double> r( (long double) vbatch[n].v.re, (long double) vbatch[n].v.im );
+			if ( !Close( r, vinterp[n], opt.tol, maxErr ) ) nMismatch++;
+		}
+
+		// the batch must beat the long double program
+		const BOOL fSlow = ( nsBatch >= nsLd );
+		tprintf(TEXT("%-56" TFMT_S " long double %7.1f ns  dd %7.1f ns  batch %7.1f ns x%-5.2f fallback %5.1f%%%" TFMT_S "%" TFMT_S "%" TFMT_S "\n"), sExpression.GetString(),
+			nsLd, ns, nsBatch, nsLd / nsBatch, 100 * batch.FallbackRate(), batch.Native() ? TEXT("") : TEXT(" (not in kernels)"),
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""), fSlow ? TEXT(" FAILED") : TEXT(""));
+		nFailed += ( nMismatch || fSlow ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// Integer programs against CMyParser programs on integer inputs in [ 0, 15 ]. Results must be
+// exact where long double is integral below 2^63 and close to it above. Expressions CMyParser
+// can't parse, such as remainders, are checked against the integer interpreter
+static int BenchInteger( const BENCH_OPTIONS & opt )
+{
+	std::vector<CStringOp> vexpr;
+	if ( opt.fCorpus )
+	{
+		for(const auto & v : g_vszIntCorpus) vexpr.push_back( v );
+	}
+	else
+	{
+		vexpr = opt.vexpr;
+	}
+
+	size_t nFailed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		CMyParserInt parser;
+		CExprProgram<TOKINT> prog;
+		try
+		{
+			parser.Compile( sExpression.GetString() );
+			prog.Build( parser.Tree() );
+		}
+		catch( CExprParserException & e )
+		{
+			tprintf(TEXT("Error compiling '%" TFMT_S "' in integers: %" TFMT_S "\n"), sExpression.GetString(), e.Message().GetString());
+			nFailed++;
+			continue;
+		}
+
+		const auto & vnames = prog.Slots();
+		const size_t nslots = vnames.size();
+		std::mt19937_64 rng( 6 );
+		std::uniform_int_distribution<int> dist( 0, 15 );
+		std::vector<TOKINT> vrows( opt.nRows * nslots ), vslots( nslots ), vres( opt.nRows );
+		for(size_t n = 0; n < vrows.size(); ++n)
+		{
+			vrows[n] = TOKINT( int64_t( dist( rng ) ) );
+			vrows[n].var = TRUE;
+			vrows[n].name = vnames[ n % nslots ];
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			std::copy( vrows.begin() + n * nslots, vrows.begin() + ( n + 1 ) * nslots, vslots.begin() );
+			try
+			{
+				vres[n] = prog.Execute( vslots.data() );
+			}
+			catch( CExprParserException & e )
+			{
+				vres[n].undef = TRUE;
+			}
+		}
+		const double nsInt = Elapsed( t0, opt.nRows );
+
+		size_t nWide = 0, nMismatch = 0;
+		for(const auto & r : vres) nWide += ( !r.undef && r.v.Wide() ? 1 : 0 );
+
+		CMyParser ld;
+		CExprProgram<TOK> ldprog;
+		BOOL fLd = TRUE;
+		try
+		{
+			ld.Compile( sExpression.GetString() );
+			ldprog.Build( ld.Tree() );
+			fLd = ( ldprog.Slots().size() == nslots );
+			for(size_t v = 0; fLd && v < nslots; ++v) fLd = ( ldprog.Slots()[v] == vnames[v] );
+		}
+		catch( CExprParserException & e )
+		{
+			fLd = FALSE;
+		}
+
+		double nsLd = 0;
+		if ( fLd )
+		{
+			std::vector<TOK> vldrows( vrows.size() ), vldslots( nslots );
+			std::vector<std::complex<long double>> vldres( opt.nRows );
+			for(size_t n = 0; n < vrows.size(); ++n)
+			{
+				vldrows[n] = TOK( (long double) vrows[n].v.Value() );
+				vldrows[n].var = TRUE;
+				vldrows[n].name = vrows[n].name;
+			}
+
+			t0 = std::chrono::steady_clock::now();
+			for(size_t n = 0; n < opt.nRows; ++n)
+			{
+				std::copy( vldrows.begin() + n * nslots, vldrows.begin() + ( n + 1 ) * nslots, vldslots.begin() );
+				vldres[n] = Run( [ &ldprog ]( TOK * pSlots ) { return ldprog.Execute( pSlots ); }, vldslots.data() );
+			}
+			nsLd = Elapsed( t0, opt.nRows );
+
+			for(size_t n = 0; n < opt.nRows; ++n)
+			{
+				const long double v = vldres[n].real();
+				long double maxErr = 0;
+				if ( vres[n].undef || !std::isfinite( v ) )
+				{
+					nMismatch += ( vres[n].undef == std::isfinite( v ) ? 1 : 0 );
+				}
+				else if ( v == std::floor( v ) && std::fabs( v ) < 0x1p63L )
+				{
+					nMismatch += ( vres[n].v.Value() != (__int128) v ? 1 : 0 );
+				}
+				else
+				{
+					nMismatch += ( Close( (long double) vres[n].v.Value(), vldres[n], opt.tol, maxErr ) ? 0 : 1 );
+				}
+			}
+		}
+		else
+		{
+			for(size_t n = 0; n < opt.nRows; ++n)
+			{
+				for(size_t v = 0; v < nslots; ++v) parser.AddVariable( vnames[v].GetString(), vrows[ n * nslots + v ] );
+
+				TOKINT result;
+				try
+				{
+					parser.Evaluate();
+					parser.Result( result );
+				}
+				catch( CExprParserException & e )
+				{
+					result.undef = TRUE;
+				}
+
+				nMismatch += ( result.undef != vres[n].undef || !result.undef && result.v != vres[n].v ? 1 : 0 );
+			}
+		}
+
+		if ( fLd )
+		{
+			tprintf(TEXT("%-40" TFMT_S " int %7.1f ns  long double %7.1f ns x%-5.2f wide %5ld%" TFMT_S "\n"), sExpression.GetString(), nsInt, nsLd, nsLd / nsInt,
+				nWide, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		}
+		else
+		{
+			tprintf(TEXT("%-40" TFMT_S " int %7.1f ns  (against the interpreter) wide %5ld%" TFMT_S "\n"), sExpression.GetString(), nsInt,
+				nWide, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		}
+
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// mixed precision against the long double program: speed, fallback rate and errors within the tolerance
+static int BenchMixed( const BENCH_OPTIONS & opt )
+{
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		for(const auto & v : g_vszMixedCorpus) vexpr.push_back( v );
+	}
+
+	size_t nFailed = 0, nEvals = 0, nFallbacks = 0;
+	double nsProg = 0, nsMixed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		const CExprProgram<TOK> & prog = in.prog;
+		CMyMixed mixed( prog, opt.tol );
+
+		size_t nMismatch = 0;
+		long double maxErr = 0;
+		const double ns = Measure( in, opt, vinterp, [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, nMismatch );
+		const double nsMix = Measure( in, opt, vinterp, [ &mixed ]( TOK * pSlots ) { return mixed.Evaluate( pSlots ); }, nMismatch, &maxErr );
+
+		nsProg += ns;
+		nsMixed += nsMix;
+		nEvals += mixed.Evaluations();
+		nFallbacks += mixed.Fallbacks();
+
+		tprintf(TEXT("%-56" TFMT_S " long double %7.1f ns  mixed %7.1f ns x%-5.2f fallback %5.1f%%%" TFMT_S " err %.2Le%" TFMT_S "\n"), sExpression.GetString(), ns, nsMix, ns / nsMix,
+			100 * mixed.FallbackRate(), mixed.Native() ? TEXT("") : TEXT(" (not in double)"), maxErr, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	if ( nEvals )
+	{
+		tprintf(TEXT("total: %.1f ns -> %.1f ns x%.2f, fallback %.1f%% of %ld rows\n"), nsProg, nsMixed, nsProg / nsMixed, 100.0 * nFallbacks / nEvals, nEvals);
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+typedef struct _tagCONST_VARS
+{
+	double					x;
+	double					y;
+} CONST_VARS;
+
+// formula of EXPR_CONST against the same formula compiled by CMyParser
+template <class FORMULA>
+static BOOL BenchConstFormula( const FORMULA & formula, const BENCH_OPTIONS & opt )
+{
+	CExprProgram<TOK> prog;
+	FORMULA::Program( prog );
+
+	std::mt19937_64 rng( 7 );
+	std::uniform_real_distribution<double> dist( 0.5, 2.0 );
+	std::vector<CONST_VARS> vvars( opt.nRows );
+	std::vector<TOK> vrows, vslots;
+	for(auto & v : vvars)
+	{
+		v.x = dist( rng );
+		v.y = dist( rng );
+		FORMULA::Slots( v, prog, vslots );
+		vrows.insert( vrows.end(), vslots.begin(), vslots.end() );
+	}
+
+	std::vector<long double> vconst( opt.nRows );
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < opt.nRows; ++n) vconst[n] = formula( vvars[n] );
+	const double nsConst = Elapsed( t0, opt.nRows );
+
+	const size_t nslots = prog.Slots().size();
+	std::vector<std::complex<long double>> vprog( opt.nRows );
+	t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < opt.nRows; ++n)
+	{
+		std::copy( vrows.begin() + n * nslots, vrows.begin() + ( n + 1 ) * nslots, vslots.begin() );
+		vprog[n] = Run( [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, vslots.data() );
+	}
+	const double nsProg = Elapsed( t0, opt.nRows );
+
+	size_t nMismatch = 0;
+	long double maxErr = 0;
+	for(size_t n = 0; n < opt.nRows; ++n)
+	{
+		if ( !Close( vconst[n], vprog[n], opt.tol, maxErr ) ) nMismatch++;
+	}
+
+	tprintf(TEXT("%-44" TFMT_S " program %7.1f ns  constexpr %6.1f ns x%-7.1f err %.2Le%" TFMT_S "\n"), FORMULA::Expression(), nsProg, nsConst, nsProg / nsConst,
+		maxErr, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+	return !nMismatch;
+}
+
+// formulas compiled at C++ compile time. The expressions are fixed, so the mode ignores the arguments
+static int BenchConst( const BENCH_OPTIONS & opt )
+{
+	constexpr auto vformula = std::make_tuple(
+		EXPR_CONST( CONST_VARS, "x^2 + 3x - 7", x, y ),
+		EXPR_CONST( CONST_VARS, "sin(x)cos(y) + exp(-x^2)", x, y ),
+		EXPR_CONST( CONST_VARS, "sqrt(x^2 + y^2)/(1 + x)", x, y ),
+		EXPR_CONST( CONST_VARS, "(x - y)^3 / (x + y)^-2", x, y ),
+		EXPR_CONST( CONST_VARS, "arctg(x/y) + arcctg(x) + ctg(y) + tg(x)", x, y ),
+		EXPR_CONST( CONST_VARS, "x! + sinc(y) + cbrt(x)", x, y ),
+		EXPR_CONST( CONST_VARS, "-x^2 - -y + ~x", x, y ),
+		EXPR_CONST( CONST_VARS, "arcsin(x - 1) + arccos(y/2)", x, y ),
+		EXPR_CONST( CONST_VARS, "x^y + 2^x + e()*pi()", x, y ),
+		EXPR_CONST( CONST_VARS, "x; y*2", x, y ),
+		EXPR_CONST( CONST_VARS, "4x^4 - 3x^3 + 2x^2 - x + 1", x, y ),
+		EXPR_CONST( CONST_VARS, "1 + x + x^2/2 + x^3/6 + x^4/24 + x^5/120 + x^6/720", x, y )
+	);
+
+	size_t nFailed = 0;
+	std::apply( [ & ]( const auto & ... formula ) { nFailed = ( ( BenchConstFormula( formula, opt ) ? 0 : 1 ) + ... ); }, vformula );
+	return ( nFailed ? 1 : 0 );
+}
+
+// formula of the rule engine: sum of c * x^k * sin( w * y ) for k < nTerms. Built either by
+// CExprBuilder, or rendered to text and compiled
+static VOID BuildTerms( const CMyParser & parser, size_t nTerms, CExprProgram<TOK> & prog )
+{
+	CExprBuilder<TOK> b( parser );
+	const EXPR_ARG x = b.Variable( TEXT("x") ), y = b.Variable( TEXT("y") );
+	EXPR_ARG sum = b.Const( 0.5 );
+	for(size_t k = 1; k <= nTerms; ++k)
+	{
+		const EXPR_ARG s = b.Func( TEXT("sin"), { b.Op( TEXT("*"), b.Const( 0.25 * k ), y ) } );
+		const EXPR_ARG t = b.Op( TEXT("*"), b.Op( TEXT("*"), b.Const( k - 2.5 ), b.Op( TEXT("^"), x, b.Const( TOK( (long double) k ) ) ) ), s );
+		sum = b.Op( TEXT("+"), sum, t );
+	}
+
+	b.Build( sum, prog );
+}
+
+static VOID CompileTerms( CMyParser & parser, size_t nTerms, CExprProgram<TOK> & prog )
+{
+	CStringOp s( TEXT("0.5") );
+	for(size_t k = 1; k <= nTerms; ++k)
+	{
+		s += CStringOp().Format( TEXT(" + %g*x^%ld*sin(%g*y)"), k - 2.5, k, 0.25 * k );
+	}
+
+	parser.Compile( s.GetString() );
+	prog.Build( parser.Tree() );
+}
+
+// programs of the builder against the compiled text: time of construction and results
+static int BenchBuilder( const BENCH_OPTIONS & opt )
+{
+	const size_t nBuilds = 200;
+	size_t nFailed = 0;
+
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	for(size_t nTerms : { 2, 8, 32 })
+	{
+		CMyParser parser;
+		CExprProgram<TOK> built, compiled;
+
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < nBuilds; ++n) BuildTerms( parser, nTerms, built );
+		const double nsBuild = Elapsed( t0, nBuilds );
+
+		t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < nBuilds; ++n) CompileTerms( parser, nTerms, compiled );
+		const double nsCompile = Elapsed( t0, nBuilds );
+
+		optimizer.Optimize( built );
+		optimizer.Optimize( compiled );
+
+		std::mt19937_64 rng( 8 );
+		std::uniform_real_distribution<double> dist( 0.5, 1.5 );
+		size_t nMismatch = 0;
+		long double maxErr = 0;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			// both programs take x first
+			TOK vslots[] = { TOK( dist( rng ) ), TOK( dist( rng ) ) };
+			TOK vcopy[] = { vslots[0], vslots[1] };
+			const std::complex<long double> a = Run( [ &built ]( TOK * pSlots ) { return built.Execute( pSlots ); }, vslots );
+			const std::complex<long double> b = Run( [ &compiled ]( TOK * pSlots ) { return compiled.Execute( pSlots ); }, vcopy );
+			if ( !Close( a, b, opt.tol, maxErr ) ) nMismatch++;
+		}
+
+		tprintf(TEXT("%2ld terms: builder %8.2f us  text %8.2f us x%-6.1f nodes %3ld/%3ld err %.2Le%" TFMT_S "\n"), nTerms, nsBuild / 1000, nsCompile / 1000,
+			nsCompile / nsBuild, built.Nodes().size(), compiled.Nodes().size(), maxErr, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// optimizer with and without common subexpressions against the interpreter, then impure
+// function which must be called on each evaluation
+static int BenchCse( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+
+	CExprOptimizer<TOK> optimizer, plain;
+	CMyParser::Optimizer( optimizer );
+	CMyParser::Optimizer( plain );
+	plain.EnablePass( TEXT("cse"), FALSE );
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.insert( vexpr.end(), std::begin( g_vszCseCorpus ), std::end( g_vszCseCorpus ) );
+	}
+
+	size_t nNodes = 0, nMerged = 0;
+	double nsPlain = 0, nsMerged = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		CExprProgram<TOK> a = in.prog, b = in.prog;
+		plain.Optimize( a );
+		optimizer.Optimize( b );
+
+		size_t nMismatch = 0;
+		const double ns = Measure( in, opt, vinterp, [ &a ]( TOK * pSlots ) { return a.Execute( pSlots ); }, nMismatch );
+		const double nsCse = Measure( in, opt, vinterp, [ &b ]( TOK * pSlots ) { return b.Execute( pSlots ); }, nMismatch );
+
+		nNodes += a.Nodes().size();
+		nMerged += b.Nodes().size();
+		nsPlain += ns;
+		nsMerged += nsCse;
+
+		tprintf(TEXT("%-56" TFMT_S " nodes %2ld -> %2ld, %7.1f ns -> %7.1f ns x%-4.2f%" TFMT_S "\n"), sExpression.GetString(), a.Nodes().size(), b.Nodes().size(),
+			ns, nsCse, ns / nsCse, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	if ( nNodes )
+	{
+		tprintf(TEXT("total: nodes %ld -> %ld (-%.1f%%), %.1f ns -> %.1f ns x%.2f\n"), nNodes, nMerged, 100.0 * ( nNodes - nMerged ) / nNodes,
+			nsPlain, nsMerged, nsPlain / nsMerged);
+	}
+
+	// counter without efaPure: neither folded by Compile nor merged, each call gives the next value
+	size_t nTicks = 0;
+	CMyParser parser;
+	parser.AddFunc( TEXT("tick"), 0 ) = [ &nTicks ]( const std::vector<TOK> & varg ) { return TOK( (long double) ++nTicks ); };
+	parser.Compile( TEXT("tick() - tick() + 2*tick()") );
+
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+	optimizer.Optimize( prog );
+
+	BOOL fOk = TRUE;
+	for(size_t n = 0; n < 4; ++n)
+	{
+		// t - ( t + 1 ) + 2( t + 2 ) = 2t + 3
+		const long double t = nTicks + 1;
+		fOk &= ( prog.Execute( nullptr ).v == std::complex<long double>( 2 * t + 3 ) );
+	}
+
+	tprintf(TEXT("impure tick(): %ld nodes, %ld calls%" TFMT_S "\n"), prog.Nodes().size(), nTicks, fOk ? TEXT("") : TEXT(" MISMATCH"));
+	return ( nFailed || !fOk ? 1 : 0 );
+}
+
+// partial sum of the zeta function, the costly pure function of "memo" mode
+static TOK Zeta( const std::vector<TOK> & varg )
+{
+	std::complex<long double> z = 0;
+	for(long k = 1; k <= 2000; ++k) z += std::pow( std::complex<long double>( k ), -varg[0].v );
+	return TOK( z );
+}
+
+// interpreter and programs with the memoized zeta against the plain one. Arguments are taken
+// from a small grid, so they repeat across evaluations as well as within one
+static int BenchMemo( const BENCH_OPTIONS & opt )
+{
+	const size_t nThreads = 4, nRows = std::min<size_t>( opt.nRows, 2000 );
+	LPCTSTR pszExpression = TEXT("zeta(x) + zeta(y)/zeta(x) - zeta(x + y)");
+
+	CMyParser plain, memo;
+	plain.AddFunc( TEXT("zeta"), 1, efaPure, eccExpensive ) = Zeta;
+	memo.AddFunc( TEXT("zeta"), 1, efaPure, eccExpensive ) = Zeta;
+	memo.AddFunc( TEXT("tick"), 0 ) = []( const std::vector<TOK> & varg ) { return TOK( 0.0L ); };
+	std::shared_ptr<CExprMemo<TOK>> pmemo = memo.Memoize( TEXT("zeta"), 256 );
+	if ( !pmemo || memo.Memoize( TEXT("tick"), 256 ) )
+	{
+		tprintf(TEXT("Memoize has accepted an impure function or rejected a pure one\n"));
+		return 1;
+	}
+
+	std::mt19937_64 rng( 4 );
+	std::uniform_int_distribution<int> dist( 4, 12 );
+	std::vector<long double> vx( nRows ), vy( nRows );
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		vx[n] = dist( rng ) / 2.0L;
+		vy[n] = dist( rng ) / 2.0L;
+	}
+
+	plain.Compile( pszExpression );
+	memo.Compile( pszExpression );
+
+	std::vector<std::complex<long double>> va( nRows ), vb( nRows );
+	double ns[ 2 ];
+	for(size_t p = 0; p < 2; ++p)
+	{
+		CMyParser & parser = ( p ? memo : plain );
+		auto & vres = ( p ? vb : va );
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < nRows; ++n)
+		{
+			TOK x( vx[n] ), y( vy[n] );
+			x.var = y.var = TRUE;
+			x.name = TEXT("x");
+			y.name = TEXT("y");
+			parser.AddVariable( TEXT("x"), x );
+			parser.AddVariable( TEXT("y"), y );
+
+			TOK result;
+			parser.Evaluate();
+			parser.Result( result );
+			vres[n] = result.v;
+		}
+		ns[p] = Elapsed( t0, nRows );
+	}
+
+	size_t nMismatch = 0;
+	long double maxErr = 0;
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		if ( !Close( vb[n], va[n], opt.tol, maxErr ) ) nMismatch++;
+	}
+
+	tprintf(TEXT("interpreter: plain %9.1f ns, memo %9.1f ns x%-6.1f hits %ld misses %ld rate %.3f%" TFMT_S "\n"), ns[0], ns[1], ns[0] / ns[1],
+		pmemo->Hits(), pmemo->Misses(), pmemo->HitRate(), nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+
+	// program of the memoized parser shares the cache with it
+	pmemo->Clear();
+	CExprProgram<TOK> prog;
+	prog.Build( memo.Tree() );
+
+	const size_t uX = prog.Slot( TEXT("x") ), uY = prog.Slot( TEXT("y") );
+	std::vector<std::complex<long double>> vthr( nRows );
+	std::vector<std::thread> vthread;
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t t = 0; t < nThreads; ++t)
+	{
+		vthread.push_back( std::thread( [ &, t ]
+			{
+				std::vector<TOK> vslots( prog.Slots().size() );
+				for(size_t n = t; n < nRows; n += nThreads)
+				{
+					vslots[ uX ] = TOK( vx[n] );
+					vslots[ uY ] = TOK( vy[n] );
+					vthr[n] = Run( [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, vslots.data() );
+				}
+			} ) );
+	}
+	for(auto & v : vthread) v.join();
+	const double nsThreads = Elapsed( t0, nRows );
+
+	size_t nThrMismatch = 0;
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		if ( !Close( vthr[n], va[n], opt.tol, maxErr ) ) nThrMismatch++;
+	}
+
+	tprintf(TEXT("%ld threads: program %9.1f ns, hits %ld misses %ld rate %.3f, cached %ld err %.2Le%" TFMT_S "\n"), nThreads, nsThreads,
+		pmemo->Hits(), pmemo->Misses(), pmemo->HitRate(), pmemo->Size(), maxErr, nThrMismatch ? TEXT(" MISMATCH") : TEXT(""));
+	return ( nMismatch || nThrMismatch ? 1 : 0 );
+}
+
+// lazy conditionals against the same functions taking evaluated arguments: interpreter,
+// program and JIT, then impure function which must be called for the taken branch only
+static int BenchLazy( const BENCH_OPTIONS & opt )
+{
+	BENCH_OPTIONS lazyOpt = opt;
+	lazyOpt.nRows = std::min<size_t>( opt.nRows, 2000 );
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.assign( std::begin( g_vszLazyCorpus ), std::end( g_vszLazyCorpus ) );
+	}
+
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	auto truth = []( const TOK & a ) { return ( a.v != 0.0L ); };
+	size_t nFailed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT lazy, eager;
+		lazy.parser.AddFunc( TEXT("zeta"), 1, efaPure, eccExpensive ) = Zeta;
+		eager.parser.AddFunc( TEXT("zeta"), 1, efaPure, eccExpensive ) = Zeta;
+		eager.parser.AddFunc( TEXT("select"), 3, efaPure | efaRealClosed, eccCheap ) = [ truth ]( const std::vector<TOK> & varg ) { return ( truth( varg[0] ) ? varg[1] : varg[2] ); };
+		eager.parser.AddFunc( TEXT("and"), 2, efaPure | efaRealClosed, eccCheap ) = [ truth ]( const std::vector<TOK> & varg ) { return TOK( truth( varg[0] ) && truth( varg[1] ) ? 1.0L : 0.0L ); };
+		eager.parser.AddFunc( TEXT("or"), 2, efaPure | efaRealClosed, eccCheap ) = [ truth ]( const std::vector<TOK> & varg ) { return TOK( truth( varg[0] ) || truth( varg[1] ) ? 1.0L : 0.0L ); };
+
+		if ( !Prepare( sExpression, lazyOpt.nRows, lazy ) || !Prepare( sExpression, lazyOpt.nRows, eager ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::vector<std::complex<long double>> vlazy( lazyOpt.nRows ), veager( lazyOpt.nRows );
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < lazyOpt.nRows; ++n) veager[n] = Interpret( eager, n );
+		const double nsEager = Elapsed( t0, lazyOpt.nRows );
+
+		t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < lazyOpt.nRows; ++n) vlazy[n] = Interpret( lazy, n );
+		const double nsLazy = Elapsed( t0, lazyOpt.nRows );
+
+		size_t nMismatch = 0;
+		long double maxErr = 0;
+		for(size_t n = 0; n < lazyOpt.nRows; ++n)
+		{
+			if ( !Close( vlazy[n], veager[n], opt.tol, maxErr ) ) nMismatch++;
+		}
+
+		CExprProgram<TOK> prog = lazy.prog;
+		optimizer.Optimize( prog );
+		size_t nConditional = 0;
+		for(size_t u = 0; u < prog.Nodes().size(); ++u) nConditional += ( prog.Conditional( u ) ? 1 : 0 );
+
+		const double nsEagerProg = Measure( eager, lazyOpt, veager, [ &eager ]( TOK * pSlots ) { return eager.prog.Execute( pSlots ); }, nMismatch );
+		const double nsLazyProg = Measure( lazy, lazyOpt, veager, [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, nMismatch );
+
+		tprintf(TEXT("%-60" TFMT_S " interp %9.1f -> %9.1f ns x%-6.1f program %9.1f -> %9.1f ns x%-6.1f conditional nodes %2ld/%-2ld"),
+			sExpression.GetString(), nsEager, nsLazy, nsEager / nsLazy, nsEagerProg, nsLazyProg, nsEagerProg / nsLazyProg, nConditional, prog.Nodes().size());
+
+		// the JIT evaluates both branches and selects one by the mask of the condition
+		CMyJit jit;
+		if ( jit.Compile( lazy.prog ) )
+		{
+			const size_t nslots = lazy.prog.Slots().size();
+			std::vector<double> vslots;
+			for(const auto & v : lazy.vvalues) vslots.push_back( double( v.real() ) );
+
+			for(size_t n = 0; n < lazyOpt.nRows; ++n)
+			{
+				double d;
+				if ( jit.Evaluate( vslots.data() + n * nslots, d ) && !Close( d, veager[n], opt.tol, maxErr ) ) nMismatch++;
+			}
+			tprintf(TEXT(", jit select"));
+		}
+
+		tprintf(TEXT("%" TFMT_S "\n"), nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	// impure counter in the branches: called only for the rows which take them
+	size_t nTicks = 0, nTaken = 0;
+	CMyParser parser;
+	parser.AddFunc( TEXT("tick"), 0 ) = [ &nTicks ]( const std::vector<TOK> & varg ) { return TOK( (long double) ++nTicks ); };
+	parser.Compile( TEXT("select(x > 1, tick(), 0) + and(x < 1, tick())") );
+
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+	optimizer.Optimize( prog );
+
+	std::mt19937_64 rng( 1 );
+	std::uniform_real_distribution<double> dist( 0.5, 2.0 );
+	std::vector<TOK> vslots( prog.Slots().size() );
+	for(size_t n = 0; n < lazyOpt.nRows; ++n)
+	{
+		TOK x( dist( rng ) );
+		x.var = TRUE;
+		x.name = TEXT("x");
+		parser.AddVariable( TEXT("x"), x );
+		parser.Evaluate();
+
+		vslots[ prog.Slot( TEXT("x") ) ] = x;
+		prog.Execute( vslots.data() );
+		nTaken += 2;		// one of the branches in each of the interpreter and the program
+	}
+
+	tprintf(TEXT("impure tick() in the branches: %ld calls for %ld taken branches%" TFMT_S "\n"), nTicks, nTaken, nTicks == nTaken ? TEXT("") : TEXT(" MISMATCH"));
+	return ( nFailed || nTicks != nTaken ? 1 : 0 );
+}
+
+// sum over the index against the same series written term by term, then the long ranges
+// which programs split over the threads. The reduction is pairwise over the fixed blocks, so
+// the program must give the same values as the interpreter, which evaluates them in turn
+static int BenchSeries( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+	const size_t nRows = std::min<size_t>( opt.nRows, 16 );
+	BENCH_OPTIONS seriesOpt = opt;
+	seriesOpt.nRows = nRows;
+
+	if ( opt.fCorpus )
+	{
+		for(const size_t nTerms : { 100, 1000, 3000 })
+		{
+			CStringOp sExpanded, sSum = CStringOp().Format( TEXT("sum(k, 1, %ld, 1/(1 + k*x)^2)"), nTerms );
+			for(size_t k = 1; k <= nTerms; ++k)
+			{
+				sExpanded += CStringOp().Format( TEXT("%" TFMT_S "1/(1 + %ld*x)^2"), k > 1 ? TEXT(" + ") : TEXT(""), k );
+			}
+
+			BENCH_INPUT expanded, sum;
+			auto t0 = std::chrono::steady_clock::now();
+			BOOL fCompiled = Prepare( sExpanded, nRows, expanded );
+			const double msExpanded = Elapsed( t0, 1000000 );
+
+			t0 = std::chrono::steady_clock::now();
+			fCompiled = Prepare( sSum, nRows, sum ) && fCompiled;
+			const double msSum = Elapsed( t0, 1000000 );
+			if ( !fCompiled )
+			{
+				nFailed++;
+				continue;
+			}
+
+			// the sum has the slot of the index too, x must be the same
+			const size_t uX = expanded.prog.Slot( TEXT("x") ), cSum = sum.prog.Slots().size();
+			for(size_t n = 0; n < nRows; ++n)
+			{
+				sum.vvalues[ n * cSum + sum.prog.Slot( TEXT("x") ) ] = expanded.vvalues[ n * expanded.prog.Slots().size() + uX ];
+			}
+
+			std::vector<std::complex<long double>> vexpanded( nRows ), vsum( nRows );
+			t0 = std::chrono::steady_clock::now();
+			for(size_t n = 0; n < nRows; ++n) vexpanded[n] = Interpret( expanded, n );
+			const double nsExpanded = Elapsed( t0, nRows );
+
+			t0 = std::chrono::steady_clock::now();
+			for(size_t n = 0; n < nRows; ++n) vsum[n] = Interpret( sum, n );
+			const double nsSum = Elapsed( t0, nRows );
+
+			size_t nMismatch = 0;
+			long double maxErr = 0;
+			for(size_t n = 0; n < nRows; ++n)
+			{
+				if ( !Close( vsum[n], vexpanded[n], opt.tol, maxErr ) ) nMismatch++;
+			}
+
+			// the best of 5 runs, the first one of the sum makes its plan. The body of the sum is
+			// evaluated by chunks, so the program must be faster than the one of the terms
+			double nsExpandedProg = std::numeric_limits<double>::infinity(), nsSumProg = nsExpandedProg;
+			for(size_t r = 0; r < 5; ++r)
+			{
+				nsExpandedProg = std::min( nsExpandedProg, Measure( expanded, seriesOpt, vexpanded, [ &expanded ]( TOK * pSlots ) { return expanded.prog.Execute( pSlots ); }, nMismatch ) );
+				nsSumProg = std::min( nsSumProg, Measure( sum, seriesOpt, vexpanded, [ &sum ]( TOK * pSlots ) { return sum.prog.Execute( pSlots ); }, nMismatch ) );
+			}
+
+			const BOOL fSlower = ( nsSumProg >= nsExpandedProg );
+			tprintf(TEXT("%5ld terms: compile %9.2f -> %6.3f ms, interp %10.0f -> %9.0f ns, program %9.0f -> %9.0f ns x%-4.2f, nodes %5ld -> %ld%" TFMT_S "%" TFMT_S "\n"),
+				nTerms, msExpanded, msSum, nsExpanded, nsSum, nsExpandedProg, nsSumProg, nsExpandedProg / nsSumProg, expanded.prog.Nodes().size(), sum.prog.Nodes().size(),
+				nMismatch ? TEXT(" MISMATCH") : TEXT(""), fSlower ? TEXT(" FAILED") : TEXT(""));
+			nFailed += ( nMismatch || fSlower ? 1 : 0 );
+		}
+	}
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.assign( std::begin( g_vszSeriesCorpus ), std::end( g_vszSeriesCorpus ) );
+	}
+
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, 1, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		auto t0 = std::chrono::steady_clock::now();
+		const std::vector<std::complex<long double>> vinterp( 1, Interpret( in, 0 ) );
+		const double msInterp = Elapsed( t0, 1000000 );
+
+		// the values must be the same, not close
+		size_t nMismatch = 0;
+		BENCH_OPTIONS exactOpt = opt;
+		exactOpt.nRows = 1;
+		exactOpt.tol = 0;
+
+		const size_t nThreads = CExprProgram<TOK>::ReduceThreads(), nParallel = std::max<size_t>( nThreads, 4 );
+		CExprProgram<TOK>::ReduceThreads() = 1;
+		const double msProgram = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nParallel;
+		const double msParallel = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nThreads;
+
+		// optimized body, e.g. powers by multiplications, is close to the others only
+		BENCH_OPTIONS closeOpt = opt;
+		closeOpt.nRows = 1;
+		CExprProgram<TOK> optimized = in.prog;
+		CExprOptimizer<TOK> optimizer;
+		CMyParser::Optimizer( optimizer );
+		optimizer.Optimize( optimized );
+		const double msOptimized = Measure( in, closeOpt, vinterp, [ &optimized ]( TOK * pSlots ) { return optimized.Execute( pSlots ); }, nMismatch ) / 1000000;
+
+		tprintf(TEXT("%-48" TFMT_S " = %-24.17Lg interp %8.2f ms, program %8.2f ms, %2ld threads %8.2f ms, optimized %8.2f ms%" TFMT_S "\n"),
+			sExpression.GetString(), vinterp[0].real(), msInterp, msProgram, nParallel, msParallel, msOptimized,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	// impure body is evaluated in turn by the program too
+	size_t nTicks = 0;
+	CMyParser parser;
+	parser.AddFunc( TEXT("tick"), 0 ) = [ &nTicks ]( const std::vector<TOK> & varg ) { return TOK( (long double) ++nTicks ); };
+	parser.Compile( TEXT("sum(k, 1, 50000, tick())") );
+
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+	std::vector<TOK> vslots( prog.Slots().size() );
+	const TOK result = prog.Execute( vslots.data() );
+	const BOOL fTicks = ( nTicks == 50000 && result.v.real() == 50000.0L * 50001.0L / 2 );
+
+	tprintf(TEXT("impure tick() in the body: %ld calls, sum %.0Lf%" TFMT_S "\n"), nTicks, result.v.real(), fTicks ? TEXT("") : TEXT(" MISMATCH"));
+	return ( nFailed || !fTicks ? 1 : 0 );
+}
+
+// integral by the host loop which evaluates the compiled body point by point, against the
+// built-in function in the interpreter and in the program, and the program over threads
+static int BenchIntegrate( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+	for(const auto & integral : g_vIntegralCorpus)
+	{
+		const CStringOp sExpression = CStringOp().Format( TEXT("integrate(x, %.21Lg, %.21Lg, %" TFMT_S ", %.3Lg)"), integral.a, integral.b, integral.pszBody, integral.tol );
+
+		// the host loop
+		CMyParser host;
+		host.Compile( integral.pszBody );
+		auto batch = [ &host ]( const long double * px, std::complex<long double> * py, size_t count )
+		{
+			for(size_t n = 0; n < count; ++n)
+			{
+				TOK x( px[n] ), result;
+				x.var = TRUE;
+				host.AddVariable( TEXT("x"), x );
+				host.Evaluate();
+				host.Result( result );
+				py[n] = result.v;
+			}
+		};
+
+		EXPR_NUMERIC_REPORT report( TEXT("host") );
+		auto t0 = std::chrono::steady_clock::now();
+		const std::complex<long double> vhost = CExprQuadrature<long double, std::complex<long double>>::Integrate( batch, integral.a, integral.b, integral.tol, report );
+		const double msHost = Elapsed( t0, 1000000 );
+
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, 1, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		t0 = std::chrono::steady_clock::now();
+		const std::vector<std::complex<long double>> vinterp( 1, Interpret( in, 0 ) );
+		const double msInterp = Elapsed( t0, 1000000 );
+		report = CMyParser::Report();
+
+		// the same points give the same values in any order
+		size_t nMismatch = 0;
+		BENCH_OPTIONS exactOpt = opt;
+		exactOpt.nRows = 1;
+		exactOpt.tol = 0;
+
+		const size_t nThreads = CExprProgram<TOK>::ReduceThreads(), nParallel = std::max<size_t>( nThreads, 4 );
+		CExprProgram<TOK>::ReduceThreads() = 1;
+		const double msProgram = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nParallel;
+		const double msParallel = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nThreads;
+
+		long double maxErr = 0;
+		nMismatch += ( Close( vhost, vinterp[0], 0, maxErr ) ? 0 : 1 );
+		const long double err = std::abs( vinterp[0] - std::complex<long double>( integral.exact ) );
+		nMismatch += ( !std::isnan( integral.exact ) && !( err <= std::max( integral.tol, report.error ) ) ? 1 : 0 );
+
+		tprintf(TEXT("%-28" TFMT_S " = %-21.17Lg evals %6ld, rounds %2ld, error %8.2Lg (est %8.2Lg), host %8.2f ms, interp %8.2f ms, program %7.2f ms, %2ld threads %7.2f ms%" TFMT_S "\n"),
+			integral.pszBody, vinterp[0].real(), report.nEvals, report.nIterations, err, report.error, msHost, msInterp, msProgram, nParallel, msParallel,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// roots and minimums by the host loop which evaluates the compiled body and its tangent point
+// by point, and by Newton steps over the known derivative, against the built-in functions in the interpreter
+// and in the program
+static int BenchSolve( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+	for(const auto & eq : g_vSolveCorpus)
+	{
+		const BOOL fMinimize = eq.fMinimize;
+		const long double tol = ( fMinimize ? MINIMIZE_TOLERANCE : SOLVE_TOLERANCE );
+		const CStringOp sExpression = CStringOp().Format( TEXT("%" TFMT_S "(x, %" TFMT_S ", %.21Lg)"), fMinimize ? TEXT("minimize") : TEXT("solve"), eq.pszBody, eq.x0 );
+
+		// the host loop
+		CMyParser host;
+		host.Compile( eq.pszBody );
+		auto f = [ &host ]( long double v )
+		{
+			TOK x( v ), result;
+			x.var = TRUE;
+			host.AddVariable( TEXT("x"), x );
+			host.Evaluate();
+			host.Result( result );
+			return result.v.real();
+		};
+
+		// and its tangent by x, as solve takes it. Lazy bodies have no tangent
+		CExprDerivatives<TOK> rules;
+		CMyParser::Derivatives( rules );
+		CExprProgram<TOK> body;
+		body.Build( host.Tree() );
+		std::unique_ptr<CExprDiff<TOK>> pdiff;
+		if ( !body.Lazy() )
+		{
+			pdiff.reset( new CExprDiff<TOK>( rules, body ) );
+		}
+
+		std::vector<TOK> vslot( body.Slots().size(), TOK( 0.0L ) ), vdir( vslot.size(), TOK( 0.0L ) );
+		const size_t uVar = body.Slot( TEXT("x") );
+		vdir[uVar] = TOK( 1.0L );
+		CExprSolver<long double>::DERIV fdf;
+		if ( pdiff )
+		{
+			fdf = [ &pdiff, &vslot, &vdir, uVar ]( long double v, long double & df )
+			{
+				vslot[uVar].v = v;
+				TOK y;
+				df = pdiff->Tangent( vslot.data(), vdir.data(), y ).v.real();
+				return y.v.real();
+			};
+		}
+
+		EXPR_NUMERIC_REPORT report( TEXT("host") );
+		auto t0 = std::chrono::steady_clock::now();
+		const long double xhost = ( fMinimize ? CExprSolver<long double>::Minimize( f, eq.x0, tol, report ) :
+			CExprSolver<long double>::Solve( f, fdf, eq.x0, tol, report ) );
+		const double usHost = Elapsed( t0, 1000 );
+
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, 1, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		t0 = std::chrono::steady_clock::now();
+		const std::vector<std::complex<long double>> vinterp( 1, Interpret( in, 0 ) );
+		const double usInterp = Elapsed( t0, 1000 );
+		report = CMyParser::Report();
+
+		// the same steps give the same points
+		size_t nMismatch = 0;
+		BENCH_OPTIONS exactOpt = opt;
+		exactOpt.nRows = 1;
+		exactOpt.tol = 0;
+		const double usProgram = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000;
+
+		long double maxErr = 0;
+		nMismatch += ( Close( xhost, vinterp[0], 0, maxErr ) ? 0 : 1 );
+		nMismatch += ( report.fConverged ? 0 : 1 );
+
+		// minimums are found to the square root of the precision of the body only
+		const long double err = std::abs( vinterp[0] - std::complex<long double>( eq.exact ) );
+		nMismatch += ( err <= ( fMinimize ? 1e-8L : 1e-15L ) * ( 1 + std::abs( eq.exact ) ) ? 0 : 1 );
+
+		CStringOp sNewton;
+		if ( eq.fdf )
+		{
+			EXPR_NUMERIC_REPORT newton( TEXT("newton") );
+			const long double xnewton = CExprSolver<long double>::Solve( [ &eq ]( long double x ) { long double df; return eq.fdf( x, df ); }, eq.fdf, eq.x0, tol, newton );
+			nMismatch += ( newton.fConverged && std::abs( xnewton - eq.exact ) <= 1e-15L * ( 1 + std::abs( eq.exact ) ) ? 0 : 1 );
+			sNewton.Format( TEXT(", newton %2ld steps"), newton.nIterations );
+		}
+
+		tprintf(TEXT("%-44" TFMT_S " = %-21.17Lg evals %3ld, steps %2ld, error %8.2Lg, host %8.2f us, interp %8.2f us, program %8.2f us%" TFMT_S "%" TFMT_S "\n"),
+			sExpression.GetString(), vinterp[0].real(), report.nEvals, report.nIterations, err, usHost, usInterp, usProgram, sNewton.GetString(),
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// Monte Carlo by the host loop which evaluates the compiled body sample by sample, against the
+// built-in function in the interpreter, in the program and in the program over threads
+static int BenchMc( const BENCH_OPTIONS & opt )
+{
+	size_t nFailed = 0;
+	for(const auto & mc : g_vMcCorpus)
+	{
+		const CStringOp sExpression = CStringOp().Format( TEXT("mc(k, %ld, %" TFMT_S ")"), mc.count, mc.pszBody );
+
+		// the host loop
+		CMyParser host;
+		host.Compile( mc.pszBody );
+		auto batch = [ &host ]( size_t first, std::complex<long double> * py, size_t count )
+		{
+			for(size_t n = 0; n < count; ++n)
+			{
+				TOK k( (long double) ( first + n ) ), result;
+				k.var = TRUE;
+				host.AddVariable( TEXT("k"), k );
+				host.Evaluate();
+				host.Result( result );
+				py[n] = result.v;
+			}
+		};
+
+		EXPR_NUMERIC_REPORT report( TEXT("host") );
+		auto t0 = std::chrono::steady_clock::now();
+		const std::complex<long double> vhost = CExprMonteCarlo<std::complex<long double>>::Mean( batch, mc.count, report );
+		const double msHost = Elapsed( t0, 1000000 );
+
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, 1, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		t0 = std::chrono::steady_clock::now();
+		const std::vector<std::complex<long double>> vinterp( 1, Interpret( in, 0 ) );
+		const double msInterp = Elapsed( t0, 1000000 );
+		report = CMyParser::Report();
+
+		// the samples are the same for any count of threads
+		size_t nMismatch = 0;
+		BENCH_OPTIONS exactOpt = opt;
+		exactOpt.nRows = 1;
+		exactOpt.tol = 0;
+
+		const size_t nThreads = CExprProgram<TOK>::ReduceThreads(), nParallel = std::max<size_t>( nThreads, 4 );
+		CExprProgram<TOK>::ReduceThreads() = 1;
+		const double msProgram = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nParallel;
+		const double msParallel = Measure( in, exactOpt, vinterp, [ &in ]( TOK * pSlots ) { return in.prog.Execute( pSlots ); }, nMismatch ) / 1000000;
+		CExprProgram<TOK>::ReduceThreads() = nThreads;
+
+		long double maxErr = 0;
+		nMismatch += ( Close( vhost, vinterp[0], 0, maxErr ) ? 0 : 1 );
+
+		// the samples are fixed, so the exact mean is checked within two intervals
+		const long double err = std::abs( vinterp[0] - std::complex<long double>( mc.exact ) );
+		nMismatch += ( err <= 2 * report.error ? 0 : 1 );
+
+		tprintf(TEXT("%-72" TFMT_S " = %-10.6Lg +- %-9.3Lg var %-9.4Lg error %8.2Lg, host %8.2f ms, interp %8.2f ms, program %7.2f ms, %2ld threads %7.2f ms%" TFMT_S "\n"),
+			mc.pszBody, vinterp[0].real(), report.error, report.variance, err, msHost, msInterp, msProgram, nParallel, msParallel,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// powers of "diff" mode at the zero base and their exact derivatives by x
+typedef struct _tagBENCH_POINT
+{
+	LPCTSTR					pszFormula;
+	long double				x;
+	long double				exact;
+} BENCH_POINT;
+
+static const BENCH_POINT g_vZeroCorpus[] =
+{
+	{ TEXT("x^0"), 0, 0 },
+	{ TEXT("x^1"), 0, 1 },
+	{ TEXT("x^2"), 0, 0 },
+	{ TEXT("x^3 + x"), 0, 1 },
+	{ TEXT("(x + 1)^2"), -1, 0 },
+	{ TEXT("x^1.5"), 0, 0 },
+};
+
+// sum of the terms in va, vb, ... of "diff" mode. Names are of the same length, the parser
+// would read x10 as x1 followed by 0 once x1 is known
+static CStringOp ChainFormula( size_t nVars )
+{
+	CStringOp s;
+	for(size_t k = 1; k < nVars && k < 26; ++k)
+	{
+		const TCHAR a = TCHAR( 'a' + k - 1 ), b = TCHAR( 'a' + k );
+		s += CStringOp().Format( TEXT("%" TFMT_S "sin(v%c)*exp(0.1*v%c) + v%c^2/(1 + v%c^2)"), k > 1 ? TEXT(" + ") : TEXT(""), a, b, a, b );
+	}
+
+	return s;
+}
+
+// gradients by the forward and the reverse modes against the central differences made by the
+// program and by the interpreter, 2N evaluations each. The modes must agree with each other
+// and with the differences to their error
+static int BenchDiff( const BENCH_OPTIONS & opt )
+{
+	CExprDerivatives<TOK> rules;
+	CMyParser::Derivatives( rules );
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.push_back( ChainFormula( 25 ) );
+	}
+
+	const size_t nRows = std::min<size_t>( opt.nRows, 200 );
+	size_t nFailed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		std::unique_ptr<CExprDiff<TOK>> pdiff;
+		try
+		{
+			pdiff.reset( new CExprDiff<TOK>( rules, in.prog ) );
+		}
+		catch( CExprParserException & e )
+		{
+			tprintf(TEXT("%-48" TFMT_S " can't be differentiated: %" TFMT_S "\n"), sExpression.GetString(), e.Message().GetString());
+			continue;
+		}
+
+		const size_t nslots = in.prog.Slots().size();
+		std::vector<TOK> vslots, vgrad( nslots ), vfwd( nslots ), vfd( nslots ), vdir( nslots, TOK( 0.0L ) );
+		double nsReverse = 0, nsForward = 0, nsProgram = 0, nsParser = 0;
+		long double maxModes = 0, maxFd = 0;
+		size_t nMismatch = 0;
+
+		for(size_t r = 0; r < nRows; ++r)
+		{
+			Row( in, r, vslots );
+			const TOK exact = in.prog.Execute( vslots.data() );
+
+			auto t0 = std::chrono::steady_clock::now();
+			const TOK value = pdiff->Gradient( vslots.data(), vgrad.data() );
+			nsReverse += Elapsed( t0, 1 );
+
+			t0 = std::chrono::steady_clock::now();
+			for(size_t i = 0; i < nslots; ++i)
+			{
+				TOK v;
+				vdir[i] = TOK( 1.0L );
+				vfwd[i] = pdiff->Tangent( vslots.data(), vdir.data(), v );
+				vdir[i] = TOK( 0.0L );
+			}
+			nsForward += Elapsed( t0, 1 );
+
+			// central differences with the step near the cube root of the precision
+			t0 = std::chrono::steady_clock::now();
+			for(size_t i = 0; i < nslots; ++i)
+			{
+				const std::complex<long double> x = vslots[i].v;
+				const long double h = 5e-7L * std::max( 1.0L, std::abs( x ) );
+				vslots[i].v = x + h;
+				const std::complex<long double> fp = in.prog.Execute( vslots.data() ).v;
+				vslots[i].v = x - h;
+				const std::complex<long double> fm = in.prog.Execute( vslots.data() ).v;
+				vslots[i].v = x;
+				vfd[i] = TOK( ( fp - fm ) / ( 2 * h ) );
+			}
+			nsProgram += Elapsed( t0, 1 );
+
+			t0 = std::chrono::steady_clock::now();
+			Interpret( in, r );
+			for(size_t i = 0; i < nslots; ++i)
+			{
+				const std::complex<long double> x = in.vvalues[ r * nslots + i ];
+				const long double h = 5e-7L * std::max( 1.0L, std::abs( x ) );
+				TOK tok( x + h );
+				tok.var = TRUE;
+				in.parser.AddVariable( in.prog.Slots()[i].GetString(), tok );
+				in.parser.Evaluate();
+				tok.v = x - h;
+				in.parser.AddVariable( in.prog.Slots()[i].GetString(), tok );
+				in.parser.Evaluate();
+				tok.v = x;
+				in.parser.AddVariable( in.prog.Slots()[i].GetString(), tok );
+			}
+			nsParser += Elapsed( t0, 1 );
+
+			nMismatch += ( Close( value.v, exact.v, 0, maxModes ) ? 0 : 1 );
+			for(size_t i = 0; i < nslots; ++i)
+			{
+				nMismatch += ( Close( vfwd[i].v, vgrad[i].v, 1e-15L, maxModes ) ? 0 : 1 );
+				nMismatch += ( Close( vfd[i].v, vgrad[i].v, 1e-7L, maxFd ) ? 0 : 1 );
+			}
+		}
+
+		tprintf(TEXT("%-48.48" TFMT_S " %2ld vars: reverse %8.0f ns, forward %8.0f ns, differences by program %8.0f ns, by parser %9.0f ns, modes %7.2Lg, differences %7.2Lg%" TFMT_S "\n"),
+			sExpression.GetString(), nslots, nsReverse / nRows, nsForward / nRows, nsProgram / nRows, nsParser / nRows, maxModes, maxFd,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	// the tangent is the derivative of the solver's Newton steps
+	CMyParser parser;
+	parser.Compile( TEXT("x^3 - 2x - 5") );
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+	CExprDiff<TOK> diff( rules, prog );
+	auto fdf = [ &diff ]( long double x, long double & df )
+	{
+		TOK slot( x ), dir( 1.0L ), value;
+		df = diff.Tangent( &slot, &dir, value ).v.real();
+		return value.v.real();
+	};
+
+	EXPR_NUMERIC_REPORT report( TEXT("newton") );
+	const long double root = CExprSolver<long double>::Solve( [ &fdf ]( long double x ) { long double df; return fdf( x, df ); }, fdf, 3, SOLVE_TOLERANCE, report );
+	const BOOL fNewton = ( report.fConverged && std::abs( root - 2.09455148154232659148238654057930296L ) < 1e-15L );
+	tprintf(TEXT("Newton steps over the tangent of x^3 - 2x - 5: root %.17Lg, %ld steps%" TFMT_S "\n"), root, report.nIterations, fNewton ? TEXT("") : TEXT(" MISMATCH"));
+
+	// both modes at the zero base, where b a^(b - 1) of the complex std::pow is NaN for b = 1
+	for(const auto & point : g_vZeroCorpus)
+	{
+		CMyParser zero;
+		zero.Compile( point.pszFormula );
+		CExprProgram<TOK> body;
+		body.Build( zero.Tree() );
+		CExprDiff<TOK> dz( rules, body );
+
+		TOK slot( point.x ), dir( 1.0L ), value, grad;
+		const std::complex<long double> fwd = dz.Tangent( &slot, &dir, value ).v;
+		dz.Gradient( &slot, &grad );
+		const BOOL fExact = ( fwd == std::complex<long double>( point.exact ) && grad.v == fwd );
+		tprintf(TEXT("%-16" TFMT_S " at %-4Lg: forward %-6Lg reverse %-6Lg%" TFMT_S "\n"), point.pszFormula, point.x, fwd.real(), grad.v.real(), fExact ? TEXT("") : TEXT(" MISMATCH"));
+		nFailed += ( fExact ? 0 : 1 );
+	}
+
+	return ( nFailed || !fNewton ? 1 : 0 );
+}
+
+// formulas with the parts which depend on the session constants only, for "specialize" mode
+static LPCTSTR g_vszSessionCorpus[] =
+{
+	TEXT("exp(-r*t)*sqrt(s^2*t)*x + sin(a*b)*x^2"),
+	TEXT("(a^2 + b^2)^(1/3)*cos(a - b)*x + arctg(a*b + 1)/(1 + x^2)"),
+	TEXT("exp(-a*b)*select(x > b, x - b, 0)"),
+};
+
+// partial evaluation: the variables besides x, or the first half of them if there is no x,
+// take the values of the first row in all rows and are fixed. The specialized program against the general one
+static int BenchSpecialize( const BENCH_OPTIONS & opt )
+{
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.insert( vexpr.end(), std::begin( g_vszSessionCorpus ), std::end( g_vszSessionCorpus ) );
+	}
+
+	size_t nFailed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		// bound variables of the lazy functions can't be fixed
+		const auto & vnames = in.prog.Slots();
+		const size_t nslots = vnames.size();
+		const BOOL fX = ( in.prog.Slot( CStringOp( TEXT("x") ) ) != size_t( -1 ) );
+		std::map<CStringOp, TOK> mfixed;
+		CStringOp sFixed;
+		for(size_t v = 0; v < ( fX ? nslots : nslots / 2 ); ++v)
+		{
+			if ( vnames[v] == CStringOp( TEXT("x") ) || optimizer.Assigns( in.prog, v ) )
+			{
+				continue;
+			}
+
+			mfixed[ vnames[v] ] = TOK( in.vvalues[v] );
+			sFixed += vnames[v];
+			for(size_t n = 1; n < opt.nRows; ++n) in.vvalues[ n * nslots + v ] = in.vvalues[v];
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		CExprProgram<TOK> general = in.prog, special;
+		optimizer.Optimize( general );
+		try
+		{
+			special = optimizer.Specialize( in.prog, mfixed );
+		}
+		catch( CExprParserException & e )
+		{
+			tprintf(TEXT("%-56" TFMT_S " can't be specialized: %" TFMT_S "\n"), sExpression.GetString(), e.Message().GetString());
+			continue;
+		}
+
+		size_t nMismatch = 0;
+		const double nsGeneral = Measure( in, opt, vinterp, [ &general ]( TOK * pSlots ) { return general.Execute( pSlots ); }, nMismatch );
+		const double nsSpecial = Measure( in, opt, vinterp, [ &special ]( TOK * pSlots ) { return special.Execute( pSlots ); }, nMismatch );
+
+		tprintf(TEXT("%-56" TFMT_S " fixed %-3" TFMT_S " nodes %2ld -> %2ld, %8.1f ns -> %8.1f ns x%-5.2f%" TFMT_S "\n"), sExpression.GetString(),
+			mfixed.size() ? sFixed.GetString() : TEXT("-"), general.Nodes().size(), special.Nodes().size(), nsGeneral, nsSpecial, nsGeneral / nsSpecial,
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	// bound variables can't be fixed
+	CMyParser parser;
+	parser.Compile( TEXT("integrate(y, 0, x, y^2)") );
+	CExprProgram<TOK> prog;
+	prog.Build( parser.Tree() );
+
+	BOOL fRejected = FALSE;
+	try
+	{
+		optimizer.Specialize( prog, { { CStringOp( TEXT("y") ), TOK( 1.0L ) } } );
+	}
+	catch( CExprParserException & e )
+	{
+		fRejected = TRUE;
+	}
+
+	tprintf(TEXT("fixed bound variable: %" TFMT_S "\n"), fRejected ? TEXT("rejected") : TEXT("accepted MISMATCH"));
+	return ( nFailed || !fRejected ? 1 : 0 );
+}
+
+// formulas with the session constants assigned before the swept variable, for "sweep" mode
+static LPCTSTR g_vszSweepCorpus[] =
+{
+	TEXT("a = 1.5; b = exp(-a)*cos(a); b*sin(x) + a*x^2"),
+	TEXT("r = 0.05; t = 2; exp(-r*t)*select(x > 1, x - 1, 0) + r*x"),
+	TEXT("integrate(y, 0, 1, exp(-y^2)*cos(y))*x^2 + x"),
+};
+
+// x, or the first variable if there is no x, takes the values of the grid, the others are
+// the values of the first row. The rows of the sweep against the general program per row
+static int BenchSweep( const BENCH_OPTIONS & opt )
+{
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	std::vector<CStringOp> vexpr = opt.vexpr;
+	if ( opt.fCorpus )
+	{
+		vexpr.insert( vexpr.end(), std::begin( g_vszSessionCorpus ), std::end( g_vszSessionCorpus ) );
+		vexpr.insert( vexpr.end(), std::begin( g_vszSweepCorpus ), std::end( g_vszSweepCorpus ) );
+	}
+
+	size_t nFailed = 0;
+	for(const auto & sExpression : vexpr)
+	{
+		BENCH_INPUT in;
+		if ( !Prepare( sExpression, opt.nRows, in ) )
+		{
+			nFailed++;
+			continue;
+		}
+
+		const size_t nslots = in.prog.Slots().size();
+		size_t uX = in.prog.Slot( CStringOp( TEXT("x") ) );
+		uX = ( uX == size_t( -1 ) ? 0 : uX );
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			for(size_t v = 0; v < nslots; ++v)
+			{
+				in.vvalues[ n * nslots + v ] = ( v == uX ? 0.5L + 1.5L * n / opt.nRows : in.vvalues[v] );
+			}
+		}
+
+		std::vector<std::complex<long double>> vinterp( opt.nRows );
+		for(size_t n = 0; n < opt.nRows; ++n) vinterp[n] = Interpret( in, n );
+
+		CExprProgram<TOK> general = in.prog;
+		optimizer.Optimize( general );
+		CExprSweep<TOK> sweep( in.prog, uX < nslots ? std::vector<size_t>( 1, uX ) : std::vector<size_t>(), optimizer );
+
+		std::vector<TOK> vrows, vslots;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			Row( in, n, vslots );
+			vrows.insert( vrows.end(), vslots.begin(), vslots.end() );
+		}
+
+		std::vector<TOK> vres( opt.nRows );
+		std::vector<std::complex<long double>> vgeneral( opt.nRows );
+		auto t0 = std::chrono::steady_clock::now();
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			std::copy( vrows.begin() + n * nslots, vrows.begin() + ( n + 1 ) * nslots, vslots.begin() );
+			vgeneral[n] = Run( [ &general ]( TOK * pSlots ) { return general.Execute( pSlots ); }, vslots.data() );
+		}
+		const double nsGeneral = Elapsed( t0, opt.nRows );
+
+		double nsSweep = 0;
+		size_t nMismatch = 0;
+		try
+		{
+			t0 = std::chrono::steady_clock::now();
+			sweep.Evaluate( vrows.data(), opt.nRows, vres.data() );
+			nsSweep = Elapsed( t0, opt.nRows );
+		}
+		catch( CExprParserException & e )
+		{
+			nMismatch++;
+		}
+
+		// the same operations in the same order give the same values
+		long double maxErr = 0;
+		for(size_t n = 0; n < opt.nRows; ++n)
+		{
+			nMismatch += ( Close( vres[n].v, vinterp[n], opt.tol, maxErr ) && Close( vres[n].v, vgeneral[n], 0, maxErr ) ? 0 : 1 );
+		}
+
+		tprintf(TEXT("%-56" TFMT_S " nodes %2ld: %2ld per batch, %2ld per row, %8.1f ns -> %8.1f ns x%-5.2f%" TFMT_S "%" TFMT_S "\n"), sExpression.GetString(),
+			sweep.Nodes(), sweep.BatchNodes(), sweep.RowNodes(), nsGeneral, nsSweep, nsGeneral / nsSweep, sweep.Hoisted() ? TEXT("") : TEXT(" (plain)"),
+			nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+		nFailed += ( nMismatch ? 1 : 0 );
+	}
+
+	return ( nFailed ? 1 : 0 );
+}
+
+// formula k of the set which shares the subterms, for "multi" mode
+static CStringOp MultiFormula( size_t k )
+{
+	static LPCTSTR vszTerm[] =
+	{
+		TEXT("sin(x)*exp(-y^2)"), TEXT("sqrt(x^2 + y^2 + z^2)"), TEXT("cos(z - w)/(1 + w^2)"), TEXT("(x + y)^3"),
+		TEXT("arctg(x/z)"), TEXT("exp(-(x - w)^2)"), TEXT("cbrt(y*z + 1)"), TEXT("sinc(w*x)"),
+	};
+
+	const size_t nTerms = sizeof( vszTerm ) / sizeof( vszTerm[0] );
+	return CStringOp().Format( TEXT("(%" TFMT_S ")*%ld + (%" TFMT_S ")/%ld - (%" TFMT_S ")^2"), vszTerm[ k % nTerms ], k + 1,
+		vszTerm[ ( k / nTerms ) % nTerms ], k + 2, vszTerm[ ( 5 * k + 3 ) % nTerms ]);
+}
+
+// the set of expressions by separate parsers, by separate programs and by one program of
+// all of them. The program of the set must give the same values as the separate ones
+static BOOL BenchMultiSet( LPCTSTR pszSet, const std::vector<CStringOp> & vexpr, const BENCH_OPTIONS & opt, const CExprOptimizer<TOK> & optimizer )
+{
+	const size_t nRows = std::min<size_t>( opt.nRows, 2000 );
+	std::vector<std::unique_ptr<BENCH_INPUT>> vin;
+	std::vector<CExprProgram<TOK>> vprog;
+	CExprMulti<TOK> multi;
+	size_t nNodes = 0;
+
+	for(const auto & sExpression : vexpr)
+	{
+		vin.emplace_back( new BENCH_INPUT );
+		if ( !Prepare( sExpression, nRows, *vin.back() ) )
+		{
+			return FALSE;
+		}
+
+		multi.Add( vin.back()->prog );
+		vprog.push_back( vin.back()->prog );
+		optimizer.Optimize( vprog.back() );
+		nNodes += vprog.back().Nodes().size();
+	}
+
+	multi.Optimize( optimizer );
+
+	// the same values of the variables for all expressions
+	const size_t nslots = multi.Slots().size(), nout = multi.Outputs();
+	std::mt19937_64 rng( 1 );
+	std::uniform_real_distribution<double> dist( 0.5, 2.0 );
+	std::vector<std::complex<long double>> vvalues( nRows * nslots );
+	for(auto & v : vvalues) v = dist( rng );
+
+	std::vector<std::vector<TOK>> vrows( vexpr.size() );
+	std::vector<TOK> vmultiRows, vslots;
+	for(size_t f = 0; f < vexpr.size(); ++f)
+	{
+		BENCH_INPUT & in = *vin[f];
+		const size_t ns = in.prog.Slots().size();
+		for(size_t n = 0; n < nRows; ++n)
+		{
+			for(size_t v = 0; v < ns; ++v) in.vvalues[ n * ns + v ] = vvalues[ n * nslots + multi.Program().Slot( in.prog.Slots()[v] ) ];
+			Row( in, n, vslots );
+			vrows[f].insert( vrows[f].end(), vslots.begin(), vslots.end() );
+		}
+	}
+
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		for(size_t v = 0; v < nslots; ++v)
+		{
+			TOK tok( vvalues[ n * nslots + v ] );
+			tok.var = TRUE;
+			tok.name = multi.Slots()[v];
+			vmultiRows.push_back( tok );
+		}
+	}
+
+	std::vector<std::complex<long double>> vinterp( nRows * nout ), vsep( nRows * nout );
+	auto t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		for(size_t f = 0; f < nout; ++f) vinterp[ n * nout + f ] = Interpret( *vin[f], n );
+	}
+	const double nsParsers = Elapsed( t0, nRows );
+
+	t0 = std::chrono::steady_clock::now();
+	for(size_t n = 0; n < nRows; ++n)
+	{
+		for(size_t f = 0; f < nout; ++f)
+		{
+			const size_t ns = vprog[f].Slots().size();
+			vslots.resize( ns );
+			std::copy( vrows[f].begin() + n * ns, vrows[f].begin() + ( n + 1 ) * ns, vslots.begin() );
+			const CExprProgram<TOK> & prog = vprog[f];
+			vsep[ n * nout + f ] = Run( [ &prog ]( TOK * pSlots ) { return prog.Execute( pSlots ); }, vslots.data() );
+		}
+	}
+	const double nsPrograms = Elapsed( t0, nRows );
+
+	std::vector<TOK> vres( nRows * nout );
+	size_t nMismatch = 0;
+	t0 = std::chrono::steady_clock::now();
+	try
+	{
+		multi.Evaluate( vmultiRows.data(), nRows, vres.data() );
+	}
+	catch( CExprParserException & e )
+	{
+		nMismatch++;
+	}
+	const double nsMulti = Elapsed( t0, nRows );
+
+	long double maxErr = 0, maxSep = 0;
+	for(size_t n = 0; n < nRows * nout; ++n)
+	{
+		nMismatch += ( Close( vres[n].v, vinterp[n], opt.tol, maxErr ) && Close( vres[n].v, vsep[n], 0, maxSep ) ? 0 : 1 );
+	}
+
+	tprintf(TEXT("%-10" TFMT_S " %3ld outputs: nodes %4ld -> %4ld, per row: parsers %9.0f ns, programs %8.0f ns, multi-output %8.0f ns x%-5.2f, error %7.2Lg%" TFMT_S "\n"),
+		pszSet, nout, nNodes, multi.Program().Nodes().size() - 1, nsParsers, nsPrograms, nsMulti, nsPrograms / nsMulti, maxErr, nMismatch ? TEXT(" MISMATCH") : TEXT(""));
+	return !nMismatch;
+}
+
+static int BenchMulti( const BENCH_OPTIONS & opt )
+{
+	CExprOptimizer<TOK> optimizer;
+	CMyParser::Optimizer( optimizer );
+
+	if ( !opt.fCorpus )
+	{
+		return ( BenchMultiSet( TEXT("arguments"), opt.vexpr, opt, optimizer ) ? 0 : 1 );
+	}
+
+	std::vector<CStringOp> vgenerated;
+	for(size_t k = 0; k < 100; ++k) vgenerated.push_back( MultiFormula( k ) );
+
+	const BOOL fCorpus = BenchMultiSet( TEXT("corpus"), opt.vexpr, opt, optimizer );
+	const BOOL fGenerated = BenchMultiSet( TEXT("generated"), vgenerated, opt, optimizer );
+	return ( fCorpus && fGenerated ? 0 : 1 );
+}
+
+int main(int argc, char ** argv, char ** env)
+{
+	static const struct
+	{
+		const char *	pszMode;
+		int				( *pfn )( const BENCH_OPTIONS & opt );
+	} vmode[] =
+	{
+		{ "limits", BenchLimits },
+		{ "jit", BenchJit },
+		{ "tier", BenchTier },
+		{ "profile", BenchProfile },
+		{ "kernels", BenchKernels },
+		{ "pow", BenchPow },
+		{ "poly", BenchPoly },
+		{ "fusion", BenchFusion },
+		{ "dd", BenchDD },
+		{ "int", BenchInteger },
+		{ "mixed", BenchMixed },
+		{ "const", BenchConst },
+		{ "builder", BenchBuilder },
+		{ "cse", BenchCse },
+		{ "memo", BenchMemo },
+		{ "lazy", BenchLazy },
+		{ "series", BenchSeries },
+		{ "integrate", BenchIntegrate },
+		{ "solve", BenchSolve },
+		{ "mc", BenchMc },
+		{ "diff", BenchDiff },
+		{ "specialize", BenchSpecialize },
+		{ "sweep", BenchSweep },
+		{ "multi", BenchMulti },
+	};
+
+	BENCH_OPTIONS opt;
+	opt.nRows = 20000;
+	opt.tol = 1e-9;
+	opt.fCorpus = FALSE;
+
+	int i = 2;
+	for(; i < argc - 1; i += 2)
+	{
+		if ( !strcmp(argv[i], "-n") ) opt.nRows = strtoul(argv[i + 1], nullptr, 10);
+		else if ( !strcmp(argv[i], "-t") ) opt.tol = strtold(argv[i + 1], nullptr);
+		else break;
+	}
+
+	for(; i < argc; ++i) opt.vexpr.push_back( CStringOp( argv[i] ) );
+	if ( !opt.vexpr.size() )
+	{
+		for(const auto & v : g_vszCorpus) opt.vexpr.push_back( v );
+		opt.fCorpus = TRUE;
+	}
+
+	for(const auto & v : vmode)
+	{
+		if ( argc > 1 && !strcmp(argv[1], v.pszMode) )
+		{
+			return v.pfn( opt );
+		}
+	}
+
+	tprintf(TEXT("Usage: mexprbench mode [-n rows] [-t tolerance] [expression ...]\nModes:"));
+	for(const auto & v : vmode) tprintf(TEXT(" %s"), v.pszMode);
+	tprintf(TEXT("\n"));
+	return 255;
+}
@@ -0,0 +1,83 @@
+/*
+    An universal parser for math-like expressions
+    Copyright (C) 2019 ALXR aka loginsin
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/* Ahead-of-time compiler: prints C++ header with the function evaluating an expression */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "Controls.h"
+#include "CMyCodeGen.h"
+
+int main(int argc, char ** argv, char ** env)
+{
+	BOOL fReal = FALSE;
+	CStringOp sName = TEXT("mexpr_fn");
+	int i = 1;
+
+	for(; i < argc - 1; ++i)
+	{
+		if ( !strcmp(argv[i], "-r") )
+		{
+			fReal = TRUE;
+		}
+		else if ( !strcmp(argv[i], "-n") && i + 1 < argc - 1 )
+		{
+			sName = CStringOp( argv[++i] );
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if ( i != argc - 1 )
+	{
+		tprintf(TEXT("Usage: mexprgen [-r] [-n name] expression\n"));
+		return 255;
+	}
+
+	try
+	{
+		CMyParser parser;
+		CExprProgram<TOK> prog;
+		CStringOp sExpression( argv[i] );
+
+		parser.Compile( sExpression.GetString() );
+		prog.Build( parser.Tree() );
+
+		CMyCodeGen gen( prog, fReal );
+		tprintf(
+#ifdef _UNICODE
+		TEXT("%ls")
+#else
+		TEXT("%s")
+#endif
+		, gen.Generate( sName.GetString(), sExpression.GetString() ).GetString() );
+	}
+	catch( CExprParserException & e )
+	{
+		tprintf(
+#ifdef _UNICODE
+		TEXT("Error compiling: %ls\n")
+#else
+		TEXT("Error compiling: %s\n")
+#endif
+, e.Message().GetString());
+		return 1;
+	}
+
+	return 0;
+}
@@ -43,6 +43,7 @@ typedef wchar_t			TCHAR;
 typedef const wchar_t*		LPCTSTR;
 #define _tcslen			wcslen
 #define _vsntprintf		vswprintf
+#define TFMT_S			"ls"		// conversion of the TCHAR string argument of Format
 #else
 #define TEXT(quote)			quote
 #define _T(x)				x
@@ -52,8 +53,10 @@ typedef char			TCHAR;
 typedef const char*		LPCTSTR;
 #define _tcslen			strlen
 #define _vsntprintf		vsnprintf
+#define TFMT_S			"s"
 #endif
 
+typedef unsigned int UINT;
 typedef unsigned long DWORD;
 typedef unsigned long long ULONG_PTR;
 typedef unsigned long long ULONGLONG;